@@ -0,0 +1,307 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include <expression.hpp>
+#include <height_field_codec.hpp>
+#include <heightmap_export.hpp>
+#include <project_file.hpp>
+#include <sequence_export.hpp>
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    /* Arguments */
+
+    static const char *EXPORT_EXTENSIONS[] = {".obj", ".glb", ".hfz", ".png", ".r32", ".hfh"};
+    static constexpr uint32_t MAX_DETAIL = 16384; // a 16385^2 grid of one surface is 1 GiB of floats
+
+    static std::string lowercase_extension(const std::string &path) {
+        auto extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    template <typename T>
+    static T parse_number(const std::string &option, const std::string &text) {
+        T value{};
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc{} || end != text.data() + text.size()) { throw std::runtime_error{"'" + text + "' is not a valid value for " + option}; }
+        return value;
+    }
+
+    // Applies job options to `job`; the command line also takes the options that only exist once, `command` is null for manifest lines
+    static void parse_options(const std::vector<std::string> &args, BatchJob &job, const std::filesystem::path &base, BatchCommand *command,
+                              std::string *manifest) {
+        const auto resolve = [&base](const std::string &path) { return std::filesystem::path(path).is_relative() ? (base / path).string() : path; };
+        for (size_t i = 0; i < args.size(); ++i) {
+            const auto &option = args[i];
+            if (i + 1 == args.size()) { throw std::runtime_error{option.starts_with("--") ? option + " needs a value" : "unexpected '" + option + "'"}; }
+            const auto &value = args[++i];
+            if      (option == "--project") { job.project_path = resolve(value); }
+            else if (option == "--export")  { job.export_path = resolve(value); }
+            else if (option == "--detail")  { job.detail = parse_number<uint32_t>(option, value); }
+            else if (option == "--time")    { job.time = parse_number<double>(option, value); }
+            else if (option == "--surface") { job.surface = value; }
+            else if (option == "--bad-vertices") {
+                if      (value == "keep")  { job.bad_vertices = BadVertexPolicy::Keep; }
+                else if (value == "drop")  { job.bad_vertices = BadVertexPolicy::DropTriangles; }
+                else if (value == "patch") { job.bad_vertices = BadVertexPolicy::Patch; }
+                else { throw std::runtime_error{"--bad-vertices is one of keep, drop or patch"}; }
+            }
+            else if (command != nullptr && option == "--jobs")     { command->worker_count = parse_number<uint32_t>(option, value); }
+            else if (command != nullptr && option == "--manifest") { *manifest = value; }
+            else { throw std::runtime_error{"unknown option '" + option + "'"}; }
+        }
+        if (job.detail > MAX_DETAIL) { throw std::runtime_error{"--detail is at most " + std::to_string(MAX_DETAIL)}; }
+    }
+
+    static void validate_job(const BatchJob &job, const std::string &where) {
+        if (job.project_path.empty()) { throw std::runtime_error{where + "needs --project"}; }
+        if (job.export_path.empty())  { throw std::runtime_error{where + "needs --export"}; }
+        const auto extension = lowercase_extension(job.export_path);
+        if (std::find(std::begin(EXPORT_EXTENSIONS), std::end(EXPORT_EXTENSIONS), extension) == std::end(EXPORT_EXTENSIONS)) {
+            throw std::runtime_error{where + "cannot export '" + job.export_path + "', the extension picks the format"};
+        }
+    }
+
+    // Whitespace separated, double quotes keep paths with spaces together
+    static std::vector<std::string> split_arguments(const std::string &line) {
+        std::vector<std::string> args;
+        std::string current;
+        bool is_quoted = false, has_token = false;
+        for (const auto c : line) {
+            if (c == '"') { is_quoted = !is_quoted; has_token = true; continue; }
+            if (is_quoted == false && (c == ' ' || c == '\t' || c == '\r')) {
+                if (has_token) { args.push_back(std::move(current)); current.clear(); has_token = false; }
+                continue;
+            }
+            current += c;
+            has_token = true;
+        }
+        if (is_quoted) { throw std::runtime_error{"unterminated quote"}; }
+        if (has_token) { args.push_back(std::move(current)); }
+        return args;
+    }
+
+    BatchCommand parse_batch_command(int argc, const char *const *argv) {
+        BatchCommand command;
+        BatchJob defaults;
+        std::string manifest;
+        parse_options({argv + 1, argv + argc}, defaults, {}, &command, &manifest);
+        if (manifest.empty()) {
+            validate_job(defaults, "");
+            command.jobs.push_back(defaults);
+            return command;
+        }
+
+        std::ifstream file{manifest};
+        if (file.is_open() == false) { throw std::runtime_error{"could not open the manifest '" + manifest + "'"}; }
+        const auto base = std::filesystem::path(manifest).parent_path();
+        // options on the command line are relative to the working directory, the manifest's to the manifest
+        std::string line;
+        for (uint32_t line_number = 1; std::getline(file, line); ++line_number) {
+            if (const auto comment = line.find('#'); comment != std::string::npos) { line.erase(comment); }
+            const auto where = manifest + ":" + std::to_string(line_number) + ": ";
+            try {
+                const auto args = split_arguments(line);
+                if (args.empty()) { continue; }
+                auto job = defaults;
+                parse_options(args, job, base, nullptr, nullptr);
+                validate_job(job, "");
+                command.jobs.push_back(std::move(job));
+            } catch (const std::exception &err) {
+                throw std::runtime_error{where + err.what()};
+            }
+        }
+        if (command.jobs.empty()) { throw std::runtime_error{"the manifest '" + manifest + "' has no jobs"}; }
+        return command;
+    }
+
+    /* Jobs */
+
+    // A project ready to evaluate: data read, scattered points resampled for the grid and every surface compiled
+    struct PreparedProject {
+        Project project;
+        uint32_t detail{0};
+        std::vector<std::string> surface_names;
+        std::vector<Program> programs;
+    };
+
+    static PreparedProject prepare_project(const std::string &path, uint32_t detail) {
+        PreparedProject prepared;
+        auto &project = prepared.project;
+        load_project(path, project);
+        const auto errors = load_data_sources(path, project.data_sources);
+        if (errors.empty() == false) { throw std::runtime_error{errors.front()}; }
+
+        prepared.detail = detail != 0 ? detail : project.settings.detail;
+        // (detail + 1)^2 values per surface are allocated from it, whichever of the two it came from
+        if (prepared.detail < 1 || prepared.detail > MAX_DETAIL) {
+            throw std::runtime_error{"'" + path + "' has detail " + std::to_string(prepared.detail) + ", outside 1.." + std::to_string(MAX_DETAIL)};
+        }
+        const auto bounds = static_cast<float>(project.settings.bounds);
+        // the resolution the application resamples with for this grid
+        for (auto &d : project.data_sources) {
+            if (d.points == nullptr) { continue; }
+            d.resampling = {d.scattered_settings, prepared.detail + 1, bounds};
+            d.grid       = std::make_shared<const DataGrid>(resample_scattered(*d.points, d.scattered_settings, prepared.detail + 1, bounds));
+            d.domain     = {-bounds, bounds, -bounds, bounds};
+        }
+        for (const auto &f : project.functions) {
+            if (f.is_surface == false) { continue; }
+            prepared.surface_names.push_back(f.name);
+            prepared.programs.push_back(compile_program(f.name, project.functions, project.constants, project.sliders, project.data_sources));
+        }
+        if (prepared.programs.empty()) { throw std::runtime_error{"'" + path + "' has no surfaces"}; }
+        return prepared;
+    }
+
+    // The first job to ask for a project prepares it, the others wait for the same result (or the same error).
+    // Knowing every job up front, an entry is dropped once its last job has it, so a project stays in memory only
+    // while jobs still use it instead of until the whole batch ends.
+    struct ProjectCache {
+        explicit ProjectCache(const std::vector<BatchJob> &jobs) {
+            for (const auto &job : jobs) { ++_entries[key(job.project_path, job.detail)].remaining_jobs; }
+        }
+
+        std::shared_ptr<const PreparedProject> get(const std::string &path, uint32_t detail) {
+            std::unique_lock lock{_mutex};
+            const auto it = _entries.find(key(path, detail));
+            if (it == _entries.end()) { lock.unlock(); return std::make_shared<const PreparedProject>(prepare_project(path, detail)); }
+            auto &entry = it->second;
+            const auto is_first = entry.prepared.valid() == false;
+            std::promise<std::shared_ptr<const PreparedProject>> promise;
+            if (is_first) { entry.prepared = promise.get_future().share(); }
+            const auto future = entry.prepared;
+            if (--entry.remaining_jobs == 0) { _entries.erase(it); }
+            lock.unlock();
+
+            if (is_first == false) { return future.get(); }
+            try {
+                auto prepared = std::make_shared<const PreparedProject>(prepare_project(path, detail));
+                promise.set_value(prepared);
+                return prepared;
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+      private:
+        using Key = std::pair<std::string, uint32_t>;
+        struct Entry {
+            std::shared_future<std::shared_ptr<const PreparedProject>> prepared; // invalid until the first job asks
+            size_t remaining_jobs{0};
+        };
+
+        // The same file under different spellings is one project
+        static Key key(const std::string &path, uint32_t detail) {
+            std::error_code error;
+            const auto canonical = std::filesystem::weakly_canonical(path, error);
+            return {error ? path : canonical.string(), detail};
+        }
+
+        std::mutex _mutex;
+        std::map<Key, Entry> _entries;
+    };
+
+    // Returns what was written, for the report
+    static std::string run_job(const BatchJob &job, ProjectCache &cache) {
+        const auto prepared = cache.get(job.project_path, job.detail);
+        const auto &project = prepared->project;
+        const auto detail = prepared->detail;
+        const auto bounds = static_cast<float>(project.settings.bounds);
+        const auto extension = lowercase_extension(job.export_path);
+        const auto is_heightmap = extension == ".png" || extension == ".r32" || extension == ".hfh";
+
+        // heightmaps hold one surface, only that one is evaluated
+        std::vector<Program> programs = prepared->programs;
+        std::vector<std::string> names = prepared->surface_names;
+        if (is_heightmap) {
+            const auto it = job.surface.empty() ? names.begin() : std::find(names.begin(), names.end(), job.surface);
+            if (it == names.end()) { throw std::runtime_error{"'" + job.project_path + "' has no surface '" + job.surface + "'"}; }
+            const auto index = static_cast<size_t>(it - names.begin());
+            programs = {prepared->programs[index]};
+            names = {names[index]};
+        }
+        const auto side = static_cast<size_t>(detail) + 1;
+        std::vector<float> heights(side * side * programs.size());
+        evaluate_height_frame(programs, make_parameters(project.sliders, job.time), job.time, detail, bounds, heights.data());
+
+        std::string report;
+        if (extension == ".obj" || extension == ".glb") {
+            const auto mesh = export_mesh(job.export_path, heights.data(), detail, names, bounds, job.bad_vertices,
+                                          extension == ".obj" ? MeshFormat::Obj : MeshFormat::Glb);
+            if (mesh.bad_vertices != 0) { report = ", " + std::to_string(mesh.bad_vertices) + " NaN/Inf vertices"; }
+        } else if (extension == ".hfz") {
+            export_height_field_hfz(job.export_path, heights.data(), detail, static_cast<uint32_t>(programs.size()), bounds);
+        } else {
+            const auto format = extension == ".png" ? HeightmapFormat::Png16 : extension == ".r32" ? HeightmapFormat::RawFloat32 : HeightmapFormat::Half;
+            export_heightmap(job.export_path, heights.data(), static_cast<uint32_t>(side), static_cast<uint32_t>(side), bounds, format);
+        }
+        return std::to_string(side) + "x" + std::to_string(side) + ", " + std::to_string(names.size()) + (names.size() == 1 ? " surface" : " surfaces") + report;
+    }
+
+    int run_batch(const BatchCommand &command) {
+        // the rows of every job already spread over the thread pool; a second job overlaps loading and writing files with it
+        const auto default_workers = std::max(2u, global_thread_pool().thread_count() / 4);
+        const auto worker_count = static_cast<uint32_t>(std::min<size_t>(command.worker_count != 0 ? command.worker_count : default_workers, command.jobs.size()));
+
+        ProjectCache cache{command.jobs};
+        std::atomic<size_t> next_job{0};
+        std::atomic<uint32_t> failed{0};
+        std::mutex output_mutex;
+        const auto worker = [&] {
+            for (auto i = next_job.fetch_add(1); i < command.jobs.size(); i = next_job.fetch_add(1)) {
+                const auto &job = command.jobs[i];
+                const auto start = std::chrono::steady_clock::now();
+                const auto prefix = "[" + std::to_string(i + 1) + "/" + std::to_string(command.jobs.size()) + "] " + job.project_path + " -> " + job.export_path;
+                try {
+                    const auto report = run_job(job, cache);
+                    char seconds[32];
+                    std::snprintf(seconds, sizeof(seconds), "%.2f s", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                    std::lock_guard lock{output_mutex};
+                    std::cout << prefix << " (" << report << ", " << seconds << ")" << std::endl;
+                } catch (const std::exception &err) {
+                    failed.fetch_add(1);
+                    std::lock_guard lock{output_mutex};
+                    std::cerr << prefix << ": " << err.what() << std::endl;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < worker_count; ++i) { workers.emplace_back(worker); }
+        worker();
+        for (auto &w : workers) { w.join(); }
+
+        if (failed.load() != 0) { std::cerr << failed.load() << " of " << command.jobs.size() << " jobs failed" << std::endl; }
+        return failed.load() == 0 ? 0 : 1;
+    }
+
+    int batch_main(int argc, const char *const *argv) {
+        if (argc > 1 && std::string_view{argv[1]} == "--help") { std::cout << BATCH_USAGE; return 0; }
+        try {
+            return run_batch(parse_batch_command(argc, argv));
+        } catch (const std::exception &err) {
+            std::cerr << "3dcalculator: " << err.what() << '\n' << BATCH_USAGE;
+            return 2;
+        }
+    }
+
+} // namespace g3d
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <mesh_export.hpp>
+
+namespace g3d {
+/* Definitions */
+    // One project evaluated at one TIME on the CPU and written to one file, the format picked by its extension:
+    // ".obj" and ".glb" meshes and ".hfz" height fields of every surface, ".png", ".r32" and ".hfh" heightmaps of one.
+    struct BatchJob {
+        std::string project_path, export_path;
+        uint32_t detail{0};  // 0 keeps the project's
+        double time{0.0};
+        std::string surface; // heightmaps only, empty picks the first surface
+        BadVertexPolicy bad_vertices{BadVertexPolicy::DropTriangles};
+    };
+    struct BatchCommand {
+        std::vector<BatchJob> jobs;
+        uint32_t worker_count{0}; // jobs run at once, 0 picks from the job count and the cores
+    };
+
+    inline constexpr const char *BATCH_USAGE =
+        "usage: 3dcalculator --project <file> --export <file> [--detail <n>] [--time <t>] [--surface <name>]\n"
+        "                    [--bad-vertices keep|drop|patch]\n"
+        "       3dcalculator --manifest <file> [--jobs <n>] [job options as defaults]\n"
+        "A manifest holds one job per line, written with the same options; '#' starts a comment and relative\n"
+        "paths are relative to the manifest. Exports: .obj .glb .hfz .png .r32 .hfh\n";
+
+    // The options after argv[0]. Throws std::runtime_error for unknown options, bad values and unreadable manifests.
+    BatchCommand parse_batch_command(int argc, const char *const *argv);
+
+    // Runs the jobs on a bounded set of workers without a window or a GPU context. Jobs of the same project share one
+    // load, one resampling of its scattered data and one compilation. Reports every job on stdout and every failure
+    // on stderr; returns the exit code, 0 when every job succeeded and 1 otherwise.
+    int run_batch(const BatchCommand &command);
+
+    // The whole command line of a headless run: prints the usage for --help, otherwise parses and runs the jobs.
+    // Returns 2 when the command line is invalid.
+    int batch_main(int argc, const char *const *argv);
+} // namespace g3d
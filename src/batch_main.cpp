@@ -0,0 +1,4 @@
+#include <batch.hpp>
+
+// The headless exporter on its own, for machines without a display or the windowing libraries
+int main(int argc, char **argv) { return g3d::batch_main(argc, argv); }
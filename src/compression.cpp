@@ -0,0 +1,191 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+#include <thread_pool.hpp>
+
+// only declared inside the implementation part of stb_image_write.h
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+namespace g3d {
+
+    std::vector<uint8_t> zlib_compress(const void *data, size_t size, int quality) {
+        if (size > INT_MAX) { throw std::runtime_error{"zlib: input larger than 2 GiB"}; }
+        int compressed_size = 0;
+        auto *compressed = stbi_zlib_compress(static_cast<unsigned char *>(const_cast<void *>(data)), static_cast<int>(size), &compressed_size, quality);
+        if (compressed == nullptr) { throw std::runtime_error{"zlib: out of memory"}; }
+        std::vector<uint8_t> out(compressed, compressed + compressed_size);
+        std::free(compressed);
+        return out;
+    }
+
+    // Deflate bit stream, least significant bit first
+    struct DeflateWriter {
+        std::vector<uint8_t> bytes;
+        uint64_t bits{0};
+        uint32_t used{0};
+
+        void write(uint32_t value, uint32_t count) { // count <= 32
+            bits |= static_cast<uint64_t>(value) << used;
+            used += count;
+            if (used >= 32) {
+                const auto word = static_cast<uint32_t>(bits);
+                bytes.insert(bytes.end(), reinterpret_cast<const uint8_t *>(&word), reinterpret_cast<const uint8_t *>(&word) + 4);
+                bits >>= 32;
+                used -= 32;
+            }
+        }
+        // Huffman codes are defined most significant bit first
+        void write_code(uint32_t code, uint32_t count) {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < count; ++i) { reversed |= ((code >> i) & 1) << (count - 1 - i); }
+            write(reversed, count);
+        }
+        void align() {
+            while (used > 0) { bytes.push_back(static_cast<uint8_t>(bits)); bits >>= 8; used = used > 8 ? used - 8 : 0; }
+        }
+    };
+
+    static void write_fixed_symbol(DeflateWriter &out, uint32_t symbol) {
+        // the fixed literal/length code, bit reversed once
+        struct Code { uint16_t bits; uint8_t length; };
+        static const auto codes = [] {
+            std::vector<Code> table(288);
+            for (uint32_t s = 0; s < 288; ++s) {
+                const auto [code, length] = s < 144 ? std::pair{0x30 + s, 8u} : s < 256 ? std::pair{0x190 + s - 144, 9u}
+                                          : s < 280 ? std::pair{s - 256, 7u} : std::pair{0xc0 + s - 280, 8u};
+                uint32_t reversed = 0;
+                for (uint32_t i = 0; i < length; ++i) { reversed |= ((code >> i) & 1) << (length - 1 - i); }
+                table[s] = Code{static_cast<uint16_t>(reversed), static_cast<uint8_t>(length)};
+            }
+            return table;
+        }();
+        out.write(codes[symbol].bits, codes[symbol].length);
+    }
+
+    static void write_fixed_match(DeflateWriter &out, uint32_t length, uint32_t distance) {
+        static constexpr uint16_t length_base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr uint16_t distance_base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                                     4097, 6145, 8193, 12289, 16385, 24577};
+        static constexpr uint8_t distance_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        const auto l = static_cast<uint32_t>(std::upper_bound(std::begin(length_base), std::end(length_base), length) - std::begin(length_base) - 1);
+        write_fixed_symbol(out, 257 + l);
+        out.write(length - length_base[l], length_extra[l]);
+        const auto d = static_cast<uint32_t>(std::upper_bound(std::begin(distance_base), std::end(distance_base), distance) - std::begin(distance_base) - 1);
+        out.write_code(d, 5);
+        out.write(distance - distance_base[d], distance_extra[d]);
+    }
+
+    static uint32_t adler32(const uint8_t *data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            const auto n = std::min<size_t>(size, 5552); // largest run that cannot overflow before the modulo
+            for (size_t i = 0; i < n; ++i) { a += data[i]; b += a; }
+            a %= 65521; b %= 65521;
+            data += n; size -= n;
+        }
+        return (b << 16) | a;
+    }
+    // Checksum of the concatenation, from zlib's adler32_combine
+    static uint32_t adler32_combine(uint32_t first, uint32_t second, size_t second_size) {
+        constexpr uint32_t BASE = 65521;
+        const auto rem = static_cast<uint32_t>(second_size % BASE);
+        uint32_t sum1 = first & 0xffff;
+        uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sum1) % BASE);
+        sum1 += (second & 0xffff) + BASE - 1;
+        sum2 += (first >> 16) + (second >> 16) + BASE - rem;
+        if (sum1 >= BASE) { sum1 -= BASE; }
+        if (sum1 >= BASE) { sum1 -= BASE; }
+        if (sum2 >= 2 * BASE) { sum2 -= 2 * BASE; }
+        if (sum2 >= BASE) { sum2 -= BASE; }
+        return sum1 | (sum2 << 16);
+    }
+
+    std::vector<uint8_t> zlib_compress_parallel(const void *data, size_t size) {
+        constexpr size_t CHUNK = 1 << 20, WINDOW = 32768, HASH_BITS = 15;
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        const auto chunk_count = std::max<size_t>(1, (size + CHUNK - 1) / CHUNK);
+        std::vector<std::vector<uint8_t>> streams(chunk_count);
+        std::vector<uint32_t> checksums(chunk_count);
+
+        global_thread_pool().parallel_for(chunk_count, [&](size_t chunk) {
+            const auto *in = bytes + chunk * CHUNK;
+            const auto n = std::min(CHUNK, size - chunk * CHUNK);
+            const auto is_last = chunk + 1 == chunk_count;
+            checksums[chunk] = adler32(in, n);
+
+            DeflateWriter out;
+            out.bytes.reserve(n / 2);
+            out.write(is_last ? 1 : 0, 1); // BFINAL
+            out.write(1, 2);                // fixed Huffman codes
+
+            // one candidate per hash of the next 3 bytes, positions are stored + 1 so 0 means empty
+            std::vector<uint32_t> head(size_t{1} << HASH_BITS, 0);
+            const auto hash = [&](size_t i) { return ((in[i] << 16 | in[i + 1] << 8 | in[i + 2]) * 2654435761u) >> (32 - HASH_BITS); };
+            size_t i = 0;
+            while (i < n) {
+                if (i + 3 <= n) {
+                    const auto h = hash(i);
+                    const auto candidate = head[h];
+                    head[h] = static_cast<uint32_t>(i + 1);
+                    if (candidate > 0 && i - (candidate - 1) <= WINDOW) {
+                        const auto *match = in + candidate - 1;
+                        const auto limit = std::min<size_t>(258, n - i);
+                        size_t length = 0;
+                        while (length < limit && match[length] == in[i + length]) { ++length; }
+                        if (length >= 3) {
+                            write_fixed_match(out, static_cast<uint32_t>(length), static_cast<uint32_t>(in + i - match));
+                            // index the start of the skipped bytes too, later rows often repeat them
+                            for (size_t k = i + 1; k < i + std::min<size_t>(length, 8) && k + 3 <= n; ++k) { head[hash(k)] = static_cast<uint32_t>(k + 1); }
+                            i += length;
+                            continue;
+                        }
+                    }
+                }
+                write_fixed_symbol(out, in[i]);
+                ++i;
+            }
+            write_fixed_symbol(out, 256);
+            if (is_last == false) {
+                // sync flush: an empty stored block ends the chunk on a byte boundary
+                out.write(0, 3);
+                out.align();
+                out.bytes.insert(out.bytes.end(), {0x00, 0x00, 0xff, 0xff});
+            } else {
+                out.align();
+            }
+            streams[chunk] = std::move(out.bytes);
+        });
+
+        auto checksum = checksums[0];
+        for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+            checksum = adler32_combine(checksum, checksums[chunk], std::min(CHUNK, size - chunk * CHUNK));
+        }
+        size_t total = 6;
+        for (const auto &s : streams) { total += s.size(); }
+        std::vector<uint8_t> out;
+        out.reserve(total);
+        out.insert(out.end(), {0x78, 0x01});
+        for (const auto &s : streams) { out.insert(out.end(), s.begin(), s.end()); }
+        for (int shift = 24; shift >= 0; shift -= 8) { out.push_back(static_cast<uint8_t>(checksum >> shift)); }
+        return out;
+    }
+
+    std::vector<uint8_t> zlib_decompress(const uint8_t *data, size_t compressed_size, size_t size) {
+        if (compressed_size > INT_MAX || size > INT_MAX) { throw std::runtime_error{"zlib: stream larger than 2 GiB"}; }
+        std::vector<uint8_t> out(size);
+        const auto written = stbi_zlib_decode_buffer(reinterpret_cast<char *>(out.data()), static_cast<int>(size),
+                                                     reinterpret_cast<const char *>(data), static_cast<int>(compressed_size));
+        if (written != static_cast<int>(size)) { throw std::runtime_error{"zlib: corrupt stream"}; }
+        return out;
+    }
+
+} // namespace g3d
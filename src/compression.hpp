@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    // zlib streams through the stb implementations. Quality trades speed for size, 5 is stb's default.
+    std::vector<uint8_t> zlib_compress(const void *data, size_t size, int quality = 5);
+    // For large buffers: 1 MiB chunks are deflated on the thread pool with fixed Huffman codes and greedy matching,
+    // then joined with sync flushes into one zlib stream that any inflater reads. Matches never cross chunks.
+    std::vector<uint8_t> zlib_compress_parallel(const void *data, size_t size);
+    // Throws std::runtime_error when the stream is corrupt or does not inflate to exactly `size` bytes
+    std::vector<uint8_t> zlib_decompress(const uint8_t *data, size_t compressed_size, size_t size);
+} // namespace g3d
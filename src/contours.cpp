@@ -0,0 +1,202 @@
+#include "contours.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    static uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) { hash = (hash ^ bytes[i]) * 0x100000001b3ull; }
+        return hash;
+    }
+
+    void ContourExtractor::extract(const float *heights, uint32_t detail, float bounds, const ContourSettings &settings) {
+        const auto row = detail + 1;
+        const auto vertex_count = static_cast<size_t>(row) * row;
+
+        // levels
+        auto min_level = settings.min_level, max_level = settings.max_level;
+        if (settings.is_auto_range) {
+            min_level = INFINITY; max_level = -INFINITY;
+            for (size_t i = 0; i < vertex_count; ++i) {
+                if (std::isfinite(heights[i])) { min_level = std::min(min_level, heights[i]); max_level = std::max(max_level, heights[i]); }
+            }
+        }
+        levels.clear();
+        if (min_level <= max_level) {
+            for (uint32_t i = 0; i < settings.level_count; ++i) {
+                levels.push_back(min_level + (max_level - min_level) * static_cast<float>(i + 1) / static_cast<float>(settings.level_count + 1));
+            }
+        }
+
+        const auto tiles_per_side = (detail + TILE_SIZE - 1) / TILE_SIZE;
+        if (detail != _detail || _tiles.size() != static_cast<size_t>(tiles_per_side) * tiles_per_side) {
+            _tiles.assign(static_cast<size_t>(tiles_per_side) * tiles_per_side, Tile{});
+            _detail = detail;
+        }
+        const auto inputs_hash = fnv1a(&bounds, sizeof(bounds), fnv1a(levels.data(), levels.size() * sizeof(float)));
+        const auto cell_size   = 2.0f * bounds / static_cast<float>(detail);
+
+        global_thread_pool().parallel_for(_tiles.size(), [&](size_t tile_index) {
+            auto &tile = _tiles[tile_index];
+            const auto x0 = static_cast<uint32_t>(tile_index % tiles_per_side) * TILE_SIZE;
+            const auto z0 = static_cast<uint32_t>(tile_index / tiles_per_side) * TILE_SIZE;
+            const auto cells_x = std::min(TILE_SIZE, detail - x0);
+            const auto cells_z = std::min(TILE_SIZE, detail - z0);
+
+            auto hash = inputs_hash;
+            for (uint32_t z = z0; z <= z0 + cells_z; ++z) { hash = fnv1a(&heights[z * row + x0], (cells_x + 1) * sizeof(float), hash); }
+            if (hash == tile.hash) { return; }
+            tile.hash = hash;
+            tile.segments.clear();
+
+            const auto point_on_edge = [&](uint64_t edge, float level) {
+                const auto v = static_cast<uint32_t>(edge >> 1);
+                const auto w = (edge & 1) ? v + row : v + 1;
+                const auto t = (level - heights[v]) / (heights[w] - heights[v]);
+                auto p = glm::vec2{static_cast<float>(v % row), static_cast<float>(v / row)};
+                if (edge & 1) { p.y += t; } else { p.x += t; }
+                return p * cell_size - bounds;
+            };
+
+            uint8_t above[2][TILE_SIZE + 1], finite[2][TILE_SIZE + 1], cases[TILE_SIZE];
+            for (uint32_t level_index = 0; level_index < levels.size(); ++level_index) {
+                const auto level = levels[level_index];
+                // branch-free classification, one vertex row at a time; NaN compares false and is masked out
+                const auto classify_row = [&](uint32_t z, uint8_t *a, uint8_t *f) {
+                    const auto *h = &heights[z * row + x0];
+                    for (uint32_t i = 0; i <= cells_x; ++i) { a[i] = h[i] >= level; f[i] = std::abs(h[i]) <= 3.402823e38f; }
+                };
+                classify_row(z0, above[0], finite[0]);
+                for (uint32_t z = z0; z < z0 + cells_z; ++z) {
+                    const auto *a = above[(z - z0) & 1], *fa = finite[(z - z0) & 1];
+                    auto *b = above[(z - z0 + 1) & 1], *fb = finite[(z - z0 + 1) & 1];
+                    classify_row(z + 1, b, fb);
+                    for (uint32_t i = 0; i < cells_x; ++i) {
+                        const uint8_t valid = fa[i] & fa[i + 1] & fb[i + 1] & fb[i];
+                        cases[i] = static_cast<uint8_t>((a[i] | a[i + 1] << 1 | b[i + 1] << 2 | b[i] << 3) * valid);
+                    }
+
+                    for (uint32_t i = 0; i < cells_x; ++i) {
+                        const auto c = cases[i];
+                        if (c == 0 || c == 15) { continue; }
+
+                        const uint64_t v00 = static_cast<uint64_t>(z) * row + x0 + i, v10 = v00 + 1, v01 = v00 + row;
+                        const uint64_t edges[4] = {2 * v00, 2 * v10 + 1, 2 * v01, 2 * v00 + 1}; // bottom, right, top, left
+                        const auto add = [&](uint32_t e0, uint32_t e1) {
+                            tile.segments.push_back(Segment{
+                                .edges  = {edges[e0], edges[e1]},
+                                .points = {point_on_edge(edges[e0], level), point_on_edge(edges[e1], level)},
+                                .level  = level_index,
+                            });
+                        };
+                        if (c == 5 || c == 10) {
+                            // saddle: the cell center decides which corners are connected
+                            const auto h = &heights[v00];
+                            const auto is_center_above = (h[0] + h[1] + h[row] + h[row + 1]) * 0.25f >= level;
+                            if ((c == 5) == is_center_above) { add(0, 1); add(2, 3); }
+                            else                             { add(3, 0); add(1, 2); }
+                            continue;
+                        }
+                        const uint8_t bits[4] = {static_cast<uint8_t>(c & 1), static_cast<uint8_t>((c >> 1) & 1), static_cast<uint8_t>((c >> 2) & 1), static_cast<uint8_t>((c >> 3) & 1)};
+                        uint32_t crossing[2], n = 0;
+                        for (uint32_t e = 0; e < 4; ++e) {
+                            if (bits[e] != bits[(e + 1) & 3]) { crossing[n++] = e; }
+                        }
+                        add(crossing[0], crossing[1]);
+                    }
+                }
+            }
+        });
+
+        // stitch
+        std::vector<const Segment *> segments;
+        for (const auto &tile : _tiles) {
+            for (const auto &segment : tile.segments) { segments.push_back(&segment); }
+        }
+        line_vertices.clear();
+        for (const auto *s : segments) {
+            const auto y = levels[s->level];
+            line_vertices.emplace_back(s->points[0].x, y, s->points[0].y);
+            line_vertices.emplace_back(s->points[1].x, y, s->points[1].y);
+        }
+
+        const auto key = [&](uint64_t edge, uint32_t level) { return edge * levels.size() + level; };
+        std::unordered_map<uint64_t, std::array<int32_t, 2>> by_edge;
+        by_edge.reserve(segments.size() * 2);
+        for (int32_t i = 0; i < static_cast<int32_t>(segments.size()); ++i) {
+            for (const auto edge : segments[i]->edges) {
+                auto [it, inserted] = by_edge.try_emplace(key(edge, segments[i]->level), std::array<int32_t, 2>{i, -1});
+                if (inserted == false) { it->second[1] = i; }
+            }
+        }
+
+        polylines.clear();
+        std::vector<uint8_t> is_used(segments.size(), 0);
+        for (int32_t first = 0; first < static_cast<int32_t>(segments.size()); ++first) {
+            if (is_used[first]) { continue; }
+            is_used[first] = 1;
+            const auto level = segments[first]->level;
+            std::deque<glm::vec2> points{segments[first]->points[0], segments[first]->points[1]};
+
+            // walks away from `edge` through neighbouring segments, returns the edge it stopped at
+            const auto walk = [&](uint64_t edge, bool is_forward) {
+                for (;;) {
+                    const auto &pair = by_edge.at(key(edge, level));
+                    const auto next = pair[0] >= 0 && is_used[pair[0]] == 0 ? pair[0] : pair[1] >= 0 && is_used[pair[1]] == 0 ? pair[1] : -1;
+                    if (next < 0) { return edge; }
+                    is_used[next] = 1;
+                    const auto *s = segments[next];
+                    const auto side = s->edges[0] == edge ? 1 : 0;
+                    if (is_forward) { points.push_back(s->points[side]); } else { points.push_front(s->points[side]); }
+                    edge = s->edges[side];
+                }
+            };
+            const auto end   = walk(segments[first]->edges[1], true);
+            const auto begin = walk(segments[first]->edges[0], false);
+            polylines.push_back(Polyline{.level = levels[level], .points = {points.begin(), points.end()}, .is_closed = begin == end});
+            if (polylines.back().is_closed) { polylines.back().points.pop_back(); }
+        }
+    }
+
+    void export_contours_to_svg(const std::string &path, const std::vector<Polyline> &polylines, float bounds) {
+        std::ofstream file{path, std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "' for writing"}; }
+
+        float min_level = INFINITY, max_level = -INFINITY;
+        for (const auto &p : polylines) { min_level = std::min(min_level, p.level); max_level = std::max(max_level, p.level); }
+
+        file << "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"" << -bounds << ' ' << -bounds << ' ' << 2.0f * bounds << ' ' << 2.0f * bounds << "\">\n";
+        file << "<g fill=\"none\" stroke-width=\"" << bounds / 250.0f << "\">\n";
+        for (const auto &p : polylines) {
+            // low levels blue, high levels red
+            const auto t = max_level > min_level ? (p.level - min_level) / (max_level - min_level) : 0.5f;
+            file << (p.is_closed ? "<polygon" : "<polyline") << " stroke=\"rgb(" << static_cast<int>(255 * t) << ",80," << static_cast<int>(255 * (1.0f - t))
+                 << ")\" data-level=\"" << p.level << "\" points=\"";
+            for (const auto &point : p.points) { file << point.x << ',' << point.y << ' '; }
+            file << "\"/>\n";
+        }
+        file << "</g>\n</svg>\n";
+    }
+
+    void export_contours_to_polylines(const std::string &path, const std::vector<Polyline> &polylines) {
+        std::ofstream file{path, std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "' for writing"}; }
+
+        // one block per polyline: a header line, then one "x z" line per point
+        for (const auto &p : polylines) {
+            file << "level " << p.level << (p.is_closed ? " closed " : " open ") << p.points.size() << '\n';
+            for (const auto &point : p.points) { file << point.x << ' ' << point.y << '\n'; }
+            file << '\n';
+        }
+    }
+
+} // namespace g3d
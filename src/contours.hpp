@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace g3d {
+/* Definitions */
+    struct ContourSettings {
+        bool is_enabled{false};
+        uint32_t level_count{10};
+        bool is_auto_range{true}; // spread the levels over the finite range of the height field
+        float min_level{-1.0f}, max_level{1.0f};
+    };
+
+    struct Polyline {
+        float level{0.0f};
+        std::vector<glm::vec2> points; // (x, z)
+        bool is_closed{false};
+    };
+
+    // Marching squares over a (detail + 1)^2 height field laid out like the compute shader writes it.
+    // The field is cut into tiles that are classified in parallel; a tile whose heights and levels hash
+    // the same as last time keeps its segments, so only the changed parts of a field are re-extracted.
+    // Segments end on grid edges, which are stitched into polylines by their integer edge ids.
+    struct ContourExtractor {
+        static constexpr uint32_t TILE_SIZE = 32; // cells per tile side
+
+        void extract(const float *heights, uint32_t detail, float bounds, const ContourSettings &settings);
+
+        std::vector<float> levels;
+        std::vector<Polyline> polylines;
+        std::vector<glm::vec3> line_vertices; // GL_LINES pairs at (x, level, z)
+
+      private:
+        struct Segment {
+            uint64_t edges[2];
+            glm::vec2 points[2];
+            uint32_t level;
+        };
+        struct Tile {
+            uint64_t hash{0};
+            std::vector<Segment> segments;
+        };
+        std::vector<Tile> _tiles;
+        uint32_t _detail{0};
+    };
+
+    // Both throw std::runtime_error when the file cannot be written
+    void export_contours_to_svg(const std::string &path, const std::vector<Polyline> &polylines, float bounds);
+    void export_contours_to_polylines(const std::string &path, const std::vector<Polyline> &polylines);
+} // namespace g3d
@@ -0,0 +1,100 @@
+#include "critical_points.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <unordered_map>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    static std::optional<CriticalPoint> refine(const Program &program, const double *parameters, double x, double z,
+                                               double bounds, double max_step, const CriticalPointSettings &settings) {
+        for (uint32_t iteration = 0; iteration <= settings.max_iterations; ++iteration) {
+            const auto j = evaluate_jet(program, x, z, parameters);
+            if (std::isfinite(j.v) == false || std::isfinite(j.dx) == false || std::isfinite(j.dz) == false) { return std::nullopt; }
+
+            const auto gradient_norm = std::hypot(j.dx, j.dz);
+            if (gradient_norm <= settings.gradient_tolerance * std::max(1.0, std::abs(j.v))) {
+                const auto det   = j.dxx * j.dzz - j.dxz * j.dxz;
+                const auto scale = j.dxx * j.dxx + 2.0 * j.dxz * j.dxz + j.dzz * j.dzz;
+                if (std::abs(det) <= 1e-10 * scale || scale == 0.0) { return std::nullopt; } // degenerate, e.g. a ridge line
+
+                const auto kind = det < 0.0 ? CriticalPoint::Kind::Saddle : j.dxx > 0.0 ? CriticalPoint::Kind::Minimum : CriticalPoint::Kind::Maximum;
+                return CriticalPoint{.kind = kind, .x = x, .z = z, .y = j.v};
+            }
+            if (iteration == settings.max_iterations) { break; }
+
+            // Newton step on grad f = 0; near a singular Hessian fall back to the Cauchy step of |grad f|^2 / 2
+            double sx = 0.0, sz = 0.0;
+            const auto det = j.dxx * j.dzz - j.dxz * j.dxz;
+            if (std::abs(det) > 1e-12 * (j.dxx * j.dxx + j.dzz * j.dzz + j.dxz * j.dxz)) {
+                sx = -( j.dzz * j.dx - j.dxz * j.dz) / det;
+                sz = -(-j.dxz * j.dx + j.dxx * j.dz) / det;
+            } else {
+                const auto hgx  = j.dxx * j.dx + j.dxz * j.dz, hgz = j.dxz * j.dx + j.dzz * j.dz;
+                const auto hhgx = j.dxx * hgx + j.dxz * hgz, hhgz = j.dxz * hgx + j.dzz * hgz;
+                const auto denominator = hhgx * hhgx + hhgz * hhgz;
+                if (denominator == 0.0) { return std::nullopt; }
+                const auto t = (hgx * hgx + hgz * hgz) / denominator;
+                sx = -t * hgx;
+                sz = -t * hgz;
+            }
+
+            // trust region: never jump further than one seed cell per iteration
+            const auto step = std::hypot(sx, sz);
+            if (std::isfinite(step) == false) { return std::nullopt; }
+            if (step > max_step) { sx *= max_step / step; sz *= max_step / step; }
+            x += sx;
+            z += sz;
+            if (std::abs(x) > bounds + max_step || std::abs(z) > bounds + max_step) { return std::nullopt; }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<CriticalPoint> find_critical_points(const Program &program, const double *parameters,
+                                                    double bounds, const CriticalPointSettings &settings) {
+        const auto seeds   = std::max(settings.seeds_per_axis, 2u);
+        const auto spacing = 2.0 * bounds / (seeds - 1);
+
+        std::vector<std::optional<CriticalPoint>> converged(static_cast<size_t>(seeds) * seeds);
+        global_thread_pool().parallel_for(converged.size(), [&](size_t i) {
+            const auto x = -bounds + spacing * static_cast<double>(i % seeds);
+            const auto z = -bounds + spacing * static_cast<double>(i / seeds);
+            converged[i] = refine(program, parameters, x, z, bounds, spacing, settings);
+        }, 16);
+
+        // many seeds fall into the same basin; points closer than a quarter cell are the same point
+        const auto cell_size = spacing * 0.25;
+        const auto cell_key  = [](int64_t cx, int64_t cz) { return static_cast<uint64_t>(cx) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(cz); };
+        std::unordered_multimap<uint64_t, size_t> cells;
+        std::vector<CriticalPoint> points;
+        for (const auto &candidate : converged) {
+            if (candidate.has_value() == false) { continue; }
+            const auto &p = *candidate;
+            if (std::abs(p.x) > bounds || std::abs(p.z) > bounds) { continue; }
+
+            const auto cx = static_cast<int64_t>(std::floor(p.x / cell_size));
+            const auto cz = static_cast<int64_t>(std::floor(p.z / cell_size));
+            bool is_duplicate = false;
+            for (int64_t dz = -1; dz <= 1 && is_duplicate == false; ++dz) {
+                for (int64_t dx = -1; dx <= 1 && is_duplicate == false; ++dx) {
+                    const auto [first, last] = cells.equal_range(cell_key(cx + dx, cz + dz));
+                    is_duplicate = std::any_of(first, last, [&](const auto &cell) {
+                        return std::hypot(points[cell.second].x - p.x, points[cell.second].z - p.z) < cell_size;
+                    });
+                }
+            }
+            if (is_duplicate) { continue; }
+            cells.emplace(cell_key(cx, cz), points.size());
+            points.push_back(p);
+        }
+
+        std::sort(points.begin(), points.end(), [](const CriticalPoint &a, const CriticalPoint &b) {
+            return a.kind != b.kind ? a.kind < b.kind : a.y < b.y;
+        });
+        return points;
+    }
+
+} // namespace g3d
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    struct CriticalPoint {
+        enum class Kind : uint32_t { Minimum, Maximum, Saddle };
+
+        Kind kind{Kind::Minimum};
+        double x{0.0}, z{0.0}, y{0.0};
+    };
+
+    struct CriticalPointSettings {
+        uint32_t seeds_per_axis{64};
+        uint32_t max_iterations{50};
+        double gradient_tolerance{1e-9};
+    };
+
+    // Seeds a grid over [-bounds, bounds]^2 and runs a damped Newton iteration on the gradient from
+    // every seed in parallel. Converged points are classified by their Hessian and deduplicated
+    // through a spatial hash with cells a fraction of the seed spacing wide.
+    std::vector<CriticalPoint> find_critical_points(const Program &program, const double *parameters,
+                                                    double bounds, const CriticalPointSettings &settings);
+} // namespace g3d
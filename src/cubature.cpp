@@ -0,0 +1,147 @@
+#include "cubature.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    // Genz-Malik for n = 2
+    static constexpr double N = 2.0;
+    static constexpr double WEIGHT_1 = (12824.0 - 9120.0 * N + 400.0 * N * N) / 19683.0;
+    static constexpr double WEIGHT_2 = 980.0 / 6561.0;
+    static constexpr double WEIGHT_3 = (1820.0 - 400.0 * N) / 19683.0;
+    static constexpr double WEIGHT_4 = 200.0 / 19683.0;
+    static constexpr double WEIGHT_5 = 6859.0 / 19683.0 / 4.0;
+    static constexpr double WEIGHT_E1 = (729.0 - 950.0 * N + 50.0 * N * N) / 729.0;
+    static constexpr double WEIGHT_E2 = 245.0 / 486.0;
+    static constexpr double WEIGHT_E3 = (265.0 - 100.0 * N) / 1458.0;
+    static constexpr double WEIGHT_E4 = 25.0 / 729.0;
+    static const double LAMBDA_2 = std::sqrt(9.0 / 70.0);
+    static const double LAMBDA_3 = std::sqrt(9.0 / 10.0); // also lambda 4
+    static const double LAMBDA_5 = std::sqrt(9.0 / 19.0);
+    static constexpr uint32_t POINTS_PER_REGION = 17;
+
+    struct Region {
+        double cx, cz, hx, hz; // center and half widths
+        double value{0.0}, error{0.0};
+        uint32_t split_axis{0};
+
+        bool operator<(const Region &other) const { return error < other.error; }
+    };
+
+    // Offsets in units of the half widths: center, +-l2 and +-l3 per axis, (+-l3, +-l3), (+-l5, +-l5)
+    static void region_points(const Region &r, double *xs, double *zs) {
+        const double axis[4] = {LAMBDA_2, -LAMBDA_2, LAMBDA_3, -LAMBDA_3};
+        const double diagonal[2] = {LAMBDA_3, LAMBDA_5};
+        uint32_t i = 0;
+        xs[i] = r.cx; zs[i] = r.cz; ++i;
+        for (const auto a : axis) { xs[i] = r.cx + a * r.hx; zs[i] = r.cz; ++i; }
+        for (const auto a : axis) { xs[i] = r.cx; zs[i] = r.cz + a * r.hz; ++i; }
+        for (const auto d : diagonal) {
+            for (const auto sx : {1.0, -1.0}) {
+                for (const auto sz : {1.0, -1.0}) { xs[i] = r.cx + sx * d * r.hx; zs[i] = r.cz + sz * d * r.hz; ++i; }
+            }
+        }
+    }
+
+    static void apply_rule(Region &r, const double *f) {
+        const auto f0 = f[0];
+        const auto sum_2 = f[1] + f[2] + f[5] + f[6];
+        const auto sum_3 = f[3] + f[4] + f[7] + f[8];
+        const auto sum_4 = f[9] + f[10] + f[11] + f[12];
+        const auto sum_5 = f[13] + f[14] + f[15] + f[16];
+        const auto volume = 4.0 * r.hx * r.hz;
+
+        const auto degree_7 = volume * (WEIGHT_1 * f0 + WEIGHT_2 * sum_2 + WEIGHT_3 * sum_3 + WEIGHT_4 * sum_4 + WEIGHT_5 * sum_5);
+        const auto degree_5 = volume * (WEIGHT_E1 * f0 + WEIGHT_E2 * sum_2 + WEIGHT_E3 * sum_3 + WEIGHT_E4 * sum_4);
+        r.value = degree_7;
+        r.error = std::isfinite(degree_7) ? std::abs(degree_7 - degree_5) : INFINITY;
+
+        // fourth divided differences pick the axis where the integrand is least polynomial
+        const auto ratio = (LAMBDA_2 * LAMBDA_2) / (LAMBDA_3 * LAMBDA_3);
+        const auto difference_x = std::abs(f[1] + f[2] - 2.0 * f0 - ratio * (f[3] + f[4] - 2.0 * f0));
+        const auto difference_z = std::abs(f[5] + f[6] - 2.0 * f0 - ratio * (f[7] + f[8] - 2.0 * f0));
+        r.split_axis = difference_z > difference_x || (difference_z == difference_x && r.hz > r.hx) ? 1 : 0;
+    }
+
+    static void evaluate_regions(const Program &program, const double *parameters, Integrand integrand, std::vector<Region> &regions) {
+        constexpr size_t REGIONS_PER_BATCH = 8;
+        const auto batches = (regions.size() + REGIONS_PER_BATCH - 1) / REGIONS_PER_BATCH;
+        global_thread_pool().parallel_for(batches, [&](size_t batch) {
+            const auto first = batch * REGIONS_PER_BATCH;
+            const auto count = std::min(REGIONS_PER_BATCH, regions.size() - first);
+            double xs[REGIONS_PER_BATCH * POINTS_PER_REGION], zs[REGIONS_PER_BATCH * POINTS_PER_REGION], f[REGIONS_PER_BATCH * POINTS_PER_REGION];
+            for (size_t i = 0; i < count; ++i) { region_points(regions[first + i], xs + i * POINTS_PER_REGION, zs + i * POINTS_PER_REGION); }
+
+            const auto point_count = count * POINTS_PER_REGION;
+            if (integrand == Integrand::Volume) {
+                evaluate_batch(program, xs, zs, parameters, f, point_count);
+            } else {
+                for (size_t i = 0; i < point_count; ++i) {
+                    const auto g = evaluate_gradient(program, xs[i], zs[i], parameters);
+                    f[i] = std::sqrt(1.0 + g.d[0] * g.d[0] + g.d[1] * g.d[1]);
+                }
+            }
+            for (size_t i = 0; i < count; ++i) { apply_rule(regions[first + i], f + i * POINTS_PER_REGION); }
+        });
+    }
+
+    CubatureResult integrate(const Program &program, const double *parameters, double bounds, const CubatureSettings &settings) {
+        CubatureResult result;
+
+        // start from a small grid so that narrow features are unlikely to fall between all sample points
+        constexpr uint32_t INITIAL_SPLITS = 8;
+        std::vector<Region> batch;
+        const auto h = bounds / INITIAL_SPLITS;
+        for (uint32_t j = 0; j < INITIAL_SPLITS; ++j) {
+            for (uint32_t i = 0; i < INITIAL_SPLITS; ++i) {
+                batch.push_back(Region{.cx = -bounds + h * (2 * i + 1), .cz = -bounds + h * (2 * j + 1), .hx = h, .hz = h});
+            }
+        }
+
+        std::vector<Region> regions; // a max-heap on the error
+        const auto batch_limit = static_cast<size_t>(global_thread_pool().thread_count()) * 16;
+        for (;;) {
+            evaluate_regions(program, parameters, settings.integrand, batch);
+            result.evaluations += batch.size() * POINTS_PER_REGION;
+            for (const auto &r : batch) { regions.push_back(r); std::push_heap(regions.begin(), regions.end()); }
+            batch.clear();
+
+            // the totals are summed again from scratch, running sums would accumulate cancellation errors
+            double value = 0.0, error = 0.0;
+            for (const auto &r : regions) { value += r.value; error += r.error; }
+            result.value = value;
+            result.error = error;
+            result.regions = static_cast<uint32_t>(regions.size());
+
+            const auto tolerance = std::max(settings.absolute_tolerance, settings.relative_tolerance * std::abs(value));
+            if (error <= tolerance) { result.has_converged = true; break; }
+            if (std::isfinite(value) == false || result.evaluations + 2 * POINTS_PER_REGION > settings.max_evaluations) { break; }
+
+            // bisect the worst regions until they account for the excess error or the batch is full
+            auto excess = error - tolerance;
+            while (regions.empty() == false && batch.size() < batch_limit && excess > 0.0 &&
+                   result.evaluations + (batch.size() + 2) * POINTS_PER_REGION <= settings.max_evaluations) {
+                std::pop_heap(regions.begin(), regions.end());
+                const auto r = regions.back();
+                regions.pop_back();
+                excess -= r.error;
+                auto a = r, b = r;
+                if (r.split_axis == 0) {
+                    a.hx = b.hx = r.hx * 0.5;
+                    a.cx -= a.hx; b.cx += b.hx;
+                } else {
+                    a.hz = b.hz = r.hz * 0.5;
+                    a.cz -= a.hz; b.cz += b.hz;
+                }
+                batch.push_back(a);
+                batch.push_back(b);
+            }
+            if (batch.empty()) { break; }
+        }
+        return result;
+    }
+
+} // namespace g3d
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    enum class Integrand : uint32_t {
+        Volume,      // integral of f(x, z)
+        SurfaceArea, // integral of sqrt(1 + fx^2 + fz^2)
+    };
+
+    struct CubatureSettings {
+        Integrand integrand{Integrand::Volume};
+        double relative_tolerance{1e-6};
+        double absolute_tolerance{1e-10};
+        uint64_t max_evaluations{4'000'000};
+    };
+    struct CubatureResult {
+        double value{0.0}, error{0.0};
+        uint64_t evaluations{0};
+        uint32_t regions{0};
+        bool has_converged{false};
+    };
+
+    // Adaptive Genz-Malik cubature over [-bounds, bounds]^2: a degree 7 rule with an embedded degree 5
+    // rule for the error estimate. Every pass bisects the worst regions along their roughest axis and
+    // evaluates the children in parallel, feeding their sample points to the batch evaluator.
+    CubatureResult integrate(const Program &program, const double *parameters, double bounds, const CubatureSettings &settings);
+} // namespace g3d
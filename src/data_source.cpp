@@ -0,0 +1,237 @@
+#include "data_source.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+namespace g3d {
+
+    static DataGrid load_image(const std::string &path) {
+        DataGrid grid;
+        int width = 0, height = 0, channels = 0;
+        // one channel: stb reduces colour images to luminance
+        if (stbi_is_hdr(path.c_str())) {
+            auto *pixels = stbi_loadf(path.c_str(), &width, &height, &channels, 1);
+            if (pixels == nullptr) { throw std::runtime_error{"Could not read '" + path + "': " + stbi_failure_reason()}; }
+            grid.values.assign(pixels, pixels + static_cast<size_t>(width) * height);
+            stbi_image_free(pixels);
+        } else if (stbi_is_16_bit(path.c_str())) {
+            auto *pixels = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+            if (pixels == nullptr) { throw std::runtime_error{"Could not read '" + path + "': " + stbi_failure_reason()}; }
+            grid.values.resize(static_cast<size_t>(width) * height);
+            std::transform(pixels, pixels + grid.values.size(), grid.values.begin(), [](uint16_t p) { return p / 65535.0f; });
+            stbi_image_free(pixels);
+        } else {
+            auto *pixels = stbi_load(path.c_str(), &width, &height, &channels, 1);
+            if (pixels == nullptr) { throw std::runtime_error{"Could not read '" + path + "': " + stbi_failure_reason()}; }
+            grid.values.resize(static_cast<size_t>(width) * height);
+            std::transform(pixels, pixels + grid.values.size(), grid.values.begin(), [](uint8_t p) { return p / 255.0f; });
+            stbi_image_free(pixels);
+        }
+        grid.width  = static_cast<uint32_t>(width);
+        grid.height = static_cast<uint32_t>(height);
+        return grid;
+    }
+
+    static DataGrid load_table(const std::string &path) {
+        std::ifstream file{path};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+
+        DataGrid grid;
+        std::string line;
+        for (uint32_t line_number = 1; std::getline(file, line); ++line_number) {
+            line = line.substr(0, line.find('#'));
+            std::replace_if(line.begin(), line.end(), [](char c) { return c == ',' || c == ';' || c == '\t' || c == '\r'; }, ' ');
+            if (line.find_first_not_of(' ') == std::string::npos) { continue; }
+
+            const auto first_value = grid.values.size();
+            const char *p = line.data(), *end = line.data() + line.size();
+            bool is_numeric = true;
+            while (p < end) {
+                while (p < end && *p == ' ') { ++p; }
+                if (p == end) { break; }
+                float v;
+                const auto [next, ec] = std::from_chars(p, end, v);
+                if (ec != std::errc{} || (next < end && *next != ' ')) { is_numeric = false; break; }
+                grid.values.push_back(v);
+                p = next;
+            }
+            if (is_numeric == false) {
+                grid.values.resize(first_value);
+                if (grid.height == 0) { continue; } // a header row
+                throw std::runtime_error{path + ':' + std::to_string(line_number) + ": expected numbers"};
+            }
+            const auto row_width = static_cast<uint32_t>(grid.values.size() - first_value);
+            if (grid.height > 0 && row_width != grid.width) {
+                throw std::runtime_error{path + ':' + std::to_string(line_number) + ": expected " + std::to_string(grid.width) + " values"};
+            }
+            grid.width = row_width;
+            ++grid.height;
+        }
+        return grid;
+    }
+
+    static DataGrid load_raw(const std::string &path) {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+        const auto count = static_cast<size_t>(file.tellg()) / sizeof(float);
+        const auto side = static_cast<uint32_t>(std::llround(std::sqrt(static_cast<double>(count))));
+        if (static_cast<size_t>(side) * side != count) { throw std::runtime_error{"'" + path + "' is not a square float32 grid"}; }
+        DataGrid grid{side, side, std::vector<float>(count)};
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(grid.values.data()), static_cast<std::streamsize>(count * sizeof(float)));
+        return grid;
+    }
+
+    DataGrid load_data_grid(const std::string &path) {
+        auto extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        auto grid = extension == ".csv" || extension == ".txt" || extension == ".tsv" ? load_table(path)
+                  : extension == ".r32"                                              ? load_raw(path)
+                                                                                     : load_image(path);
+        if (grid.width == 0 || grid.height == 0) { throw std::runtime_error{"'" + path + "' holds no values"}; }
+        return grid;
+    }
+
+    std::vector<DataPoint> load_data_points(const std::string &path) {
+        std::ifstream file{path};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+
+        // from_chars rather than streams, point clouds run into millions of lines
+        std::vector<DataPoint> points;
+        std::string line;
+        for (uint32_t line_number = 1; std::getline(file, line); ++line_number) {
+            line = line.substr(0, line.find('#'));
+            std::replace_if(line.begin(), line.end(), [](char c) { return c == ',' || c == '\t' || c == '\r'; }, ' ');
+            if (line.find_first_not_of(' ') == std::string::npos) { continue; }
+
+            const char *p = line.data(), *end = line.data() + line.size();
+            double xzy[3];
+            for (auto &v : xzy) {
+                while (p < end && *p == ' ') { ++p; }
+                if (p < end && *p == '+') { ++p; } // from_chars takes no plus sign
+                const auto [next, ec] = std::from_chars(p, end, v);
+                if (ec != std::errc{}) { throw std::runtime_error{path + ':' + std::to_string(line_number) + ": expected \"x z y\""}; }
+                p = next;
+            }
+            points.push_back(DataPoint{xzy[0], xzy[1], xzy[2]});
+        }
+        return points;
+    }
+
+    // Position on the grid along one axis, clamped to the edge samples; `scale` converts per-sample derivatives
+    struct AxisSample {
+        int32_t i;           // first of the two middle taps
+        double t;            // in [0, 1] between taps i and i + 1
+        double scale;        // samples per unit, zero where the position was clamped
+    };
+    static AxisSample axis_sample(double v, double min, double max, uint32_t size) {
+        const auto last = static_cast<double>(size - 1);
+        const auto g = (v - min) / (max - min) * last;
+        const auto clamped = std::isnan(g) ? 0.0 : std::clamp(g, 0.0, last); // casting NaN to an index is undefined
+        const auto i = std::min(static_cast<int32_t>(clamped), std::max(static_cast<int32_t>(size) - 2, 0));
+        return {i, clamped - i, g == clamped ? last / (max - min) : 0.0};
+    }
+
+    // Catmull-Rom weights of the taps i - 1 .. i + 2 and their first and second derivatives in t
+    static void catmull_rom(double t, double w[4], double d1[4], double d2[4]) {
+        const auto t2 = t * t, t3 = t2 * t;
+        w[0] = 0.5 * (-t3 + 2.0 * t2 - t);      d1[0] = 0.5 * (-3.0 * t2 + 4.0 * t - 1.0); d2[0] = 0.5 * (-6.0 * t + 4.0);
+        w[1] = 0.5 * (3.0 * t3 - 5.0 * t2 + 2.0); d1[1] = 0.5 * (9.0 * t2 - 10.0 * t);      d2[1] = 0.5 * (18.0 * t - 10.0);
+        w[2] = 0.5 * (-3.0 * t3 + 4.0 * t2 + t); d1[2] = 0.5 * (-9.0 * t2 + 8.0 * t + 1.0); d2[2] = 0.5 * (-18.0 * t + 8.0);
+        w[3] = 0.5 * (t3 - t2);                  d1[3] = 0.5 * (3.0 * t2 - 2.0 * t);        d2[3] = 0.5 * (6.0 * t - 2.0);
+    }
+
+    DataSample sample_data(const DataSampler &sampler, double x, double z) {
+        const auto &grid = *sampler.grid;
+        const auto ax = axis_sample(x, sampler.x_min, sampler.x_max, grid.width);
+        const auto az = axis_sample(z, sampler.z_min, sampler.z_max, grid.height);
+        const auto texel = [&](int32_t i, int32_t j) {
+            i = std::clamp(i, 0, static_cast<int32_t>(grid.width) - 1);
+            j = std::clamp(j, 0, static_cast<int32_t>(grid.height) - 1);
+            return static_cast<double>(grid.values[static_cast<size_t>(j) * grid.width + i]);
+        };
+
+        // tensor product of per-axis weights; bilinear is the two tap case with no curvature
+        double wx[4], dx[4], ddx[4], wz[4], dz[4], ddz[4];
+        int32_t first = 0, taps = 2;
+        if (sampler.sampling == DataSampling::Bicubic) {
+            catmull_rom(ax.t, wx, dx, ddx);
+            catmull_rom(az.t, wz, dz, ddz);
+            first = -1; taps = 4;
+        } else {
+            wx[0] = 1.0 - ax.t; wx[1] = ax.t; dx[0] = -1.0; dx[1] = 1.0; ddx[0] = ddx[1] = 0.0;
+            wz[0] = 1.0 - az.t; wz[1] = az.t; dz[0] = -1.0; dz[1] = 1.0; ddz[0] = ddz[1] = 0.0;
+        }
+        DataSample s;
+        for (int32_t b = 0; b < taps; ++b) {
+            for (int32_t a = 0; a < taps; ++a) {
+                const auto v = texel(ax.i + first + a, az.i + first + b);
+                s.f   += wx[a] * wz[b] * v;
+                s.fx  += dx[a] * wz[b] * v;
+                s.fz  += wx[a] * dz[b] * v;
+                s.fxx += ddx[a] * wz[b] * v;
+                s.fxz += dx[a] * dz[b] * v;
+                s.fzz += wx[a] * ddz[b] * v;
+            }
+        }
+        s.fx *= ax.scale; s.fxx *= ax.scale * ax.scale;
+        s.fz *= az.scale; s.fzz *= az.scale * az.scale;
+        s.fxz *= ax.scale * az.scale;
+        return s;
+    }
+
+    void sample_data_batch(const DataSampler &sampler, const double *xs, const double *zs, double *out, size_t count) {
+        constexpr size_t LANES = 64;
+        const auto &grid = *sampler.grid;
+        const auto w = static_cast<int32_t>(grid.width), h = static_cast<int32_t>(grid.height);
+        const auto sx = (w - 1) / (sampler.x_max - sampler.x_min), sz = (h - 1) / (sampler.z_max - sampler.z_min);
+        const auto *values = grid.values.data();
+
+        int32_t ix[LANES], iz[LANES];
+        double tx[LANES], tz[LANES];
+        for (size_t first = 0; first < count; first += LANES) {
+            const auto lanes = std::min(LANES, count - first);
+            // branch-free per lane, so the loop vectorises and the loads below become gathers; NaN samples the first texel
+            // like axis_sample() does
+            for (size_t l = 0; l < lanes; ++l) {
+                const auto ux = (xs[first + l] - sampler.x_min) * sx, uz = (zs[first + l] - sampler.z_min) * sz;
+                const auto gx = std::clamp(std::isnan(ux) ? 0.0 : ux, 0.0, static_cast<double>(w - 1));
+                const auto gz = std::clamp(std::isnan(uz) ? 0.0 : uz, 0.0, static_cast<double>(h - 1));
+                ix[l] = std::min(static_cast<int32_t>(gx), std::max(w - 2, 0));
+                iz[l] = std::min(static_cast<int32_t>(gz), std::max(h - 2, 0));
+                tx[l] = gx - ix[l];
+                tz[l] = gz - iz[l];
+            }
+            if (sampler.sampling == DataSampling::Bilinear) {
+                const auto step_x = w > 1 ? 1 : 0, step_z = h > 1 ? w : 0;
+                for (size_t l = 0; l < lanes; ++l) {
+                    const auto *p = values + static_cast<size_t>(iz[l]) * w + ix[l];
+                    const double v00 = p[0], v10 = p[step_x], v01 = p[step_z], v11 = p[step_z + step_x];
+                    const auto top = v00 + (v10 - v00) * tx[l], bottom = v01 + (v11 - v01) * tx[l];
+                    out[first + l] = top + (bottom - top) * tz[l];
+                }
+            } else {
+                for (size_t l = 0; l < lanes; ++l) {
+                    double wx[4], wz[4], unused[4];
+                    catmull_rom(tx[l], wx, unused, unused);
+                    catmull_rom(tz[l], wz, unused, unused);
+                    double sum = 0.0;
+                    for (int32_t b = 0; b < 4; ++b) {
+                        const auto *row = values + static_cast<size_t>(std::clamp(iz[l] + b - 1, 0, h - 1)) * w;
+                        double row_sum = 0.0;
+                        for (int32_t a = 0; a < 4; ++a) { row_sum += wx[a] * row[std::clamp(ix[l] + a - 1, 0, w - 1)]; }
+                        sum += wz[b] * row_sum;
+                    }
+                    out[first + l] = sum;
+                }
+            }
+        }
+    }
+
+} // namespace g3d
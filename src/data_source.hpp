@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    enum class DataSampling : uint32_t { Bilinear, Bicubic };
+
+    // Row-major samples, row 0 along z_min and column 0 along x_min of the domain they are mapped onto
+    struct DataGrid {
+        uint32_t width{0}, height{0};
+        std::vector<float> values;
+    };
+
+    // Images go through stb_image as one luminance channel scaled to [0, 1] (16 bit and HDR images keep
+    // their precision); ".csv", ".txt" and ".tsv" are tables with one row per line; ".r32" is a square raw
+    // float32 grid. Throws std::runtime_error for unreadable or ragged files.
+    DataGrid load_data_grid(const std::string &path);
+
+    struct DataPoint {
+        double x{0.0}, z{0.0}, y{0.0};
+    };
+    // One "x z y" triple per line, separated by spaces, tabs or commas; '#' starts a comment.
+    // Throws std::runtime_error when the file cannot be read or a line is malformed.
+    std::vector<DataPoint> load_data_points(const std::string &path);
+
+    // What an equation's name(x, z) call samples: the grid spans [x_min, x_max] x [z_min, z_max] with its
+    // first and last samples on the edges, and clamps to the edge beyond. Bicubic is Catmull-Rom.
+    struct DataSampler {
+        std::shared_ptr<const DataGrid> grid;
+        double x_min{-1.0}, x_max{1.0}, z_min{-1.0}, z_max{1.0};
+        DataSampling sampling{DataSampling::Bilinear};
+    };
+    // Value and derivatives of the interpolant with respect to x and z
+    struct DataSample {
+        double f{0.0}, fx{0.0}, fz{0.0}, fxx{0.0}, fxz{0.0}, fzz{0.0};
+    };
+    DataSample sample_data(const DataSampler &sampler, double x, double z);
+    // Values only: texel indices and weights are computed for every lane first, then gathered in one pass
+    void sample_data_batch(const DataSampler &sampler, const double *xs, const double *zs, double *out, size_t count);
+} // namespace g3d
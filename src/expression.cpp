@@ -0,0 +1,605 @@
+#include "expression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace g3d {
+
+    /* Parsing */
+
+    struct Node {
+        enum class Kind { Number, Identifier, Call, Negate, Binary } kind{Kind::Number};
+        double value{0.0};
+        std::string name; // identifier or callee
+        char op{0};       // Binary only
+        std::vector<Node> children;
+    };
+
+    struct Parser {
+        std::string_view source;
+        size_t pos{0};
+
+        [[noreturn]] void fail(const std::string &message) const {
+            throw std::runtime_error{"CPU evaluator: " + message + " at '" + std::string{source} + "':" + std::to_string(pos + 1)};
+        }
+        void skip_spaces() { while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) { ++pos; } }
+        bool accept(char c) {
+            skip_spaces();
+            if (pos < source.size() && source[pos] == c) { ++pos; return true; }
+            return false;
+        }
+        void expect(char c) { if (accept(c) == false) { fail(std::string{"expected '"} + c + "'"); } }
+
+        Node parse() {
+            auto node = expression();
+            skip_spaces();
+            if (pos != source.size()) { fail("unexpected character"); }
+            return node;
+        }
+        Node expression() {
+            auto lhs = term();
+            for (;;) {
+                if      (accept('+')) { lhs = binary('+', std::move(lhs), term()); }
+                else if (accept('-')) { lhs = binary('-', std::move(lhs), term()); }
+                else { return lhs; }
+            }
+        }
+        Node term() {
+            auto lhs = unary();
+            for (;;) {
+                if      (accept('*')) { lhs = binary('*', std::move(lhs), unary()); }
+                else if (accept('/')) { lhs = binary('/', std::move(lhs), unary()); }
+                else { return lhs; }
+            }
+        }
+        Node unary() {
+            if (accept('+')) { return unary(); }
+            if (accept('-')) { return Node{.kind = Node::Kind::Negate, .children = {unary()}}; }
+            return primary();
+        }
+        Node primary() {
+            skip_spaces();
+            if (accept('(')) {
+                auto node = expression();
+                expect(')');
+                return node;
+            }
+            if (pos < source.size() && (std::isdigit(static_cast<unsigned char>(source[pos])) || source[pos] == '.')) { return number(); }
+            if (pos < source.size() && (std::isalpha(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) {
+                const auto begin = pos;
+                while (pos < source.size() && (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) { ++pos; }
+                Node node{.kind = Node::Kind::Identifier, .name = std::string{source.substr(begin, pos - begin)}};
+                if (accept('(')) {
+                    node.kind = Node::Kind::Call;
+                    if (accept(')') == false) {
+                        do { node.children.push_back(expression()); } while (accept(','));
+                        expect(')');
+                    }
+                }
+                return node;
+            }
+            fail(pos < source.size() ? "unsupported syntax" : "unexpected end of expression");
+        }
+        Node number() {
+            const auto begin = pos;
+            while (pos < source.size() && (std::isdigit(static_cast<unsigned char>(source[pos])) || source[pos] == '.')) { ++pos; }
+            if (pos < source.size() && (source[pos] == 'e' || source[pos] == 'E')) {
+                ++pos;
+                if (pos < source.size() && (source[pos] == '+' || source[pos] == '-')) { ++pos; }
+                while (pos < source.size() && std::isdigit(static_cast<unsigned char>(source[pos]))) { ++pos; }
+            }
+            const auto text = std::string{source.substr(begin, pos - begin)};
+            if (pos < source.size() && (source[pos] == 'f' || source[pos] == 'F')) { ++pos; } // GLSL float suffix
+            char *end = nullptr;
+            const auto value = std::strtod(text.c_str(), &end);
+            if (end != text.c_str() + text.size()) { fail("malformed number"); }
+            return Node{.kind = Node::Kind::Number, .value = value};
+        }
+        static Node binary(char op, Node lhs, Node rhs) {
+            Node node{.kind = Node::Kind::Binary, .op = op};
+            node.children.push_back(std::move(lhs));
+            node.children.push_back(std::move(rhs));
+            return node;
+        }
+    };
+
+    /* Scalar semantics, shared by constant folding and every evaluator */
+
+    static double apply(Op op, double a, double b) {
+        switch (op) {
+        case Op::Add: return a + b;
+        case Op::Sub: return a - b;
+        case Op::Mul: return a * b;
+        case Op::Div: return a / b;
+        case Op::Neg: return -a;
+        case Op::Sin: return std::sin(a);
+        case Op::Cos: return std::cos(a);
+        case Op::Tan: return std::tan(a);
+        case Op::Asin: return std::asin(a);
+        case Op::Acos: return std::acos(a);
+        case Op::Atan: return std::atan(a);
+        case Op::Sinh: return std::sinh(a);
+        case Op::Cosh: return std::cosh(a);
+        case Op::Tanh: return std::tanh(a);
+        case Op::Asinh: return std::asinh(a);
+        case Op::Acosh: return std::acosh(a);
+        case Op::Atanh: return std::atanh(a);
+        case Op::Exp: return std::exp(a);
+        case Op::Log: return std::log(a);
+        case Op::Exp2: return std::exp2(a);
+        case Op::Log2: return std::log2(a);
+        case Op::Sqrt: return std::sqrt(a);
+        case Op::InverseSqrt: return 1.0 / std::sqrt(a);
+        case Op::Abs: return std::abs(a);
+        case Op::Sign: return static_cast<double>((a > 0.0) - (a < 0.0));
+        case Op::Floor: return std::floor(a);
+        case Op::Ceil: return std::ceil(a);
+        case Op::Fract: return a - std::floor(a);
+        case Op::Radians: return a * (std::numbers::pi / 180.0);
+        case Op::Degrees: return a * (180.0 / std::numbers::pi);
+        case Op::Pow: return std::pow(a, b);
+        case Op::Mod: return a - b * std::floor(a / b); // GLSL mod, not fmod
+        case Op::Min: return b < a ? b : a;
+        case Op::Max: return a < b ? b : a;
+        case Op::Atan2: return std::atan2(a, b);
+        case Op::Step: return a > b ? 0.0 : 1.0; // step(edge, x)
+        default: return 0.0;
+        }
+    }
+    static bool is_binary(Op op) { return op == Op::Add || op == Op::Sub || op == Op::Mul || op == Op::Div || op >= Op::Pow; }
+
+    // First and second derivatives of a unary op at a
+    struct UnaryDerivatives { double f, f1, f2; };
+    static UnaryDerivatives differentiate(Op op, double a) {
+        const auto f = apply(op, a, 0.0);
+        switch (op) {
+        case Op::Neg: return {f, -1.0, 0.0};
+        case Op::Sin: return {f, std::cos(a), -f};
+        case Op::Cos: return {f, -std::sin(a), -f};
+        case Op::Tan: return {f, 1.0 + f * f, 2.0 * f * (1.0 + f * f)};
+        case Op::Asin: { const auto q = 1.0 - a * a; return {f, 1.0 / std::sqrt(q), a / (q * std::sqrt(q))}; }
+        case Op::Acos: { const auto q = 1.0 - a * a; return {f, -1.0 / std::sqrt(q), -a / (q * std::sqrt(q))}; }
+        case Op::Atan: { const auto q = 1.0 + a * a; return {f, 1.0 / q, -2.0 * a / (q * q)}; }
+        case Op::Sinh: return {f, std::cosh(a), f};
+        case Op::Cosh: return {f, std::sinh(a), f};
+        case Op::Tanh: return {f, 1.0 - f * f, -2.0 * f * (1.0 - f * f)};
+        case Op::Asinh: { const auto q = a * a + 1.0; return {f, 1.0 / std::sqrt(q), -a / (q * std::sqrt(q))}; }
+        case Op::Acosh: { const auto q = a * a - 1.0; return {f, 1.0 / std::sqrt(q), -a / (q * std::sqrt(q))}; }
+        case Op::Atanh: { const auto q = 1.0 - a * a; return {f, 1.0 / q, 2.0 * a / (q * q)}; }
+        case Op::Exp: return {f, f, f};
+        case Op::Log: return {f, 1.0 / a, -1.0 / (a * a)};
+        case Op::Exp2: return {f, f * std::numbers::ln2, f * std::numbers::ln2 * std::numbers::ln2};
+        case Op::Log2: return {f, 1.0 / (a * std::numbers::ln2), -1.0 / (a * a * std::numbers::ln2)};
+        case Op::Sqrt: return {f, 0.5 / f, -0.25 / (f * f * f)};
+        case Op::InverseSqrt: return {f, -0.5 * f / a, 0.75 * f / (a * a)};
+        case Op::Abs: return {f, static_cast<double>((a > 0.0) - (a < 0.0)), 0.0};
+        case Op::Fract: return {f, 1.0, 0.0};
+        case Op::Radians: return {f, std::numbers::pi / 180.0, 0.0};
+        case Op::Degrees: return {f, 180.0 / std::numbers::pi, 0.0};
+        default: return {f, 0.0, 0.0}; // sign, floor, ceil: piecewise constant
+        }
+    }
+
+    // Partial derivatives of a binary op at (a, b)
+    struct BinaryDerivatives { double f, fa, fb, faa, fab, fbb; };
+    static BinaryDerivatives differentiate(Op op, double a, double b) {
+        const auto f = apply(op, a, b);
+        switch (op) {
+        case Op::Add: return {f, 1.0, 1.0, 0.0, 0.0, 0.0};
+        case Op::Sub: return {f, 1.0, -1.0, 0.0, 0.0, 0.0};
+        case Op::Mul: return {f, b, a, 0.0, 1.0, 0.0};
+        case Op::Div: return {f, 1.0 / b, -a / (b * b), 0.0, -1.0 / (b * b), 2.0 * a / (b * b * b)};
+        case Op::Pow: {
+            // the logarithm only exists for positive bases; elsewhere the exponent is treated as constant
+            const auto ln_a = a > 0.0 ? std::log(a) : 0.0;
+            const auto a_b1 = b == 0.0 ? 0.0 : std::pow(a, b - 1.0);
+            const auto a_b2 = b == 0.0 || b == 1.0 ? 0.0 : std::pow(a, b - 2.0);
+            return {f, b * a_b1, f * ln_a, b * (b - 1.0) * a_b2, a_b1 * (1.0 + b * ln_a), f * ln_a * ln_a};
+        }
+        case Op::Mod: return {f, 1.0, -std::floor(a / b), 0.0, 0.0, 0.0};
+        case Op::Min: return b < a ? BinaryDerivatives{f, 0.0, 1.0, 0.0, 0.0, 0.0} : BinaryDerivatives{f, 1.0, 0.0, 0.0, 0.0, 0.0};
+        case Op::Max: return a < b ? BinaryDerivatives{f, 0.0, 1.0, 0.0, 0.0, 0.0} : BinaryDerivatives{f, 1.0, 0.0, 0.0, 0.0, 0.0};
+        case Op::Atan2: {
+            const auto r2 = a * a + b * b, r4 = r2 * r2;
+            return {f, b / r2, -a / r2, -2.0 * a * b / r4, (a * a - b * b) / r4, 2.0 * a * b / r4};
+        }
+        default: return {f, 0.0, 0.0, 0.0, 0.0, 0.0}; // step
+        }
+    }
+
+    /* Number types */
+
+    template <typename T> struct Number;
+    template <> struct Number<double> {
+        static double constant(double c) { return c; }
+        static double value(double a) { return a; }
+        static double unary(Op op, double a) { return apply(op, a, 0.0); }
+        static double binary(Op op, double a, double b) { return apply(op, a, b); }
+        static double chain(const BinaryDerivatives &d, double, double) { return d.f; }
+    };
+    template <int N> struct Number<Dual<N>> {
+        static Dual<N> constant(double c) { return Dual<N>{.v = c}; }
+        static double value(const Dual<N> &a) { return a.v; }
+        static Dual<N> unary(Op op, const Dual<N> &a) {
+            const auto d = differentiate(op, a.v);
+            Dual<N> r{.v = d.f};
+            for (int i = 0; i < N; ++i) { r.d[i] = d.f1 * a.d[i]; }
+            return r;
+        }
+        static Dual<N> binary(Op op, const Dual<N> &a, const Dual<N> &b) { return chain(differentiate(op, a.v, b.v), a, b); }
+        static Dual<N> chain(const BinaryDerivatives &d, const Dual<N> &a, const Dual<N> &b) {
+            Dual<N> r{.v = d.f};
+            for (int i = 0; i < N; ++i) { r.d[i] = d.fa * a.d[i] + d.fb * b.d[i]; }
+            return r;
+        }
+    };
+    template <> struct Number<Jet> {
+        static Jet constant(double c) { return Jet{.v = c}; }
+        static double value(const Jet &a) { return a.v; }
+        static Jet unary(Op op, const Jet &a) {
+            const auto d = differentiate(op, a.v);
+            return Jet{
+                .v = d.f, .dx = d.f1 * a.dx, .dz = d.f1 * a.dz,
+                .dxx = d.f1 * a.dxx + d.f2 * a.dx * a.dx,
+                .dxz = d.f1 * a.dxz + d.f2 * a.dx * a.dz,
+                .dzz = d.f1 * a.dzz + d.f2 * a.dz * a.dz,
+            };
+        }
+        static Jet binary(Op op, const Jet &a, const Jet &b) { return chain(differentiate(op, a.v, b.v), a, b); }
+        static Jet chain(const BinaryDerivatives &d, const Jet &a, const Jet &b) {
+            return Jet{
+                .v = d.f, .dx = d.fa * a.dx + d.fb * b.dx, .dz = d.fa * a.dz + d.fb * b.dz,
+                .dxx = d.fa * a.dxx + d.fb * b.dxx + d.faa * a.dx * a.dx + 2.0 * d.fab * a.dx * b.dx + d.fbb * b.dx * b.dx,
+                .dxz = d.fa * a.dxz + d.fb * b.dxz + d.faa * a.dx * a.dz + d.fab * (a.dx * b.dz + a.dz * b.dx) + d.fbb * b.dx * b.dz,
+                .dzz = d.fa * a.dzz + d.fb * b.dzz + d.faa * a.dz * a.dz + 2.0 * d.fab * a.dz * b.dz + d.fbb * b.dz * b.dz,
+            };
+        }
+    };
+
+    /* Compilation */
+
+    struct Compiler {
+        struct Key {
+            Op op; uint32_t a, b; uint64_t value_bits;
+            bool operator==(const Key &) const = default;
+        };
+        struct KeyHash {
+            size_t operator()(const Key &k) const {
+                return std::hash<uint64_t>{}(k.value_bits ^ (uint64_t(k.op) << 56) ^ (uint64_t(k.a) << 28) ^ k.b);
+            }
+        };
+
+        const std::vector<Function> &functions;
+        const std::vector<Constant> &constants;
+        const std::vector<Slider> &sliders;
+        const std::vector<DataSource> &data_sources;
+        Program program;
+        std::unordered_map<Key, uint32_t, KeyHash> emitted;
+        std::unordered_map<std::string, Node> parsed;
+        std::vector<std::string> call_stack;
+
+        uint32_t emit(Op op, uint32_t a = 0, uint32_t b = 0, double value = 0.0) {
+            const auto is_constant = [&](uint32_t r) { return program.code[r].op == Op::Constant; };
+            if (op != Op::Constant && op != Op::X && op != Op::Z && op != Op::Parameter && op != Op::Sample && is_constant(a) && (is_binary(op) == false || is_constant(b))) {
+                value = apply(op, program.code[a].value, is_binary(op) ? program.code[b].value : 0.0);
+                op = Op::Constant;
+                a = b = 0;
+            }
+            if (is_binary(op) == false && op != Op::Parameter) { b = 0; }
+            if ((op == Op::Add || op == Op::Mul || op == Op::Min || op == Op::Max) && b < a) { std::swap(a, b); } // commutative
+
+            Key key{op, a, b, 0};
+            std::memcpy(&key.value_bits, &value, sizeof(double));
+            const auto [it, inserted] = emitted.try_emplace(key, static_cast<uint32_t>(program.code.size()));
+            if (inserted) { program.code.push_back(Instruction{.op = op, .a = a, .b = b, .value = value}); }
+            return it->second;
+        }
+        uint32_t constant(double value) { return emit(Op::Constant, 0, 0, value); }
+
+        uint32_t compile_function(const std::string &name, uint32_t x, uint32_t z) {
+            const auto function = std::find_if(functions.begin(), functions.end(), [&](const Function &f) { return f.name == name; });
+            if (std::find(call_stack.begin(), call_stack.end(), name) != call_stack.end()) {
+                throw std::runtime_error{"CPU evaluator: function '" + name + "' is recursive"};
+            }
+            auto it = parsed.find(name);
+            if (it == parsed.end()) { it = parsed.emplace(name, Parser{function->value}.parse()).first; }
+
+            call_stack.push_back(name);
+            const auto result = compile(it->second, x, z);
+            call_stack.pop_back();
+            return result;
+        }
+
+        uint32_t compile(const Node &node, uint32_t x, uint32_t z) {
+            switch (node.kind) {
+            case Node::Kind::Number: return constant(node.value);
+            case Node::Kind::Negate: return emit(Op::Neg, compile(node.children[0], x, z));
+            case Node::Kind::Binary: {
+                const auto a = compile(node.children[0], x, z);
+                const auto b = compile(node.children[1], x, z);
+                switch (node.op) {
+                case '+': return emit(Op::Add, a, b);
+                case '-': return emit(Op::Sub, a, b);
+                case '*': return emit(Op::Mul, a, b);
+                default:  return emit(Op::Div, a, b);
+                }
+            }
+            case Node::Kind::Identifier: return identifier(node.name, x, z);
+            case Node::Kind::Call: return call(node, x, z);
+            }
+            return 0;
+        }
+
+        uint32_t identifier(const std::string &name, uint32_t x, uint32_t z) {
+            if (name == "x") { return x; }
+            if (name == "z") { return z; }
+            if (name == "TIME") { return emit(Op::Parameter, Program::PARAMETER_TIME); }
+            for (const auto &c : constants) {
+                if (c.name == name) { return constant(c.value); }
+            }
+            for (uint32_t i = 0; i < sliders.size(); ++i) {
+                if (sliders[i].name == name) { return emit(Op::Parameter, Program::PARAMETER_TIME + 1 + i); }
+            }
+            throw std::runtime_error{"CPU evaluator: unknown identifier '" + name + "'"};
+        }
+
+        uint32_t call(const Node &node, uint32_t x, uint32_t z) {
+            static const std::unordered_map<std::string, Op> UNARY = {
+                {"sin", Op::Sin}, {"cos", Op::Cos}, {"tan", Op::Tan}, {"asin", Op::Asin}, {"acos", Op::Acos},
+                {"sinh", Op::Sinh}, {"cosh", Op::Cosh}, {"tanh", Op::Tanh}, {"asinh", Op::Asinh}, {"acosh", Op::Acosh}, {"atanh", Op::Atanh},
+                {"exp", Op::Exp}, {"log", Op::Log}, {"exp2", Op::Exp2}, {"log2", Op::Log2}, {"sqrt", Op::Sqrt}, {"inversesqrt", Op::InverseSqrt},
+                {"abs", Op::Abs}, {"sign", Op::Sign}, {"floor", Op::Floor}, {"ceil", Op::Ceil}, {"fract", Op::Fract},
+                {"radians", Op::Radians}, {"degrees", Op::Degrees},
+            };
+            static const std::unordered_map<std::string, Op> BINARY = {
+                {"pow", Op::Pow}, {"mod", Op::Mod}, {"min", Op::Min}, {"max", Op::Max}, {"step", Op::Step},
+            };
+
+            std::vector<uint32_t> args;
+            for (const auto &child : node.children) { args.push_back(compile(child, x, z)); }
+            const auto expect_args = [&](size_t count) {
+                if (args.size() != count) {
+                    throw std::runtime_error{"CPU evaluator: '" + node.name + "' takes " + std::to_string(count) + " argument(s)"};
+                }
+            };
+
+            if (const auto it = UNARY.find(node.name); it != UNARY.end()) { expect_args(1); return emit(it->second, args[0]); }
+            if (const auto it = BINARY.find(node.name); it != BINARY.end()) { expect_args(2); return emit(it->second, args[0], args[1]); }
+            if (node.name == "atan") {
+                if (args.size() == 2) { return emit(Op::Atan2, args[0], args[1]); }
+                expect_args(1);
+                return emit(Op::Atan, args[0]);
+            }
+            if (node.name == "clamp") {
+                expect_args(3);
+                return emit(Op::Min, emit(Op::Max, args[0], args[1]), args[2]);
+            }
+            if (node.name == "mix") {
+                expect_args(3);
+                return emit(Op::Add, args[0], emit(Op::Mul, emit(Op::Sub, args[1], args[0]), args[2]));
+            }
+            if (node.name == "smoothstep") {
+                expect_args(3);
+                const auto t  = emit(Op::Div, emit(Op::Sub, args[2], args[0]), emit(Op::Sub, args[1], args[0]));
+                const auto tc = emit(Op::Min, emit(Op::Max, t, constant(0.0)), constant(1.0));
+                return emit(Op::Mul, emit(Op::Mul, tc, tc), emit(Op::Sub, constant(3.0), emit(Op::Mul, constant(2.0), tc)));
+            }
+            if (const auto source = std::find_if(data_sources.begin(), data_sources.end(), [&](const DataSource &d) { return d.name == node.name; });
+                source != data_sources.end()) {
+                expect_args(2);
+                if (source->grid == nullptr) { throw std::runtime_error{"CPU evaluator: data source '" + node.name + "' has no data"}; }
+                // one sampler per source, shared by every call to it
+                auto sampler = std::find_if(program.samplers.begin(), program.samplers.end(), [&](const DataSampler &s) { return s.grid == source->grid; });
+                if (sampler == program.samplers.end()) {
+                    program.samplers.push_back(DataSampler{source->grid, source->domain.x, source->domain.y, source->domain.z, source->domain.w, source->sampling});
+                    sampler = program.samplers.end() - 1;
+                }
+                return emit(Op::Sample, args[0], args[1], static_cast<double>(sampler - program.samplers.begin()));
+            }
+            if (std::any_of(functions.begin(), functions.end(), [&](const Function &f) { return f.name == node.name; })) {
+                expect_args(2);
+                return compile_function(node.name, args[0], args[1]);
+            }
+            throw std::runtime_error{"CPU evaluator: unsupported function '" + node.name + "'"};
+        }
+    };
+
+    Program compile_program(std::string_view function_name,
+                            const std::vector<Function> &functions,
+                            const std::vector<Constant> &constants,
+                            const std::vector<Slider> &sliders,
+                            const std::vector<DataSource> &data_sources) {
+        const auto function = std::find_if(functions.begin(), functions.end(), [&](const Function &f) { return f.name == function_name; });
+        if (function == functions.end()) { throw std::runtime_error{"CPU evaluator: no function named '" + std::string{function_name} + "'"}; }
+
+        Compiler compiler{functions, constants, sliders, data_sources};
+        compiler.program.parameter_count = static_cast<uint32_t>(sliders.size()) + 1;
+        const auto x = compiler.emit(Op::X);
+        const auto z = compiler.emit(Op::Z);
+        compiler.program.result = compiler.compile_function(function->name, x, z);
+        return std::move(compiler.program);
+    }
+
+    std::vector<double> make_parameters(const std::vector<Slider> &sliders, double time) {
+        std::vector<double> parameters{time};
+        for (const auto &s : sliders) { parameters.push_back(s.value); }
+        return parameters;
+    }
+
+    /* Evaluation */
+
+    template <typename T>
+    T evaluate(const Program &program, const T &x, const T &z, const T *parameters) {
+        thread_local std::vector<T> registers;
+        registers.resize(program.code.size());
+        for (size_t i = 0; i < program.code.size(); ++i) {
+            const auto &in = program.code[i];
+            switch (in.op) {
+            case Op::Constant:  registers[i] = Number<T>::constant(in.value); break;
+            case Op::X:         registers[i] = x; break;
+            case Op::Z:         registers[i] = z; break;
+            case Op::Parameter: registers[i] = parameters[in.a]; break;
+            case Op::Sample: {
+                const auto s = sample_data(program.samplers[static_cast<size_t>(in.value)], Number<T>::value(registers[in.a]), Number<T>::value(registers[in.b]));
+                registers[i] = Number<T>::chain(BinaryDerivatives{s.f, s.fx, s.fz, s.fxx, s.fxz, s.fzz}, registers[in.a], registers[in.b]);
+                break;
+            }
+            default:
+                registers[i] = is_binary(in.op) ? Number<T>::binary(in.op, registers[in.a], registers[in.b])
+                                                : Number<T>::unary(in.op, registers[in.a]);
+            }
+        }
+        return registers[program.result];
+    }
+    template double evaluate<double>(const Program &, const double &, const double &, const double *);
+    template Dual<2> evaluate<Dual<2>>(const Program &, const Dual<2> &, const Dual<2> &, const Dual<2> *);
+    template Dual<8> evaluate<Dual<8>>(const Program &, const Dual<8> &, const Dual<8> &, const Dual<8> *);
+    template Jet evaluate<Jet>(const Program &, const Jet &, const Jet &, const Jet *);
+
+    double evaluate(const Program &program, double x, double z, const double *parameters) {
+        return evaluate<double>(program, x, z, parameters);
+    }
+
+    Dual<2> evaluate_gradient(const Program &program, double x, double z, const double *parameters) {
+        thread_local std::vector<Dual<2>> lifted;
+        lifted.resize(program.parameter_count);
+        for (uint32_t i = 0; i < program.parameter_count; ++i) { lifted[i] = Dual<2>{.v = parameters[i]}; }
+        return evaluate<Dual<2>>(program, Dual<2>{.v = x, .d = {1.0, 0.0}}, Dual<2>{.v = z, .d = {0.0, 1.0}}, lifted.data());
+    }
+
+    Jet evaluate_jet(const Program &program, double x, double z, const double *parameters) {
+        thread_local std::vector<Jet> lifted;
+        lifted.resize(program.parameter_count);
+        for (uint32_t i = 0; i < program.parameter_count; ++i) { lifted[i] = Jet{.v = parameters[i]}; }
+        return evaluate<Jet>(program, Jet{.v = x, .dx = 1.0}, Jet{.v = z, .dz = 1.0}, lifted.data());
+    }
+
+    void evaluate_batch(const Program &program, const double *xs, const double *zs, const double *parameters, double *out, size_t count) {
+        constexpr size_t LANES = 64;
+        thread_local std::vector<double> registers;
+        registers.resize(program.code.size() * LANES);
+
+        for (size_t first = 0; first < count; first += LANES) {
+            const auto lanes = std::min(LANES, count - first);
+            for (size_t i = 0; i < program.code.size(); ++i) {
+                const auto &in = program.code[i];
+                auto *r = &registers[i * LANES];
+                // leaves read no registers, the `a` of a parameter is its index
+                switch (in.op) {
+                case Op::Constant:  std::fill_n(r, lanes, in.value); continue;
+                case Op::X:         std::copy_n(xs + first, lanes, r); continue;
+                case Op::Z:         std::copy_n(zs + first, lanes, r); continue;
+                case Op::Parameter: std::fill_n(r, lanes, parameters[in.a]); continue;
+                default: break;
+                }
+                const auto *a = &registers[in.a * LANES];
+                const auto *b = &registers[in.b * LANES];
+                // the op is dispatched once per batch, the lane loops are plain arithmetic
+                switch (in.op) {
+                case Op::Add: for (size_t l = 0; l < lanes; ++l) { r[l] = a[l] + b[l]; } break;
+                case Op::Sub: for (size_t l = 0; l < lanes; ++l) { r[l] = a[l] - b[l]; } break;
+                case Op::Mul: for (size_t l = 0; l < lanes; ++l) { r[l] = a[l] * b[l]; } break;
+                case Op::Div: for (size_t l = 0; l < lanes; ++l) { r[l] = a[l] / b[l]; } break;
+                case Op::Neg: for (size_t l = 0; l < lanes; ++l) { r[l] = -a[l]; } break;
+                case Op::Min: for (size_t l = 0; l < lanes; ++l) { r[l] = b[l] < a[l] ? b[l] : a[l]; } break;
+                case Op::Max: for (size_t l = 0; l < lanes; ++l) { r[l] = a[l] < b[l] ? b[l] : a[l]; } break;
+                case Op::Sin: for (size_t l = 0; l < lanes; ++l) { r[l] = std::sin(a[l]); } break;
+                case Op::Cos: for (size_t l = 0; l < lanes; ++l) { r[l] = std::cos(a[l]); } break;
+                case Op::Exp: for (size_t l = 0; l < lanes; ++l) { r[l] = std::exp(a[l]); } break;
+                case Op::Sqrt: for (size_t l = 0; l < lanes; ++l) { r[l] = std::sqrt(a[l]); } break;
+                case Op::Sample: sample_data_batch(program.samplers[static_cast<size_t>(in.value)], a, b, r, lanes); break;
+                default:
+                    for (size_t l = 0; l < lanes; ++l) { r[l] = apply(in.op, a[l], b[l]); }
+                }
+            }
+            std::copy_n(&registers[program.result * LANES], lanes, out + first);
+        }
+    }
+
+    void evaluate_gradient_batch(const Program &program, const double *xs, const double *zs, const double *parameters,
+                                 double *values, double *dxs, double *dzs, size_t count) {
+        constexpr size_t LANES = 64;
+        // value, d/dx and d/dz planes of every register
+        thread_local std::vector<double> registers;
+        const auto plane = program.code.size() * LANES;
+        registers.resize(plane * 3);
+        auto *vs = registers.data(), *gx = vs + plane, *gz = gx + plane;
+
+        for (size_t first = 0; first < count; first += LANES) {
+            const auto lanes = std::min(LANES, count - first);
+            for (size_t i = 0; i < program.code.size(); ++i) {
+                const auto &in = program.code[i];
+                const auto r = i * LANES, a = in.a * LANES, b = in.b * LANES;
+                switch (in.op) {
+                case Op::Constant:
+                case Op::Parameter:
+                    std::fill_n(vs + r, lanes, in.op == Op::Constant ? in.value : parameters[in.a]);
+                    std::fill_n(gx + r, lanes, 0.0);
+                    std::fill_n(gz + r, lanes, 0.0);
+                    break;
+                case Op::X:
+                    std::copy_n(xs + first, lanes, vs + r);
+                    std::fill_n(gx + r, lanes, 1.0);
+                    std::fill_n(gz + r, lanes, 0.0);
+                    break;
+                case Op::Z:
+                    std::copy_n(zs + first, lanes, vs + r);
+                    std::fill_n(gx + r, lanes, 0.0);
+                    std::fill_n(gz + r, lanes, 1.0);
+                    break;
+                case Op::Add:
+                    for (size_t l = 0; l < lanes; ++l) { vs[r + l] = vs[a + l] + vs[b + l]; gx[r + l] = gx[a + l] + gx[b + l]; gz[r + l] = gz[a + l] + gz[b + l]; }
+                    break;
+                case Op::Sub:
+                    for (size_t l = 0; l < lanes; ++l) { vs[r + l] = vs[a + l] - vs[b + l]; gx[r + l] = gx[a + l] - gx[b + l]; gz[r + l] = gz[a + l] - gz[b + l]; }
+                    break;
+                case Op::Mul:
+                    for (size_t l = 0; l < lanes; ++l) {
+                        const auto va = vs[a + l], vb = vs[b + l];
+                        vs[r + l] = va * vb;
+                        gx[r + l] = gx[a + l] * vb + va * gx[b + l];
+                        gz[r + l] = gz[a + l] * vb + va * gz[b + l];
+                    }
+                    break;
+                case Op::Neg:
+                    for (size_t l = 0; l < lanes; ++l) { vs[r + l] = -vs[a + l]; gx[r + l] = -gx[a + l]; gz[r + l] = -gz[a + l]; }
+                    break;
+                case Op::Sample:
+                    for (size_t l = 0; l < lanes; ++l) {
+                        const auto s = sample_data(program.samplers[static_cast<size_t>(in.value)], vs[a + l], vs[b + l]);
+                        vs[r + l] = s.f;
+                        gx[r + l] = s.fx * gx[a + l] + s.fz * gx[b + l];
+                        gz[r + l] = s.fx * gz[a + l] + s.fz * gz[b + l];
+                    }
+                    break;
+                default:
+                    for (size_t l = 0; l < lanes; ++l) {
+                        double f, fa, fb = 0.0;
+                        if (is_binary(in.op)) {
+                            const auto d = differentiate(in.op, vs[a + l], vs[b + l]);
+                            f = d.f; fa = d.fa; fb = d.fb;
+                        } else {
+                            const auto d = differentiate(in.op, vs[a + l]);
+                            f = d.f; fa = d.f1;
+                        }
+                        const auto gxb = fb != 0.0 ? gx[b + l] : 0.0, gzb = fb != 0.0 ? gz[b + l] : 0.0;
+                        vs[r + l] = f;
+                        gx[r + l] = fa * gx[a + l] + fb * gxb;
+                        gz[r + l] = fa * gz[a + l] + fb * gzb;
+                    }
+                }
+            }
+            const auto result = program.result * LANES;
+            std::copy_n(vs + result, lanes, values + first);
+            std::copy_n(gx + result, lanes, dxs + first);
+            std::copy_n(gz + result, lanes, dzs + first);
+        }
+    }
+
+} // namespace g3d
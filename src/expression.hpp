@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <data_source.hpp>
+#include <project.hpp>
+
+namespace g3d {
+/* Definitions */
+    // Operations of the CPU evaluator. clamp, mix and smoothstep are lowered onto these while compiling.
+    enum class Op : uint8_t {
+        Constant, X, Z, Parameter,
+        Add, Sub, Mul, Div, Neg,
+        Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh, Asinh, Acosh, Atanh,
+        Exp, Log, Exp2, Log2, Sqrt, InverseSqrt, Abs, Sign, Floor, Ceil, Fract, Radians, Degrees,
+        Pow, Mod, Min, Max, Atan2, Step,
+        Sample, // a data source at (a, b), `value` indexes Program::samplers
+    };
+    struct Instruction {
+        Op op{Op::Constant};
+        uint32_t a{0}, b{0}; // operand registers, or the parameter index
+        double value{0.0};   // Op::Constant and Op::Sample only
+    };
+
+    // A function of (x, z) compiled from the user's GLSL-style equations, with every call inlined.
+    // Instruction i writes register i, so the code is in SSA form, constant folded and deduplicated.
+    struct Program {
+        static constexpr uint32_t PARAMETER_TIME = 0; // followed by one parameter per slider
+
+        std::vector<Instruction> code;
+        uint32_t result{0};
+        uint32_t parameter_count{1};
+        std::vector<DataSampler> samplers; // shares the grids, so programs outlive edits to the data sources
+    };
+
+    // Compiles `function_name` against the project's functions, constants, sliders and data sources.
+    // Throws std::runtime_error for syntax errors and for GLSL the CPU evaluator does not support.
+    Program compile_program(std::string_view function_name,
+                            const std::vector<Function> &functions,
+                            const std::vector<Constant> &constants,
+                            const std::vector<Slider> &sliders,
+                            const std::vector<DataSource> &data_sources = {});
+    // TIME followed by the slider values, in the order compile_program() expects them
+    std::vector<double> make_parameters(const std::vector<Slider> &sliders, double time);
+
+    // Forward-mode derivatives: N first order directions
+    template <int N>
+    struct Dual {
+        double v{0.0};
+        double d[N]{};
+    };
+    // Value, gradient and Hessian with respect to (x, z)
+    struct Jet {
+        double v{0.0};
+        double dx{0.0}, dz{0.0};
+        double dxx{0.0}, dxz{0.0}, dzz{0.0};
+    };
+
+    // Scalar evaluation, instantiated for double, Dual<2>, Dual<8> and Jet. Parameters may carry derivatives too.
+    template <typename T>
+    T evaluate(const Program &program, const T &x, const T &z, const T *parameters);
+
+    double evaluate(const Program &program, double x, double z, const double *parameters);
+    Dual<2> evaluate_gradient(const Program &program, double x, double z, const double *parameters);
+    Jet evaluate_jet(const Program &program, double x, double z, const double *parameters);
+
+    // Evaluates many points at once: every instruction runs over a batch of lanes,
+    // which amortises dispatch and lets the compiler vectorise the arithmetic.
+    void evaluate_batch(const Program &program, const double *xs, const double *zs, const double *parameters, double *out, size_t count);
+    // Batched forward-mode gradient: values and both partial derivatives for every point
+    void evaluate_gradient_batch(const Program &program, const double *xs, const double *zs, const double *parameters,
+                                 double *values, double *dxs, double *dzs, size_t count);
+} // namespace g3d
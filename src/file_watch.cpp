@@ -0,0 +1,111 @@
+#include "file_watch.hpp"
+
+#include <chrono>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace g3d {
+
+    // How often the thread checks whether it should stop, and how long a file must hold still
+    static constexpr int STOP_CHECK_MS = 200;
+    static constexpr auto SETTLE_TIME  = std::chrono::milliseconds{50};
+
+    // Size and write time, or false when the file does not exist (mid-rename, for example)
+    static bool file_stamp(const std::string &path, uint64_t &size, int64_t &write_time) {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if (error) { return false; }
+        write_time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        return !error;
+    }
+
+    FileWatcher::~FileWatcher() { stop(); }
+
+    void FileWatcher::watch(const std::string &path, std::function<void()> wake) {
+        stop();
+        _path = path;
+        _wake = std::move(wake);
+        _is_changed = false;
+        if (file_stamp(_path, _size, _write_time) == false) { _size = 0; _write_time = 0; }
+        _thread = std::thread([this] { run(); });
+    }
+
+    void FileWatcher::stop() {
+        if (_thread.joinable() == false) { return; }
+        _is_stopping = true;
+        _thread.join();
+        _is_stopping = false;
+    }
+
+    void FileWatcher::report_when_settled() {
+        uint64_t size = 0;
+        int64_t write_time = 0;
+        auto exists = file_stamp(_path, size, write_time);
+        for (;;) {
+            std::this_thread::sleep_for(SETTLE_TIME);
+            if (_is_stopping) { return; }
+            uint64_t next_size = 0;
+            int64_t next_write_time = 0;
+            const auto next_exists = file_stamp(_path, next_size, next_write_time);
+            if (next_exists == exists && next_size == size && next_write_time == write_time) { break; }
+            exists = next_exists; size = next_size; write_time = next_write_time;
+        }
+        if (exists == false || (size == _size && write_time == _write_time)) { return; }
+        _size = size;
+        _write_time = write_time;
+        _is_changed = true;
+        if (_wake) { _wake(); }
+    }
+
+#ifdef _WIN32
+    void FileWatcher::run() {
+        auto folder = std::filesystem::path(_path).parent_path();
+        if (folder.empty()) { folder = "."; }
+        const auto handle = FindFirstChangeNotificationA(folder.string().c_str(), FALSE,
+                                                         FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (handle == INVALID_HANDLE_VALUE) { return; }
+        while (_is_stopping == false) {
+            if (WaitForSingleObject(handle, STOP_CHECK_MS) != WAIT_OBJECT_0) { continue; }
+            // the notification covers the whole folder, the stamp tells whether it was this file
+            report_when_settled();
+            if (FindNextChangeNotification(handle) == FALSE) { break; }
+        }
+        FindCloseChangeNotification(handle);
+    }
+#else
+    void FileWatcher::run() {
+        const auto path = std::filesystem::path(_path);
+        auto folder = path.parent_path();
+        if (folder.empty()) { folder = "."; }
+        const auto name = path.filename().string();
+        const auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) { return; }
+        // scripts either rewrite the file or rename a finished one over it
+        if (inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) { close(fd); return; }
+
+        alignas(inotify_event) char buffer[4096];
+        while (_is_stopping == false) {
+            pollfd request{fd, POLLIN, 0};
+            if (::poll(&request, 1, STOP_CHECK_MS) <= 0) { continue; }
+            bool is_watched_file = false;
+            for (ssize_t length; (length = read(fd, buffer, sizeof(buffer))) > 0;) {
+                for (const char *at = buffer; at < buffer + length;) {
+                    const auto *event = reinterpret_cast<const inotify_event *>(at);
+                    if (event->len > 0 && name == event->name) { is_watched_file = true; }
+                    at += sizeof(inotify_event) + event->len;
+                }
+            }
+            if (is_watched_file) { report_when_settled(); }
+        }
+        close(fd);
+    }
+#endif
+
+} // namespace g3d
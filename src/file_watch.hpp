@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace g3d {
+/* Definitions */
+    // Reports changes other programs make to one file. A background thread waits on its folder (inotify on Linux,
+    // change notifications on Windows), so nothing is polled while the file stays untouched. A change only counts
+    // once the size and write time of the file hold still, so a generator is not caught halfway through writing,
+    // and writes that leave both as they were are ignored.
+    struct FileWatcher {
+        ~FileWatcher();
+
+        // `wake` runs on the watching thread after every change, e.g. to wake a loop that waits for events
+        void watch(const std::string &path, std::function<void()> wake = {});
+        void stop();
+        // True once for any number of changes since the last call
+        bool poll() { return _is_changed.exchange(false); }
+        bool is_watching() const { return _thread.joinable(); }
+
+      private:
+        void run();
+        void report_when_settled();
+
+        std::thread _thread;
+        std::atomic<bool> _is_stopping{false}, _is_changed{false};
+        std::string _path;
+        std::function<void()> _wake;
+        uint64_t _size{0};
+        int64_t _write_time{0};
+    };
+} // namespace g3d
@@ -0,0 +1,144 @@
+#include "fit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    using FitDual = Dual<FitSettings::MAX_PARAMETERS>;
+    static constexpr size_t POINTS_PER_TASK = 1024;
+
+    // Half the sum of squared residuals; NaN and Inf residuals make the whole cost infinite
+    static double cost(const Program &program, const std::vector<double> &parameters, const std::vector<DataPoint> &points) {
+        const auto tasks = (points.size() + POINTS_PER_TASK - 1) / POINTS_PER_TASK;
+        std::vector<double> partial(tasks);
+        global_thread_pool().parallel_for(tasks, [&](size_t task) {
+            const auto first = task * POINTS_PER_TASK;
+            const auto count = std::min(POINTS_PER_TASK, points.size() - first);
+            double xs[POINTS_PER_TASK], zs[POINTS_PER_TASK], fs[POINTS_PER_TASK];
+            for (size_t i = 0; i < count; ++i) { xs[i] = points[first + i].x; zs[i] = points[first + i].z; }
+            evaluate_batch(program, xs, zs, parameters.data(), fs, count);
+
+            double sum = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                const auto r = fs[i] - points[first + i].y;
+                sum += std::isfinite(r) ? r * r : INFINITY;
+            }
+            partial[task] = sum;
+        });
+        double sum = 0.0;
+        for (const auto p : partial) { sum += p; }
+        return 0.5 * sum;
+    }
+
+    // Solves the k x k system a * x = b in place with Cholesky; false when a is not positive definite
+    static bool solve_normal_equations(std::vector<double> a, std::vector<double> &b, size_t k) {
+        for (size_t j = 0; j < k; ++j) {
+            auto d = a[j * k + j];
+            for (size_t m = 0; m < j; ++m) { d -= a[j * k + m] * a[j * k + m]; }
+            if (d <= 0.0 || std::isfinite(d) == false) { return false; }
+            a[j * k + j] = std::sqrt(d);
+            for (size_t i = j + 1; i < k; ++i) {
+                auto s = a[i * k + j];
+                for (size_t m = 0; m < j; ++m) { s -= a[i * k + m] * a[j * k + m]; }
+                a[i * k + j] = s / a[j * k + j];
+            }
+        }
+        for (size_t i = 0; i < k; ++i) {
+            for (size_t m = 0; m < i; ++m) { b[i] -= a[i * k + m] * b[m]; }
+            b[i] /= a[i * k + i];
+        }
+        for (size_t i = k; i-- > 0;) {
+            for (size_t m = i + 1; m < k; ++m) { b[i] -= a[m * k + i] * b[m]; }
+            b[i] /= a[i * k + i];
+        }
+        return true;
+    }
+
+    FitResult fit_parameters(const Program &program, std::vector<double> parameters, const std::vector<uint32_t> &free_parameters,
+                             const std::vector<DataPoint> &points, const FitSettings &settings) {
+        const auto k = free_parameters.size();
+        if (k == 0 || k > FitSettings::MAX_PARAMETERS) { throw std::runtime_error{"Choose between 1 and " + std::to_string(FitSettings::MAX_PARAMETERS) + " sliders to fit"}; }
+        if (points.size() < k) { throw std::runtime_error{"Not enough data points for " + std::to_string(k) + " free parameters"}; }
+
+        FitResult result;
+        auto current_cost = cost(program, parameters, points);
+        if (std::isfinite(current_cost) == false) { throw std::runtime_error{"f is not finite at every data point with the current slider values"}; }
+        result.initial_rms = std::sqrt(2.0 * current_cost / points.size());
+
+        const auto tasks = (points.size() + POINTS_PER_TASK - 1) / POINTS_PER_TASK;
+        std::vector<double> jtj(k * k), jtr(k);
+        std::vector<std::vector<double>> partial_jtj(tasks), partial_jtr(tasks);
+        double lambda = 1e-3;
+        for (result.iterations = 0; result.iterations < settings.max_iterations; ++result.iterations) {
+            // normal equations, summed per task and then reduced in a fixed order so runs are reproducible
+            global_thread_pool().parallel_for(tasks, [&](size_t task) {
+                std::vector<FitDual> lifted(parameters.size());
+                for (size_t i = 0; i < parameters.size(); ++i) { lifted[i].v = parameters[i]; }
+                for (size_t j = 0; j < k; ++j) { lifted[free_parameters[j]].d[j] = 1.0; }
+
+                auto &a = partial_jtj[task], &b = partial_jtr[task];
+                a.assign(k * k, 0.0);
+                b.assign(k, 0.0);
+                const auto first = task * POINTS_PER_TASK;
+                const auto last  = std::min(first + POINTS_PER_TASK, points.size());
+                for (auto i = first; i < last; ++i) {
+                    const auto f = evaluate<FitDual>(program, FitDual{.v = points[i].x}, FitDual{.v = points[i].z}, lifted.data());
+                    const auto r = f.v - points[i].y;
+                    for (size_t row = 0; row < k; ++row) {
+                        b[row] += f.d[row] * r;
+                        for (size_t col = 0; col <= row; ++col) { a[row * k + col] += f.d[row] * f.d[col]; }
+                    }
+                }
+            });
+            std::fill(jtj.begin(), jtj.end(), 0.0);
+            std::fill(jtr.begin(), jtr.end(), 0.0);
+            for (size_t task = 0; task < tasks; ++task) {
+                for (size_t i = 0; i < k * k; ++i) { jtj[i] += partial_jtj[task][i]; }
+                for (size_t i = 0; i < k; ++i) { jtr[i] += partial_jtr[task][i]; }
+            }
+            for (size_t row = 0; row < k; ++row) {
+                for (size_t col = row + 1; col < k; ++col) { jtj[row * k + col] = jtj[col * k + row]; }
+            }
+
+            // raise the damping until a step lowers the cost
+            bool is_improved = false;
+            double relative_decrease = 0.0;
+            while (lambda < 1e16) {
+                auto damped = jtj;
+                for (size_t i = 0; i < k; ++i) { damped[i * k + i] += lambda * std::max(jtj[i * k + i], 1e-12); }
+                auto step = jtr;
+                if (solve_normal_equations(damped, step, k)) {
+                    auto trial = parameters;
+                    for (size_t i = 0; i < k; ++i) { trial[free_parameters[i]] -= step[i]; }
+                    const auto trial_cost = cost(program, trial, points);
+                    if (trial_cost < current_cost) {
+                        relative_decrease = (current_cost - trial_cost) / std::max(current_cost, 1e-300);
+                        parameters   = std::move(trial);
+                        current_cost = trial_cost;
+                        lambda       = std::max(lambda * 0.1, 1e-12);
+                        is_improved  = true;
+                        break;
+                    }
+                }
+                lambda *= 10.0;
+            }
+            if (current_cost == 0.0 || (is_improved && relative_decrease < settings.tolerance)) {
+                result.has_converged = true;
+                break;
+            }
+            if (is_improved == false) {
+                result.has_stalled = true;
+                break;
+            }
+        }
+
+        for (const auto p : free_parameters) { result.values.push_back(parameters[p]); }
+        result.rms = std::sqrt(2.0 * current_cost / points.size());
+        return result;
+    }
+
+} // namespace g3d
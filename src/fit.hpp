@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <data_source.hpp>
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    struct FitSettings {
+        static constexpr uint32_t MAX_PARAMETERS = 8;
+
+        uint32_t max_iterations{100};
+        double tolerance{1e-12}; // on the relative decrease of the cost
+    };
+    struct FitResult {
+        std::vector<double> values; // of the free parameters
+        double initial_rms{0.0}, rms{0.0};
+        uint32_t iterations{0};
+        bool has_converged{false}; // the cost decreased by less than the tolerance, or reached zero
+        bool has_stalled{false};   // no damping gave a step that lowers the cost, before converging
+    };
+
+    // Levenberg-Marquardt on the residuals f(x, z) - y over the free parameters (indices into the parameter
+    // vector). The Jacobian comes from forward-mode dual numbers seeded on the free parameters and is
+    // accumulated into J^T J in parallel; trial steps only need residuals, which run through the batch evaluator.
+    FitResult fit_parameters(const Program &program, std::vector<double> parameters, const std::vector<uint32_t> &free_parameters,
+                             const std::vector<DataPoint> &points, const FitSettings &settings);
+} // namespace g3d
@@ -0,0 +1,167 @@
+#include "font_atlas_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <imgui/imgui.h>
+
+namespace g3d {
+
+    static constexpr char CACHE_MAGIC[4] = {'G', 'F', 'A', '1'};
+
+    struct CacheHeader {
+        char magic[4];
+        int32_t tex_width, tex_height;
+        uint32_t font_count;
+        uint64_t key;
+        ImVec2 uv_scale, uv_white_pixel;
+        ImVec4 uv_lines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+    };
+    struct FontRecord {
+        float font_size, ascent, descent;
+        uint32_t glyph_count;
+        ImWchar fallback_char, ellipsis_char, dot_char;
+    };
+
+    static std::vector<char> read_file(const std::string &path) {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (file.is_open() == false) { return {}; }
+        std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()))) { return {}; }
+        return bytes;
+    }
+
+    // FNV-1a over the font and everything that changes the output, including the glyph layout of this ImGui build
+    static uint64_t atlas_key(const std::vector<char> &font, const std::vector<float> &sizes) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        const auto mix = [&hash](const void *data, size_t size) {
+            for (size_t i = 0; i < size; ++i) { hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 0x100000001b3ull; }
+        };
+        const uint32_t layout[] = {IMGUI_VERSION_NUM, sizeof(ImFontGlyph), sizeof(ImWchar), sizeof(CacheHeader), sizeof(FontRecord)};
+        mix(layout, sizeof(layout));
+        mix(sizes.data(), sizes.size() * sizeof(float));
+        mix(font.data(), font.size());
+        return hash;
+    }
+
+    static std::filesystem::path cache_path(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return std::filesystem::temp_directory_path() / "3dcalculator" / "fonts" / name;
+    }
+
+    static bool load_cached_atlas(ImFontAtlas &atlas, uint64_t key, size_t font_count) {
+        const auto bytes = read_file(cache_path(key).string());
+        CacheHeader header;
+        if (bytes.size() < sizeof(header)) { return false; }
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.key != key || header.font_count != font_count ||
+            header.tex_width <= 0 || header.tex_height <= 0) {
+            return false;
+        }
+
+        // validate everything before touching the atlas, a truncated file is a plain miss
+        size_t offset = sizeof(header);
+        std::vector<FontRecord> records(font_count);
+        std::vector<size_t> glyph_offsets(font_count);
+        for (size_t i = 0; i < font_count; ++i) {
+            if (bytes.size() - offset < sizeof(FontRecord)) { return false; }
+            std::memcpy(&records[i], bytes.data() + offset, sizeof(FontRecord));
+            glyph_offsets[i] = offset + sizeof(FontRecord);
+            if (records[i].glyph_count == 0 || (bytes.size() - glyph_offsets[i]) / sizeof(ImFontGlyph) < records[i].glyph_count) { return false; }
+            offset = glyph_offsets[i] + records[i].glyph_count * sizeof(ImFontGlyph);
+        }
+        const auto pixel_count = static_cast<size_t>(header.tex_width) * header.tex_height;
+        if (bytes.size() - offset != pixel_count) { return false; }
+
+        for (size_t i = 0; i < font_count; ++i) {
+            auto *font = IM_NEW(ImFont);
+            font->ContainerAtlas = &atlas;
+            font->FontSize       = records[i].font_size;
+            font->Ascent         = records[i].ascent;
+            font->Descent        = records[i].descent;
+            font->FallbackChar   = records[i].fallback_char;
+            font->EllipsisChar   = records[i].ellipsis_char;
+            font->DotChar        = records[i].dot_char;
+            font->Glyphs.resize(static_cast<int>(records[i].glyph_count));
+            std::memcpy(font->Glyphs.Data, bytes.data() + glyph_offsets[i], records[i].glyph_count * sizeof(ImFontGlyph));
+            font->BuildLookupTable();
+            atlas.Fonts.push_back(font);
+        }
+        atlas.TexWidth        = header.tex_width;
+        atlas.TexHeight       = header.tex_height;
+        atlas.TexUvScale      = header.uv_scale;
+        atlas.TexUvWhitePixel = header.uv_white_pixel;
+        std::memcpy(atlas.TexUvLines, header.uv_lines, sizeof(header.uv_lines));
+        atlas.TexPixelsAlpha8 = static_cast<unsigned char *>(IM_ALLOC(pixel_count));
+        std::memcpy(atlas.TexPixelsAlpha8, bytes.data() + offset, pixel_count);
+        atlas.TexReady = true;
+        return true;
+    }
+
+    static void store_cached_atlas(const ImFontAtlas &atlas, uint64_t key) {
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.tex_width      = atlas.TexWidth;
+        header.tex_height     = atlas.TexHeight;
+        header.font_count     = static_cast<uint32_t>(atlas.Fonts.Size);
+        header.key            = key;
+        header.uv_scale       = atlas.TexUvScale;
+        header.uv_white_pixel = atlas.TexUvWhitePixel;
+        std::memcpy(header.uv_lines, atlas.TexUvLines, sizeof(header.uv_lines));
+
+        std::vector<char> bytes(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header) + sizeof(header));
+        for (const auto *font : atlas.Fonts) {
+            const FontRecord record{font->FontSize, font->Ascent, font->Descent, static_cast<uint32_t>(font->Glyphs.Size),
+                                    font->FallbackChar, font->EllipsisChar, font->DotChar};
+            bytes.insert(bytes.end(), reinterpret_cast<const char *>(&record), reinterpret_cast<const char *>(&record) + sizeof(record));
+            bytes.insert(bytes.end(), reinterpret_cast<const char *>(font->Glyphs.Data), reinterpret_cast<const char *>(font->Glyphs.Data + font->Glyphs.Size));
+        }
+        bytes.insert(bytes.end(), atlas.TexPixelsAlpha8, atlas.TexPixelsAlpha8 + static_cast<size_t>(atlas.TexWidth) * atlas.TexHeight);
+
+        // the cache is an optimisation, failing to write it is not an error
+        std::error_code error;
+        const auto path = cache_path(key);
+        std::filesystem::create_directories(path.parent_path(), error);
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open()) { file.write(bytes.data(), static_cast<std::streamsize>(bytes.size())); }
+    }
+
+    ImFontAtlas *load_font_atlas(const std::string &path, const std::vector<float> &sizes) {
+        auto *atlas = IM_NEW(ImFontAtlas);
+        auto font = read_file(path);
+        if (font.empty()) {
+            for (const auto size : sizes) {
+                ImFontConfig config;
+                config.SizePixels = size;
+                atlas->AddFontDefault(&config);
+            }
+            atlas->Build();
+        } else {
+            const auto key = atlas_key(font, sizes);
+            if (load_cached_atlas(*atlas, key, sizes.size()) == false) {
+                atlas->Clear();
+                for (const auto size : sizes) {
+                    // every font gets its own copy, the atlas frees them
+                    auto *data = IM_ALLOC(font.size());
+                    std::memcpy(data, font.data(), font.size());
+                    ImFontConfig config;
+                    std::snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx", std::filesystem::path(path).filename().string().c_str(), size);
+                    atlas->AddFontFromMemoryTTF(data, static_cast<int>(font.size()), size, &config);
+                }
+                atlas->Build();
+                store_cached_atlas(*atlas, key);
+            }
+        }
+        // the backend converts on its first frame otherwise
+        unsigned char *pixels;
+        int width, height;
+        atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+        return atlas;
+    }
+
+} // namespace g3d
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct ImFontAtlas;
+
+namespace g3d {
+/* Definitions */
+    // An atlas with the font at `path` at every size in `sizes`, in that order, with the RGBA texture data
+    // already converted. The built atlas (pixels and glyph tables) is cached on disk keyed by a hash of the
+    // font file, the sizes and the ImGui version, so later starts load it instead of rasterising.
+    // Needs no ImGui context, so it can run on a worker thread; pass the result to ImGui::CreateContext().
+    // A missing font file falls back to ImGui's default font at the same sizes.
+    ImFontAtlas *load_font_atlas(const std::string &path, const std::vector<float> &sizes);
+} // namespace g3d
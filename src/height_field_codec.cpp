@@ -0,0 +1,209 @@
+#include "height_field_codec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    struct CodecHeader {
+        uint32_t width, height, layers, rows_per_block;
+        uint64_t block_count;
+    };
+
+    // Little-endian bit stream in 64 bit words
+    struct BitWriter {
+        std::vector<uint64_t> words;
+        uint64_t current{0};
+        uint32_t used{0};
+
+        void write(uint64_t bits, uint32_t count) { // count <= 38, bits above count are zero
+            current |= bits << used;
+            used += count;
+            if (used >= 64) {
+                words.push_back(current);
+                used -= 64;
+                current = used > 0 ? bits >> (count - used) : 0;
+            }
+        }
+        void flush() {
+            if (used > 0) { words.push_back(current); current = 0; used = 0; }
+        }
+    };
+    struct BitReader {
+        const uint8_t *data;
+        size_t word_count, next{0};
+        uint64_t current{0};
+        uint32_t available{0};
+        bool is_overrun{false}; // reads past the end return zeros, workers must not throw
+
+        uint64_t load_word() {
+            if (next >= word_count) { is_overrun = true; return 0; }
+            uint64_t w;
+            std::memcpy(&w, data + next++ * sizeof(uint64_t), sizeof(w));
+            return w;
+        }
+        uint32_t read(uint32_t count) { // count <= 32
+            if (count == 0) { return 0; }
+            uint64_t bits;
+            if (available >= count) {
+                bits = current;
+                current = count == 64 ? 0 : current >> count;
+                available -= count;
+            } else {
+                const auto w = load_word();
+                bits = current | (w << available);
+                const auto taken = count - available;
+                current = w >> taken;
+                available = 64 - taken;
+            }
+            return static_cast<uint32_t>(bits & ((uint64_t{1} << count) - 1));
+        }
+    };
+
+    // Which NaN an operation on two NaNs returns depends on the operand order the compiler picked (the encoder's
+    // vectorised loop and the decoder's scalar one differ) and on the CPU, so every NaN prediction becomes one pattern
+    static float canonical(float prediction) { return prediction != prediction ? std::bit_cast<float>(0x7fc00000u) : prediction; }
+
+    static float predict(const float *row, const float *up, uint32_t x) {
+        if (up == nullptr) { return x > 0 ? canonical(row[x - 1]) : 0.0f; }
+        if (x == 0) { return canonical(up[0]); }
+        return canonical(row[x - 1] + up[x] - up[x - 1]);
+    }
+    // Same stencil on the change against the reference, ref and ref_up are the reference's rows
+    static float predict(const float *row, const float *up, const float *ref, const float *ref_up, uint32_t x) {
+        auto p = ref[x];
+        if (x > 0) { p += row[x - 1] - ref[x - 1]; }
+        if (up != nullptr) {
+            p += up[x] - ref_up[x];
+            if (x > 0) { p -= up[x - 1] - ref_up[x - 1]; }
+        }
+        return canonical(p);
+    }
+
+    std::vector<uint8_t> HeightFieldCodec::encode(const float *values, uint32_t width, uint32_t height, uint32_t layers, const float *reference) {
+        const auto blocks_per_layer = (height + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+        const auto block_count = static_cast<size_t>(blocks_per_layer) * layers;
+        std::vector<std::vector<uint64_t>> streams(block_count);
+
+        global_thread_pool().parallel_for(block_count, [&](size_t block) {
+            const auto layer = block / blocks_per_layer;
+            const auto first_row = static_cast<uint32_t>(block % blocks_per_layer) * ROWS_PER_BLOCK;
+            const auto last_row  = std::min(first_row + ROWS_PER_BLOCK, height);
+            const auto *grid = values + layer * width * static_cast<size_t>(height);
+            const auto *ref_grid = reference != nullptr ? reference + layer * width * static_cast<size_t>(height) : nullptr;
+
+            BitWriter out;
+            std::vector<uint32_t> residuals(width);
+            for (auto y = first_row; y < last_row; ++y) {
+                const auto *row = grid + static_cast<size_t>(y) * width;
+                const auto *up  = y > first_row ? row - width : nullptr;
+                // every value is known here, so the whole row is predicted in one loop the compiler can vectorise
+                if (ref_grid != nullptr) {
+                    const auto *ref = ref_grid + static_cast<size_t>(y) * width;
+                    const auto *ref_up = up != nullptr ? ref - width : nullptr;
+                    for (uint32_t x = 0; x < width; ++x) { residuals[x] = std::bit_cast<uint32_t>(row[x]) ^ std::bit_cast<uint32_t>(predict(row, up, ref, ref_up, x)); }
+                } else if (up != nullptr && width > 0) {
+                    residuals[0] = std::bit_cast<uint32_t>(row[0]) ^ std::bit_cast<uint32_t>(canonical(up[0]));
+                    for (uint32_t x = 1; x < width; ++x) {
+                        residuals[x] = std::bit_cast<uint32_t>(row[x]) ^ std::bit_cast<uint32_t>(canonical(row[x - 1] + up[x] - up[x - 1]));
+                    }
+                } else {
+                    for (uint32_t x = 0; x < width; ++x) { residuals[x] = std::bit_cast<uint32_t>(row[x]) ^ std::bit_cast<uint32_t>(predict(row, nullptr, x)); }
+                }
+                for (uint32_t x = 0; x < width; ++x) {
+                    const auto bits = static_cast<uint32_t>(32 - std::countl_zero(residuals[x]));
+                    out.write(bits, 6);
+                    out.write(residuals[x], bits);
+                }
+            }
+            out.flush();
+            streams[block] = std::move(out.words);
+        });
+
+        const CodecHeader header{width, height, layers, ROWS_PER_BLOCK, block_count};
+        size_t size = sizeof(header) + (block_count + 1) * sizeof(uint64_t);
+        for (const auto &s : streams) { size += s.size() * sizeof(uint64_t); }
+
+        std::vector<uint8_t> out(size);
+        std::memcpy(out.data(), &header, sizeof(header));
+        // word offsets of the blocks, so the decoder can start them all at once
+        uint64_t offset = 0;
+        auto *offsets = out.data() + sizeof(header);
+        auto *payload = offsets + (block_count + 1) * sizeof(uint64_t);
+        for (size_t i = 0; i <= block_count; ++i) {
+            std::memcpy(offsets + i * sizeof(uint64_t), &offset, sizeof(offset));
+            if (i == block_count) { break; }
+            std::memcpy(payload + offset * sizeof(uint64_t), streams[i].data(), streams[i].size() * sizeof(uint64_t));
+            offset += streams[i].size();
+        }
+        return out;
+    }
+
+    std::vector<float> HeightFieldCodec::decode(const uint8_t *data, size_t size, const float *reference, size_t reference_count) {
+        const auto fail = [](const char *what) { throw std::runtime_error{std::string{"Height field codec: "} + what}; };
+        CodecHeader header;
+        if (size < sizeof(header)) { fail("truncated header"); }
+        std::memcpy(&header, data, sizeof(header));
+        const auto rows_per_block = header.rows_per_block;
+        if (rows_per_block == 0) { fail("bad block size"); }
+        const auto blocks_per_layer = (static_cast<uint64_t>(header.height) + rows_per_block - 1) / rows_per_block;
+        if (header.block_count != blocks_per_layer * header.layers) { fail("block count does not match the grid"); }
+        if (header.block_count + 1 > (size - sizeof(header)) / sizeof(uint64_t)) { fail("truncated block table"); }
+
+        const auto *offsets = data + sizeof(header);
+        const auto *payload = offsets + (header.block_count + 1) * sizeof(uint64_t);
+        const auto payload_words = (size - static_cast<size_t>(payload - data)) / sizeof(uint64_t);
+        const auto offset_at = [&](uint64_t i) { uint64_t o; std::memcpy(&o, offsets + i * sizeof(uint64_t), sizeof(o)); return o; };
+        for (uint64_t i = 0; i < header.block_count; ++i) {
+            if (offset_at(i) > offset_at(i + 1) || offset_at(i + 1) > payload_words) { fail("block out of bounds"); }
+        }
+
+        const auto width = header.width, height = header.height;
+        // every value costs at least its 6 bit length, which bounds what a header may ask to allocate
+        if (static_cast<uint64_t>(width) * height * header.layers * 6 > payload_words * 64) { fail("grid larger than its data"); }
+        std::vector<float> values(static_cast<size_t>(width) * height * header.layers);
+        if (reference != nullptr && reference_count != values.size()) { fail("reference does not match the grid"); }
+        std::atomic<bool> is_corrupt{false};
+        global_thread_pool().parallel_for(header.block_count, [&](size_t block) {
+            const auto layer = block / blocks_per_layer;
+            const auto first_row = static_cast<uint32_t>(block % blocks_per_layer) * rows_per_block;
+            const auto last_row  = std::min(first_row + rows_per_block, height);
+            auto *grid = values.data() + layer * width * static_cast<size_t>(height);
+            const auto *ref_grid = reference != nullptr ? reference + layer * width * static_cast<size_t>(height) : nullptr;
+
+            BitReader in{payload + offset_at(block) * sizeof(uint64_t), offset_at(block + 1) - offset_at(block)};
+            for (auto y = first_row; y < last_row; ++y) {
+                auto *row = grid + static_cast<size_t>(y) * width;
+                const auto *up = y > first_row ? row - width : nullptr;
+                for (uint32_t x = 0; x < width; ++x) {
+                    const auto bits = in.read(6);
+                    if (bits > 32 || in.is_overrun) { is_corrupt = true; return; }
+                    const auto residual = in.read(bits);
+                    const auto prediction = ref_grid != nullptr ? predict(row, up, ref_grid + static_cast<size_t>(y) * width, up != nullptr ? ref_grid + static_cast<size_t>(y - 1) * width : nullptr, x)
+                                                                : predict(row, up, x);
+                    row[x] = std::bit_cast<float>(residual ^ std::bit_cast<uint32_t>(prediction));
+                }
+            }
+            if (in.is_overrun) { is_corrupt = true; }
+        });
+        if (is_corrupt) { fail("corrupt block"); }
+        return values;
+    }
+
+    void export_height_field_hfz(const std::string &path, const float *heights, uint32_t detail, uint32_t surface_count, float bounds) {
+        const auto stream = HeightFieldCodec::encode(heights, detail + 1, detail + 1, surface_count);
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        const uint32_t header[] = {0x315a4648 /* "HFZ1" */, detail, surface_count};
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(&bounds), sizeof(bounds));
+        file.write(reinterpret_cast<const char *>(stream.data()), static_cast<std::streamsize>(stream.size()));
+    }
+
+} // namespace g3d
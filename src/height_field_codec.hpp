@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    // Lossless compression of row-major float grids. Every value is predicted from its left, up and up-left
+    // neighbours (left + up - up_left, in float arithmetic, so the decoder forms the exact same prediction);
+    // the bit pattern of the value XORed with the prediction has mostly zero high bits on smooth fields,
+    // and only its significant bits are packed, after a 6 bit length. NaN and Inf pass through unchanged.
+    // The grid is cut into blocks of rows that are predicted and packed independently, on the thread pool.
+    // With a reference grid (the previous frame of an animation) the prediction is the reference value moved
+    // by how the neighbours moved, which codes frame to frame changes; decode needs the same reference.
+    struct HeightFieldCodec {
+        static constexpr uint32_t ROWS_PER_BLOCK = 64;
+
+        // `layers` grids of width x height, back to back, like the surfaces in the height field SSBO
+        static std::vector<uint8_t> encode(const float *values, uint32_t width, uint32_t height, uint32_t layers, const float *reference = nullptr);
+        // Throws std::runtime_error when the data is truncated or corrupt, or the reference has another size
+        static std::vector<float> decode(const uint8_t *data, size_t size, const float *reference = nullptr, size_t reference_count = 0);
+    };
+
+    // A standalone compressed height field: an "HFZ1" header with the grid size, the surface count and the plane
+    // bounds, then one HeightFieldCodec stream. Throws std::runtime_error when the file cannot be written.
+    void export_height_field_hfz(const std::string &path, const float *heights, uint32_t detail, uint32_t surface_count, float bounds);
+} // namespace g3d
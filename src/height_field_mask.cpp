@@ -0,0 +1,94 @@
+#include "height_field_mask.hpp"
+
+#include <glad/glad.h>
+
+namespace g3d {
+
+    static const char *MASK_SOURCE = R"glsl(
+        #version 460 core
+        layout(local_size_x=16, local_size_y=16, local_size_z=1) in;
+        layout(std430, binding=0) readonly buffer height_field { float values[]; };
+        layout(std430, binding=5) writeonly buffer Mask { uint mask[]; };
+        layout(std430, binding=6) buffer Counts { uint counts[5]; };
+        uniform uint detail;
+        uniform float cell_size;
+        uniform float jump_slope;
+        shared uint local_counts[5];
+
+        const uint FINITE = 0u, NAN_VALUE = 1u, POSITIVE_INF = 2u, NEGATIVE_INF = 3u, JUMP = 4u;
+
+        bool is_jump(float h, uint neighbour) {
+            float n = values[neighbour];
+            return !isnan(n) && !isinf(n) && abs(h - n) > jump_slope * cell_size;
+        }
+        void main() {
+            uint lid = gl_LocalInvocationIndex;
+            if (lid < 5u) { local_counts[lid] = 0u; }
+            barrier();
+
+            uint row = detail + 1u;
+            uint gx = gl_GlobalInvocationID.x, gy = gl_GlobalInvocationID.y;
+            if (gx < row && gy < row) {
+                uint idx = gl_GlobalInvocationID.z * row * row + gy * row + gx;
+                float h = values[idx];
+                uint c = FINITE;
+                if (isnan(h))      { c = NAN_VALUE; }
+                else if (isinf(h)) { c = h > 0.0 ? POSITIVE_INF : NEGATIVE_INF; }
+                else if ((gx > 0u && is_jump(h, idx - 1u)) || (gx + 1u < row && is_jump(h, idx + 1u)) ||
+                         (gy > 0u && is_jump(h, idx - row)) || (gy + 1u < row && is_jump(h, idx + row))) { c = JUMP; }
+                mask[idx] = c;
+                atomicAdd(local_counts[c], 1u);
+            }
+            barrier();
+            if (lid < 5u && local_counts[lid] != 0u) { atomicAdd(counts[lid], local_counts[lid]); }
+        }
+    )glsl";
+
+    static const UniformName UNIFORM_DETAIL     = intern_uniform_name("detail");
+    static const UniformName UNIFORM_CELL_SIZE  = intern_uniform_name("cell_size");
+    static const UniformName UNIFORM_JUMP_SLOPE = intern_uniform_name("jump_slope");
+
+    void HeightFieldMask::create() {
+        _program = create_program({{GL_COMPUTE_SHADER, MASK_SOURCE}});
+        _uniforms.on_program_linked(_program);
+        glCreateBuffers(1, &_counts);
+        glNamedBufferStorage(_counts, sizeof(HeightFieldMaskCounts), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    void HeightFieldMask::dispatch(HandleBuffer heights, uint32_t detail, uint32_t surface_count, float bounds, float jump_slope) {
+        if (_fence != nullptr) { glDeleteSync(_fence); _fence = nullptr; }
+        const auto row = detail + 1;
+        const auto vertex_count = row * row * surface_count;
+        if (vertex_count == 0) { return; }
+        if (vertex_count > _capacity) {
+            glDeleteBuffers(1, &mask);
+            glCreateBuffers(1, &mask);
+            glNamedBufferStorage(mask, vertex_count * sizeof(uint32_t), nullptr, 0);
+            _capacity = vertex_count;
+        }
+
+        uniform1ui(_uniforms, UNIFORM_DETAIL, detail);
+        uniform1f(_uniforms, UNIFORM_CELL_SIZE, 2.0f * bounds / static_cast<float>(detail));
+        uniform1f(_uniforms, UNIFORM_JUMP_SLOPE, jump_slope);
+        const uint32_t zero = 0;
+        glClearNamedBufferData(_counts, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, heights);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, mask);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, _counts);
+        glUseProgram(_program);
+        glDispatchCompute((row + 15) / 16, (row + 15) / 16, surface_count);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool HeightFieldMask::poll(HeightFieldMaskCounts &counts) {
+        if (_fence == nullptr) { return false; }
+        const auto status = glClientWaitSync(_fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { return false; }
+        glDeleteSync(_fence);
+        _fence = nullptr;
+        glGetNamedBufferSubData(_counts, 0, sizeof(HeightFieldMaskCounts), &counts);
+        return true;
+    }
+
+} // namespace g3d
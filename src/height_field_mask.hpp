@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+#include <renderer.hpp>
+#include <uniforms.hpp>
+
+namespace g3d {
+/* Definitions */
+    enum class VertexClass : uint32_t { Finite, NaN, PositiveInf, NegativeInf, Jump, Count };
+
+    struct HeightFieldMaskCounts {
+        uint32_t counts[static_cast<uint32_t>(VertexClass::Count)]{};
+
+        uint32_t operator[](VertexClass c) const { return counts[static_cast<uint32_t>(c)]; }
+        bool operator==(const HeightFieldMaskCounts &) const = default;
+    };
+
+    // Classifies every vertex of every surface of the height field into a VertexClass, one uint per vertex,
+    // laid out like the height field itself. A finite vertex is a Jump when the slope to one of its finite
+    // neighbours exceeds jump_slope, which is how poles and discontinuities show up on the grid.
+    // The per-class counts are read back through a fence, like the statistics.
+    struct HeightFieldMask {
+        static constexpr uint32_t BINDING = 5;
+        static constexpr uint32_t COUNTS_BINDING = 6;
+
+        void create();
+        void dispatch(HandleBuffer heights, uint32_t detail, uint32_t surface_count, float bounds, float jump_slope);
+        bool poll(HeightFieldMaskCounts &counts);
+
+        HandleBuffer mask{0};
+
+      private:
+        HandleProgram _program{0};
+        UniformTable _uniforms;
+        HandleBuffer _counts{0};
+        uint32_t _capacity{0};
+        HandleFence _fence{nullptr};
+    };
+} // namespace g3d
@@ -0,0 +1,174 @@
+#include "height_field_stats.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include <glad/glad.h>
+
+namespace g3d {
+
+    // Must match the Moments struct of the shaders below
+    struct GpuMoments {
+        float min, max, mean, m2;
+        uint32_t count, _padding[3];
+    };
+    struct GpuResult {
+        GpuMoments moments;
+        uint32_t histogram[HeightFieldStats::HISTOGRAM_BINS];
+    };
+
+    static const char *REDUCTION_COMMON_SOURCE = R"glsl(
+        #version 460 core
+        layout(local_size_x=256) in;
+        struct Moments { float min_v; float max_v; float mean; float m2; uint n; uint pad0, pad1, pad2; };
+        layout(std430, binding=0) readonly buffer height_field { float values[]; };
+        layout(std430, binding=3) buffer Partials { Moments partials[]; };
+        layout(std430, binding=4) buffer Result { Moments result; uint histogram[256]; };
+        uniform uint offset;
+        uniform uint count;
+        shared Moments shared_moments[256];
+
+        Moments empty_moments() { return Moments(3.402823e38, -3.402823e38, 0.0, 0.0, 0u, 0u, 0u, 0u); }
+        Moments combine(Moments a, Moments b) {
+            if (a.n == 0u) { return b; }
+            if (b.n == 0u) { return a; }
+            float n = float(a.n + b.n);
+            float delta = b.mean - a.mean;
+            Moments r = a;
+            r.n = a.n + b.n;
+            r.mean = a.mean + delta * float(b.n) / n;
+            r.m2 = a.m2 + b.m2 + delta * delta * float(a.n) * float(b.n) / n;
+            r.min_v = min(a.min_v, b.min_v);
+            r.max_v = max(a.max_v, b.max_v);
+            return r;
+        }
+        void reduce_shared(uint lid) {
+            for (uint stride = gl_WorkGroupSize.x / 2u; stride > 0u; stride /= 2u) {
+                barrier();
+                if (lid < stride) { shared_moments[lid] = combine(shared_moments[lid], shared_moments[lid + stride]); }
+            }
+            barrier();
+        }
+    )glsl";
+
+    static const char *MOMENTS_SOURCE = R"glsl(
+        void main() {
+            uint lid = gl_LocalInvocationID.x;
+            Moments m = empty_moments();
+            for (uint i = gl_GlobalInvocationID.x; i < count; i += gl_NumWorkGroups.x * gl_WorkGroupSize.x) {
+                float v = values[offset + i];
+                if (isnan(v) || isinf(v)) { continue; }
+                m.n += 1u;
+                float delta = v - m.mean;
+                m.mean += delta / float(m.n);
+                m.m2 += delta * (v - m.mean);
+                m.min_v = min(m.min_v, v);
+                m.max_v = max(m.max_v, v);
+            }
+            shared_moments[lid] = m;
+            reduce_shared(lid);
+            if (lid == 0u) { partials[gl_WorkGroupID.x] = shared_moments[0]; }
+        }
+    )glsl";
+
+    static const char *MERGE_SOURCE = R"glsl(
+        void main() {
+            uint lid = gl_LocalInvocationID.x;
+            shared_moments[lid] = lid < count ? partials[lid] : empty_moments();
+            reduce_shared(lid);
+            if (lid == 0u) { result = shared_moments[0]; }
+        }
+    )glsl";
+
+    static const char *HISTOGRAM_SOURCE = R"glsl(
+        shared uint shared_histogram[256];
+        void main() {
+            uint lid = gl_LocalInvocationID.x;
+            shared_histogram[lid] = 0u;
+            barrier();
+
+            float range = result.max_v - result.min_v;
+            float bin_scale = range > 0.0 ? 256.0 / range : 0.0;
+            for (uint i = gl_GlobalInvocationID.x; i < count; i += gl_NumWorkGroups.x * gl_WorkGroupSize.x) {
+                float v = values[offset + i];
+                if (isnan(v) || isinf(v)) { continue; }
+                uint bin = min(uint((v - result.min_v) * bin_scale), 255u);
+                atomicAdd(shared_histogram[bin], 1u);
+            }
+            barrier();
+            if (shared_histogram[lid] != 0u) { atomicAdd(histogram[lid], shared_histogram[lid]); }
+        }
+    )glsl";
+
+    static const UniformName UNIFORM_OFFSET = intern_uniform_name("offset");
+    static const UniformName UNIFORM_COUNT  = intern_uniform_name("count");
+
+    void HeightFieldReducer::create() {
+        const auto with_common = [](const char *main_source) { return std::string{REDUCTION_COMMON_SOURCE} + main_source; };
+        const auto moments   = with_common(MOMENTS_SOURCE);
+        const auto merge     = with_common(MERGE_SOURCE);
+        const auto histogram = with_common(HISTOGRAM_SOURCE);
+        _program_moments   = create_program({{GL_COMPUTE_SHADER, moments.c_str()}});
+        _program_merge     = create_program({{GL_COMPUTE_SHADER, merge.c_str()}});
+        _program_histogram = create_program({{GL_COMPUTE_SHADER, histogram.c_str()}});
+        _uniforms_moments.on_program_linked(_program_moments);
+        _uniforms_merge.on_program_linked(_program_merge);
+        _uniforms_histogram.on_program_linked(_program_histogram);
+
+        glCreateBuffers(1, &_partials);
+        glCreateBuffers(1, &_result);
+        glNamedBufferStorage(_partials, MAX_WORKGROUPS * sizeof(GpuMoments), nullptr, 0);
+        glNamedBufferStorage(_result, sizeof(GpuResult), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    void HeightFieldReducer::dispatch(HandleBuffer heights, uint32_t offset, uint32_t count) {
+        if (_fence != nullptr) { glDeleteSync(_fence); _fence = nullptr; }
+        if (count == 0) { return; }
+
+        const auto workgroups = std::min(MAX_WORKGROUPS, (count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+        uniform1ui(_uniforms_moments, UNIFORM_OFFSET, offset);
+        uniform1ui(_uniforms_moments, UNIFORM_COUNT, count);
+        uniform1ui(_uniforms_histogram, UNIFORM_OFFSET, offset);
+        uniform1ui(_uniforms_histogram, UNIFORM_COUNT, count);
+
+        const uint32_t zero = 0;
+        glClearNamedBufferData(_result, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, heights);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _partials);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _result);
+
+        glUseProgram(_program_moments);
+        glDispatchCompute(workgroups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(_program_merge);
+        uniform1ui(_uniforms_merge, UNIFORM_COUNT, workgroups);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(_program_histogram);
+        glDispatchCompute(workgroups, 1, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool HeightFieldReducer::poll(HeightFieldStats &stats) {
+        if (_fence == nullptr) { return false; }
+        const auto status = glClientWaitSync(_fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { return false; }
+        glDeleteSync(_fence);
+        _fence = nullptr;
+
+        GpuResult result;
+        glGetNamedBufferSubData(_result, 0, sizeof(GpuResult), &result);
+        stats.finite_count = result.moments.count;
+        stats.min          = result.moments.count > 0 ? result.moments.min : 0.0f;
+        stats.max          = result.moments.count > 0 ? result.moments.max : 0.0f;
+        stats.mean         = result.moments.mean;
+        stats.variance     = result.moments.count > 0 ? result.moments.m2 / static_cast<float>(result.moments.count) : 0.0f;
+        std::copy(std::begin(result.histogram), std::end(result.histogram), stats.histogram);
+        return true;
+    }
+
+} // namespace g3d
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+#include <renderer.hpp>
+#include <uniforms.hpp>
+
+namespace g3d {
+/* Definitions */
+    struct HeightFieldStats {
+        static constexpr uint32_t HISTOGRAM_BINS = 256;
+
+        uint32_t finite_count{0}; // NaN and Inf values are left out of everything below
+        float min{0.0f}, max{0.0f};
+        float mean{0.0f}, variance{0.0f};
+        uint32_t histogram[HISTOGRAM_BINS]{};
+    };
+
+    // Parallel reduction of a range of the height field on the GPU: per-workgroup moments merged
+    // with Chan's formula, then a 256-bin histogram over [min, max]. The results are read back
+    // through a fence, so poll() never stalls the frame.
+    struct HeightFieldReducer {
+        static constexpr uint32_t WORKGROUP_SIZE = 256;
+        static constexpr uint32_t MAX_WORKGROUPS = 64;
+
+        void create();
+        void dispatch(HandleBuffer heights, uint32_t offset, uint32_t count);
+        bool poll(HeightFieldStats &stats);
+        bool is_pending() const { return _fence != nullptr; }
+
+      private:
+        HandleProgram _program_moments{0}, _program_merge{0}, _program_histogram{0};
+        UniformTable _uniforms_moments, _uniforms_merge, _uniforms_histogram;
+        HandleBuffer _partials{0}, _result{0};
+        HandleFence _fence{nullptr};
+    };
+} // namespace g3d
@@ -0,0 +1,159 @@
+#include "heightmap_export.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+#include <compression.hpp>
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    HeightRange height_range(const float *values, size_t count) {
+        constexpr size_t CHUNK = 1 << 16;
+        const auto chunk_count = (count + CHUNK - 1) / CHUNK;
+        std::vector<HeightRange> partial(chunk_count, HeightRange{INFINITY, -INFINITY, 0});
+        global_thread_pool().parallel_for(chunk_count, [&](size_t chunk) {
+            auto &r = partial[chunk];
+            const auto last = std::min(count, (chunk + 1) * CHUNK);
+            for (auto i = chunk * CHUNK; i < last; ++i) {
+                if (std::isfinite(values[i]) == false) { continue; }
+                r.min = std::min(r.min, values[i]);
+                r.max = std::max(r.max, values[i]);
+                ++r.finite_count;
+            }
+        });
+        HeightRange range{INFINITY, -INFINITY, 0};
+        for (const auto &r : partial) {
+            range.min = std::min(range.min, r.min);
+            range.max = std::max(range.max, r.max);
+            range.finite_count += r.finite_count;
+        }
+        if (range.finite_count == 0) { range.min = range.max = 0.0f; }
+        return range;
+    }
+
+    static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+        static const auto table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                auto c = n;
+                for (int k = 0; k < 8; ++k) { c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1; }
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) { crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8); }
+        return ~crc;
+    }
+
+    static void write_png_chunk(std::ofstream &file, const char type[4], const uint8_t *data, size_t size) {
+        const uint8_t length[] = {uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size)};
+        file.write(reinterpret_cast<const char *>(length), 4);
+        file.write(type, 4);
+        file.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+        const auto crc = crc32(data, size, crc32(reinterpret_cast<const uint8_t *>(type), 4));
+        const uint8_t crc_bytes[] = {uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc)};
+        file.write(reinterpret_cast<const char *>(crc_bytes), 4);
+    }
+
+    static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+        const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+    }
+
+    static void write_png16(std::ofstream &file, const float *heights, uint32_t width, uint32_t height, float bounds, const HeightRange &range) {
+        const auto stride = static_cast<size_t>(width) * 2;
+        const auto scale  = range.max > range.min ? 65535.0f / (range.max - range.min) : 0.0f;
+
+        // big-endian samples, then one filter byte and the filtered row per scanline
+        std::vector<uint8_t> samples(stride * height), scanlines((stride + 1) * height);
+        global_thread_pool().parallel_for(height, [&](size_t y) {
+            auto *out = samples.data() + y * stride;
+            for (uint32_t x = 0; x < width; ++x) {
+                const auto h = heights[y * width + x];
+                const auto v = std::isfinite(h) ? static_cast<uint16_t>(std::clamp((h - range.min) * scale, 0.0f, 65535.0f) + 0.5f) : uint16_t{0};
+                out[x * 2] = static_cast<uint8_t>(v >> 8);
+                out[x * 2 + 1] = static_cast<uint8_t>(v);
+            }
+        }, 16);
+        global_thread_pool().parallel_for(height, [&](size_t y) {
+            const auto *row = samples.data() + y * stride;
+            const auto *up  = y > 0 ? row - stride : nullptr;
+            auto *out = scanlines.data() + y * (stride + 1);
+            // the usual heuristic: keep the filter (Sub, Up or Paeth) whose bytes sum to the least as signed values
+            std::vector<uint8_t> candidate(stride);
+            uint64_t best_cost = UINT64_MAX;
+            for (uint8_t filter : {uint8_t{1}, uint8_t{2}, uint8_t{4}}) {
+                if (filter != 1 && up == nullptr) { continue; }
+                for (size_t i = 0; i < std::min<size_t>(2, stride); ++i) { candidate[i] = static_cast<uint8_t>(row[i] - (filter == 1 ? 0 : up[i])); }
+                if (filter == 1)      { for (size_t i = 2; i < stride; ++i) { candidate[i] = static_cast<uint8_t>(row[i] - row[i - 2]); } }
+                else if (filter == 2) { for (size_t i = 2; i < stride; ++i) { candidate[i] = static_cast<uint8_t>(row[i] - up[i]); } }
+                else                  { for (size_t i = 2; i < stride; ++i) { candidate[i] = static_cast<uint8_t>(row[i] - paeth(row[i - 2], up[i], up[i - 2])); } }
+                uint64_t cost = 0;
+                for (size_t i = 0; i < stride; ++i) { cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[i]))); }
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    out[0] = filter;
+                    std::memcpy(out + 1, candidate.data(), stride);
+                }
+            }
+        }, 16);
+        const auto compressed = zlib_compress_parallel(scanlines.data(), scanlines.size());
+
+        static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+        const uint8_t header[] = {uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+                                  uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+                                  16 /* bit depth */, 0 /* grayscale */, 0, 0, 0};
+        write_png_chunk(file, "IHDR", header, sizeof(header));
+        // what a reader needs to turn the samples back into heights
+        for (const auto &[key, value] : {std::pair{"height_min", range.min}, std::pair{"height_max", range.max}, std::pair{"bounds", bounds}}) {
+            char digits[32];
+            auto text = std::string{key} + '\0' + std::string(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+            write_png_chunk(file, "tEXt", reinterpret_cast<const uint8_t *>(text.data()), text.size());
+        }
+        constexpr size_t IDAT_SIZE = 1 << 24;
+        for (size_t offset = 0; offset < compressed.size(); offset += IDAT_SIZE) {
+            write_png_chunk(file, "IDAT", compressed.data() + offset, std::min(IDAT_SIZE, compressed.size() - offset));
+        }
+        write_png_chunk(file, "IEND", nullptr, 0);
+    }
+
+    void export_heightmap(const std::string &path, const float *heights, uint32_t width, uint32_t height, float bounds, HeightmapFormat format) {
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        const auto count = static_cast<size_t>(width) * height;
+
+        switch (format) {
+        case HeightmapFormat::Png16:
+            write_png16(file, heights, width, height, bounds, height_range(heights, count));
+            break;
+        case HeightmapFormat::RawFloat32:
+            file.write(reinterpret_cast<const char *>(heights), static_cast<std::streamsize>(count * sizeof(float)));
+            break;
+        case HeightmapFormat::Half: {
+            const auto range = height_range(heights, count);
+            const uint32_t header[] = {0x31484648 /* "HFH1" */, width, height};
+            const float extent[] = {range.min, range.max, bounds};
+            std::vector<uint16_t> halves(count);
+            global_thread_pool().parallel_for(height, [&](size_t y) {
+                for (size_t i = y * width; i < (y + 1) * width; ++i) { halves[i] = glm::packHalf1x16(heights[i]); }
+            }, 16);
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(extent), sizeof(extent));
+            file.write(reinterpret_cast<const char *>(halves.data()), static_cast<std::streamsize>(halves.size() * sizeof(uint16_t)));
+            break;
+        }
+        }
+        if (file.fail()) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+    }
+
+} // namespace g3d
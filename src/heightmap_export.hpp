@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace g3d {
+/* Definitions */
+    enum class HeightmapFormat : uint32_t { Png16, RawFloat32, Half };
+
+    struct HeightRange {
+        float min{0.0f}, max{0.0f};
+        size_t finite_count{0};
+    };
+    // Min and max of the finite values, reduced per chunk on the thread pool
+    HeightRange height_range(const float *values, size_t count);
+
+    // One width x height row-major grid, row 0 at z = -bounds, written as
+    //  - Png16: 16 bit grayscale PNG, heights normalised to [min, max] of the grid, NaN and Inf as 0; min, max and
+    //    bounds go in tEXt chunks. Rows are filtered and deflated on the thread pool.
+    //  - RawFloat32: the floats as they are, no header, like the .r32 most terrain tools import
+    //  - Half: an "HFH1" header (width, height, min, max, bounds) followed by IEEE half floats
+    // Throws std::runtime_error when the file cannot be written.
+    void export_heightmap(const std::string &path, const float *heights, uint32_t width, uint32_t height, float bounds, HeightmapFormat format);
+} // namespace g3d
@@ -1,11 +1,16 @@
 ﻿#include <fstream>
 #include <sstream>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <filesystem>
 #include <map>
 #include <concepts>
+#include <optional>
+#include <charconv>
+#include <thread>
 #include <ShlObj_core.h>
 
 #include <glad/glad.h>
@@ -15,37 +20,65 @@
 #include <imgui/imgui_impl_opengl3.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_stdlib.h>
+#include <imgui/implot.h>
 
 #include <orbital_camera.hpp>
 #include <renderer.hpp>
-
-struct Function {
-    std::string name, value;
-};
-struct Slider {
-    Slider() = default;
-    Slider(const std::string &name, float value) : name{name}, value{value} {}
-
-    std::string name;
-    float value{0.f}, min{0.f}, max{1.0f};
-};
-struct Constant {
-    std::string name;
-    float value{0.f};
-};
+#include <uniforms.hpp>
+#include <project.hpp>
+#include <project_file.hpp>
+#include <program_cache.hpp>
+#include <snapshot.hpp>
+#include <height_field_codec.hpp>
+#include <heightmap_export.hpp>
+#include <mesh_export.hpp>
+#include <batch.hpp>
+#include <file_watch.hpp>
+#include <font_atlas_cache.hpp>
+#include <data_source.hpp>
+#include <scattered_data.hpp>
+#include <height_field_stats.hpp>
+#include <height_field_mask.hpp>
+#include <sequence_export.hpp>
+#include <streamlines.hpp>
+#include <expression.hpp>
+#include <critical_points.hpp>
+#include <cubature.hpp>
+#include <contours.hpp>
+#include <sampling.hpp>
+#include <sweep.hpp>
+#include <fit.hpp>
 
 struct AppState {
     g3d::Window window;
     g3d::OrbitalCamera camera;
-    g3d::Framebuffer framebuffer_main;
+    g3d::Framebuffer framebuffer_main;    // the scene, drawn into a resolution_scale fraction of it
+    g3d::Framebuffer framebuffer_present; // the scene upscaled to the canvas size, shown by ImGui
+    g3d::RenderTargetPool render_targets;
 
     std::vector<Function> functions;
     std::vector<Slider> sliders;
     std::vector<Constant> constants;
+    std::vector<DataSource> data_sources;
+    g3d::ScatteredResampleJob scattered_job; // interpolates scattered data sources onto the plane, one source at a time
+    
+    std::string project_path;            // the opened project, empty for a new one
+    g3d::FileWatcher project_watcher;    // reloads the opened project when another program rewrites it
+    bool is_project_watched = true;
     
     std::vector<std::string> logs;
     bool needs_recompilation = false;
+    bool needs_height_field_update = true; // inputs of the compute pass changed since the last dispatch
+    uint64_t height_field_revision = 0;    // bumped by every dispatch, lets consumers skip unchanged fields
+    bool is_time_dependent = false;      // some function references TIME, so the plane animates
+    uint32_t pending_redraw_frames = 0;  // frames still to draw after the last input event
     uint32_t* heights_buffer=nullptr;
+    uint64_t compute_program_key = 0;     // program_cache_key() of the current compute shader source
+    uint64_t data_sources_key = 0;        // the same hash over the data grids in binding 8, which the source does not hold
+    // a height field stored in the opened project, shown before the first compilation finishes
+    std::optional<g3d::HeightFieldSnapshot> pending_snapshot;
+    uint64_t snapshot_program_key = 0;   // the field in the SSBO came from this height_field_key(), so it need not be recomputed
+    bool is_snapshot_embedded = true;    // when saving binary projects
     bool log_list_scroll_down = false;
     struct {
         ImFont *font = nullptr;
@@ -65,59 +98,183 @@ struct AppState {
         glm::vec4 color_grid        = glm::vec4{94,  94,  94,  255} / glm::vec4{255};
         glm::vec4 color_plane       = glm::vec4{135, 135, 135, 255} / glm::vec4{255};
         glm::vec4 color_plane_grid  = glm::vec4{228, 159, 61,  255} / glm::vec4{255};
+        glm::vec4 color_contours    = glm::vec4{240, 240, 240, 255} / glm::vec4{255};
+        glm::vec4 color_streamlines = glm::vec4{90,  190, 240, 255} / glm::vec4{255};
+        glm::vec4 color_arrows      = glm::vec4{250, 250, 120, 255} / glm::vec4{255};
     } color_settings;
 
     struct RenderSettings {
         bool is_grid_rendered               = true;
         bool is_plane_grid_rendered         = true;
+        bool is_render_on_demand            = true;
+        float target_fps                    = 60.0f;
+        float unfocused_target_fps          = 15.0f;
+        bool is_dynamic_resolution          = true;
+        float gpu_frame_budget_ms           = 8.0f;
+        float min_resolution_scale          = 0.5f;
     } render_settings;
+    float resolution_scale = 1.0f;
+    float scene_gpu_ms     = 0.0f;
+    bool is_full_resolution_held = false; // the scene went idle and was redrawn at full resolution, until it moves again
+
+    g3d::HeightFieldStats stats;
+    uint64_t stats_revision = 0;
+    uint32_t stats_surface  = 0; // index among the visible surfaces
+
+    // NaN, Inf and jump classification of every vertex
+    struct MaskSettings {
+        bool is_overlay_shown = false;
+        float jump_slope      = 100.0f; // |dh| / cell size above which neighbours count as a discontinuity
+    } mask_settings;
+    g3d::HeightFieldMaskCounts mask_counts, reported_mask_counts;
+
+    g3d::BadVertexPolicy export_bad_vertices = g3d::BadVertexPolicy::DropTriangles;
+    struct HeightmapExportSettings {
+        g3d::HeightmapFormat format = g3d::HeightmapFormat::Png16;
+        int surface         = 0;
+        uint32_t resolution = 0; // 0 reads the plane's grid back, anything else evaluates the surface on the CPU
+    } heightmap_export;
+
+    // per-vertex slope, aspect and curvatures, written by the height field pass when a map needs them
+    enum class ScalarMap : uint32_t { Shading, Slope, Aspect, GaussianCurvature, MeanCurvature };
+    struct ScalarMapSettings {
+        ScalarMap map          = ScalarMap::Shading;
+        float curvature_range  = 1.0f; // curvatures are shown in [-range, range]
+    } scalar_map_settings;
+
+    g3d::ContourSettings contour_settings;
+    g3d::ContourExtractor contours;        // isolines of f, extracted from a read back copy of its height field
+    uint64_t contours_revision = 0;
+    bool needs_contour_update  = false;    // settings changed, the field did not
+
+    g3d::StreamlineSettings streamline_settings;
+    g3d::StreamlineJob streamline_job;     // traces f on the CPU, restarted whenever the height field changes
+    uint64_t streamlines_revision = 0;
+    bool needs_streamline_update  = false;
+
+    g3d::SequenceSettings sequence_settings;
+    g3d::SequenceExportJob sequence_export_job; // TIME-range export of every surface, evaluated on the CPU
+    g3d::SweepJob sweep_job;                    // the parameter sweep of the Analysis tab
+    g3d::PlotSampleJob plot_job;                // the plots of the 2D tab
+
+    // CPU analyses of "f", run on request from the Analysis tab
+    struct Analysis {
+        g3d::CriticalPointSettings critical_point_settings;
+        std::vector<g3d::CriticalPoint> critical_points;
+        bool needs_marker_upload = false;
+        g3d::CubatureSettings cubature_settings;
+        g3d::CubatureResult cubature_result;
+        bool has_cubature_result = false;
+        g3d::SweepSettings sweep_settings;
+        std::vector<std::string> sweep_sliders; // by name, indices shift when sliders are removed
+        std::vector<std::string> sweep_axis_names; // the sliders of sweep_result's axes when it was run
+        g3d::SweepResult sweep_result;
+        std::vector<int> sweep_slice;           // fixed steps of the axes beyond the first two
+        bool has_sweep_result = false;
+        std::vector<g3d::DataPoint> fit_points;
+        std::string fit_points_file;
+        std::vector<std::string> fit_sliders;   // by name, like sweep_sliders
+        g3d::FitSettings fit_settings;
+        g3d::FitResult fit_result;
+        bool has_fit_result = false;
+    } analysis;
+
+    // the 2D tab: f as a heatmap and one cross-section, both sampled by the CPU evaluator on plot_job
+    struct Plot2D {
+        uint32_t heatmap_resolution = 256;
+        g3d::SliceAxis slice_axis = g3d::SliceAxis::ConstantZ;
+        double slice_position     = 0.0;
+        g3d::CurveSamplingSettings curve_settings;
+        g3d::PlotSamples samples;
+        uint64_t revision    = ~0ull; // height_field_revision the plots were sampled at
+        uint64_t failed_key  = ~0ull; // height_field_key() whose CPU compilation failure was logged
+        bool needs_update    = true;
+    } plot_2d;
 
     void reset() {
         functions.clear();
-        functions.emplace_back("f", "sin(x)");
+        functions.push_back(Function{.name = "f", .value = "sin(x)", .is_surface = true});
         sliders.clear();
         constants.clear();
+        data_sources.clear();
+        project_path.clear();
+        project_watcher.stop();
         logs.clear();
         font_idx = 2;
         plane_settings = PlaneSettings{};
         color_settings = ColorSettings{};
         render_settings = RenderSettings{};
+        sweep_job.cancel();
+        analysis = Analysis{.needs_marker_upload = true};
+        contour_settings = g3d::ContourSettings{};
+        streamline_settings = g3d::StreamlineSettings{};
+        scalar_map_settings = ScalarMapSettings{};
+        mask_settings = MaskSettings{};
+        plot_job.cancel();
+        plot_2d = Plot2D{};
         needs_recompilation = true;
+        needs_height_field_update = true;
+    }
+    // The jobs run on global_thread_pool(), a function static that is destroyed before app_state; they must be
+    // done before main() returns
+    void stop_background_jobs() {
+        sweep_job.cancel();
+        plot_job.cancel();
+        streamline_job.cancel();
+        sequence_export_job.wait();
+        scattered_job.wait();
     }
 } app_state;
 
 static void start_application(const char* window_title, uint32_t window_width, uint32_t window_height);
 static void terminate_application();
 static void on_window_resize(GLFWwindow*, int, int);
+static void request_redraw();
+static void wait_for_next_frame();
 
 static void imgui_newframe();
 static void imgui_renderframe();
 
 static void resize_main_frambuffer(uint32_t width, uint32_t height);
-static void set_rendering_state_opengl(const g3d::RenderState&);
+static void update_resolution_scale(float scene_gpu_ms);
 static void create_plane_shader_source_and_compile(g3d::HandleProgram program, g3d::HandleShader &vertex_shader, g3d::HandleShader &fragment_shader);
 static void create_grid_shader_source_and_compile (g3d::HandleProgram program, g3d::HandleShader &vertex_shader, g3d::HandleShader &fragment_shader);
 static void create_compute_shader(g3d::HandleProgram program, g3d::HandleShader &compute_shader);
-static void recalculate_plane_height_field(g3d::HandleProgram program, g3d::HandleBuffer *height_buffer, uint32_t *current_size);
+static uint32_t update_surface_table(g3d::HandleBuffer surfaces_buffer, g3d::HandleBuffer indirect_buffer);
+static void update_data_source_buffer(g3d::HandleBuffer buffer);
+static uint64_t height_field_key();
+static void recalculate_plane_height_field(g3d::HandleProgram program, g3d::HandleBuffer *height_buffer, uint32_t *current_size,
+                                           g3d::HandleBuffer *derived_buffer, uint32_t *current_derived_size, uint32_t surface_count);
 static void draw_gui();
-
-static void uniform1f(uint32_t program, const char* name, float value);
-static void uniform3f(uint32_t program, const char* name, glm::vec3 value);
-static void uniformm4(uint32_t program, const char* name, const glm::mat4& value);
+static g3d::Program compile_cpu_function(const std::string &name);
+static std::string documents_path(const std::string &file_name);
+
+static const g3d::UniformName UNIFORM_DETAIL     = g3d::intern_uniform_name("detail");
+static const g3d::UniformName UNIFORM_BOUNDS     = g3d::intern_uniform_name("bounds");
+static const g3d::UniformName UNIFORM_SIZE       = g3d::intern_uniform_name("size");
+static const g3d::UniformName UNIFORM_TIME       = g3d::intern_uniform_name("TIME");
+static const g3d::UniformName UNIFORM_USER_COLOR = g3d::intern_uniform_name("user_color");
+static const g3d::UniformName UNIFORM_SHOW_MASK  = g3d::intern_uniform_name("show_mask");
+static const g3d::UniformName UNIFORM_WRITE_DERIVED   = g3d::intern_uniform_name("write_derived");
+static const g3d::UniformName UNIFORM_SCALAR_MAP      = g3d::intern_uniform_name("scalar_map");
+static const g3d::UniformName UNIFORM_CURVATURE_RANGE = g3d::intern_uniform_name("curvature_range");
 
 static void save_project(const char *file_name);
 static void load_project(const char *file_name);
+static void reload_project(const std::string &path);
+static void watch_project();
 static void export_to_obj(const std::string& file_name, g3d::HandleBuffer buffer);
 static void log_list_add_message(const std::string& msg);
 
-int main() {
+int main(int argc, char **argv) {
+    // with arguments the calculator runs headless: no window and no GL context, the surfaces are evaluated on the CPU
+    if (argc > 1) { return g3d::batch_main(argc, argv); }
+
     start_application("3DCalc", 1280, 960);
 
-    g3d::HandleFramebuffer framebuffer_main;
-    g3d::HandleTexture texture_fmain_color;
-    g3d::HandleTexture texture_fmain_depth_stencil;
+    g3d::HandleFramebuffer framebuffer_main, framebuffer_present;
 
-    g3d::HandleProgram program_compute; g3d::HandleShader shader_compute;
+    g3d::HandleProgram program_compute; g3d::HandleShader shader_compute = 0;
     g3d::HandleProgram program_plane;   g3d::HandleShader shader_plane_vert;    g3d::HandleShader shader_plane_frag;
     g3d::HandleProgram program_line;    g3d::HandleShader shader_line_vert;     g3d::HandleShader shader_line_frag;
     g3d::HandleProgram program_grid;    g3d::HandleShader shader_grid_vert;     g3d::HandleShader shader_grid_frag;
@@ -125,17 +282,14 @@ int main() {
     program_compute = glCreateProgram();
     g3d::HandleVao vao_plane;
     g3d::HandleVao vao_line;
-    g3d::HandleBuffer vbo_plane, ebo_plane, vbo_heights_plane;
+    g3d::HandleBuffer vbo_plane, ebo_plane, vbo_heights_plane, ssbo_derived_plane, ssbo_surfaces, indirect_plane, ssbo_data_sources;
     g3d::HandleBuffer vbo_line;
+    g3d::HandleVao vao_markers, vao_contours, vao_streamlines;
+    g3d::HandleBuffer vbo_markers, vbo_contours, vbo_streamlines;
     glCreateFramebuffers(1, &framebuffer_main);
-    glCreateTextures(GL_TEXTURE_2D, 1, &texture_fmain_color);
-    glCreateTextures(GL_TEXTURE_2D, 1, &texture_fmain_depth_stencil);
-    glTextureStorage2D(texture_fmain_color, 1, GL_RGB8, app_state.window.width, app_state.window.height);
-    glTextureStorage2D(texture_fmain_depth_stencil, 1, GL_DEPTH24_STENCIL8, app_state.window.width, app_state.window.height);
-    glNamedFramebufferTexture(framebuffer_main, GL_COLOR_ATTACHMENT0, texture_fmain_color, 0);
-    glNamedFramebufferTexture(framebuffer_main, GL_DEPTH_STENCIL_ATTACHMENT, texture_fmain_depth_stencil, 0);
+    glCreateFramebuffers(1, &framebuffer_present);
     glNamedFramebufferDrawBuffer(framebuffer_main, GL_COLOR_ATTACHMENT0);
-    assert((glCheckNamedFramebufferStatus(framebuffer_main, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) && "Main framebuffer initialisation error.");
+    glNamedFramebufferDrawBuffer(framebuffer_present, GL_COLOR_ATTACHMENT0);
     app_state.heights_buffer = &vbo_heights_plane;
 
     program_plane = glCreateProgram();  shader_plane_vert = glCreateShader(GL_VERTEX_SHADER); shader_plane_frag = glCreateShader(GL_FRAGMENT_SHADER);
@@ -145,6 +299,10 @@ int main() {
     glCreateBuffers(1, &vbo_plane);
     glCreateBuffers(1, &ebo_plane);
     glCreateBuffers(1, &vbo_heights_plane);
+    glCreateBuffers(1, &ssbo_derived_plane);
+    glCreateBuffers(1, &ssbo_surfaces);
+    glCreateBuffers(1, &indirect_plane);
+    glCreateBuffers(1, &ssbo_data_sources);
     glVertexArrayVertexBuffer(vao_plane, 0, vbo_plane, 0, 8);
     glVertexArrayElementBuffer(vao_plane, ebo_plane);
     glEnableVertexArrayAttrib(vao_plane, 0);
@@ -158,6 +316,75 @@ int main() {
     glVertexArrayAttribBinding(vao_line, 0, 0);
     glVertexArrayAttribFormat(vao_line, 0, 3, GL_FLOAT, GL_FALSE, 0);
 
+    // critical point markers: xyz and the point kind
+    glCreateVertexArrays(1, &vao_markers);
+    glCreateBuffers(1, &vbo_markers);
+    glVertexArrayVertexBuffer(vao_markers, 0, vbo_markers, 0, 16);
+    glEnableVertexArrayAttrib(vao_markers, 0);
+    glVertexArrayAttribBinding(vao_markers, 0, 0);
+    glVertexArrayAttribFormat(vao_markers, 0, 4, GL_FLOAT, GL_FALSE, 0);
+    const auto program_markers = g3d::create_program({
+        {GL_VERTEX_SHADER, R"glsl(
+            #version 460 core
+            layout(location=0) in vec4 in_point;
+            layout(std140, binding=0) uniform FrameTransforms { mat4 v; mat4 p; };
+            flat out vec3 vout_color;
+            void main() {
+                const vec3 colors[3] = vec3[3](vec3(0.25, 0.55, 1.0), vec3(1.0, 0.3, 0.25), vec3(1.0, 0.9, 0.2)); // min, max, saddle
+                vout_color = colors[int(in_point.w)];
+                gl_Position = p * v * vec4(in_point.xyz, 1.0);
+                gl_Position.z -= 0.002 * gl_Position.w; // keep markers on top of the surface they sit on
+                gl_PointSize = 9.0;
+            }
+        )glsl"},
+        {GL_FRAGMENT_SHADER, R"glsl(
+            #version 460 core
+            flat in vec3 vout_color;
+            out vec4 FRAG_COLOR;
+            void main() {
+                if (length(gl_PointCoord - 0.5) > 0.5) { discard; }
+                FRAG_COLOR = vec4(vout_color, 1.0);
+            }
+        )glsl"},
+    });
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    glCreateVertexArrays(1, &vao_contours);
+    glCreateBuffers(1, &vbo_contours);
+    glVertexArrayVertexBuffer(vao_contours, 0, vbo_contours, 0, 12);
+    glEnableVertexArrayAttrib(vao_contours, 0);
+    glVertexArrayAttribBinding(vao_contours, 0, 0);
+    glVertexArrayAttribFormat(vao_contours, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    const auto program_contours = g3d::create_program({
+        {GL_VERTEX_SHADER, R"glsl(
+            #version 460 core
+            layout(location=0) in vec3 in_pos;
+            layout(std140, binding=0) uniform FrameTransforms { mat4 v; mat4 p; };
+            void main() {
+                gl_Position = p * v * vec4(in_pos, 1.0);
+                gl_Position.z -= 0.001 * gl_Position.w; // the lines lie exactly on the surface
+            }
+        )glsl"},
+        {GL_FRAGMENT_SHADER, R"glsl(
+            #version 460 core
+            uniform vec3 user_color;
+            out vec4 FRAG_COLOR;
+            void main() { FRAG_COLOR = vec4(user_color, 1.0); }
+        )glsl"},
+    });
+    g3d::BufferReadback contour_readback;
+    struct { uint32_t detail, bounds; } contour_request{}; // the plane the pending readback was taken from
+    uint32_t contour_vertex_count = 0;
+
+    // streamlines followed by the arrow glyphs, drawn with the isoline program
+    glCreateVertexArrays(1, &vao_streamlines);
+    glCreateBuffers(1, &vbo_streamlines);
+    glVertexArrayVertexBuffer(vao_streamlines, 0, vbo_streamlines, 0, 12);
+    glEnableVertexArrayAttrib(vao_streamlines, 0);
+    glVertexArrayAttribBinding(vao_streamlines, 0, 0);
+    glVertexArrayAttribFormat(vao_streamlines, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    uint32_t streamline_vertex_count = 0, arrow_vertex_count = 0;
+
      {
         float vbo[] {-1.0,  1.0, 1.0,  1.0, -1.0, -1.0, 1.0, -1.0 };
         unsigned ebo[]{0, 1, 2, 2, 1, 3};
@@ -168,16 +395,10 @@ int main() {
         glNamedBufferStorage(vbo_line,  sizeof(lineverts), lineverts, 0);
     }
 
-    g3d::Texture texture_fmain_color_wrapped {
-        .handle = texture_fmain_color,
-        .target = GL_TEXTURE_2D, .format = GL_RGB8,
-        .width = app_state.window.width, .height = app_state.window.height
-    };
-    g3d::Texture texture_fmain_depth_stencil_wrapped {
-        .handle = texture_fmain_depth_stencil,
-        .target = GL_TEXTURE_2D, .format = GL_DEPTH24_STENCIL8,
-        .width = app_state.window.width, .height = app_state.window.height
-    };
+    // storage comes from app_state.render_targets on the first resize
+    g3d::Texture texture_fmain_color_wrapped            { .target = GL_TEXTURE_2D, .format = GL_RGB8 };
+    g3d::Texture texture_fmain_depth_stencil_wrapped    { .target = GL_TEXTURE_2D, .format = GL_DEPTH24_STENCIL8 };
+    g3d::Texture texture_fpresent_color_wrapped         { .target = GL_TEXTURE_2D, .format = GL_RGB8 };
 
 
     // App State Initialisation    
@@ -188,8 +409,15 @@ int main() {
                      {GL_DEPTH_STENCIL_ATTACHMENT,   &texture_fmain_depth_stencil_wrapped}
         }
     };
+    app_state.framebuffer_present = g3d::Framebuffer{
+        .handle = framebuffer_present,
+        .textures = {{GL_COLOR_ATTACHMENT0,          &texture_fpresent_color_wrapped}}
+    };
+    resize_main_frambuffer(app_state.window.width, app_state.window.height);
+    assert((glCheckNamedFramebufferStatus(framebuffer_main, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) && "Main framebuffer initialisation error.");
+    assert((glCheckNamedFramebufferStatus(framebuffer_present, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) && "Present framebuffer initialisation error.");
     // Function "f" shall always be present
-    app_state.functions.push_back(Function{"f", "sin(x)"});
+    app_state.functions.push_back(Function{.name = "f", .value = "sin(x)", .is_surface = true});
 
     // Rendering States
     g3d::RenderState plane_render_state{ 
@@ -198,58 +426,270 @@ int main() {
     g3d::RenderState grid_render_state{ 
         .vao = vao_line, .program = program_grid, .line_width = 2.0f
     };
+    g3d::RenderState marker_render_state{
+        .vao = vao_markers, .program = program_markers
+    };
+    g3d::RenderState contour_render_state{
+        .vao = vao_contours, .program = program_contours, .line_width = 1.5f
+    };
+    g3d::RenderState streamline_render_state{
+        .vao = vao_streamlines, .program = program_contours, .line_width = 1.0f
+    };
 
     auto &window = app_state.window;
     
     create_plane_shader_source_and_compile(program_plane, shader_plane_vert, shader_plane_frag);
     create_grid_shader_source_and_compile(program_grid, shader_grid_vert, shader_grid_frag);
     create_compute_shader(program_compute, shader_compute);
-    uint32_t current_buffer_size=0;
+
+    g3d::UniformTable uniforms_plane, uniforms_grid, uniforms_compute, uniforms_contours;
+    uniforms_contours.on_program_linked(program_contours);
+    uniforms_plane.on_program_linked(program_plane);
+    uniforms_grid.on_program_linked(program_grid);
+    uniforms_compute.on_program_linked(program_compute);
+    g3d::FrameUniformBuffer frame_uniforms;
+    frame_uniforms.create();
+    g3d::Renderer renderer;
+    g3d::GpuTimer scene_timer;
+    scene_timer.create();
+    g3d::HeightFieldReducer height_field_reducer;
+    height_field_reducer.create();
+    g3d::HeightFieldMask height_field_mask;
+    height_field_mask.create();
+
+    uint32_t current_buffer_size=0, current_derived_size=0;
+    request_redraw();
     while(glfwWindowShouldClose(window.pglfw_window) == false) {
-        glfwPollEvents();
+        wait_for_next_frame();
+        if (app_state.project_watcher.poll()) {
+            reload_project(app_state.project_path);
+            request_redraw();
+        }
+        if (app_state.pending_redraw_frames == 0) { continue; }
+        --app_state.pending_redraw_frames;
+
         imgui_newframe();
         app_state.camera.update();
 
-        if(app_state.needs_recompilation) {
+        // scattered data sources follow the plane: a changed plane or interpolation resamples them in the background
+        // while the previous grid stays in use, a finished grid relinks the compute shader
+        if (g3d::ScatteredResampleJob::Result resampled; app_state.scattered_job.poll(resampled)) {
+            if (resampled.error.empty() == false) { log_list_add_message(resampled.error); }
+            for (auto &d : app_state.data_sources) {
+                if (d.points != resampled.data) { continue; }
+                // a failed resampling keeps the previous grid and is not retried until the plane or settings change
+                if (resampled.grid == nullptr) { d.resampling = resampled.resampling; continue; }
+                const auto b = resampled.resampling.bounds;
+                d.grid       = resampled.grid;
+                d.domain     = {-b, b, -b, b};
+                d.resampling = resampled.resampling;
+                app_state.needs_recompilation = true;
+            }
+        } else if (app_state.scattered_job.is_running()) {
+            request_redraw();
+        }
+        if (app_state.scattered_job.is_running() == false) {
+            for (const auto &d : app_state.data_sources) {
+                const g3d::ScatteredResampling wanted{d.scattered_settings, app_state.plane_settings.detail + 1, (float)app_state.plane_settings.bounds};
+                if (d.points == nullptr || d.resampling == wanted) { continue; }
+                app_state.scattered_job.start(d.points, wanted);
+                request_redraw();
+                break;
+            }
+        }
+
+        // a just opened snapshot gets one frame on screen before the compilation runs
+        if(app_state.needs_recompilation && app_state.pending_snapshot.has_value() == false) {
             app_state.needs_recompilation = false;
             try {
                 create_compute_shader(program_compute, shader_compute);
+                uniforms_compute.on_program_linked(program_compute);
+                app_state.needs_height_field_update = height_field_key() != app_state.snapshot_program_key;
+                app_state.snapshot_program_key = 0;
             } catch(const std::exception& err) {
                 log_list_add_message(err.what());
             }
         }
 
+        const auto &canvas = app_state.framebuffer_present;
+        const auto render_width  = std::max(1u, (uint32_t)(canvas.width  * app_state.resolution_scale));
+        const auto render_height = std::max(1u, (uint32_t)(canvas.height * app_state.resolution_scale));
+
         glEnable(GL_DEPTH_TEST);
         glBindFramebuffer(GL_FRAMEBUFFER, app_state.framebuffer_main.handle);
-        glViewport(0, 0, app_state.framebuffer_main.textures[0].second->width, app_state.framebuffer_main.textures[0].second->height);
+        glViewport(0, 0, render_width, render_height);
         auto &bc = app_state.color_settings.color_background;
         glClearColor(bc.r, bc.g, bc.b, bc.a);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        frame_uniforms.upload({.v = app_state.camera.view_matrix(), .p = app_state.camera.projection_matrix()});
 
         if (app_state.render_settings.is_grid_rendered) {
-            set_rendering_state_opengl(grid_render_state);
-            uniformm4(program_grid, "v", app_state.camera.view_matrix());
-            uniformm4(program_grid, "p", app_state.camera.projection_matrix());
-            uniform1f(program_grid, "bounds", app_state.plane_settings.bounds);
-            uniform3f(program_grid, "user_color", app_state.color_settings.color_grid);
-            glDrawArraysInstanced(GL_LINES, 0, 2, app_state.plane_settings.bounds * 2 + 1);
-            glDrawArraysInstanced(GL_LINES, 4, 2, app_state.plane_settings.bounds * 2 + 1);
-        }
-
-        glUseProgram(program_compute);
-        uniform1f(program_compute, "detail", app_state.plane_settings.detail);
-        uniform1f(program_compute, "bounds", app_state.plane_settings.bounds);
-        uniform1f(program_compute, "TIME", (float)glfwGetTime());
-        for(const auto& s : app_state.sliders) { uniform1f(program_compute, s.name.c_str(), s.value); }
-        recalculate_plane_height_field(program_compute, &vbo_heights_plane, &current_buffer_size); 
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        set_rendering_state_opengl(plane_render_state);
-        uniformm4(program_plane, "v", app_state.camera.view_matrix());
-        uniformm4(program_plane, "p", app_state.camera.projection_matrix());
-        uniform1f(program_plane, "detail", app_state.plane_settings.detail);
-        uniform1f(program_plane, "size", app_state.plane_settings.bounds);
-        uniform3f(program_plane, "user_color", app_state.color_settings.color_plane);
-        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, app_state.plane_settings.detail * app_state.plane_settings.detail);
+            g3d::uniform1f(uniforms_grid, UNIFORM_BOUNDS, app_state.plane_settings.bounds);
+            g3d::uniform3f(uniforms_grid, UNIFORM_USER_COLOR, app_state.color_settings.color_grid);
+            renderer.draw_arrays(grid_render_state, GL_LINES, 0, 2, app_state.plane_settings.bounds * 2 + 1);
+            renderer.draw_arrays(grid_render_state, GL_LINES, 4, 2, app_state.plane_settings.bounds * 2 + 1);
+        }
+
+        const auto surface_count = update_surface_table(ssbo_surfaces, indirect_plane);
+        update_data_source_buffer(ssbo_data_sources);
+        if (app_state.pending_snapshot.has_value()) {
+            auto &snapshot = *app_state.pending_snapshot;
+            if (snapshot.surface_count == surface_count && snapshot.detail == app_state.plane_settings.detail) {
+                if (snapshot.heights.size() > current_buffer_size) {
+                    current_buffer_size = (uint32_t)snapshot.heights.size();
+                    glDeleteBuffers(1, &vbo_heights_plane);
+                    glCreateBuffers(1, &vbo_heights_plane);
+                    glNamedBufferStorage(vbo_heights_plane, current_buffer_size * sizeof(float), 0, GL_MAP_READ_BIT | GL_DYNAMIC_STORAGE_BIT);
+                }
+                glNamedBufferSubData(vbo_heights_plane, 0, snapshot.heights.size() * sizeof(float), snapshot.heights.data());
+                app_state.needs_height_field_update = false;
+                ++app_state.height_field_revision;
+                // the mask is built from the heights alone, so it follows the snapshot like it follows a dispatch
+                height_field_mask.dispatch(vbo_heights_plane, app_state.plane_settings.detail, surface_count,
+                                           app_state.plane_settings.bounds, app_state.mask_settings.jump_slope);
+                // the derived field only comes out of the compute pass: drop the old one (the scalar map switches off
+                // until then) and have the compilation dispatch, instead of trusting the snapshot's key
+                const bool is_derived_written = app_state.scalar_map_settings.map != AppState::ScalarMap::Shading;
+                if (is_derived_written) { current_derived_size = 0; }
+                app_state.snapshot_program_key = is_derived_written ? 0 : snapshot.program_key;
+            }
+            app_state.pending_snapshot.reset();
+            request_redraw();
+        }
+        if (app_state.needs_height_field_update || app_state.is_time_dependent) {
+            app_state.needs_height_field_update = false;
+            glUseProgram(program_compute);
+            g3d::uniform1f(uniforms_compute, UNIFORM_DETAIL, app_state.plane_settings.detail);
+            g3d::uniform1f(uniforms_compute, UNIFORM_BOUNDS, app_state.plane_settings.bounds);
+            g3d::uniform1f(uniforms_compute, UNIFORM_TIME, (float)glfwGetTime());
+            for(const auto& s : app_state.sliders) { g3d::uniform1f(uniforms_compute, s.uniform, s.value); }
+            g3d::uniform1ui(uniforms_compute, UNIFORM_WRITE_DERIVED, app_state.scalar_map_settings.map != AppState::ScalarMap::Shading);
+            recalculate_plane_height_field(program_compute, &vbo_heights_plane, &current_buffer_size, &ssbo_derived_plane, &current_derived_size, surface_count);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            ++app_state.height_field_revision;
+            height_field_mask.dispatch(vbo_heights_plane, app_state.plane_settings.detail, surface_count,
+                                       app_state.plane_settings.bounds, app_state.mask_settings.jump_slope);
+        }
+        if (height_field_mask.poll(app_state.mask_counts)) {
+            // report once per change, animated surfaces would flood the log otherwise
+            auto counts = app_state.mask_counts;
+            counts.counts[(uint32_t)g3d::VertexClass::Finite] = 0;
+            if (counts != app_state.reported_mask_counts && counts != g3d::HeightFieldMaskCounts{}) {
+                using enum g3d::VertexClass;
+                log_list_add_message("Height field: " + std::to_string(counts[NaN]) + " NaN, " + std::to_string(counts[PositiveInf]) + " +Inf, " +
+                                     std::to_string(counts[NegativeInf]) + " -Inf, " + std::to_string(counts[Jump]) + " jump vertices");
+            }
+            app_state.reported_mask_counts = counts;
+        }
+
+        const auto vertex_count = (app_state.plane_settings.detail + 1) * (app_state.plane_settings.detail + 1);
+        if (app_state.stats_revision != app_state.height_field_revision && surface_count > 0) {
+            app_state.stats_revision = app_state.height_field_revision;
+            app_state.stats_surface  = std::min(app_state.stats_surface, surface_count - 1);
+            height_field_reducer.dispatch(vbo_heights_plane, app_state.stats_surface * vertex_count, vertex_count);
+        }
+        if (height_field_reducer.poll(app_state.stats) == false && height_field_reducer.is_pending()) { request_redraw(); }
+
+        // isolines of f: read its slice of the height field back whenever it changes, extract when it arrives
+        auto &contours = app_state.contours;
+        const auto f_surface = [&]() -> int32_t {
+            int32_t slot = 0;
+            for (const auto &f : app_state.functions) {
+                if (f.name == "f") { return f.is_surface ? slot : -1; }
+                slot += f.is_surface;
+            }
+            return -1;
+        }();
+        if (app_state.contour_settings.is_enabled && f_surface >= 0 && contour_readback.is_pending() == false &&
+            (app_state.contours_revision != app_state.height_field_revision || app_state.needs_contour_update)) {
+            app_state.contours_revision    = app_state.height_field_revision;
+            app_state.needs_contour_update = false;
+            contour_readback.request(vbo_heights_plane, (uint64_t)f_surface * vertex_count * sizeof(float), (uint64_t)vertex_count * sizeof(float));
+            contour_request = {app_state.plane_settings.detail, app_state.plane_settings.bounds};
+        }
+        static std::vector<uint8_t> contour_heights;
+        if (contour_readback.poll(contour_heights)) {
+            // the plane may have changed while the readback was in flight, the grid is the one that was requested
+            contours.extract((const float*)contour_heights.data(), contour_request.detail, (float)contour_request.bounds, app_state.contour_settings);
+            contour_vertex_count = (uint32_t)contours.line_vertices.size();
+            if (contour_vertex_count > 0) { glNamedBufferData(vbo_contours, contour_vertex_count * sizeof(glm::vec3), contours.line_vertices.data(), GL_DYNAMIC_DRAW); }
+        } else if (contour_readback.is_pending()) {
+            request_redraw();
+        }
+        if (app_state.contour_settings.is_enabled && f_surface >= 0 && contour_vertex_count > 0) {
+            g3d::uniform3f(uniforms_contours, UNIFORM_USER_COLOR, app_state.color_settings.color_contours);
+            renderer.draw_arrays(contour_render_state, GL_LINES, 0, contour_vertex_count);
+        }
+
+        // streamlines of f: traced on a background thread, the newest request starts once the last one lands
+        auto &streamline_settings = app_state.streamline_settings;
+        if (streamline_settings.is_enabled && app_state.streamline_job.is_running() == false &&
+            (app_state.streamlines_revision != app_state.height_field_revision || app_state.needs_streamline_update)) {
+            app_state.streamlines_revision    = app_state.height_field_revision;
+            app_state.needs_streamline_update = false;
+            try {
+                app_state.streamline_job.start(compile_cpu_function("f"), g3d::make_parameters(app_state.sliders, glfwGetTime()),
+                                               app_state.plane_settings.bounds, streamline_settings);
+            } catch (const std::exception &err) {
+                streamline_settings.is_enabled = false;
+                log_list_add_message(err.what());
+            }
+        }
+        g3d::Streamlines streamlines;
+        if (std::string error; app_state.streamline_job.poll(streamlines, error)) {
+            if (error.empty() == false) { streamline_settings.is_enabled = false; log_list_add_message(error); } // and no lines are drawn
+            streamline_vertex_count = (uint32_t)streamlines.line_vertices.size();
+            arrow_vertex_count      = (uint32_t)streamlines.arrow_vertices.size();
+            streamlines.line_vertices.insert(streamlines.line_vertices.end(), streamlines.arrow_vertices.begin(), streamlines.arrow_vertices.end());
+            if (streamlines.line_vertices.empty() == false) {
+                glNamedBufferData(vbo_streamlines, streamlines.line_vertices.size() * sizeof(glm::vec3), streamlines.line_vertices.data(), GL_DYNAMIC_DRAW);
+            }
+        } else if (app_state.streamline_job.is_running()) {
+            request_redraw();
+        }
+        if (std::string message; app_state.sequence_export_job.poll(message)) {
+            log_list_add_message(message);
+        } else if (app_state.sequence_export_job.is_running()) {
+            request_redraw();
+        }
+        if (streamline_settings.is_enabled) {
+            if (streamline_vertex_count > 0) {
+                g3d::uniform3f(uniforms_contours, UNIFORM_USER_COLOR, app_state.color_settings.color_streamlines);
+                renderer.draw_arrays(streamline_render_state, GL_LINES, 0, streamline_vertex_count);
+            }
+            if (streamline_settings.is_arrows_shown && arrow_vertex_count > 0) {
+                g3d::uniform3f(uniforms_contours, UNIFORM_USER_COLOR, app_state.color_settings.color_arrows);
+                renderer.draw_arrays(streamline_render_state, GL_LINES, streamline_vertex_count, arrow_vertex_count);
+            }
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo_heights_plane);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g3d::HeightFieldMask::BINDING, height_field_mask.mask);
+        g3d::uniform1ui(uniforms_plane, UNIFORM_SHOW_MASK, app_state.mask_settings.is_overlay_shown && height_field_mask.mask != 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, ssbo_derived_plane);
+        g3d::uniform1ui(uniforms_plane, UNIFORM_SCALAR_MAP, current_derived_size > 0 ? (uint32_t)app_state.scalar_map_settings.map : 0u);
+        g3d::uniform1f(uniforms_plane, UNIFORM_CURVATURE_RANGE, app_state.scalar_map_settings.curvature_range);
+        g3d::uniform1f(uniforms_plane, UNIFORM_DETAIL, app_state.plane_settings.detail);
+        g3d::uniform1f(uniforms_plane, UNIFORM_SIZE, app_state.plane_settings.bounds);
+        renderer.draw_elements_indirect(plane_render_state, GL_TRIANGLES, indirect_plane, surface_count);
+
+        auto &analysis = app_state.analysis;
+        if (analysis.needs_marker_upload) {
+            analysis.needs_marker_upload = false;
+            std::vector<glm::vec4> markers;
+            for (const auto &c : analysis.critical_points) { markers.emplace_back((float)c.x, (float)c.y, (float)c.z, (float)c.kind); }
+            if (markers.empty() == false) { glNamedBufferData(vbo_markers, markers.size() * sizeof(glm::vec4), markers.data(), GL_DYNAMIC_DRAW); }
+        }
+        if (analysis.critical_points.empty() == false) {
+            renderer.draw_arrays(marker_render_state, GL_POINTS, 0, (uint32_t)analysis.critical_points.size());
+        }
+        scene_timer.begin(); // raster work only, the height field compute does not scale with resolution
+        renderer.render();
+        scene_timer.end();
+        if (scene_timer.has_new_result) { update_resolution_scale(scene_timer.elapsed_ms); }
+
+        glBlitNamedFramebuffer(app_state.framebuffer_main.handle, canvas.handle,
+                               0, 0, render_width, render_height, 0, 0, canvas.width, canvas.height,
+                               GL_COLOR_BUFFER_BIT, render_width == canvas.width ? GL_NEAREST : GL_LINEAR);
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, app_state.window.width, app_state.window.height);
@@ -260,10 +700,15 @@ int main() {
         glfwSwapBuffers(window.pglfw_window);   
         window.has_just_resized = false;
     }
+    app_state.stop_background_jobs();
     return 0;
 }
 
 static void start_application(const char* window_title, uint32_t window_width, uint32_t window_height) {
+    // the font atlas is loaded from its cache, or rasterised, while the window and the context come up
+    ImFontAtlas *font_atlas = nullptr;
+    std::thread font_thread([&font_atlas] { font_atlas = g3d::load_font_atlas("fonts/consola.ttf", {12, 14, 20, 25}); });
+
     // initialise opengl and create window
     FreeConsole(); // hide cmd console
     glfwInit();
@@ -283,16 +728,23 @@ static void start_application(const char* window_title, uint32_t window_width, u
 
     // initialise ImGui 
     IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
+    font_thread.join();
+    ImGui::CreateContext(font_atlas); // shared, so the atlas lives as long as the application, like the context
+    ImPlot::CreateContext();
+    // installed before the ImGui backend, which chains to them; any input wakes the render-on-demand loop
+    auto *pwindow = app_state.window.pglfw_window;
+    glfwSetCursorPosCallback(pwindow,   [](GLFWwindow *, double, double) { request_redraw(); });
+    glfwSetMouseButtonCallback(pwindow, [](GLFWwindow *, int, int, int) { request_redraw(); });
+    glfwSetScrollCallback(pwindow,      [](GLFWwindow *, double, double) { request_redraw(); });
+    glfwSetKeyCallback(pwindow,         [](GLFWwindow *, int, int, int, int) { request_redraw(); });
+    glfwSetCharCallback(pwindow,        [](GLFWwindow *, unsigned) { request_redraw(); });
+    glfwSetWindowFocusCallback(pwindow, [](GLFWwindow *, int) { request_redraw(); });
+    glfwSetCursorEnterCallback(pwindow, [](GLFWwindow *, int) { request_redraw(); });
+    glfwSetWindowRefreshCallback(pwindow, [](GLFWwindow *) { request_redraw(); });
     ImGui_ImplGlfw_InitForOpenGL(app_state.window.pglfw_window, true);
     ImGui_ImplOpenGL3_Init("#version 460 core");
     ImGui::StyleColorsDark();
-    auto &io = ImGui::GetIO();
-    
-    app_state.fonts[0].font = io.Fonts->AddFontFromFileTTF("fonts/consola.ttf", 12);
-    app_state.fonts[1].font = io.Fonts->AddFontFromFileTTF("fonts/consola.ttf", 14);
-    app_state.fonts[2].font = io.Fonts->AddFontFromFileTTF("fonts/consola.ttf", 20);
-    app_state.fonts[3].font = io.Fonts->AddFontFromFileTTF("fonts/consola.ttf", 25);
+    for (int i = 0; i < 4; ++i) { app_state.fonts[i].font = font_atlas->Fonts[i]; }
 
     glfwSetFramebufferSizeCallback(app_state.window.pglfw_window, on_window_resize);
 }
@@ -313,20 +765,33 @@ static void imgui_renderframe() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 static void resize_main_frambuffer(uint32_t width, uint32_t height) {
-    for(auto& [attachment, t] : app_state.framebuffer_main.textures) {
-        t->width = width;
-        t->height= height;
-
-        glDeleteTextures(1, &t->handle);
-        glCreateTextures(t->target, 1, &t->handle);
-        glTextureStorage2D(t->handle, 1, t->format, t->width, t->height);
-        glNamedFramebufferTexture(app_state.framebuffer_main.handle, attachment, t->handle, 0);
+    // Both framebuffers keep canvas-sized storage: the scene only shrinks its viewport when scaled,
+    // so scale changes never touch textures and resizes only swap them when the canvas outgrows them.
+    for(auto *framebuffer : {&app_state.framebuffer_main, &app_state.framebuffer_present}) {
+        framebuffer->width  = width;
+        framebuffer->height = height;
+        for(auto& [attachment, t] : framebuffer->textures) {
+            if(t->handle != 0 && t->width >= width && t->height >= height) { continue; }
+
+            app_state.render_targets.release(*t);
+            *t = app_state.render_targets.acquire(t->target, t->format, width, height);
+            glNamedFramebufferTexture(framebuffer->handle, attachment, t->handle, 0);
+        }
     }
 }
-static void set_rendering_state_opengl(const g3d::RenderState& state) {
-    glBindVertexArray(state.vao);
-    glUseProgram(state.program);
-    glLineWidth(state.line_width);
+static void update_resolution_scale(float scene_gpu_ms) {
+    const auto &rs = app_state.render_settings;
+    auto &scale    = app_state.resolution_scale;
+    app_state.scene_gpu_ms = scene_gpu_ms;
+    if(rs.is_dynamic_resolution == false || app_state.is_full_resolution_held) { scale = 1.0f; return; }
+
+    // raster cost is roughly proportional to the pixel count, i.e. to scale^2
+    if(scene_gpu_ms > rs.gpu_frame_budget_ms) {
+        scale *= glm::max(glm::sqrt(rs.gpu_frame_budget_ms / scene_gpu_ms), 0.85f);
+    } else if(scene_gpu_ms < rs.gpu_frame_budget_ms * 0.7f) {
+        scale *= 1.05f;
+    }
+    scale = glm::clamp(scale, rs.min_resolution_scale, 1.0f);
 }
 static void create_plane_shader_source_and_compile(g3d::HandleProgram program, g3d::HandleShader& vertex_shader, g3d::HandleShader& fragment_shader) {
 
@@ -337,20 +802,35 @@ static void create_plane_shader_source_and_compile(g3d::HandleProgram program, g
         layout(std430, binding=0) buffer HeightField {
             float values[];
         };
-        uniform mat4 p;
-        uniform mat4 v;
+        struct Surface { vec4 color; uint function_index; uint offset; };
+        layout(std430, binding=1) readonly buffer Surfaces { Surface surfaces[]; };
+        layout(std140, binding=0) uniform FrameTransforms { mat4 v; mat4 p; };
+        layout(std430, binding=5) readonly buffer Mask { uint mask[]; };
+        layout(std430, binding=7) readonly buffer DerivedField { vec4 derived[]; };
         uniform float TIME;
         uniform float detail;
         uniform float size;
+        uniform uint show_mask;
+        uniform uint scalar_map;
 
         out vec3 vout_pos;
         out vec3 vout_norm;
+        out vec4 vout_mask_color;
+        out float vout_scalar;
+        flat out vec3 vout_color;
 
         void main() {
             uint gx = (gl_InstanceID) % uint(detail);
             uint gy = (gl_InstanceID) / uint(detail);
-            uint gidx = (gy+uint(in_pos.y)) * uint(detail+1) + (gx+uint(in_pos.x));
+            uint gidx = surfaces[gl_DrawID].offset + (gy+uint(in_pos.y)) * uint(detail+1) + (gx+uint(in_pos.x));
+            vout_color = surfaces[gl_DrawID].color.rgb;
             float height = values[gidx];
+            // finite, NaN, +Inf, -Inf, jump; non-finite vertices are pulled to y = 0 so their area stays visible
+            const vec4 mask_colors[5] = vec4[5](vec4(0.0), vec4(1.0, 0.0, 1.0, 1.0), vec4(1.0, 0.15, 0.1, 1.0), vec4(0.1, 0.3, 1.0, 1.0), vec4(1.0, 0.9, 0.0, 0.8));
+            uint vertex_class = show_mask != 0u ? mask[gidx] : 0u;
+            vout_mask_color = mask_colors[min(vertex_class, 4u)];
+            if (vertex_class >= 1u && vertex_class <= 3u) { height = 0.0; }
+            vout_scalar = scalar_map != 0u ? derived[gidx][scalar_map - 1u] : 0.0;
             vec2 vpos = in_pos * 0.5 + 0.5;
             vpos = vpos * (2.0*size / detail);
             vpos = vpos - size;
@@ -363,6 +843,7 @@ static void create_plane_shader_source_and_compile(g3d::HandleProgram program, g
             vec3 c = vec3(vpos.x, values[gidx+uint(detail+1.0)], vpos.y + (2.0*size)/detail);
 
             vout_norm = normalize(cross(c - a, b - a));
+            if (any(isnan(vout_norm)) || any(isinf(vout_norm))) { vout_norm = vec3(0.0, 1.0, 0.0); }
 
             gl_Position = p * v * vec4(vout_pos, 1.0);
         }
@@ -372,11 +853,32 @@ static void create_plane_shader_source_and_compile(g3d::HandleProgram program, g
             out vec4 FRAG_COLOR;
             in vec3 vout_pos;
             in vec3 vout_norm;
-            uniform vec3 user_color;
+            in vec4 vout_mask_color;
+            in float vout_scalar;
+            flat in vec3 vout_color;
+            uniform uint scalar_map;
+            uniform float curvature_range;
+
+            vec3 sequential(float t) { // dark blue to yellow through teal
+                t = clamp(t, 0.0, 1.0);
+                return mix(mix(vec3(0.27, 0.00, 0.33), vec3(0.13, 0.57, 0.55), smoothstep(0.0, 0.5, t)), vec3(0.99, 0.91, 0.14), smoothstep(0.5, 1.0, t));
+            }
+            vec3 diverging(float t) { // blue, white, red over [-1, 1]
+                t = clamp(t, -1.0, 1.0);
+                return t < 0.0 ? mix(vec3(0.97), vec3(0.23, 0.30, 0.75), -t) : mix(vec3(0.97), vec3(0.71, 0.02, 0.15), t);
+            }
+            vec3 cyclic(float angle) {
+                return 0.5 + 0.5 * cos(angle + vec3(0.0, 2.094, 4.189));
+            }
 
             void main() { 
                 float att = clamp(dot(vec3(0.0,1.0,0.0), vout_norm), 0.3, 1.0);
-                FRAG_COLOR = vec4(user_color * att, 1.0);
+                vec3 color = vout_color;
+                if (scalar_map == 1u)      { color = sequential(vout_scalar / 1.5707963); }
+                else if (scalar_map == 2u) { color = cyclic(vout_scalar); }
+                else if (scalar_map >= 3u) { color = diverging(vout_scalar / curvature_range); }
+                if (scalar_map != 0u && (isnan(vout_scalar) || isinf(vout_scalar))) { color = vec3(0.5); }
+                FRAG_COLOR = vec4(mix(color * att, vout_mask_color.rgb, vout_mask_color.a), 1.0);
             }
         
         )glsl";
@@ -403,8 +905,7 @@ static void create_grid_shader_source_and_compile(g3d::HandleProgram program, g3
     const char *vertex_source = R"glsl(
         #version 460 core
         layout(location=0) in vec3 pos;
-        uniform mat4 v;
-        uniform mat4 p;
+        layout(std140, binding=0) uniform FrameTransforms { mat4 v; mat4 p; };
         uniform float bounds;
 
         void main() {
@@ -429,29 +930,86 @@ static void create_grid_shader_source_and_compile(g3d::HandleProgram program, g3
 }
 
 static void create_compute_shader(g3d::HandleProgram program, g3d::HandleShader &compute_shader) {
-    glDetachShader(program, compute_shader);
-    glDeleteShader(compute_shader);
-
-    compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+    if (compute_shader != 0) {
+        glDetachShader(program, compute_shader);
+        glDeleteShader(compute_shader);
+        compute_shader = 0;
+    }
 
     std::string compute_source = R"glsl(
         #version 460 core
         layout(local_size_x=32, local_size_y=32, local_size_z=1) in;
         layout(std430, binding=0) buffer height_field { float values[]; };
+        struct Surface { vec4 color; uint function_index; uint offset; };
+        layout(std430, binding=1) readonly buffer Surfaces { Surface surfaces[]; };
+        layout(std430, binding=7) writeonly buffer DerivedField { vec4 derived[]; }; // slope, aspect, gaussian and mean curvature
+        layout(std430, binding=8) readonly buffer DataSources { float data_values[]; }; // every loaded data source's grid, back to back
         uniform float detail;
         uniform float bounds;
         uniform float TIME;
+        uniform uint write_derived;
+        // the workgroup's vertices plus a one vertex ring, so the stencil never leaves shared memory
+        shared float tile[34*34];
+        vec2 vertex_position(ivec2 v) { return vec2(v) / detail * 2.0*bounds - bounds; } // <-bounds, bounds> on the plane
+        // the same interpolation as g3d::sample_data(), so the CPU evaluator agrees with the plane
+        float data_texel(uint offset, ivec2 size, int i, int j) { return data_values[offset + uint(clamp(j, 0, size.y-1)*size.x + clamp(i, 0, size.x-1))]; }
+        vec4 catmull_rom(float t) { float t2 = t*t, t3 = t2*t; return 0.5*vec4(-t3 + 2.0*t2 - t, 3.0*t3 - 5.0*t2 + 2.0, -3.0*t3 + 4.0*t2 + t, t3 - t2); }
+        float sample_data(uint offset, ivec2 size, vec4 domain, bool is_bicubic, float x, float z) {
+            vec2 last = vec2(size - 1);
+            vec2 g = clamp((vec2(x, z) - domain.xz) / (domain.yw - domain.xz) * last, vec2(0.0), last);
+            ivec2 i = min(ivec2(g), max(size - 2, ivec2(0)));
+            vec2 t = g - vec2(i);
+            if (!is_bicubic) {
+                float top    = mix(data_texel(offset, size, i.x, i.y),   data_texel(offset, size, i.x+1, i.y),   t.x);
+                float bottom = mix(data_texel(offset, size, i.x, i.y+1), data_texel(offset, size, i.x+1, i.y+1), t.x);
+                return mix(top, bottom, t.y);
+            }
+            vec4 wx = catmull_rom(t.x), wz = catmull_rom(t.y);
+            float sum = 0.0;
+            for (int b = 0; b < 4; ++b) {
+                int j = i.y + b - 1;
+                sum += wz[b] * dot(wx, vec4(data_texel(offset, size, i.x-1, j), data_texel(offset, size, i.x, j),
+                                            data_texel(offset, size, i.x+1, j), data_texel(offset, size, i.x+2, j)));
+            }
+            return sum;
+        }
         void main() {
             uint vx_in_row = uint(detail)+1;
             uint gx = gl_GlobalInvocationID.x;
             uint gy = gl_GlobalInvocationID.y;
+            Surface surface = surfaces[gl_GlobalInvocationID.z];
+            if (write_derived == 0u) {
+                if (gx >= vx_in_row || gy >= vx_in_row) {return;}
+                vec2 pos = vertex_position(ivec2(gx, gy));
+                values[surface.offset + gy*vx_in_row + gx] = evaluate_surface(surface.function_index, pos.x, pos.y);
+                return;
+            }
+
+            ivec2 origin = ivec2(gl_WorkGroupID.xy) * 32 - 1;
+            for (uint i = gl_LocalInvocationIndex; i < 34u*34u; i += 32u*32u) {
+                vec2 pos = vertex_position(origin + ivec2(i % 34u, i / 34u));
+                tile[i] = evaluate_surface(surface.function_index, pos.x, pos.y);
+            }
+            barrier();
             if (gx >= vx_in_row || gy >= vx_in_row) {return;}
-            uint idx = gy*vx_in_row + gx;
-            vec2 pos = vec2(float(gx), float(gy));
-            pos = pos / detail;
-            pos = pos * 2.0*bounds - bounds; // <-bounds, bounds>
 
-            values[gy*vx_in_row + gx] = f(pos.x, pos.y);
+            uint t = (gl_LocalInvocationID.y + 1u) * 34u + gl_LocalInvocationID.x + 1u;
+            float h  = 2.0*bounds / detail;
+            float f  = tile[t];
+            float fx = (tile[t+1u] - tile[t-1u]) / (2.0*h);
+            float fz = (tile[t+34u] - tile[t-34u]) / (2.0*h);
+            float fxx = (tile[t+1u] - 2.0*f + tile[t-1u]) / (h*h);
+            float fzz = (tile[t+34u] - 2.0*f + tile[t-34u]) / (h*h);
+            float fxz = (tile[t+35u] - tile[t+33u] - tile[t-33u] + tile[t-35u]) / (4.0*h*h);
+            float w = 1.0 + fx*fx + fz*fz;
+
+            uint idx = surface.offset + gy*vx_in_row + gx;
+            values[idx] = f;
+            derived[idx] = vec4(
+                atan(sqrt(fx*fx + fz*fz)),                                       // slope angle
+                atan(-fz, -fx),                                                  // direction the surface faces downhill
+                (fxx*fzz - fxz*fxz) / (w*w),                                     // gaussian curvature
+                ((1.0 + fz*fz)*fxx - 2.0*fx*fz*fxz + (1.0 + fx*fx)*fzz) / (2.0*pow(w, 1.5))); // mean curvature
         }
     )glsl";
 
@@ -465,11 +1023,30 @@ static void create_compute_shader(g3d::HandleProgram program, g3d::HandleShader
     auto& constants = app_state.constants;
     auto& sliders   = app_state.sliders;
 
-    for (const auto &f : functions) {
+    // every function gets a case, so toggling which ones are surfaces never requires a recompilation
+    std::string surface_switch = "float evaluate_surface(uint i,float x,float z){switch(i){\n";
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const auto &f = functions[i];
         forward_declarations += "float " + f.name + "(float,float);\n";
-        function_definitions += "float " + f.name + "(float x,float z){return " + f.value + ";}\n"; }
+        function_definitions += "float " + f.name + "(float x,float z){return " + f.value + ";}\n";
+        surface_switch += "case " + std::to_string(i) + "u:return " + f.name + "(x,z);\n"; }
+    forward_declarations += "float evaluate_surface(uint,float,float);\n";
+    app_state.is_time_dependent = std::any_of(functions.begin(), functions.end(), [](const Function &f) { return f.value.find("TIME") != std::string::npos; });
+    function_definitions += surface_switch + "}return 0.0;}\n";
     for (const auto &c : constants) { consts += "const float " + c.name + "=" + std::to_string(c.value) + ";\n"; }
-    for (const auto &s : sliders) { uniforms += "uniform float " + s.name + ";\n"; } 
+    // offsets follow update_data_source_buffer(), which skips the sources that failed to load
+    const auto glsl_float = [](double v) { char digits[32]; return std::string(digits, std::to_chars(digits, digits + sizeof(digits), (float)v).ptr); };
+    uint64_t data_offset = 0;
+    for (const auto &d : app_state.data_sources) {
+        forward_declarations += "float " + d.name + "(float,float);\n";
+        if (d.grid == nullptr) { function_definitions += "float " + d.name + "(float x,float z){return 0.0;}\n"; continue; }
+        function_definitions += "float " + d.name + "(float x,float z){return sample_data(" + std::to_string(data_offset) + "u,ivec2(" +
+                                std::to_string(d.grid->width) + "," + std::to_string(d.grid->height) + "),vec4(" +
+                                glsl_float(d.domain.x) + "," + glsl_float(d.domain.y) + "," + glsl_float(d.domain.z) + "," + glsl_float(d.domain.w) + ")," +
+                                (d.sampling == g3d::DataSampling::Bicubic ? "true" : "false") + ",x,z);}\n";
+        data_offset += d.grid->values.size();
+    }
+    for (auto &s : sliders) { uniforms += "uniform float " + s.name + ";\n"; s.uniform = g3d::intern_uniform_name(s.name); }
 
     auto forward_dec_idx = 0u;
     for (auto new_line_count=0u; new_line_count != 4; ++forward_dec_idx) {
@@ -480,6 +1057,11 @@ static void create_compute_shader(g3d::HandleProgram program, g3d::HandleShader
 
     compute_source.insert(compute_source.begin() + forward_dec_idx, forward_declarations.begin(), forward_declarations.end());
     compute_source += function_definitions;
+
+    app_state.compute_program_key = g3d::program_cache_key(compute_source);
+    if (g3d::load_cached_program(program, app_state.compute_program_key)) { return; }
+
+    compute_shader = glCreateShader(GL_COMPUTE_SHADER);
     const auto *compute_cstr = compute_source.c_str();
     glShaderSource(compute_shader, 1, &compute_cstr, 0);
     glCompileShader(compute_shader);
@@ -507,22 +1089,100 @@ static void create_compute_shader(g3d::HandleProgram program, g3d::HandleShader
     }
 
     glAttachShader(program, compute_shader);
+    g3d::mark_program_retrievable(program);
     glLinkProgram(program);
+    g3d::store_cached_program(program, app_state.compute_program_key);
+}
+// Concatenates the loaded data sources in the order create_compute_shader() bakes their offsets,
+// uploading only when the set of grids changed.
+static void update_data_source_buffer(g3d::HandleBuffer buffer) {
+    static std::vector<std::shared_ptr<const g3d::DataGrid>> uploaded_grids; // kept alive, so a reused address cannot look unchanged
+    std::vector<std::shared_ptr<const g3d::DataGrid>> grids;
+    for (const auto &d : app_state.data_sources) { if (d.grid != nullptr) { grids.push_back(d.grid); } }
+    if (grids != uploaded_grids) {
+        size_t count = 0;
+        for (const auto &g : grids) { count += g->values.size(); }
+        glNamedBufferData(buffer, std::max<size_t>(count, 1) * sizeof(float), nullptr, GL_STATIC_DRAW);
+        size_t offset = 0;
+        for (const auto &g : grids) {
+            glNamedBufferSubData(buffer, offset * sizeof(float), g->values.size() * sizeof(float), g->values.data());
+            offset += g->values.size();
+        }
+        std::string digest;
+        for (const auto &g : grids) {
+            const uint64_t parts[] = {g->width, g->height, g3d::program_cache_key({(const char *)g->values.data(), g->values.size() * sizeof(float)})};
+            digest.append((const char *)parts, sizeof(parts));
+        }
+        app_state.data_sources_key = digest.empty() ? 0 : g3d::program_cache_key(digest); // no data is 0, as at startup
+        uploaded_grids = std::move(grids);
+        app_state.needs_height_field_update = true;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, buffer);
+}
+// What the height field depends on beyond the settings: the compute program and the data it samples
+static uint64_t height_field_key() {
+    return app_state.compute_program_key ^ (app_state.data_sources_key * 0x9e3779b97f4a7c15ull);
+}
+// Lays out every visible surface back to back in the height field and fills one
+// indirect draw per surface; gl_DrawID then selects the surface in the plane shader.
+static uint32_t update_surface_table(g3d::HandleBuffer surfaces_buffer, g3d::HandleBuffer indirect_buffer) {
+    struct SurfaceGpu {
+        glm::vec4 color;
+        uint32_t function_index, offset, _padding[2];
+    };
+    static std::vector<SurfaceGpu> surfaces, uploaded_surfaces;
+    static std::vector<g3d::DrawElementsIndirectCommand> draws, uploaded_draws;
+
+    const auto detail       = app_state.plane_settings.detail;
+    const auto vertex_count = (detail + 1) * (detail + 1);
+    surfaces.clear();
+    draws.clear();
+    for (uint32_t i = 0; i < app_state.functions.size(); ++i) {
+        const auto &f = app_state.functions[i];
+        if (f.is_surface == false) { continue; }
+
+        surfaces.push_back(SurfaceGpu{.color = f.color, .function_index = i, .offset = static_cast<uint32_t>(surfaces.size()) * vertex_count});
+        draws.push_back(g3d::DrawElementsIndirectCommand{.count = 6, .instance_count = detail * detail});
+    }
+
+    const auto is_same = [](const auto &a, const auto &b) {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+    };
+    if (surfaces.empty() == false && (is_same(surfaces, uploaded_surfaces) == false || is_same(draws, uploaded_draws) == false)) {
+        glNamedBufferData(surfaces_buffer, surfaces.size() * sizeof(SurfaceGpu), surfaces.data(), GL_DYNAMIC_DRAW);
+        glNamedBufferData(indirect_buffer, draws.size() * sizeof(g3d::DrawElementsIndirectCommand), draws.data(), GL_DYNAMIC_DRAW);
+        app_state.needs_height_field_update = true;
+        uploaded_surfaces = surfaces;
+        uploaded_draws    = draws;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, surfaces_buffer);
+    return static_cast<uint32_t>(surfaces.size());
 }
-static void recalculate_plane_height_field(g3d::HandleProgram program, g3d::HandleBuffer *height_buffer, uint32_t *current_size) {
-    const auto vertex_count = (unsigned)glm::pow(app_state.plane_settings.detail+1, 2);
+static void recalculate_plane_height_field(g3d::HandleProgram program, g3d::HandleBuffer *height_buffer, uint32_t *current_size,
+                                           g3d::HandleBuffer *derived_buffer, uint32_t *current_derived_size, uint32_t surface_count) {
+    const auto vertex_count = (unsigned)glm::pow(app_state.plane_settings.detail+1, 2) * surface_count;
     if(vertex_count > *current_size) {
         *current_size = vertex_count; 
         glDeleteBuffers(1, height_buffer);
         glCreateBuffers(1, height_buffer);
-        glNamedBufferStorage(*height_buffer, vertex_count * sizeof(float), 0, GL_MAP_READ_BIT);
+        glNamedBufferStorage(*height_buffer, vertex_count * sizeof(float), 0, GL_MAP_READ_BIT | GL_DYNAMIC_STORAGE_BIT);
+    }
+    // the derived field is only allocated once a scalar map asks for it
+    const bool is_derived_written = app_state.scalar_map_settings.map != AppState::ScalarMap::Shading;
+    if(is_derived_written && vertex_count > *current_derived_size) {
+        *current_derived_size = vertex_count;
+        glDeleteBuffers(1, derived_buffer);
+        glCreateBuffers(1, derived_buffer);
+        glNamedBufferStorage(*derived_buffer, vertex_count * sizeof(glm::vec4), 0, 0);
     }
+    if(surface_count == 0) { return; }
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, *height_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, *derived_buffer);
     //glUseProgram(program);
     const float compute_num = (float)(app_state.plane_settings.detail+1) / 32.0f;
     const uint32_t compute_num_uint = glm::ceil(compute_num);
-    glDispatchCompute(compute_num_uint, compute_num_uint, 1);
+    glDispatchCompute(compute_num_uint, compute_num_uint, surface_count);
 }
 
 static void draw_menu_bar();
@@ -543,7 +1203,42 @@ static void draw_gui() {
     ImGui::End();
     ImGui::PopStyleVar();
 }
+static void request_redraw() {
+    // ImGui needs a couple of frames to settle hover and popup state after an event
+    app_state.pending_redraw_frames = std::max(app_state.pending_redraw_frames, 3u);
+}
+// Blocks until the next frame is due. A static scene sleeps until input arrives,
+// an animated one is paced to the configured frame rate.
+static void wait_for_next_frame() {
+    static double last_frame_time = 0.0;
+    const auto &rs = app_state.render_settings;
+    auto *pwindow  = app_state.window.pglfw_window;
+
+    const bool is_animating = app_state.is_time_dependent || app_state.needs_recompilation
+                              || app_state.camera.has_moved() || app_state.window.has_just_resized;
+    if (is_animating || rs.is_render_on_demand == false) { request_redraw(); }
+    if (is_animating) { app_state.is_full_resolution_held = false; }
+
+    // the frame left on screen while idle is redrawn at full resolution, the scale adapts again once the scene moves
+    if (app_state.pending_redraw_frames == 0 && app_state.resolution_scale < 1.0f) {
+        app_state.resolution_scale        = 1.0f;
+        app_state.is_full_resolution_held = true;
+        request_redraw();
+    }
+    if (app_state.pending_redraw_frames == 0) {
+        glfwWaitEventsTimeout(0.5);
+        return;
+    }
+
+    const bool is_focused   = glfwGetWindowAttrib(pwindow, GLFW_FOCUSED) == GLFW_TRUE;
+    const float target_fps  = glm::max(is_focused ? rs.target_fps : rs.unfocused_target_fps, 1.0f);
+    const double deadline   = last_frame_time + 1.0 / target_fps;
+    for (double now = glfwGetTime(); now < deadline; now = glfwGetTime()) { glfwWaitEventsTimeout(deadline - now); }
+    glfwPollEvents();
+    last_frame_time = glfwGetTime();
+}
 static void on_window_resize(GLFWwindow*, int width, int height) {
+    request_redraw();
     app_state.window.has_just_resized = true;
     app_state.window.width  = static_cast<uint32_t>(width);
     app_state.window.height = static_cast<uint32_t>(height);
@@ -560,15 +1255,22 @@ static void draw_menu_bar() {
             }
             if (ImGui::Button("Open project")) {
                 nfdchar_t *outPath = NULL;
-                nfdresult_t result = NFD_OpenDialog("3dg", std::filesystem::current_path().string().c_str(), &outPath);
+                nfdresult_t result = NFD_OpenDialog("3dg,3dgb", std::filesystem::current_path().string().c_str(), &outPath);
                 if (result == NFD_OKAY) {
-                    load_project(outPath);
-                    file_name = outPath;
-                    file_name = file_name.substr(file_name.rfind('\\')+1, file_name.rfind('.') - file_name.rfind('\\')-1);
-                    app_state.needs_recompilation = true;
+                    try {
+                        load_project(outPath);
+                        app_state.project_path = outPath;
+                        watch_project();
+                        file_name = outPath;
+                        file_name = file_name.substr(file_name.rfind('\\')+1, file_name.rfind('.') - file_name.rfind('\\')-1);
+                        app_state.needs_recompilation = true;
+                    } catch(const std::exception &err) {
+                        log_list_add_message(err.what());
+                    }
                 }
             }
         
+            if (ImGui::Checkbox("Reload when the file changes", &app_state.is_project_watched)) { watch_project(); }
             if (ImGui::Button("Save project")) { 
                 ImGui::OpenPopup("save_project_popup");
             }
@@ -576,6 +1278,9 @@ static void draw_menu_bar() {
                 ImGui::Text("Filename:"); ImGui::SameLine();
                 ImGui::PushItemWidth(160.0f);
                 ImGui::InputText("##Filename", &file_name);
+                static bool is_binary = false;
+                ImGui::Checkbox("Binary (.3dgb)", &is_binary);
+                if (is_binary) { ImGui::SameLine(); ImGui::Checkbox("Embed height field", &app_state.is_snapshot_embedded); }
                 const auto spacex = ImGui::GetContentRegionAvail().x;
                 ImGui::Indent(spacex - 100.0f);
                 if(ImGui::Button("Save", ImVec2(100.0f, 0.0f))) {
@@ -583,10 +1288,17 @@ static void draw_menu_bar() {
 
                    if (no_name_error == false || file_name.empty() == false) {
                         no_name_error = false;
-                        std::string file_name_with_ext = file_name + ".3dg";
+                        std::string file_name_with_ext = file_name + (is_binary ? ".3dgb" : ".3dg");
                         
-                        save_project(file_name_with_ext.c_str()); 
-                        log_list_add_message("Project successfully saved");
+                        try {
+                            save_project(file_name_with_ext.c_str()); 
+                            // the saved file is the project now; watching it afresh also skips our own write
+                            app_state.project_path = std::filesystem::absolute(file_name_with_ext).string();
+                            watch_project();
+                            log_list_add_message("Project successfully saved");
+                        } catch(const std::exception &err) {
+                            log_list_add_message(err.what());
+                        }
                         ImGui::CloseCurrentPopup();
                    }
                 }
@@ -603,6 +1315,9 @@ static void draw_menu_bar() {
                 ImGui::Text("Filename:"); ImGui::SameLine();
                 ImGui::PushItemWidth(160.0f);
                 ImGui::InputText("##Filename", &file_name);
+                static const char *bad_vertex_names[] = {"Keep", "Drop their triangles", "Patch from neighbours"};
+                ImGui::Text("NaN/Inf:"); ImGui::SameLine();
+                ImGui::Combo("##BadVertices", (int*)&app_state.export_bad_vertices, bad_vertex_names, IM_ARRAYSIZE(bad_vertex_names));
                 const auto spacex = ImGui::GetContentRegionAvail().x;
                 ImGui::Indent(spacex - 100.0f);
                 if(ImGui::Button("Export", ImVec2(100.0f, 0.0f))) {
@@ -610,17 +1325,90 @@ static void draw_menu_bar() {
 
                    if (no_name_error == false || file_name.empty() == false) {
                         no_name_error = false;
-                        std::string file_name_with_ext = file_name + ".obj";
-                        TCHAR path[MAX_PATH];
-                        HRESULT hr = SHGetFolderPath(NULL, CSIDL_MYDOCUMENTS    , NULL, SHGFP_TYPE_CURRENT, path);
-                        if (FAILED(hr)) { assert(false); }
-
-                        std::filesystem::path _p = std::string(path) + '\\' + file_name_with_ext;
-                        log_list_add_message(std::string{"File successfully exported at: \'"} + _p.string().c_str() + '\'');
-                        export_to_obj(_p.string(), *app_state.heights_buffer); 
+                        const auto path = documents_path(file_name + ".obj");
+                        log_list_add_message("File successfully exported at: '" + path + '\'');
+                        export_to_obj(path, *app_state.heights_buffer); 
                         ImGui::CloseCurrentPopup();
                    }
                 }
+                // every surface, losslessly compressed
+                if(ImGui::Button("Export .hfz", ImVec2(100.0f, 0.0f)) && file_name.empty() == false) {
+                    const auto detail = app_state.plane_settings.detail;
+                    const auto surface_count = (uint32_t)std::count_if(app_state.functions.begin(), app_state.functions.end(), [](const Function &f) { return f.is_surface; });
+                    std::vector<float> heights((size_t)(detail + 1) * (detail + 1) * surface_count);
+                    glGetNamedBufferSubData(*app_state.heights_buffer, 0, heights.size() * sizeof(float), heights.data());
+                    try {
+                        const auto path = documents_path(file_name + ".hfz");
+                        g3d::export_height_field_hfz(path, heights.data(), detail, surface_count, (float)app_state.plane_settings.bounds);
+                        log_list_add_message("File successfully exported at: '" + path + '\'');
+                    } catch(const std::exception &err) {
+                        log_list_add_message(err.what());
+                    }
+                    ImGui::CloseCurrentPopup();
+                }
+
+                ImGui::Unindent(spacex - 100.0f);
+                ImGui::Separator();
+
+                // one surface as an image for terrain and GIS tools
+                auto &heightmap = app_state.heightmap_export;
+                std::vector<const char*> surface_names;
+                for (const auto &f : app_state.functions) { if (f.is_surface) { surface_names.push_back(f.name.c_str()); } }
+                heightmap.surface = std::clamp(heightmap.surface, 0, std::max((int)surface_names.size() - 1, 0));
+                static const char *heightmap_format_names[] = {"16-bit PNG", "Raw float32 (.r32)", "Half float (.hfh)"};
+                ImGui::Text("Heightmap:"); ImGui::SameLine();
+                ImGui::Combo("##HeightmapSurface", &heightmap.surface, surface_names.data(), (int)surface_names.size());
+                ImGui::Text("Format:"); ImGui::SameLine();
+                ImGui::Combo("##HeightmapFormat", (int*)&heightmap.format, heightmap_format_names, IM_ARRAYSIZE(heightmap_format_names));
+                ImGui::Text("Size:"); ImGui::SameLine();
+                ImGui::InputScalar("##HeightmapSize", ImGuiDataType_U32, &heightmap.resolution);
+                heightmap.resolution = std::min(heightmap.resolution, 16384u);
+                if (ImGui::IsItemHovered()) { ImGui::SetTooltip("0 exports the plane's grid, any other size evaluates the surface on the CPU"); }
+                if(ImGui::Button("Export heightmap") && file_name.empty() == false && surface_names.empty() == false) {
+                    try {
+                        const auto detail = app_state.plane_settings.detail;
+                        const auto size   = heightmap.resolution == 0 ? detail + 1 : std::max(heightmap.resolution, 2u);
+                        std::vector<float> heights((size_t)size * size);
+                        if (heightmap.resolution == 0) {
+                            const auto layer_size = (size_t)(detail + 1) * (detail + 1);
+                            glGetNamedBufferSubData(*app_state.heights_buffer, heightmap.surface * layer_size * sizeof(float), layer_size * sizeof(float), heights.data());
+                        } else {
+                            g3d::evaluate_height_frame({compile_cpu_function(surface_names[heightmap.surface])}, g3d::make_parameters(app_state.sliders, glfwGetTime()),
+                                                       glfwGetTime(), size - 1, app_state.plane_settings.bounds, heights.data());
+                        }
+                        static const char *extensions[] = {".png", ".r32", ".hfh"};
+                        const auto path = documents_path(file_name + extensions[(uint32_t)heightmap.format]);
+                        g3d::export_heightmap(path, heights.data(), size, size, (float)app_state.plane_settings.bounds, heightmap.format);
+                        log_list_add_message("Heightmap (" + std::to_string(size) + "x" + std::to_string(size) + ") exported at: '" + path + '\'');
+                    } catch(const std::exception &err) {
+                        log_list_add_message(err.what());
+                    }
+                }
+                ImGui::Separator();
+
+                // TIME-dependent surfaces: every frame of a range, one grid and delta-coded heights
+                auto &sequence = app_state.sequence_settings;
+                ImGui::Text("Frames:"); ImGui::SameLine();
+                ImGui::InputScalar("##SequenceFrames", ImGuiDataType_U32, &sequence.frame_count);
+                sequence.frame_count = std::clamp(sequence.frame_count, 1u, 10000u);
+                ImGui::Text("TIME:"); ImGui::SameLine();
+                ImGui::PushItemWidth(76.0f);
+                ImGui::InputDouble("##SequenceT0", &sequence.t0, 0.0, 0.0, "%.3f"); ImGui::SameLine();
+                ImGui::InputDouble("##SequenceT1", &sequence.t1, 0.0, 0.0, "%.3f");
+                ImGui::PopItemWidth();
+                ImGui::Checkbox("Also glTF morph targets", &sequence.is_gltf_written);
+                if (app_state.sequence_export_job.is_running()) {
+                    ImGui::ProgressBar(app_state.sequence_export_job.progress(), ImVec2(-1.0f, 0.0f));
+                } else if(ImGui::Button("Export sequence") && file_name.empty() == false) {
+                    try {
+                        std::vector<g3d::Program> programs;
+                        for (const auto &f : app_state.functions) { if (f.is_surface) { programs.push_back(compile_cpu_function(f.name)); } }
+                        app_state.sequence_export_job.start(documents_path(file_name), std::move(programs), g3d::make_parameters(app_state.sliders, glfwGetTime()),
+                                                            app_state.plane_settings.detail, app_state.plane_settings.bounds, sequence);
+                    } catch(const std::exception &err) {
+                        log_list_add_message(err.what());
+                    }
+                }
 
                 ImGui::PopItemWidth();
             ImGui::SetCursorPosX(10.0f);
@@ -646,7 +1434,10 @@ static void draw_left_child() {
 
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0,0));
         if (ImGui::BeginChild("canvas", canvas_size, true)) {
-            const auto handle = app_state.framebuffer_main.textures[0].second->handle;
+            const auto &present    = app_state.framebuffer_present;
+            const auto *texture    = present.textures[0].second;
+            const auto handle      = texture->handle;
+            const ImVec2 uv_max{(float)present.width / (float)texture->width, (float)present.height / (float)texture->height};
             const auto image_size  = ImGui::GetContentRegionAvail();
 
             auto _pos = ImGui::GetCursorPos();
@@ -660,7 +1451,7 @@ static void draw_left_child() {
             }
 
             ImGui::SetCursorPos(_pos);
-            ImGui::Image((void *)(handle), image_size);
+            ImGui::Image((void *)(handle), image_size, ImVec2(0, 0), uv_max);
         }
         ImGui::EndChild();
         ImGui::PopStyleVar();
@@ -702,17 +1493,23 @@ static void draw_left_child() {
     }   
 }
 
-enum class SelectedTab { Functions, Constants, Sliders, Settings };
-static const char *SelectedTabNames[] { "Functions", "Constants", "Sliders", "Settings" };
+enum class SelectedTab { Functions, Constants, Sliders, Settings, Statistics, Analysis, Plot2D, Data };
+static const char *SelectedTabNames[] { "Functions", "Constants", "Sliders", "Settings", "Statistics", "Analysis", "2D", "Data" };
                
 static void draw_user_variables_table(SelectedTab tab);
+static void draw_statistics_tab();
+static void draw_analysis_tab();
+static void draw_2d_tab();
+static void draw_data_sources_tab();
+static void draw_parameter_sweep();
+static void draw_slider_fit();
 static void draw_right_child() {
     static int selected_tab_idx = 0;
 
     ImGui::SetCursorPosX(ImGui::GetCursorPosX());
     if(ImGui::BeginChild("right split", ImGui::GetContentRegionAvail(), false)) {
         if(ImGui::BeginTabBar("right split tabs")) {
-            for(int i=0; i < 4; ++i) {
+            for(int i=0; i < IM_ARRAYSIZE(SelectedTabNames); ++i) {
                 const char *name = SelectedTabNames[i];
                 const int is_tab_selected = selected_tab_idx == i;
                 if(is_tab_selected) { ImGui::PushStyleColor(ImGuiCol_Tab, ImGui::GetStyle().Colors[ImGuiCol_TabActive]); }
@@ -748,17 +1545,34 @@ static void draw_right_child() {
             case 3: {
                 if (ImGui::CollapsingHeader("Color Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
                     ImGui::ColorEdit3("Background color", &app_state.color_settings.color_background.x);
-                    ImGui::ColorEdit3("Plane color", &app_state.color_settings.color_plane.x);
                     ImGui::ColorEdit3("Grid color", &app_state.color_settings.color_grid.x);
+                    ImGui::ColorEdit3("Isoline color", &app_state.color_settings.color_contours.x);
                 }
                 if (ImGui::CollapsingHeader("Plane Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
                     ImGui::PushItemWidth(150.0);
-                    ImGui::SliderInt("Plane bounds", (int*)&app_state.plane_settings.bounds, 1, 100);
-                    ImGui::SliderInt("Plane detail level", (int*)&app_state.plane_settings.detail, 1, 1000);
+                    if (ImGui::SliderInt("Plane bounds", (int*)&app_state.plane_settings.bounds, 1, g3d::PROJECT_MAX_BOUNDS, "%d", ImGuiSliderFlags_AlwaysClamp))           { app_state.needs_height_field_update = true; }
+                    if (ImGui::SliderInt("Plane detail level", (int*)&app_state.plane_settings.detail, 1, g3d::PROJECT_MAX_DETAIL, "%d", ImGuiSliderFlags_AlwaysClamp))    { app_state.needs_height_field_update = true; }
+                    static const char *scalar_map_names[] = {"Shading", "Slope", "Aspect", "Gaussian curvature", "Mean curvature"};
+                    auto &maps = app_state.scalar_map_settings;
+                    if (ImGui::Combo("Color by", (int*)&maps.map, scalar_map_names, IM_ARRAYSIZE(scalar_map_names)))  { app_state.needs_height_field_update = true; }
+                    if (maps.map == AppState::ScalarMap::GaussianCurvature || maps.map == AppState::ScalarMap::MeanCurvature) {
+                        ImGui::DragFloat("Curvature range", &maps.curvature_range, 0.01f, 1e-4f, 1e4f, "%.4g", ImGuiSliderFlags_Logarithmic);
+                    }
                     ImGui::PopItemWidth();
                 }
                 if(ImGui::CollapsingHeader("Rendering Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
                    ImGui::Checkbox("Grid drawing", &app_state.render_settings.is_grid_rendered);
+                   ImGui::Checkbox("Render on demand", &app_state.render_settings.is_render_on_demand);
+                   ImGui::PushItemWidth(150.0);
+                   ImGui::SliderFloat("Frame rate limit", &app_state.render_settings.target_fps, 10.0f, 240.0f, "%.0f");
+                   ImGui::SliderFloat("Background frame rate limit", &app_state.render_settings.unfocused_target_fps, 1.0f, 60.0f, "%.0f");
+                   ImGui::PopItemWidth();
+                   ImGui::Checkbox("Dynamic resolution", &app_state.render_settings.is_dynamic_resolution);
+                   ImGui::PushItemWidth(150.0);
+                   ImGui::SliderFloat("GPU frame budget (ms)", &app_state.render_settings.gpu_frame_budget_ms, 1.0f, 33.0f, "%.1f");
+                   ImGui::SliderFloat("Minimum resolution scale", &app_state.render_settings.min_resolution_scale, 0.25f, 1.0f, "%.2f");
+                   ImGui::PopItemWidth();
+                   ImGui::Text("Scene: %.2f ms at %.0f%% resolution", app_state.scene_gpu_ms, app_state.resolution_scale * 100.0f);
                 }
                 if(ImGui::CollapsingHeader("Editor Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
                         static const char* font_size_names[] = {"Small", "Normal", "Large", "Extra Large"};
@@ -773,11 +1587,581 @@ static void draw_right_child() {
                 }
                 break; 
             }
+            case 4: {
+                draw_statistics_tab();
+                break;
+            }
+            case 5: {
+                draw_analysis_tab();
+                break;
+            }
+            case 6: {
+                draw_2d_tab();
+                break;
+            }
+            case 7: {
+                draw_data_sources_tab();
+                break;
+            }
         }
 
     }
     ImGui::EndChild();   
 }
+static void draw_statistics_tab() {
+    const auto &stats = app_state.stats;
+
+    std::vector<const char*> surface_names;
+    for(const auto &f : app_state.functions) { if(f.is_surface) { surface_names.push_back(f.name.c_str()); } }
+    if(surface_names.empty()) { ImGui::Text("No function is drawn as a surface."); return; }
+
+    ImGui::PushItemWidth(150.0);
+    int surface_idx = (int)std::min<size_t>(app_state.stats_surface, surface_names.size() - 1);
+    if(ImGui::Combo("Surface", &surface_idx, surface_names.data(), (int)surface_names.size())) {
+        app_state.stats_surface  = surface_idx;
+        app_state.stats_revision = 0; // refresh for the newly selected surface
+    }
+    ImGui::PopItemWidth();
+
+    const auto vertex_count = (app_state.plane_settings.detail + 1) * (app_state.plane_settings.detail + 1);
+    ImGui::Text("Finite values: %u / %u", stats.finite_count, vertex_count);
+    ImGui::Text("Min:      %.6g", stats.min);
+    ImGui::Text("Max:      %.6g", stats.max);
+    ImGui::Text("Mean:     %.6g", stats.mean);
+    ImGui::Text("Variance: %.6g (std. dev. %.6g)", stats.variance, glm::sqrt(stats.variance));
+
+    static double bin_centers[g3d::HeightFieldStats::HISTOGRAM_BINS], bin_counts[g3d::HeightFieldStats::HISTOGRAM_BINS];
+    const double bin_width = glm::max((double)stats.max - (double)stats.min, 1e-6) / g3d::HeightFieldStats::HISTOGRAM_BINS;
+    for(uint32_t i = 0; i < g3d::HeightFieldStats::HISTOGRAM_BINS; ++i) {
+        bin_centers[i] = stats.min + (i + 0.5) * bin_width;
+        bin_counts[i]  = stats.histogram[i];
+    }
+    if(ImPlot::BeginPlot("Height histogram", ImVec2(-1, ImGui::GetContentRegionAvail().y))) {
+        ImPlot::SetupAxes("height", "vertices", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        ImPlot::PlotBars("##bins", bin_centers, bin_counts, g3d::HeightFieldStats::HISTOGRAM_BINS, bin_width);
+        ImPlot::EndPlot();
+    }
+}
+static std::string documents_path(const std::string &file_name) {
+    TCHAR path[MAX_PATH];
+    HRESULT hr = SHGetFolderPath(NULL, CSIDL_MYDOCUMENTS, NULL, SHGFP_TYPE_CURRENT, path);
+    if (FAILED(hr)) { assert(false); }
+    return std::string(path) + '\\' + file_name;
+}
+static void draw_data_sources_tab() {
+    auto &sources = app_state.data_sources;
+    const auto is_name_taken = [&](const std::string &name, size_t self) {
+        for(size_t i = 0; i < sources.size(); ++i) { if(i != self && sources[i].name == name) { return true; } }
+        return std::any_of(app_state.functions.begin(), app_state.functions.end(), [&](const Function &f) { return f.name == name; }) ||
+               std::any_of(app_state.constants.begin(), app_state.constants.end(), [&](const Constant &c) { return c.name == name; }) ||
+               std::any_of(app_state.sliders.begin(), app_state.sliders.end(), [&](const Slider &s) { return s.name == name; });
+    };
+    // the first dataN nobody uses, removed sources leave gaps in the numbering
+    const auto free_name = [&] {
+        for(size_t n = 1;; ++n) { if(auto name = "data" + std::to_string(n); is_name_taken(name, sources.size()) == false) { return name; } }
+    };
+    if(ImGui::Button("Import data")) {
+        nfdchar_t *out_path = NULL;
+        if(NFD_OpenDialog("png,jpg,bmp,tga,hdr,pgm,csv,txt,tsv,r32", std::filesystem::current_path().string().c_str(), &out_path) == NFD_OKAY) {
+            try {
+                const auto b = (float)app_state.plane_settings.bounds;
+                DataSource source{.name = free_name(), .path = out_path, .domain = {-b, b, -b, b}};
+                source.grid = std::make_shared<const g3d::DataGrid>(g3d::load_data_grid(out_path));
+                sources.push_back(std::move(source));
+                app_state.needs_recompilation = true;
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+            free(out_path);
+        }
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("Import points")) {
+        nfdchar_t *out_path = NULL;
+        if(NFD_OpenDialog("txt,csv,xyz", std::filesystem::current_path().string().c_str(), &out_path) == NFD_OKAY) {
+            try {
+                DataSource source{.name = free_name(), .path = out_path, .is_scattered = true};
+                source.points = std::make_shared<const g3d::ScatteredData>(g3d::build_scattered_data(g3d::load_data_points(out_path)));
+                sources.push_back(std::move(source));
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+            free(out_path);
+        }
+    }
+    ImGui::TextWrapped("Equations sample a data source as name(x, z). Images are read as luminance in [0, 1], tables as one row per line, "
+                       "points as \"x z y\" lines, which are interpolated over the plane.");
+
+    static std::string name_before_edit;
+    int removed = -1;
+    for(size_t i = 0; i < sources.size(); ++i) {
+        auto &d = sources[i];
+        ImGui::PushID((int)i);
+        ImGui::Separator();
+        ImGui::PushItemWidth(150.0);
+        ImGui::InputText("Name", &d.name);
+        if(ImGui::IsItemActivated()) { name_before_edit = d.name; }
+        if(ImGui::IsItemDeactivatedAfterEdit()) {
+            const auto is_identifier = d.name.empty() == false && std::isdigit((unsigned char)d.name[0]) == false &&
+                                       std::all_of(d.name.begin(), d.name.end(), [](char c) { return std::isalnum((unsigned char)c) || c == '_'; });
+            if(is_identifier == false || is_name_taken(d.name, i)) {
+                log_list_add_message("'" + d.name + "' is not a free identifier, keeping '" + name_before_edit + "'");
+                d.name = name_before_edit;
+            } else {
+                app_state.needs_recompilation = true;
+            }
+        }
+        static const char *sampling_names[] = {"Bilinear", "Bicubic"};
+        if(ImGui::Combo("Sampling", (int*)&d.sampling, sampling_names, IM_ARRAYSIZE(sampling_names))) { app_state.needs_recompilation = true; }
+        if(d.is_scattered) {
+            // settings only restart the resampling, the finished grid triggers the recompilation
+            auto &ss = d.scattered_settings;
+            static const char *interpolation_names[] = {"Inverse distance", "Natural neighbour", "Radial basis"};
+            ImGui::Combo("Interpolation", (int*)&ss.interpolation, interpolation_names, IM_ARRAYSIZE(interpolation_names));
+            if(ss.interpolation != g3d::ScatteredInterpolation::NaturalNeighbour) { ImGui::SliderInt("Neighbours", (int*)&ss.neighbours, 1, 64); }
+            if(ss.interpolation == g3d::ScatteredInterpolation::InverseDistance) { ImGui::SliderFloat("Power", &ss.power, 0.5f, 8.0f, "%.2f"); }
+        } else {
+            // an empty range would divide by zero in the lookup
+            if(ImGui::DragFloatRange2("x range", &d.domain.x, &d.domain.y, 0.01f, -1e6f, 1e6f) && d.domain.y <= d.domain.x) { d.domain.y = d.domain.x + 1e-3f; }
+            if(ImGui::IsItemDeactivatedAfterEdit()) { app_state.needs_recompilation = true; }
+            if(ImGui::DragFloatRange2("z range", &d.domain.z, &d.domain.w, 0.01f, -1e6f, 1e6f) && d.domain.w <= d.domain.z) { d.domain.w = d.domain.z + 1e-3f; }
+            if(ImGui::IsItemDeactivatedAfterEdit()) { app_state.needs_recompilation = true; }
+        }
+        ImGui::PopItemWidth();
+        ImGui::Checkbox("Store the values in binary projects", &d.is_embedded);
+        if(d.is_scattered && d.points != nullptr) {
+            const auto &p = *d.points;
+            ImGui::Text("%zu points over x [%.4g, %.4g], z [%.4g, %.4g]", p.points.size(), p.x_min, p.x_max, p.z_min, p.z_max);
+        }
+        if(d.grid != nullptr)                        { ImGui::Text(d.is_scattered ? "Resampled to %u x %u" : "%u x %u samples", d.grid->width, d.grid->height); }
+        else if(d.is_scattered && d.points != nullptr) { ImGui::Text("Resampling..."); }
+        else                                         { ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.4f, 1.0f), "Not loaded, samples as 0"); }
+        ImGui::TextWrapped("%s", d.path.c_str());
+        if(d.path.empty() == false && ImGui::Button("Reload")) {
+            try {
+                if(d.is_scattered) {
+                    // the new points are resampled before they replace the current grid
+                    d.points     = std::make_shared<const g3d::ScatteredData>(g3d::build_scattered_data(g3d::load_data_points(d.path)));
+                    d.resampling = {};
+                } else {
+                    d.grid = std::make_shared<const g3d::DataGrid>(g3d::load_data_grid(d.path));
+                    app_state.needs_recompilation = true;
+                }
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+        }
+        if(d.path.empty() == false) { ImGui::SameLine(); }
+        if(ImGui::Button("Remove")) { removed = (int)i; }
+        ImGui::PopID();
+    }
+    if(removed >= 0) {
+        sources.erase(sources.begin() + removed);
+        app_state.needs_recompilation = true;
+    }
+}
+static g3d::Program compile_cpu_function(const std::string &name) {
+    return g3d::compile_program(name, app_state.functions, app_state.constants, app_state.sliders, app_state.data_sources);
+}
+static void draw_slider_fit() {
+    auto &analysis = app_state.analysis;
+    auto &selected = analysis.fit_sliders;
+
+    if(ImGui::Button("Load points")) {
+        nfdchar_t *out_path = NULL;
+        if(NFD_OpenDialog("txt,csv,xyz", std::filesystem::current_path().string().c_str(), &out_path) == NFD_OKAY) {
+            try {
+                analysis.fit_points      = g3d::load_data_points(out_path);
+                analysis.fit_points_file = out_path;
+                analysis.has_fit_result  = false;
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+            free(out_path);
+        }
+    }
+    ImGui::SameLine();
+    if(analysis.fit_points.empty()) { ImGui::TextDisabled("one \"x z y\" point per line"); return; }
+    ImGui::Text("%zu points from %s", analysis.fit_points.size(), std::filesystem::path(analysis.fit_points_file).filename().string().c_str());
+
+    if(app_state.sliders.empty()) { ImGui::Text("Add sliders to use them as free parameters."); return; }
+    for(const auto &slider : app_state.sliders) {
+        bool is_selected = std::find(selected.begin(), selected.end(), slider.name) != selected.end();
+        ImGui::BeginDisabled(is_selected == false && selected.size() >= g3d::FitSettings::MAX_PARAMETERS);
+        if(ImGui::Checkbox(("##fit_" + slider.name).c_str(), &is_selected)) {
+            if(is_selected) { selected.push_back(slider.name); }
+            else            { selected.erase(std::find(selected.begin(), selected.end(), slider.name)); }
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::Text("%s = %g", slider.name.c_str(), slider.value);
+    }
+    ImGui::PushItemWidth(150.0);
+    ImGui::SliderInt("Max iterations", (int*)&analysis.fit_settings.max_iterations, 1, 1000);
+    ImGui::PopItemWidth();
+
+    if(ImGui::Button("Fit")) {
+        try {
+            std::vector<uint32_t> free_parameters;
+            std::vector<Slider*> free_sliders;
+            for(auto &slider : app_state.sliders) {
+                if(std::find(selected.begin(), selected.end(), slider.name) == selected.end()) { continue; }
+                free_parameters.push_back(g3d::Program::PARAMETER_TIME + 1 + (uint32_t)(&slider - app_state.sliders.data()));
+                free_sliders.push_back(&slider);
+            }
+            analysis.fit_result = g3d::fit_parameters(compile_cpu_function("f"), g3d::make_parameters(app_state.sliders, glfwGetTime()),
+                                                      free_parameters, analysis.fit_points, analysis.fit_settings);
+            analysis.has_fit_result = true;
+            // write the solution back, widening the slider ranges where it falls outside them
+            for(size_t i = 0; i < free_sliders.size(); ++i) {
+                auto &slider = *free_sliders[i];
+                slider.value = (float)analysis.fit_result.values[i];
+                slider.min   = glm::min(slider.min, slider.value);
+                slider.max   = glm::max(slider.max, slider.value);
+            }
+            app_state.needs_height_field_update = true;
+        } catch(const std::exception &err) {
+            log_list_add_message(err.what());
+        }
+    }
+    if(analysis.has_fit_result) {
+        const auto &r = analysis.fit_result;
+        const auto *status = r.has_converged ? "" : r.has_stalled ? " (stalled, no step lowers the residual)" : " (not converged)";
+        ImGui::Text("RMS residual: %.6g -> %.6g after %u iterations%s", r.initial_rms, r.rms, r.iterations, status);
+    }
+}
+static void draw_parameter_sweep() {
+    auto &sweep_job = app_state.sweep_job;
+    static std::vector<std::string> pending_axis_names; // of the running sweep
+    auto &analysis = app_state.analysis;
+    auto &settings = analysis.sweep_settings;
+    auto &selected = analysis.sweep_sliders;
+
+    if(app_state.sliders.empty()) { ImGui::Text("Add sliders to sweep over their ranges."); return; }
+    // renamed and removed sliders drop out of the selection
+    std::erase_if(selected, [](const std::string &name) {
+        return std::none_of(app_state.sliders.begin(), app_state.sliders.end(), [&](const Slider &s) { return s.name == name; });
+    });
+    for(const auto &slider : app_state.sliders) {
+        bool is_selected = std::find(selected.begin(), selected.end(), slider.name) != selected.end();
+        if(ImGui::Checkbox(slider.name.c_str(), &is_selected)) {
+            if(is_selected) { selected.push_back(slider.name); }
+            else            { selected.erase(std::find(selected.begin(), selected.end(), slider.name)); }
+        }
+        ImGui::SameLine();
+        ImGui::TextDisabled("[%g, %g]", slider.min, slider.max);
+    }
+    static const char *metric_names[] = {"Integral of f", "Maximum of f", "Minimum of f", "f at a probe point"};
+    ImGui::PushItemWidth(150.0);
+    ImGui::SliderInt("Steps per slider", (int*)&settings.steps, 2, 256);
+    ImGui::Combo("Metric", (int*)&settings.metric, metric_names, IM_ARRAYSIZE(metric_names));
+    if(settings.metric == g3d::SweepMetric::ValueAtProbe) {
+        ImGui::InputDouble("Probe x", &settings.probe_x);
+        ImGui::InputDouble("Probe z", &settings.probe_z);
+    }
+    ImGui::PopItemWidth();
+
+    uint64_t combinations = 1;
+    for(size_t i = 0; i < selected.size(); ++i) { combinations *= settings.steps; }
+    ImGui::BeginDisabled(sweep_job.is_running() || selected.empty() || combinations > (1ull << 24));
+    if(ImGui::Button("Run sweep")) {
+        try {
+            settings.axes.clear();
+            pending_axis_names.clear();
+            for(const auto &name : selected) {
+                const auto it = std::find_if(app_state.sliders.begin(), app_state.sliders.end(), [&](const Slider &s) { return s.name == name; });
+                if(it == app_state.sliders.end()) { continue; }
+                settings.axes.push_back(g3d::SweepAxis{.slider = (uint32_t)(it - app_state.sliders.begin()), .min = it->min, .max = it->max});
+                pending_axis_names.push_back(name);
+            }
+            if(settings.axes.empty()) { throw std::runtime_error{"Select at least one slider to sweep"}; }
+            sweep_job.start(compile_cpu_function("f"), g3d::make_parameters(app_state.sliders, glfwGetTime()), app_state.plane_settings.bounds, settings);
+        } catch(const std::exception &err) {
+            log_list_add_message(err.what());
+        }
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::Text("%llu combinations", (unsigned long long)combinations);
+
+    if(sweep_job.is_running()) {
+        if(std::string error; sweep_job.poll(analysis.sweep_result, error)) {
+            if(error.empty() == false) { log_list_add_message(error); return; }
+            analysis.has_sweep_result = true;
+            analysis.sweep_slice.assign(analysis.sweep_result.settings.axes.size(), 0);
+            analysis.sweep_axis_names = pending_axis_names;
+            log_list_add_message("Sweep finished after " + std::to_string(analysis.sweep_result.evaluations) + " evaluations of f.");
+        } else {
+            ImGui::ProgressBar(sweep_job.progress());
+            request_redraw();
+        }
+    }
+    // the result is drawn from the axes it was run with, whatever the selection is now
+    const auto &result = analysis.sweep_result;
+    const auto &axes   = result.settings.axes;
+    const auto steps   = result.settings.steps;
+    if(analysis.has_sweep_result == false || axes.empty()) { return; }
+    const auto axis_name = [&](size_t axis) { return analysis.sweep_axis_names[axis].c_str(); };
+    const auto plot_size = ImVec2(-1, glm::max(ImGui::GetContentRegionAvail().y, 250.0f));
+    if(axes.size() == 1) {
+        static std::vector<double> xs;
+        xs.resize(steps);
+        for(uint32_t i = 0; i < steps; ++i) { xs[i] = result.axis_value(0, i); }
+        if(ImPlot::BeginPlot("##sweep", plot_size)) {
+            ImPlot::SetupAxes(axis_name(0), metric_names[(int)result.settings.metric], ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            ImPlot::PlotLine("##metric", xs.data(), result.values.data(), (int)steps);
+            ImPlot::EndPlot();
+        }
+        return;
+    }
+
+    // two axes as a heatmap, any further axes fixed at a chosen step
+    size_t offset = 0, stride = (size_t)steps * steps;
+    for(size_t axis = 2; axis < axes.size(); ++axis) {
+        ImGui::PushItemWidth(150.0);
+        ImGui::SliderInt(axis_name(axis), &analysis.sweep_slice[axis], 0, (int)steps - 1);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        ImGui::Text("= %g", result.axis_value(axis, analysis.sweep_slice[axis]));
+        offset += analysis.sweep_slice[axis] * stride;
+        stride *= steps;
+    }
+    static std::vector<double> heatmap;
+    heatmap.resize((size_t)steps * steps);
+    double v_min = INFINITY, v_max = -INFINITY;
+    for(uint32_t j = 0; j < steps; ++j) {
+        for(uint32_t i = 0; i < steps; ++i) {
+            const auto v = result.values[offset + j * steps + i];
+            heatmap[(steps - 1 - j) * steps + i] = v; // ImPlot draws the first row at the top
+            if(std::isfinite(v)) { v_min = glm::min(v_min, v); v_max = glm::max(v_max, v); }
+        }
+    }
+    if(v_min > v_max) { v_min = v_max = 0.0; }
+    if(ImPlot::BeginPlot("##sweep", ImVec2(ImGui::GetContentRegionAvail().x - 90.0f, plot_size.y), ImPlotFlags_NoLegend)) {
+        ImPlot::SetupAxes(axis_name(0), axis_name(1));
+        ImPlot::SetupAxesLimits(axes[0].min, axes[0].max, axes[1].min, axes[1].max, ImPlotCond_Always);
+        ImPlot::PlotHeatmap("##metric", heatmap.data(), (int)steps, (int)steps, v_min, v_max, nullptr,
+                            ImPlotPoint(axes[0].min, axes[1].min), ImPlotPoint(axes[0].max, axes[1].max));
+        ImPlot::EndPlot();
+        ImGui::SameLine();
+        ImPlot::ColormapScale("##sweep_scale", v_min, v_max, ImVec2(80.0f, plot_size.y));
+    }
+}
+static void draw_analysis_tab() {
+    auto &analysis = app_state.analysis;
+    const auto bounds = (double)app_state.plane_settings.bounds;
+
+    if(ImGui::CollapsingHeader("Critical points of f", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto &settings = analysis.critical_point_settings;
+        ImGui::PushItemWidth(150.0);
+        ImGui::SliderInt("Seeds per axis", (int*)&settings.seeds_per_axis, 4, 512);
+        ImGui::SliderInt("Newton iterations", (int*)&settings.max_iterations, 5, 200);
+        ImGui::PopItemWidth();
+        if(ImGui::Button("Find critical points")) {
+            try {
+                const auto program    = compile_cpu_function("f");
+                const auto parameters = g3d::make_parameters(app_state.sliders, glfwGetTime());
+                analysis.critical_points = g3d::find_critical_points(program, parameters.data(), bounds, settings);
+                log_list_add_message("Found " + std::to_string(analysis.critical_points.size()) + " isolated critical points of f.");
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+            analysis.needs_marker_upload = true;
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Clear markers")) {
+            analysis.critical_points.clear();
+            analysis.needs_marker_upload = true;
+        }
+
+        static const char *kind_names[] = {"minimum", "maximum", "saddle"};
+        const auto TABLE_FLAGS = ImGuiTableFlags_BordersH | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+        if(analysis.critical_points.empty() == false && ImGui::BeginTable("critical points", 4, TABLE_FLAGS, ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 12))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("kind"); ImGui::TableSetupColumn("x"); ImGui::TableSetupColumn("z"); ImGui::TableSetupColumn("f(x, z)");
+            ImGui::TableHeadersRow();
+            ImGuiListClipper clipper;
+            clipper.Begin((int)analysis.critical_points.size());
+            while(clipper.Step()) {
+                for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    const auto &c = analysis.critical_points[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(kind_names[(int)c.kind]);
+                    ImGui::TableNextColumn(); ImGui::Text("%.6g", c.x);
+                    ImGui::TableNextColumn(); ImGui::Text("%.6g", c.z);
+                    ImGui::TableNextColumn(); ImGui::Text("%.6g", c.y);
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    if(ImGui::CollapsingHeader("Integral of f", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto &settings = analysis.cubature_settings;
+        static const char *integrand_names[] = {"Volume under the surface", "Surface area"};
+        ImGui::PushItemWidth(150.0);
+        ImGui::Combo("Integrand", (int*)&settings.integrand, integrand_names, IM_ARRAYSIZE(integrand_names));
+        ImGui::InputDouble("Relative tolerance", &settings.relative_tolerance, 0.0, 0.0, "%.1e");
+        ImGui::InputDouble("Absolute tolerance", &settings.absolute_tolerance, 0.0, 0.0, "%.1e");
+        ImGui::PopItemWidth();
+        if(ImGui::Button("Integrate")) {
+            try {
+                const auto program    = compile_cpu_function("f");
+                const auto parameters = g3d::make_parameters(app_state.sliders, glfwGetTime());
+                analysis.cubature_result     = g3d::integrate(program, parameters.data(), bounds, settings);
+                analysis.has_cubature_result = true;
+                if(analysis.cubature_result.has_converged == false) { log_list_add_message("Integration stopped before reaching the requested tolerance."); }
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+        }
+        if(analysis.has_cubature_result) {
+            const auto &r = analysis.cubature_result;
+            ImGui::Text("Integral:    %.12g", r.value);
+            ImGui::Text("Error:       %.3g", r.error);
+            ImGui::Text("Evaluations: %llu in %u regions", (unsigned long long)r.evaluations, r.regions);
+        }
+    }
+    if(ImGui::CollapsingHeader("Parameter sweep")) {
+        draw_parameter_sweep();
+    }
+    if(ImGui::CollapsingHeader("Fit sliders to data")) {
+        draw_slider_fit();
+    }
+    if(ImGui::CollapsingHeader("Streamlines of f")) {
+        auto &settings = app_state.streamline_settings;
+        static const char *direction_names[] = {"Steepest descent", "Steepest ascent"};
+        bool is_changed = ImGui::Checkbox("Draw streamlines", &settings.is_enabled);
+        ImGui::PushItemWidth(150.0);
+        is_changed |= ImGui::Combo("Direction", (int*)&settings.direction, direction_names, IM_ARRAYSIZE(direction_names));
+        is_changed |= ImGui::SliderInt("Seeds per axis", (int*)&settings.seeds_per_axis, 1, 200);
+        is_changed |= ImGui::SliderInt("Steps", (int*)&settings.max_steps, 1, 1000);
+        is_changed |= ImGui::SliderFloat("Step length", &settings.step_length, 0.0005f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+        is_changed |= ImGui::Checkbox("Arrows", &settings.is_arrows_shown);
+        if(settings.is_arrows_shown) { is_changed |= ImGui::SliderInt("Arrows per axis", (int*)&settings.arrows_per_axis, 2, 64); }
+        ImGui::ColorEdit3("Streamline color", &app_state.color_settings.color_streamlines.x, ImGuiColorEditFlags_NoInputs);
+        ImGui::SameLine();
+        ImGui::ColorEdit3("Arrow color", &app_state.color_settings.color_arrows.x, ImGuiColorEditFlags_NoInputs);
+        ImGui::PopItemWidth();
+        if(is_changed) { app_state.needs_streamline_update = true; }
+        if(app_state.streamline_job.is_running()) { ImGui::TextUnformatted("Tracing..."); }
+    }
+    if(ImGui::CollapsingHeader("Bad values")) {
+        ImGui::Checkbox("Highlight on the plane", &app_state.mask_settings.is_overlay_shown);
+        ImGui::PushItemWidth(150.0);
+        if(ImGui::InputFloat("Jump slope", &app_state.mask_settings.jump_slope)) {
+            app_state.mask_settings.jump_slope = std::max(app_state.mask_settings.jump_slope, 0.0f);
+            app_state.needs_height_field_update = true;
+        }
+        ImGui::PopItemWidth();
+        using enum g3d::VertexClass;
+        const auto &counts = app_state.mask_counts;
+        ImGui::TextColored(ImVec4(1.0f, 0.0f, 1.0f, 1.0f), "NaN:  %u", counts[NaN]);
+        ImGui::TextColored(ImVec4(1.0f, 0.15f, 0.1f, 1.0f), "+Inf: %u", counts[PositiveInf]);
+        ImGui::TextColored(ImVec4(0.3f, 0.5f, 1.0f, 1.0f), "-Inf: %u", counts[NegativeInf]);
+        ImGui::TextColored(ImVec4(1.0f, 0.9f, 0.0f, 1.0f), "Jump: %u", counts[Jump]);
+    }
+    if(ImGui::CollapsingHeader("Isolines of f", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto &settings = app_state.contour_settings;
+        bool is_changed = ImGui::Checkbox("Draw isolines", &settings.is_enabled);
+        ImGui::PushItemWidth(150.0);
+        is_changed |= ImGui::SliderInt("Levels", (int*)&settings.level_count, 1, 100);
+        is_changed |= ImGui::Checkbox("Span the height range", &settings.is_auto_range);
+        if(settings.is_auto_range == false) {
+            is_changed |= ImGui::InputFloat("Lowest level", &settings.min_level);
+            is_changed |= ImGui::InputFloat("Highest level", &settings.max_level);
+        }
+        if(is_changed) { app_state.needs_contour_update = true; }
+
+        static std::string export_name = "isolines";
+        ImGui::InputText("##isoline_file", &export_name);
+        ImGui::PopItemWidth();
+        const auto export_contours = [](const std::string &path, auto &&write) {
+            try {
+                write(path);
+                log_list_add_message("File successfully exported at: '" + path + '\'');
+            } catch(const std::exception &err) {
+                log_list_add_message(err.what());
+            }
+        };
+        ImGui::BeginDisabled(app_state.contours.polylines.empty());
+        if(ImGui::Button("Export SVG")) {
+            export_contours(documents_path(export_name + ".svg"), [](const std::string &path) {
+                g3d::export_contours_to_svg(path, app_state.contours.polylines, (float)app_state.plane_settings.bounds);
+            });
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Export polylines")) {
+            export_contours(documents_path(export_name + ".txt"), [](const std::string &path) {
+                g3d::export_contours_to_polylines(path, app_state.contours.polylines);
+            });
+        }
+        ImGui::EndDisabled();
+        ImGui::Text("%zu polylines over %zu levels", app_state.contours.polylines.size(), app_state.contours.levels.size());
+    }
+}
+static void draw_2d_tab() {
+    auto &plot = app_state.plot_2d;
+    const auto bounds = (double)app_state.plane_settings.bounds, min_position = -bounds;
+
+    ImGui::PushItemWidth(150.0);
+    static const char *resolution_names[] = {"64", "128", "256", "512"};
+    int resolution_idx = (int)glm::log2((float)plot.heatmap_resolution) - 6;
+    if(ImGui::Combo("Heatmap resolution", &resolution_idx, resolution_names, IM_ARRAYSIZE(resolution_names))) {
+        plot.heatmap_resolution = 64u << resolution_idx;
+        plot.needs_update = true;
+    }
+    plot.needs_update |= ImGui::RadioButton("x = const", (int*)&plot.slice_axis, (int)g3d::SliceAxis::ConstantX); ImGui::SameLine();
+    plot.needs_update |= ImGui::RadioButton("z = const", (int*)&plot.slice_axis, (int)g3d::SliceAxis::ConstantZ); ImGui::SameLine();
+    plot.needs_update |= ImGui::SliderScalar("##slice", ImGuiDataType_Double, &plot.slice_position, &min_position, &bounds, "%.4f");
+    plot.needs_update |= ImGui::InputDouble("Curve tolerance", &plot.curve_settings.tolerance, 0.0, 0.0, "%.1e");
+    ImGui::PopItemWidth();
+
+    // the newest request starts once the last one lands, which also paces animated functions
+    if((plot.needs_update || plot.revision != app_state.height_field_revision) && app_state.plot_job.is_running() == false) {
+        plot.needs_update = false;
+        plot.revision     = app_state.height_field_revision;
+        try {
+            app_state.plot_job.start(compile_cpu_function("f"), g3d::make_parameters(app_state.sliders, glfwGetTime()), bounds, plot.heatmap_resolution,
+                                     plot.slice_axis, plot.slice_position, plot.curve_settings);
+        } catch(const std::exception &err) {
+            // an animated f retries every frame, its error is worth one message per source
+            if(plot.failed_key != height_field_key()) { log_list_add_message(err.what()); }
+            plot.failed_key = height_field_key();
+            plot.samples    = g3d::PlotSamples{};
+        }
+    }
+    if(std::string error; app_state.plot_job.poll(plot.samples, error)) {
+        if(error.empty() == false) { log_list_add_message(error); plot.samples = g3d::PlotSamples{}; }
+    } else if(app_state.plot_job.is_running()) {
+        request_redraw();
+    }
+    const auto &samples = plot.samples;
+
+    const auto avail = ImGui::GetContentRegionAvail();
+    const auto heatmap_height = avail.y * 0.55f;
+    if(samples.heatmap.empty() == false && ImPlot::BeginPlot("##heatmap", ImVec2(avail.x - 90.0f, heatmap_height), ImPlotFlags_Equal | ImPlotFlags_NoLegend)) {
+        ImPlot::SetupAxes("x", "z");
+        ImPlot::SetupAxesLimits(-bounds, bounds, -bounds, bounds, ImPlotCond_Always);
+        const auto res = (int)samples.resolution;
+        ImPlot::PlotHeatmap("f", samples.heatmap.data(), res, res, samples.heatmap_min, samples.heatmap_max, nullptr, ImPlotPoint(-bounds, -bounds), ImPlotPoint(bounds, bounds));
+        // the slice can be dragged on the heatmap
+        const auto slice_color = ImVec4(1.0f, 1.0f, 1.0f, 0.8f);
+        if(plot.slice_axis == g3d::SliceAxis::ConstantX) { plot.needs_update |= ImPlot::DragLineX(0, &plot.slice_position, slice_color); }
+        else                                             { plot.needs_update |= ImPlot::DragLineY(0, &plot.slice_position, slice_color); }
+        plot.slice_position = glm::clamp(plot.slice_position, -bounds, bounds);
+        ImPlot::EndPlot();
+        ImGui::SameLine();
+        ImPlot::ColormapScale("##scale", samples.heatmap_min, samples.heatmap_max, ImVec2(80.0f, heatmap_height));
+    }
+
+    const auto *free_axis = plot.slice_axis == g3d::SliceAxis::ConstantX ? "z" : "x";
+    if(ImPlot::BeginPlot("Cross-section", ImVec2(-1, ImGui::GetContentRegionAvail().y - ImGui::GetTextLineHeightWithSpacing()))) {
+        ImPlot::SetupAxes(free_axis, "f", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        ImPlot::PlotLine("f", samples.curve.t.data(), samples.curve.y.data(), (int)samples.curve.t.size());
+        ImPlot::EndPlot();
+    }
+    ImGui::Text("%zu adaptive samples", samples.curve.t.size());
+}
 static void draw_user_variables_table(SelectedTab tab) {
     static const auto draw_table = [](auto& data, auto draw_callback) {
         const auto NUM_COLS    = 2;
@@ -904,6 +2288,10 @@ static void draw_user_variables_table(SelectedTab tab) {
         if      constexpr(std::same_as<std::remove_cvref_t<decltype(data)>, Slider>)    { overrided_height = 3.0f*ImGui::GetTextLineHeightWithSpacing(); }
         else if constexpr(std::same_as<std::remove_cvref_t<decltype(data)>, Constant>)  { overrided_height = 1.1f*ImGui::GetTextLineHeightWithSpacing(); }
         if(data.name == "f" && std::same_as<std::remove_cvref_t<decltype(data)>, Function>) { disable_editing = true; } //F function cannot be renamed by the user.
+        if constexpr(std::same_as<std::remove_cvref_t<decltype(data)>, Function>) {
+            ImGui::Checkbox("##is_surface", &data.is_surface); ImGui::SameLine();
+            ImGui::ColorEdit3("##surface_color", &data.color.x, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel); ImGui::SameLine();
+        }
         if(EditableSelectable(idx*2+0, data.name, overrided_height, disable_editing)) { delete_name = data.name; }
         query_previous_item_state(s1);
 
@@ -920,7 +2308,7 @@ static void draw_user_variables_table(SelectedTab tab) {
             ImGui::PushItemWidth(45.0f);
             ImGui::InputFloat("Min", &s.min); ImGui::SameLine(); ImGui::InputFloat("Max", &s.max);
             ImGui::PushItemWidth(90.0f + 2.0f * ImGui::CalcTextSize("Min").x + ImGui::GetStyle().ItemSpacing.x*2.0f);
-            if(ImGui::SliderFloat("##value", &s.value, s.min, s.max, "%.2f")) { app_state.needs_recompilation = true; }
+            if(ImGui::SliderFloat("##value", &s.value, s.min, s.max, "%.2f")) { app_state.needs_height_field_update = true; } // a uniform, no relink needed
             ImGui::PopItemWidth();
             ImGui::PopItemWidth();
         }
@@ -945,6 +2333,7 @@ static void draw_user_variables_table(SelectedTab tab) {
             data_vector.at(swap_a) = data_vector.at(swap_b);
             data_vector.at(swap_b) = temp;
             draging_idx = swap_b; swap_a = swap_b = -1;
+            app_state.needs_recompilation = true; // slider order is the uniform layout, function order the emit order
         }
         if(idx == 0 && delete_name.empty() == false) {
             int didx = -1;
@@ -953,6 +2342,7 @@ static void draw_user_variables_table(SelectedTab tab) {
             else {
                 data_vector.erase(data_vector.begin() + didx);
                 delete_name = "";
+                app_state.needs_recompilation = true;
             }
         }
     };
@@ -965,143 +2355,159 @@ static void draw_user_variables_table(SelectedTab tab) {
     }
 }
 
-static void save_project(const char *file_name) {
-    std::ofstream file;
-    file.open(file_name, std::ofstream::out);
-    if (file.is_open() == false) { std::cerr << "File is not opened!"; return; }
-    
-    std::stringstream content;
-    content << "[Functions]\n"; for (const auto &f : app_state.functions) { content << f.name << ' ' << f.value << '\n'; }
-    content << "[Constants]\n"; for (const auto &f : app_state.constants) { content << f.name << ' ' << f.value << '\n'; }
-    content << "[Sliders]\n";   for (const auto &f : app_state.sliders)   { content << f.name << ' ' << f.value << ' ' << f.min << ' ' << f.max << '\n'; }
-
-    content << "[Color Settings]\n";
-    /*Background color*/    for(int i=0; i<4; ++i) {content << app_state.color_settings.color_background[i]; if(i<3)content<<' ';} content << '\n';
-    /*Grid color*/          for(int i=0; i<4; ++i) {content << app_state.color_settings.color_grid[i];       if(i<3)content<<' ';} content << '\n';
-    /*Plane color*/         for(int i=0; i<4; ++i) {content << app_state.color_settings.color_plane[i];      if(i<3)content<<' ';} content << '\n';
-    /*Plane Grid color*/    for(int i=0; i<4; ++i) {content << app_state.color_settings.color_plane_grid[i]; if(i<3)content<<' ';} content << '\n';
-
-    content << "[Plane Settings]\n";
-    auto &ps = app_state.plane_settings;
-    /*Plane settings*/ content << ps.bounds << ' ' << ps.detail << ' ' << ps.grid_step << ' ' << ps.grid_line_thickness << ' ' << ps.is_detail_affecting_grid_step << '\n';
-
-    content << "[Render Settings]\n";
+static Project gather_project() {
+    Project project{.functions = app_state.functions, .sliders = app_state.sliders, .constants = app_state.constants, .data_sources = app_state.data_sources};
+    auto &ps = project.settings;
+    const auto &cs = app_state.color_settings;
+    ps.color_background = cs.color_background; ps.color_grid = cs.color_grid; ps.color_plane = cs.color_plane; ps.color_plane_grid = cs.color_plane_grid;
+    const auto &pls = app_state.plane_settings;
+    ps.bounds = pls.bounds; ps.detail = pls.detail; ps.grid_step = pls.grid_step; ps.grid_line_thickness = pls.grid_line_thickness;
+    ps.is_detail_affecting_grid_step = pls.is_detail_affecting_grid_step;
+    const auto &rs = app_state.render_settings;
+    ps.is_grid_rendered = rs.is_grid_rendered; ps.is_plane_grid_rendered = rs.is_plane_grid_rendered; ps.is_render_on_demand = rs.is_render_on_demand;
+    ps.target_fps = rs.target_fps; ps.unfocused_target_fps = rs.unfocused_target_fps; ps.is_dynamic_resolution = rs.is_dynamic_resolution;
+    ps.gpu_frame_budget_ms = rs.gpu_frame_budget_ms; ps.min_resolution_scale = rs.min_resolution_scale;
+    ps.font_idx = app_state.font_idx;
+    return project;
+}
+static void apply_project(Project &&project) {
+    app_state.functions = std::move(project.functions);
+    app_state.sliders   = std::move(project.sliders);
+    app_state.constants = std::move(project.constants);
+    app_state.data_sources = std::move(project.data_sources);
+    const auto &ps = project.settings;
+    auto &cs = app_state.color_settings;
+    cs.color_background = ps.color_background; cs.color_grid = ps.color_grid; cs.color_plane = ps.color_plane; cs.color_plane_grid = ps.color_plane_grid;
+    auto &pls = app_state.plane_settings;
+    pls.bounds = ps.bounds; pls.detail = ps.detail; pls.grid_step = ps.grid_step; pls.grid_line_thickness = ps.grid_line_thickness;
+    pls.is_detail_affecting_grid_step = ps.is_detail_affecting_grid_step;
     auto &rs = app_state.render_settings;
-    content << rs.is_grid_rendered << ' ' << rs.is_plane_grid_rendered;
-
-    content << "\n[Editor Settings]\n";
-    content << app_state.font_idx;
-
-    file << content.rdbuf(); file.close();
+    rs.is_grid_rendered = ps.is_grid_rendered; rs.is_plane_grid_rendered = ps.is_plane_grid_rendered; rs.is_render_on_demand = ps.is_render_on_demand;
+    rs.target_fps = ps.target_fps; rs.unfocused_target_fps = ps.unfocused_target_fps; rs.is_dynamic_resolution = ps.is_dynamic_resolution;
+    rs.gpu_frame_budget_ms = ps.gpu_frame_budget_ms; rs.min_resolution_scale = ps.min_resolution_scale;
+    app_state.font_idx = std::clamp(ps.font_idx, 1u, 4u);
+}
+// ".3dgb" files are written in the binary format, anything else as text; loading detects the format
+static void save_project(const char *file_name) {
+    const std::string path{file_name};
+    if (path.ends_with(".3dgb") == false) { g3d::save_project_text(path, gather_project()); return; }
+
+    auto project = gather_project();
+    const auto surface_count = (uint32_t)std::count_if(app_state.functions.begin(), app_state.functions.end(), [](const Function &f) { return f.is_surface; });
+    if (app_state.is_snapshot_embedded && surface_count > 0 && app_state.compute_program_key != 0) {
+        g3d::HeightFieldSnapshot snapshot{.detail = app_state.plane_settings.detail, .surface_count = surface_count,
+                                          .bounds = (float)app_state.plane_settings.bounds, .program_key = height_field_key()};
+        snapshot.heights.resize((size_t)(snapshot.detail + 1) * (snapshot.detail + 1) * surface_count);
+        glGetNamedBufferSubData(*app_state.heights_buffer, 0, snapshot.heights.size() * sizeof(float), snapshot.heights.data());
+        project.snapshot = g3d::encode_snapshot(snapshot, g3d::SnapshotCodec::Predictive);
+    }
+    g3d::save_project_binary(path, project);
 }
-
 static void load_project(const char *file_name) {
-    std::ifstream file{file_name};
-    if (file.is_open() == false) { throw std::runtime_error{"File could not be opened"}; }
-
-    std::string line;
-    int resource_id = -1;
-    app_state.functions.clear();
-    app_state.constants.clear();
-    app_state.sliders.clear();
-    while (std::getline(file, line)) {
-        if      (line.starts_with("[Functions]"))           { resource_id = 0; continue; }
-        else if (line.starts_with("[Constants]"))           { resource_id = 1; continue; }
-        else if (line.starts_with("[Sliders]"))             { resource_id = 2; continue; }
-        else if (line.starts_with("[Color Settings]"))      { resource_id = 3; continue; }
-        else if (line.starts_with("[Plane Settings]"))      { resource_id = 4; continue; }
-        else if (line.starts_with("[Render Settings]"))     { resource_id = 5; continue; }
-        else if (line.starts_with("[Editor Settings]"))     { resource_id = 6; continue; }
-
-        if (resource_id == -1 || resource_id > 6) { throw std::runtime_error{"Error while reading the project file - label not found: " + line}; }
-
-        std::stringstream ssline{line};
-        switch (resource_id) {
-        case 0: {
-            Function f;
-            ssline >> f.name >> f.value;
-            while (ssline.eof()==false) { std::string rest; ssline >> rest; f.value += rest; }
-            app_state.functions.push_back(f);
-            break;
-        }
-        case 1: {
-            Constant c;
-            ssline >> c.name >> c.value;
-            app_state.constants.push_back(c);
-            break;
-        }
-        case 2: {
-            Slider s;
-            ssline >> s.name >> s.value >> s.min >> s.max;
-            app_state.sliders.push_back(s);
-            break;
-        }
-        case 3: {
-            auto &cs = app_state.color_settings;
-            ssline >> cs.color_background[0] >> cs.color_background[1] >> cs.color_background[2] >> cs.color_background[3]; std::getline(file, line); ssline = std::stringstream{line};    
-            ssline >> cs.color_grid[0] >> cs.color_grid[1] >> cs.color_grid[2] >> cs.color_grid[3];                         std::getline(file, line); ssline = std::stringstream{line};    
-            ssline >> cs.color_plane[0] >> cs.color_plane[1] >> cs.color_plane[2] >> cs.color_plane[3];                     std::getline(file, line); ssline = std::stringstream{line};        
-            ssline >> cs.color_plane_grid[0] >> cs.color_plane_grid[1] >> cs.color_plane_grid[2] >> cs.color_plane_grid[3];
-            break;
-        }
-        case 4: {
-            auto &ps = app_state.plane_settings;
-            ssline >> ps.bounds >> ps.detail >> ps.grid_step >> ps.grid_line_thickness >> ps.is_detail_affecting_grid_step;
-            break;
-        }
-        case 5: {
-            auto &rs = app_state.render_settings;
-            ssline >> rs.is_grid_rendered >> rs.is_plane_grid_rendered;
-            break;
-        }
-        case 6: {
-            auto &rs = app_state;
-            ssline >> rs.font_idx;
-            break;
+    auto project = gather_project();
+    g3d::load_project(file_name, project);
+    // referenced data is read from where it was imported
+    for (const auto &error : g3d::load_data_sources(file_name, project.data_sources)) { log_list_add_message(error); }
+    if (project.snapshot.empty() == false) {
+        try {
+            auto snapshot = g3d::decode_snapshot(project.snapshot.data(), project.snapshot.size());
+            if (snapshot.detail == project.settings.detail && snapshot.bounds == (float)project.settings.bounds) { app_state.pending_snapshot = std::move(snapshot); }
+        } catch(const std::exception &err) {
+            log_list_add_message(std::string{err.what()} + ", evaluating the surfaces instead");
         }
+    }
+    apply_project(std::move(project));
+}
+static void watch_project() {
+    if (app_state.is_project_watched && app_state.project_path.empty() == false) { app_state.project_watcher.watch(app_state.project_path, [] { glfwPostEmptyEvent(); }); }
+    else                                                                         { app_state.project_watcher.stop(); }
+}
+// Applies a rewritten project in place, doing only the work its changes need: the compute shader is rebuilt when
+// an equation, a constant, the slider set or a data source changed, slider values and settings only redraw the
+// field, and the camera and everything else outside the file stay as they are.
+static void reload_project(const std::string &path) {
+    auto project = gather_project();
+    try {
+        g3d::load_project(path, project);
+    } catch(const std::exception &err) {
+        log_list_add_message("Could not reload the project: " + std::string{err.what()});
+        return;
+    }
+
+    // data that did not change keeps the grid already loaded and uploaded; referenced files are not watched
+    const auto is_same_grid = [](const auto &a, const auto &b) { return a != nullptr && b != nullptr && a->width == b->width && a->height == b->height && a->values == b->values; };
+    const auto is_same_points = [](const auto &a, const auto &b) {
+        return a != nullptr && b != nullptr && a->points.size() == b->points.size() &&
+               std::memcmp(a->points.data(), b->points.data(), a->points.size() * sizeof(g3d::DataPoint)) == 0;
+    };
+    for (auto &d : project.data_sources) {
+        const auto old = std::find_if(app_state.data_sources.begin(), app_state.data_sources.end(), [&](const DataSource &o) {
+            return o.name == d.name && o.is_scattered == d.is_scattered && o.is_embedded == d.is_embedded && o.path == d.path;
+        });
+        if (old == app_state.data_sources.end()) { continue; }
+        if (d.is_scattered == false && (d.grid == nullptr || is_same_grid(d.grid, old->grid))) { d.grid = old->grid; }
+        if (d.is_scattered && (d.points == nullptr || is_same_points(d.points, old->points))) {
+            d.points     = old->points;
+            d.grid       = old->grid;
+            d.domain     = old->domain;
+            d.resampling = old->resampling;
         }
     }
+    for (const auto &error : g3d::load_data_sources(path, project.data_sources)) { log_list_add_message(error); }
+
+    const auto &functions = project.functions;
+    const auto &constants = project.constants;
+    const auto &sliders   = project.sliders;
+    const auto &sources   = project.data_sources;
+    const bool is_program_same =
+        std::equal(functions.begin(), functions.end(), app_state.functions.begin(), app_state.functions.end(),
+                   [](const Function &a, const Function &b) { return a.name == b.name && a.value == b.value; }) &&
+        std::equal(constants.begin(), constants.end(), app_state.constants.begin(), app_state.constants.end(),
+                   [](const Constant &a, const Constant &b) { return a.name == b.name && a.value == b.value; }) &&
+        std::equal(sliders.begin(), sliders.end(), app_state.sliders.begin(), app_state.sliders.end(),
+                   [](const Slider &a, const Slider &b) { return a.name == b.name; }) &&
+        std::equal(sources.begin(), sources.end(), app_state.data_sources.begin(), app_state.data_sources.end(),
+                   [](const DataSource &a, const DataSource &b) {
+                       return a.name == b.name && a.sampling == b.sampling && a.domain == b.domain && a.grid == b.grid;
+                   });
+    const auto settings = gather_project().settings;
+    const bool is_value_same =
+        std::equal(sliders.begin(), sliders.end(), app_state.sliders.begin(), app_state.sliders.end(),
+                   [](const Slider &a, const Slider &b) { return a.value == b.value && a.min == b.min && a.max == b.max; }) &&
+        std::equal(functions.begin(), functions.end(), app_state.functions.begin(), app_state.functions.end(),
+                   [](const Function &a, const Function &b) { return a.is_surface == b.is_surface && a.color == b.color; }) &&
+        // scattered sources resample and relink on their own once their settings differ
+        std::equal(sources.begin(), sources.end(), app_state.data_sources.begin(), app_state.data_sources.end(),
+                   [](const DataSource &a, const DataSource &b) { return a.scattered_settings == b.scattered_settings && a.is_embedded == b.is_embedded; }) &&
+        settings == project.settings;
+    if (is_program_same && is_value_same) { return; } // e.g. saved by this application
+
+    // without a relink the sliders keep the uniforms of the linked program, which are looked up by name
+    if (is_program_same) { for (auto &s : project.sliders) { s.uniform = g3d::intern_uniform_name(s.name); } }
+    apply_project(std::move(project));
+    if (is_program_same) { app_state.needs_height_field_update = true; }
+    else                 { app_state.needs_recompilation = true; }
+    log_list_add_message(is_program_same ? "Project reloaded, values updated" : "Project reloaded, surfaces recompiled");
 }
 static void export_to_obj(const std::string& path, g3d::HandleBuffer buffer) {
-    const auto buffer_size = (app_state.plane_settings.detail + 1) * (app_state.plane_settings.detail + 1);
-    const auto *vs = (float*)glMapNamedBufferRange(buffer, 0, buffer_size, GL_MAP_READ_BIT);
-
-    std::string file_content;
-
-    const auto s = app_state.plane_settings.bounds;
     const auto n = app_state.plane_settings.detail;
-    for(auto i=0llu; i<buffer_size; ++i) {
-        float x = i % (n+1);
-        float z = i / (n+1); // x,z are in [0, detail] range
-        float y = vs[(uint32_t)z*(n+1) + (uint32_t)x];
-        x /= n; z /= n;  // x,z are in [0, 1] range
-        x = x*2.0*s - s;
-        z = z*2.0*s - s; // x,z are in [-bounds, bounds] range
-
-        file_content +=  "v " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(z) + '\n';
-    }
-
-    file_content += '\n';
-
-    for(auto i=0llu; i<n; ++i) {
-        for(auto j=0llu; j<n; ++j) {
-            uint32_t idx = i * (n+1) + j;
-            uint32_t a = idx;
-            uint32_t b = idx + (n+1);
-            uint32_t c = idx + 1;
-            uint32_t d = b + 1;
-
-            ++a; ++b; ++c; ++d;
-
-            file_content += "f " + std::to_string(a) + ' ' + std::to_string(b) + ' ' + std::to_string(c) + '\n';
-            file_content += "f " + std::to_string(c) + ' ' + std::to_string(b) + ' ' + std::to_string(d) + '\n';
+    const auto vertex_count = (n + 1) * (n + 1);
+    std::vector<float> vs(vertex_count);
+    glGetNamedBufferSubData(buffer, 0, vertex_count * sizeof(float), vs.data());
+
+    const auto surface = std::find_if(app_state.functions.begin(), app_state.functions.end(), [](const Function &f) { return f.is_surface; });
+    const auto policy = app_state.export_bad_vertices;
+    try {
+        const auto report = g3d::export_mesh(path, vs.data(), n, {surface != app_state.functions.end() ? surface->name : "surface"},
+                                             (float)app_state.plane_settings.bounds, policy, g3d::MeshFormat::Obj);
+        if (report.bad_vertices != 0) {
+            static const char *actions[] = {"kept as is", "dropped with their triangles", "patched from their neighbours"};
+            log_list_add_message(std::to_string(report.bad_vertices) + " NaN/Inf vertices were " + actions[(uint32_t)policy] +
+                                 (policy == g3d::BadVertexPolicy::DropTriangles ? " (" + std::to_string(report.dropped_triangles) + " triangles)" : std::string{}));
         }
+    } catch(const std::exception &err) {
+        log_list_add_message(err.what());
     }
-    glUnmapNamedBuffer(buffer);
-
-    std::fstream file{path, std::ios::trunc | std::ios::out};
-    file << file_content;
-
 }
 
 static void log_list_add_message(const std::string& msg) {
@@ -1109,17 +2515,3 @@ static void log_list_add_message(const std::string& msg) {
     app_state.log_list_scroll_down = true;
 }
 
-static void uniform1f(uint32_t program, const char* name, float value) {
-    const auto location = glGetUniformLocation(program, name);
-    glUniform1f(location, value);
-}
-
-static void uniform3f(uint32_t program, const char* name, glm::vec3 value) {
-    const auto location = glGetUniformLocation(program, name);
-    glUniform3fv(location, 1, &value.x);
-}
-
-static void uniformm4(uint32_t program, const char* name, const glm::mat4& value) {
-    const auto location = glGetUniformLocation(program, name);
-    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
-}
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "mesh_export.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace g3d {
+
+    // Replaces NaN and Inf as the policy asks, per surface, and marks the vertices that were bad.
+    // Dropped triangles leave their bad vertices behind as 0.
+    static MeshExportReport apply_policy(std::vector<float> &values, std::vector<uint8_t> &is_bad, uint32_t detail, size_t surface_count,
+                                         BadVertexPolicy policy) {
+        MeshExportReport report;
+        const auto n = detail;
+        const auto vertex_count = static_cast<size_t>(n + 1) * (n + 1);
+        is_bad.resize(values.size());
+        for (size_t idx = 0; idx < values.size(); ++idx) { is_bad[idx] = std::isfinite(values[idx]) == false; report.bad_vertices += is_bad[idx]; }
+        if (policy == BadVertexPolicy::Keep || report.bad_vertices == 0) { return report; }
+
+        for (size_t s = 0; s < surface_count; ++s) {
+            auto *vs = values.data() + s * vertex_count;
+            const std::vector<float> original(vs, vs + vertex_count);
+            for (size_t idx = 0; idx < vertex_count; ++idx) {
+                if (is_bad[s * vertex_count + idx] == 0) { continue; }
+                auto y = 0.0f;
+                if (policy == BadVertexPolicy::Patch) {
+                    const auto x = idx % (n + 1), z = idx / (n + 1);
+                    auto sum = 0.0f, count = 0.0f;
+                    const auto add = [&](size_t neighbour) {
+                        if (std::isfinite(original[neighbour])) { sum += original[neighbour]; count += 1.0f; }
+                    };
+                    if (x > 0) { add(idx - 1); }
+                    if (x < n) { add(idx + 1); }
+                    if (z > 0) { add(idx - (n + 1)); }
+                    if (z < n) { add(idx + (n + 1)); }
+                    if (count > 0.0f) { y = sum / count; }
+                }
+                vs[idx] = y;
+            }
+        }
+        return report;
+    }
+
+    // Two triangles per cell, counter-clockwise seen from +y; indices are local to the surface
+    template <typename F>
+    static void for_each_triangle(uint32_t detail, F &&triangle) {
+        const auto n = detail;
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t j = 0; j < n; ++j) {
+                const auto a = i * (n + 1) + j, b = a + (n + 1), c = a + 1, d = b + 1;
+                triangle(a, b, c);
+                triangle(c, b, d);
+            }
+        }
+    }
+
+    static float grid_coordinate(uint32_t i, uint32_t detail, float bounds) {
+        return static_cast<float>(static_cast<float>(i) / detail * 2.0 * bounds - bounds);
+    }
+
+    static void write_obj(const std::string &path, const std::vector<float> &values, const std::vector<uint8_t> &is_bad, uint32_t detail,
+                          const std::vector<std::string> &surface_names, float bounds, BadVertexPolicy policy, MeshExportReport &report) {
+        std::ofstream file{path, std::ios::trunc | std::ios::out};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        const auto n = detail;
+        const auto vertex_count = static_cast<size_t>(n + 1) * (n + 1);
+
+        // flushed in pieces, a fine grid would not fit one string
+        std::string content;
+        const auto flush = [&](bool is_forced) {
+            if (is_forced || content.size() > (1u << 20)) { file << content; content.clear(); }
+        };
+        for (size_t s = 0; s < surface_names.size(); ++s) {
+            content += "o " + surface_names[s] + '\n';
+            for (size_t i = 0; i < vertex_count; ++i) {
+                const auto x = grid_coordinate(static_cast<uint32_t>(i % (n + 1)), n, bounds);
+                const auto z = grid_coordinate(static_cast<uint32_t>(i / (n + 1)), n, bounds);
+                content += "v " + std::to_string(x) + " " + std::to_string(values[s * vertex_count + i]) + " " + std::to_string(z) + '\n';
+                flush(false);
+            }
+        }
+        content += '\n';
+
+        for (size_t s = 0; s < surface_names.size(); ++s) {
+            const auto *bad = is_bad.data() + s * vertex_count;
+            const auto base = s * vertex_count + 1;
+            for_each_triangle(n, [&](uint32_t a, uint32_t b, uint32_t c) {
+                if (policy == BadVertexPolicy::DropTriangles && (bad[a] || bad[b] || bad[c])) { ++report.dropped_triangles; return; }
+                content += "f " + std::to_string(base + a) + ' ' + std::to_string(base + b) + ' ' + std::to_string(base + c) + '\n';
+                flush(false);
+            });
+        }
+        flush(true);
+        if (file.fail()) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+    }
+
+    static std::string json_number(float v) {
+        char buffer[32];
+        const auto end = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr;
+        return std::string(buffer, end);
+    }
+    static std::string json_string(const std::string &s) {
+        std::string out = "\"";
+        for (const auto c : s) {
+            if (c == '"' || c == '\\') { out += '\\'; }
+            if (static_cast<unsigned char>(c) >= 0x20) { out += c; }
+        }
+        return out + '"';
+    }
+
+    static void write_glb(const std::string &path, std::vector<float> &values, const std::vector<uint8_t> &is_bad, uint32_t detail,
+                          const std::vector<std::string> &surface_names, float bounds, BadVertexPolicy policy, MeshExportReport &report) {
+        const auto n = detail;
+        const auto vertex_count = static_cast<size_t>(n + 1) * (n + 1);
+        struct SurfaceLayout {
+            size_t surface{0};
+            uint64_t index_count{0}, index_offset{0}, vertex_offset{0};
+            float y_min{0.0f}, y_max{0.0f};
+        };
+        // every count and bound goes into the JSON, which comes before the binary chunk
+        std::vector<SurfaceLayout> layouts;
+        uint64_t byte_length = 0;
+        for (size_t s = 0; s < surface_names.size(); ++s) {
+            auto *vs = values.data() + s * vertex_count;
+            const auto *bad = is_bad.data() + s * vertex_count;
+            SurfaceLayout layout{.surface = s};
+            for_each_triangle(n, [&](uint32_t a, uint32_t b, uint32_t c) {
+                if (policy == BadVertexPolicy::DropTriangles && (bad[a] || bad[b] || bad[c])) { ++report.dropped_triangles; return; }
+                layout.index_count += 3;
+            });
+            if (layout.index_count == 0) { continue; } // glTF has no empty accessors
+            for (size_t i = 0; i < vertex_count; ++i) {
+                if (std::isfinite(vs[i]) == false) { vs[i] = 0.0f; }
+                layout.y_min = i == 0 ? vs[i] : std::min(layout.y_min, vs[i]);
+                layout.y_max = i == 0 ? vs[i] : std::max(layout.y_max, vs[i]);
+            }
+            layout.index_offset  = byte_length;
+            layout.vertex_offset = byte_length + layout.index_count * 4;
+            byte_length = layout.vertex_offset + vertex_count * 12;
+            layouts.push_back(layout);
+        }
+
+        std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"3D Calculator\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+        for (size_t k = 0; k < layouts.size(); ++k) { json += (k > 0 ? "," : "") + std::to_string(k); }
+        json += "]}],\"nodes\":[";
+        for (size_t k = 0; k < layouts.size(); ++k) {
+            json += (k > 0 ? "," : "") + std::string{"{\"mesh\":"} + std::to_string(k) + ",\"name\":" + json_string(surface_names[layouts[k].surface]) + "}";
+        }
+        json += "],\"meshes\":[";
+        for (size_t k = 0; k < layouts.size(); ++k) {
+            json += (k > 0 ? "," : "") + std::string{"{\"primitives\":[{\"attributes\":{\"POSITION\":"} + std::to_string(2 * k + 1) +
+                    "},\"indices\":" + std::to_string(2 * k) + "}]}";
+        }
+        json += "],\"buffers\":[{\"byteLength\":" + std::to_string(byte_length) + "}],\"bufferViews\":[";
+        for (size_t k = 0; k < layouts.size(); ++k) {
+            const auto &l = layouts[k];
+            json += (k > 0 ? "," : "") + std::string{"{\"buffer\":0,\"byteOffset\":"} + std::to_string(l.index_offset) +
+                    ",\"byteLength\":" + std::to_string(l.index_count * 4) + ",\"target\":34963}";
+            json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(l.vertex_offset) + ",\"byteLength\":" + std::to_string(vertex_count * 12) +
+                    ",\"byteStride\":12,\"target\":34962}";
+        }
+        json += "],\"accessors\":[";
+        for (size_t k = 0; k < layouts.size(); ++k) {
+            const auto &l = layouts[k];
+            json += (k > 0 ? "," : "") + std::string{"{\"bufferView\":"} + std::to_string(2 * k) +
+                    ",\"componentType\":5125,\"type\":\"SCALAR\",\"count\":" + std::to_string(l.index_count) + "}";
+            json += ",{\"bufferView\":" + std::to_string(2 * k + 1) + ",\"componentType\":5126,\"type\":\"VEC3\",\"count\":" + std::to_string(vertex_count) +
+                    ",\"min\":[" + json_number(-bounds) + "," + json_number(l.y_min) + "," + json_number(-bounds) +
+                    "],\"max\":[" + json_number(bounds) + "," + json_number(l.y_max) + "," + json_number(bounds) + "]}";
+        }
+        json += "]}";
+        while (json.size() % 4 != 0) { json += ' '; }
+        const auto bin_length = (byte_length + 3) / 4 * 4;
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        const auto write_u32 = [&](uint64_t v) {
+            const auto u = static_cast<uint32_t>(v);
+            file.write(reinterpret_cast<const char *>(&u), sizeof(u));
+        };
+        const auto total_length = 12 + 8 + json.size() + 8 + bin_length;
+        if (total_length > UINT32_MAX) { throw std::runtime_error{"'" + path + "' would exceed the 4 GiB a .glb can hold"}; }
+        file.write("glTF", 4); write_u32(2); write_u32(total_length);
+        write_u32(json.size()); file.write("JSON", 4); file << json;
+        write_u32(bin_length); file.write("BIN\0", 4);
+
+        // row by row, the mesh is never held as a whole
+        std::vector<uint32_t> indices;
+        std::vector<float> positions;
+        for (const auto &l : layouts) {
+            const auto *vs = values.data() + l.surface * vertex_count;
+            const auto *bad = is_bad.data() + l.surface * vertex_count;
+            for_each_triangle(n, [&](uint32_t a, uint32_t b, uint32_t c) {
+                if (policy == BadVertexPolicy::DropTriangles && (bad[a] || bad[b] || bad[c])) { return; }
+                indices.insert(indices.end(), {a, b, c});
+                if (indices.size() >= (1u << 16)) {
+                    file.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(indices.size() * 4));
+                    indices.clear();
+                }
+            });
+            file.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(indices.size() * 4));
+            indices.clear();
+            for (uint32_t z = 0; z <= n; ++z) {
+                positions.clear();
+                for (uint32_t x = 0; x <= n; ++x) {
+                    positions.insert(positions.end(), {grid_coordinate(x, n, bounds), vs[static_cast<size_t>(z) * (n + 1) + x], grid_coordinate(z, n, bounds)});
+                }
+                file.write(reinterpret_cast<const char *>(positions.data()), static_cast<std::streamsize>(positions.size() * 4));
+            }
+        }
+        file.write("\0\0\0", static_cast<std::streamsize>(bin_length - byte_length));
+        if (file.fail()) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+    }
+
+    MeshExportReport export_mesh(const std::string &path, const float *heights, uint32_t detail, const std::vector<std::string> &surface_names,
+                                 float bounds, BadVertexPolicy policy, MeshFormat format) {
+        std::vector<float> values(heights, heights + static_cast<size_t>(detail + 1) * (detail + 1) * surface_names.size());
+        std::vector<uint8_t> is_bad;
+        auto report = apply_policy(values, is_bad, detail, surface_names.size(), policy);
+        if (format == MeshFormat::Obj) { write_obj(path, values, is_bad, detail, surface_names, bounds, policy, report); }
+        else                           { write_glb(path, values, is_bad, detail, surface_names, bounds, policy, report); }
+        return report;
+    }
+
+} // namespace g3d
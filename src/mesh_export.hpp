@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    enum class MeshFormat : uint32_t { Obj, Glb };
+    // What happens to NaN and Inf heights; jump vertices are finite and exported as they are
+    enum class BadVertexPolicy : uint32_t { Keep, DropTriangles, Patch };
+
+    struct MeshExportReport {
+        uint32_t bad_vertices{0}, dropped_triangles{0};
+    };
+
+    // Writes the grids as triangle meshes over [-bounds, bounds]^2, one object per name in `surface_names`.
+    // `heights` holds the surfaces one after the other, (detail + 1)^2 row-major values each, row 0 at z = -bounds.
+    //  - Obj: text, NaN and Inf kept as they are unless the policy replaces them
+    //  - Glb: binary glTF, one mesh per surface; heights still NaN or Inf after the policy are written as 0
+    // Patch averages the finite 4-neighbours. Throws std::runtime_error when the file cannot be written.
+    MeshExportReport export_mesh(const std::string &path, const float *heights, uint32_t detail, const std::vector<std::string> &surface_names,
+                                 float bounds, BadVertexPolicy policy, MeshFormat format);
+} // namespace g3d
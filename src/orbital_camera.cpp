@@ -16,11 +16,17 @@ namespace g3d {
     }
 
     void OrbitalCamera::update() {
+        const auto previous_distance = _distance, previous_theta = _theta, previous_phi = _phi;
+        _has_moved = false;
+
         if (_wheel_locked == false) {
             _distance += ImGui::GetIO().MouseWheel;
             _distance = glm::clamp(_distance, 1.0f, 1000.0f);
         }
-        if (_mouse_locked) { return; }
+        if (_mouse_locked) {
+            _has_moved = _distance != previous_distance;
+            return;
+        }
 
         auto [x, y] = ImGui::GetMouseDragDelta(0, 1.0);
         ImGui::ResetMouseDragDelta();
@@ -30,6 +36,8 @@ namespace g3d {
         _theta -= y;
         _phi -= x;
         _theta = glm::clamp(_theta, 0.01f, 179.9f);
+
+        _has_moved = _distance != previous_distance || _theta != previous_theta || _phi != previous_phi;
     }
 
     glm::mat4 OrbitalCamera::view_matrix() const {
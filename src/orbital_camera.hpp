@@ -24,6 +24,7 @@ namespace g3d {
         void on_window_resize(uint32_t width, uint32_t height);
         void set_mouse_state(bool locked = false) { _mouse_locked = locked; }
         void set_wheel_state(bool locked = false) { _wheel_locked = locked; }
+        bool has_moved() const { return _has_moved; } // during the last update()
         glm::mat4 view_matrix() const;
         glm::mat4 projection_matrix() const;
 
@@ -32,7 +33,7 @@ namespace g3d {
       private:
         void _calculate_projection_matrix(Window *);
 
-        bool _mouse_locked = false, _wheel_locked = false;
+        bool _mouse_locked = false, _wheel_locked = false, _has_moved = false;
         float _distance{2.0f}, _theta{1.0f}, _phi{0.0f};
         glm::mat4 _projection_matrix;
     };
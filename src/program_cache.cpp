@@ -0,0 +1,63 @@
+#include "program_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace g3d {
+
+    static std::filesystem::path cache_path(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return std::filesystem::temp_directory_path() / "3dcalculator" / "programs" / name;
+    }
+
+    uint64_t program_cache_key(std::string_view source) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (const auto c : source) { hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull; }
+        return hash;
+    }
+
+    bool load_cached_program(HandleProgram program, uint64_t key) {
+        std::ifstream file{cache_path(key), std::ios::binary | std::ios::ate};
+        if (file.is_open() == false) { return false; }
+        const auto size = static_cast<size_t>(file.tellg());
+        if (size <= sizeof(GLenum)) { return false; }
+        std::vector<char> bytes(size);
+        file.seekg(0);
+        if (!file.read(bytes.data(), static_cast<std::streamsize>(size))) { return false; }
+
+        GLenum format;
+        std::memcpy(&format, bytes.data(), sizeof(format));
+        glProgramBinary(program, format, bytes.data() + sizeof(format), static_cast<GLsizei>(size - sizeof(format)));
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        return status == GL_TRUE;
+    }
+
+    void mark_program_retrievable(HandleProgram program) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    void store_cached_program(HandleProgram program, uint64_t key) {
+        GLint size = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+        if (size <= 0) { return; }
+        std::vector<char> bytes(sizeof(GLenum) + size);
+        GLenum format;
+        glGetProgramBinary(program, size, nullptr, &format, bytes.data() + sizeof(GLenum));
+        std::memcpy(bytes.data(), &format, sizeof(format));
+
+        // the cache is an optimisation, failing to write it is not an error
+        std::error_code error;
+        const auto path = cache_path(key);
+        std::filesystem::create_directories(path.parent_path(), error);
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open()) { file.write(bytes.data(), static_cast<std::streamsize>(bytes.size())); }
+    }
+
+} // namespace g3d
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+#include <renderer.hpp>
+
+namespace g3d {
+/* Definitions */
+    // Linked program binaries on disk, keyed by a hash of the shader source, so reopening a project skips
+    // the driver's compile and link. Drivers may reject binaries after an update; that is a plain miss.
+    uint64_t program_cache_key(std::string_view source);
+    // True when `program` was linked from the cache
+    bool load_cached_program(HandleProgram program, uint64_t key);
+    // Call before linking, otherwise drivers may not keep the binary around
+    void mark_program_retrievable(HandleProgram program);
+    void store_cached_program(HandleProgram program, uint64_t key);
+} // namespace g3d
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <data_source.hpp>
+#include <scattered_data.hpp>
+#include <uniforms.hpp>
+
+struct Function {
+    std::string name, value;
+    bool is_surface{false};
+    glm::vec4 color = glm::vec4{135, 135, 135, 255} / glm::vec4{255};
+};
+struct Slider {
+    Slider() = default;
+    Slider(const std::string &name, float value) : name{name}, value{value} {}
+
+    std::string name;
+    float value{0.f}, min{0.f}, max{1.0f};
+    g3d::UniformName uniform{g3d::INVALID_UNIFORM_NAME}; // refreshed whenever the compute shader is rebuilt
+};
+struct Constant {
+    std::string name;
+    float value{0.f};
+};
+// An image, a table or scattered points equations sample as name(x, z)
+struct DataSource {
+    std::string name, path;
+    g3d::DataSampling sampling{g3d::DataSampling::Bilinear};
+    glm::vec4 domain{-1.0f, 1.0f, -1.0f, 1.0f}; // x_min, x_max, z_min, z_max the grid is stretched over
+    bool is_embedded{false};                    // binary projects then store the values instead of the path
+    std::shared_ptr<const g3d::DataGrid> grid;  // null until loaded
+    // scattered (x, z, y) points are interpolated onto a grid over the plane, which `grid` then holds
+    bool is_scattered{false};
+    g3d::ScatteredSettings scattered_settings;
+    std::shared_ptr<const g3d::ScatteredData> points; // null until loaded
+    g3d::ScatteredResampling resampling;              // what `grid` was resampled with
+};
+
+// Everything a project file stores besides the equations, as one fixed-layout record
+struct ProjectSettings {
+    glm::vec4 color_background{0.0f}, color_grid{0.0f}, color_plane{0.0f}, color_plane_grid{0.0f};
+    uint32_t bounds{1}, detail{3};
+    float grid_step{1.0f}, grid_line_thickness{0.98f};
+    uint32_t is_detail_affecting_grid_step{1};
+    uint32_t is_grid_rendered{1}, is_plane_grid_rendered{1}, is_render_on_demand{1};
+    float target_fps{60.0f}, unfocused_target_fps{15.0f};
+    uint32_t is_dynamic_resolution{1};
+    float gpu_frame_budget_ms{8.0f}, min_resolution_scale{0.5f};
+    uint32_t font_idx{2};
+
+    bool operator==(const ProjectSettings &) const = default;
+};
+struct Project {
+    std::vector<Function> functions;
+    std::vector<Slider> sliders;
+    std::vector<Constant> constants;
+    std::vector<DataSource> data_sources;
+    ProjectSettings settings;
+    std::vector<uint8_t> snapshot; // an encoded g3d::HeightFieldSnapshot, only binary project files keep it
+};
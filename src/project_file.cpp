@@ -0,0 +1,536 @@
+#include "project_file.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <height_field_codec.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace g3d {
+
+    /* Mapped files */
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string &path) {
+        const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+        _file = file;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) == FALSE) { CloseHandle(file); throw std::runtime_error{"Could not read '" + path + "'"}; }
+        _size = static_cast<size_t>(size.QuadPart);
+        if (_size == 0) { return; }
+        _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mapping != nullptr) { _data = static_cast<const uint8_t *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)); }
+        if (_data == nullptr) {
+            if (_mapping != nullptr) { CloseHandle(_mapping); }
+            CloseHandle(file);
+            throw std::runtime_error{"Could not map '" + path + "'"};
+        }
+    }
+    MappedFile::~MappedFile() {
+        if (_data != nullptr) { UnmapViewOfFile(_data); }
+        if (_mapping != nullptr) { CloseHandle(_mapping); }
+        if (_file != nullptr) { CloseHandle(_file); }
+    }
+#else
+    MappedFile::MappedFile(const std::string &path) {
+        const auto fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+        struct stat info;
+        if (fstat(fd, &info) != 0) { close(fd); throw std::runtime_error{"Could not read '" + path + "'"}; }
+        _size = static_cast<size_t>(info.st_size);
+        if (_size > 0) {
+            auto *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) { close(fd); throw std::runtime_error{"Could not map '" + path + "'"}; }
+            _data = static_cast<const uint8_t *>(data);
+        }
+        close(fd); // the mapping keeps the file alive
+    }
+    MappedFile::~MappedFile() {
+        if (_data != nullptr) { munmap(const_cast<uint8_t *>(_data), _size); }
+    }
+#endif
+
+    /* Text format */
+
+    static void append_float(std::string &out, float value) {
+        char buffer[32];
+        // shortest representation that reads back to the same float
+        const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        out.append(buffer, end);
+    }
+    static void append_vec4(std::string &out, const glm::vec4 &v) {
+        for (int i = 0; i < 4; ++i) { if (i > 0) { out += ' '; } append_float(out, v[i]); }
+        out += '\n';
+    }
+
+    void save_project_text(const std::string &path, const Project &project) {
+        std::string content;
+        content += "[Functions]\n";
+        for (const auto &f : project.functions) { content += f.name + ' ' + f.value + '\n'; }
+        content += "[Surfaces]\n";
+        for (const auto &f : project.functions) {
+            if (f.is_surface) { content += f.name + ' '; append_vec4(content, f.color); }
+        }
+        content += "[Constants]\n";
+        for (const auto &c : project.constants) { content += c.name + ' '; append_float(content, c.value); content += '\n'; }
+        content += "[Sliders]\n";
+        for (const auto &s : project.sliders) {
+            content += s.name;
+            for (const auto v : {s.value, s.min, s.max}) { content += ' '; append_float(content, v); }
+            content += '\n';
+        }
+
+        const auto &ps = project.settings;
+        const auto append_values = [&content](std::initializer_list<float> values) {
+            bool is_first = true;
+            for (const auto v : values) { if (is_first == false) { content += ' '; } append_float(content, v); is_first = false; }
+            content += '\n';
+        };
+        // always by reference: the text format has no room for the values of embedded sources
+        content += "[Data Sources]\n";
+        for (const auto &d : project.data_sources) {
+            if (d.is_scattered) { continue; }
+            content += d.name + ' ' + std::to_string(static_cast<uint32_t>(d.sampling));
+            for (int i = 0; i < 4; ++i) { content += ' '; append_float(content, d.domain[i]); }
+            content += ' ' + d.path + '\n';
+        }
+        content += "[Scattered Data]\n";
+        for (const auto &d : project.data_sources) {
+            if (d.is_scattered == false) { continue; }
+            const auto &ss = d.scattered_settings;
+            content += d.name + ' ' + std::to_string(static_cast<uint32_t>(d.sampling)) + ' ' + std::to_string(static_cast<uint32_t>(ss.interpolation)) + ' ' +
+                       std::to_string(ss.neighbours) + ' ';
+            append_float(content, ss.power);
+            content += ' ' + d.path + '\n';
+        }
+        content += "[Color Settings]\n";
+        for (const auto &c : {ps.color_background, ps.color_grid, ps.color_plane, ps.color_plane_grid}) { append_vec4(content, c); }
+        content += "[Plane Settings]\n";
+        append_values({(float)ps.bounds, (float)ps.detail, ps.grid_step, ps.grid_line_thickness, (float)ps.is_detail_affecting_grid_step});
+        content += "[Render Settings]\n";
+        append_values({(float)ps.is_grid_rendered, (float)ps.is_plane_grid_rendered, (float)ps.is_render_on_demand, ps.target_fps,
+                       ps.unfocused_target_fps, (float)ps.is_dynamic_resolution, ps.gpu_frame_budget_ms, ps.min_resolution_scale});
+        content += "[Editor Settings]\n";
+        content += std::to_string(ps.font_idx) + '\n';
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+    // Splits a line into whitespace separated tokens without allocating
+    struct Tokens {
+        std::string_view rest;
+
+        std::string_view next() {
+            const auto begin = rest.find_first_not_of(" \t");
+            if (begin == std::string_view::npos) { rest = {}; return {}; }
+            const auto end = rest.find_first_of(" \t", begin);
+            const auto token = rest.substr(begin, end - begin);
+            rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end);
+            return token;
+        }
+        template <typename T>
+        bool read(T &value) {
+            const auto token = next();
+            if (token.empty()) { return false; }
+            if constexpr (std::is_same_v<T, bool>) {
+                int v;
+                if (std::from_chars(token.data(), token.data() + token.size(), v).ec != std::errc{}) { return false; }
+                value = v != 0;
+            } else if constexpr (std::is_integral_v<T>) {
+                // integers written by older versions through a float stream may carry a fraction
+                double v;
+                if (std::from_chars(token.data(), token.data() + token.size(), v).ec != std::errc{}) { return false; }
+                value = static_cast<T>(v);
+            } else {
+                if (std::from_chars(token.data(), token.data() + token.size(), value).ec != std::errc{}) { return false; }
+            }
+            return true;
+        }
+    };
+
+    static void load_project_text(std::string_view text, Project &project) {
+        enum Section { None, Functions, Constants, Sliders, Colors, Plane, Render, Editor, Surfaces, DataSources, Scattered };
+        static const std::pair<std::string_view, Section> LABELS[] = {
+            {"[Functions]", Functions}, {"[Constants]", Constants},     {"[Sliders]", Sliders}, {"[Color Settings]", Colors},
+            {"[Plane Settings]", Plane}, {"[Render Settings]", Render}, {"[Editor Settings]", Editor}, {"[Surfaces]", Surfaces},
+            {"[Data Sources]", DataSources}, {"[Scattered Data]", Scattered},
+        };
+
+        auto &ps = project.settings;
+        project.functions.clear();
+        project.constants.clear();
+        project.sliders.clear();
+        project.data_sources.clear();
+        auto section = None;
+        uint32_t line_in_section = 0;
+        bool has_surfaces_section = false;
+        while (text.empty() == false) {
+            const auto end = text.find('\n');
+            auto line = text.substr(0, end);
+            text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+            if (line.empty() == false && line.back() == '\r') { line.remove_suffix(1); }
+
+            bool is_label = false;
+            for (const auto &[label, id] : LABELS) {
+                if (line.starts_with(label)) { section = id; line_in_section = 0; is_label = true; break; }
+            }
+            if (is_label) { has_surfaces_section |= section == Surfaces; continue; }
+            if (section == None) { throw std::runtime_error{"Error while reading the project file - label not found: " + std::string{line}}; }
+
+            Tokens tokens{line};
+            switch (section) {
+            case Functions: {
+                // the equation is the rest of the line, spaces included
+                const auto name_end = line.find(' ');
+                Function f;
+                f.name  = std::string{line.substr(0, name_end)};
+                f.value = name_end == std::string_view::npos ? std::string{} : std::string{line.substr(name_end + 1)};
+                project.functions.push_back(std::move(f));
+                break;
+            }
+            case Constants: {
+                Constant c;
+                c.name = std::string{tokens.next()};
+                tokens.read(c.value);
+                project.constants.push_back(std::move(c));
+                break;
+            }
+            case Sliders: {
+                Slider s;
+                s.name = std::string{tokens.next()};
+                tokens.read(s.value); tokens.read(s.min); tokens.read(s.max);
+                project.sliders.push_back(std::move(s));
+                break;
+            }
+            case Colors: {
+                glm::vec4 *colors[] = {&ps.color_background, &ps.color_grid, &ps.color_plane, &ps.color_plane_grid};
+                if (line_in_section < 4) { for (int i = 0; i < 4; ++i) { tokens.read((*colors[line_in_section])[i]); } }
+                break;
+            }
+            case Plane:
+                tokens.read(ps.bounds); tokens.read(ps.detail); tokens.read(ps.grid_step); tokens.read(ps.grid_line_thickness);
+                tokens.read(ps.is_detail_affecting_grid_step);
+                break;
+            case Render:
+                // settings added later are absent in older projects and keep their values
+                tokens.read(ps.is_grid_rendered) && tokens.read(ps.is_plane_grid_rendered) && tokens.read(ps.is_render_on_demand) &&
+                    tokens.read(ps.target_fps) && tokens.read(ps.unfocused_target_fps) && tokens.read(ps.is_dynamic_resolution) &&
+                    tokens.read(ps.gpu_frame_budget_ms) && tokens.read(ps.min_resolution_scale);
+                break;
+            case Editor:
+                tokens.read(ps.font_idx);
+                break;
+            case Surfaces: {
+                const auto name = tokens.next();
+                glm::vec4 color;
+                for (int i = 0; i < 4; ++i) { tokens.read(color[i]); }
+                for (auto &f : project.functions) {
+                    if (f.name == name) { f.is_surface = true; f.color = color; }
+                }
+                break;
+            }
+            case DataSources: {
+                DataSource d;
+                d.name = std::string{tokens.next()};
+                uint32_t sampling = 0;
+                tokens.read(sampling);
+                d.sampling = sampling == 1 ? DataSampling::Bicubic : DataSampling::Bilinear;
+                for (int i = 0; i < 4; ++i) { tokens.read(d.domain[i]); }
+                // the path is the rest of the line, spaces included
+                const auto path_begin = tokens.rest.find_first_not_of(" \t");
+                d.path = path_begin == std::string_view::npos ? std::string{} : std::string{tokens.rest.substr(path_begin)};
+                project.data_sources.push_back(std::move(d));
+                break;
+            }
+            case Scattered: {
+                DataSource d{.is_scattered = true};
+                d.name = std::string{tokens.next()};
+                uint32_t sampling = 0, interpolation = 0;
+                tokens.read(sampling);
+                tokens.read(interpolation);
+                d.sampling = sampling == 1 ? DataSampling::Bicubic : DataSampling::Bilinear;
+                d.scattered_settings.interpolation = static_cast<ScatteredInterpolation>(std::min(interpolation, 2u));
+                tokens.read(d.scattered_settings.neighbours);
+                tokens.read(d.scattered_settings.power);
+                const auto path_begin = tokens.rest.find_first_not_of(" \t");
+                d.path = path_begin == std::string_view::npos ? std::string{} : std::string{tokens.rest.substr(path_begin)};
+                project.data_sources.push_back(std::move(d));
+                break;
+            }
+            case None: break;
+            }
+            ++line_in_section;
+        }
+
+        // projects saved before surfaces existed only ever drew "f" with the plane color
+        if (has_surfaces_section == false) {
+            for (auto &f : project.functions) {
+                if (f.name == "f") { f.is_surface = true; f.color = ps.color_plane; }
+            }
+        }
+    }
+
+    /* Binary format */
+
+    enum class SectionId : uint32_t { Strings = 1, Functions, Constants, Sliders, Settings, Snapshot, DataSources, DataBlobs };
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t section_count;
+        uint32_t reserved;
+    };
+    struct SectionEntry {
+        SectionId id;
+        uint32_t record_size; // 0 for byte blobs
+        uint64_t offset, size;
+    };
+    struct StringRef {
+        uint32_t offset, length;
+    };
+    struct FunctionRecord {
+        StringRef name, value;
+        glm::vec4 color;
+        uint32_t is_surface;
+    };
+    struct ConstantRecord {
+        StringRef name;
+        float value;
+    };
+    struct SliderRecord {
+        StringRef name;
+        float value, min, max;
+    };
+    struct DataSourceRecord {
+        StringRef name, path;
+        uint32_t sampling, is_embedded;
+        glm::vec4 domain;
+        uint32_t width, height;          // embedded sources only, their values are a HeightFieldCodec stream in DataBlobs
+        uint64_t blob_offset, blob_size;
+        uint32_t is_scattered;           // embedded scattered points are DataPoint records in DataBlobs instead
+        uint32_t interpolation, neighbours;
+        float power;
+    };
+    static_assert(std::is_trivially_copyable_v<ProjectSettings>);
+
+    // Deduplicates strings into one blob
+    struct StringTable {
+        std::string blob;
+        std::unordered_map<std::string, StringRef> refs;
+
+        StringRef intern(const std::string &s) {
+            auto [it, inserted] = refs.try_emplace(s, StringRef{static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(s.size())});
+            if (inserted) { blob += s; }
+            return it->second;
+        }
+    };
+
+    void save_project_binary(const std::string &path, const Project &project) {
+        StringTable strings;
+        std::vector<FunctionRecord> functions;
+        std::vector<ConstantRecord> constants;
+        std::vector<SliderRecord> sliders;
+        for (const auto &f : project.functions) {
+            functions.push_back({strings.intern(f.name), strings.intern(f.value), f.color, f.is_surface});
+        }
+        for (const auto &c : project.constants) { constants.push_back({strings.intern(c.name), c.value}); }
+        for (const auto &s : project.sliders) { sliders.push_back({strings.intern(s.name), s.value, s.min, s.max}); }
+        std::vector<DataSourceRecord> data_sources;
+        std::vector<uint8_t> data_blobs;
+        for (const auto &d : project.data_sources) {
+            const auto &ss = d.scattered_settings;
+            DataSourceRecord r{strings.intern(d.name), strings.intern(d.path), static_cast<uint32_t>(d.sampling), 0, d.domain, 0, 0, 0, 0,
+                               d.is_scattered, static_cast<uint32_t>(ss.interpolation), ss.neighbours, ss.power};
+            if (d.is_embedded && d.is_scattered && d.points != nullptr) {
+                const auto *bytes = reinterpret_cast<const uint8_t *>(d.points->points.data());
+                r.is_embedded = 1;
+                r.blob_offset = data_blobs.size();
+                r.blob_size   = d.points->points.size() * sizeof(DataPoint);
+                data_blobs.insert(data_blobs.end(), bytes, bytes + r.blob_size);
+            } else if (d.is_embedded && d.is_scattered == false && d.grid != nullptr) {
+                const auto stream = HeightFieldCodec::encode(d.grid->values.data(), d.grid->width, d.grid->height, 1);
+                r.is_embedded = 1;
+                r.width       = d.grid->width;
+                r.height      = d.grid->height;
+                r.blob_offset = data_blobs.size();
+                r.blob_size   = stream.size();
+                data_blobs.insert(data_blobs.end(), stream.begin(), stream.end());
+            }
+            data_sources.push_back(r);
+        }
+
+        struct Pending { SectionId id; uint32_t record_size; const void *data; size_t size; };
+        const Pending sections[] = {
+            {SectionId::Strings, 0, strings.blob.data(), strings.blob.size()},
+            {SectionId::Functions, sizeof(FunctionRecord), functions.data(), functions.size() * sizeof(FunctionRecord)},
+            {SectionId::Constants, sizeof(ConstantRecord), constants.data(), constants.size() * sizeof(ConstantRecord)},
+            {SectionId::Sliders, sizeof(SliderRecord), sliders.data(), sliders.size() * sizeof(SliderRecord)},
+            {SectionId::Settings, sizeof(ProjectSettings), &project.settings, sizeof(ProjectSettings)},
+            {SectionId::DataSources, sizeof(DataSourceRecord), data_sources.data(), data_sources.size() * sizeof(DataSourceRecord)},
+            {SectionId::DataBlobs, 0, data_blobs.data(), data_blobs.size()},
+            {SectionId::Snapshot, 0, project.snapshot.data(), project.snapshot.size()},
+        };
+        // an empty snapshot section is simply left out
+        const auto SECTION_COUNT = project.snapshot.empty() ? std::size(sections) - 1 : std::size(sections);
+
+        const auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t{7}; };
+        FileHeader header{};
+        std::memcpy(header.magic, PROJECT_MAGIC, sizeof(header.magic));
+        header.version       = PROJECT_VERSION;
+        header.section_count = SECTION_COUNT;
+
+        SectionEntry table[std::size(sections)];
+        auto offset = align(sizeof(FileHeader) + SECTION_COUNT * sizeof(SectionEntry));
+        for (size_t i = 0; i < SECTION_COUNT; ++i) {
+            table[i] = {sections[i].id, sections[i].record_size, offset, sections[i].size};
+            offset = align(offset + sections[i].size);
+        }
+
+        std::vector<uint8_t> bytes(offset, 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + sizeof(header), table, SECTION_COUNT * sizeof(SectionEntry));
+        for (size_t i = 0; i < SECTION_COUNT; ++i) {
+            if (sections[i].size > 0) { std::memcpy(bytes.data() + table[i].offset, sections[i].data, sections[i].size); }
+        }
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    static void load_project_binary(const uint8_t *data, size_t size, Project &project) {
+        const auto fail = [](const std::string &what) { throw std::runtime_error{"Malformed project file: " + what}; };
+        if (size < sizeof(FileHeader)) { fail("truncated header"); }
+        FileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.version == 0 || header.version > PROJECT_VERSION) { fail("unsupported version " + std::to_string(header.version)); }
+        if (header.section_count > (size - sizeof(FileHeader)) / sizeof(SectionEntry)) { fail("truncated section table"); }
+
+        std::string_view strings;
+        const uint8_t *records[9]{};
+        SectionEntry entries[9]{};
+        for (uint32_t i = 0; i < header.section_count; ++i) {
+            SectionEntry entry;
+            std::memcpy(&entry, data + sizeof(FileHeader) + i * sizeof(SectionEntry), sizeof(entry));
+            if (entry.offset > size || entry.size > size - entry.offset) { fail("section out of bounds"); }
+            const auto id = static_cast<uint32_t>(entry.id);
+            if (id >= std::size(entries)) { continue; } // written by a newer version
+            const auto is_blob = entry.id == SectionId::Strings || entry.id == SectionId::Snapshot || entry.id == SectionId::DataBlobs;
+            if (is_blob == false && (entry.record_size == 0 || entry.size % entry.record_size != 0)) { fail("bad record size"); }
+            entries[id] = entry;
+            records[id] = data + entry.offset;
+            if (entry.id == SectionId::Strings) { strings = {reinterpret_cast<const char *>(records[id]), static_cast<size_t>(entry.size)}; }
+        }
+
+        const auto string = [&](StringRef ref) {
+            if (ref.offset > strings.size() || ref.length > strings.size() - ref.offset) { fail("string out of bounds"); }
+            return std::string{strings.substr(ref.offset, ref.length)};
+        };
+        // copies the prefix both versions know, fields this version added keep the values of `record`
+        const auto for_each_record = [&](SectionId id, auto record, auto &&consume) {
+            const auto &entry = entries[static_cast<uint32_t>(id)];
+            const auto known = std::min<size_t>(entry.record_size, sizeof(record));
+            for (uint64_t offset = 0; offset < entry.size; offset += entry.record_size) {
+                auto r = record;
+                std::memcpy(&r, records[static_cast<uint32_t>(id)] + offset, known);
+                consume(r);
+            }
+        };
+
+        project.functions.clear();
+        project.constants.clear();
+        project.sliders.clear();
+        project.data_sources.clear();
+        project.functions.reserve(entries[static_cast<uint32_t>(SectionId::Functions)].size / sizeof(FunctionRecord));
+        for_each_record(SectionId::Functions, FunctionRecord{}, [&](const FunctionRecord &r) {
+            project.functions.push_back(Function{.name = string(r.name), .value = string(r.value), .is_surface = r.is_surface != 0, .color = r.color});
+        });
+        for_each_record(SectionId::Constants, ConstantRecord{}, [&](const ConstantRecord &r) {
+            project.constants.push_back(Constant{.name = string(r.name), .value = r.value});
+        });
+        for_each_record(SectionId::Sliders, SliderRecord{}, [&](const SliderRecord &r) {
+            Slider s{string(r.name), r.value};
+            s.min = r.min;
+            s.max = r.max;
+            project.sliders.push_back(std::move(s));
+        });
+        const auto &blobs = entries[static_cast<uint32_t>(SectionId::DataBlobs)];
+        for_each_record(SectionId::DataSources, DataSourceRecord{}, [&](const DataSourceRecord &r) {
+            DataSource d{.name = string(r.name), .path = string(r.path), .sampling = r.sampling == 1 ? DataSampling::Bicubic : DataSampling::Bilinear,
+                         .domain = r.domain, .is_embedded = r.is_embedded != 0, .is_scattered = r.is_scattered != 0,
+                         .scattered_settings = {static_cast<ScatteredInterpolation>(std::min(r.interpolation, 2u)), r.neighbours, r.power}};
+            if (d.is_embedded && d.is_scattered) {
+                if (r.blob_offset > blobs.size || r.blob_size > blobs.size - r.blob_offset || r.blob_size % sizeof(DataPoint) != 0) { fail("scattered data out of bounds"); }
+                std::vector<DataPoint> points(r.blob_size / sizeof(DataPoint));
+                std::memcpy(points.data(), records[static_cast<uint32_t>(SectionId::DataBlobs)] + r.blob_offset, r.blob_size);
+                d.points = std::make_shared<const ScatteredData>(build_scattered_data(std::move(points)));
+            } else if (d.is_embedded) {
+                if (r.blob_offset > blobs.size || r.blob_size > blobs.size - r.blob_offset) { fail("data source out of bounds"); }
+                auto values = HeightFieldCodec::decode(records[static_cast<uint32_t>(SectionId::DataBlobs)] + r.blob_offset, r.blob_size);
+                if (values.size() != static_cast<size_t>(r.width) * r.height) { fail("data source does not match its size"); }
+                d.grid = std::make_shared<const DataGrid>(DataGrid{r.width, r.height, std::move(values)});
+            }
+            project.data_sources.push_back(std::move(d));
+        });
+        for_each_record(SectionId::Settings, project.settings, [&](const ProjectSettings &r) { project.settings = r; });
+        const auto &snapshot = entries[static_cast<uint32_t>(SectionId::Snapshot)];
+        const auto *snapshot_data = records[static_cast<uint32_t>(SectionId::Snapshot)];
+        project.snapshot.assign(snapshot_data, snapshot_data + (snapshot_data != nullptr ? snapshot.size : 0));
+    }
+
+    // Everything sized from the plane (buffers of (detail + 1)^2 values, the grid step) trusts these
+    static void validate_settings(const ProjectSettings &ps) {
+        const auto fail = [](const std::string &what) { throw std::runtime_error{"Malformed project file: " + what}; };
+        if (ps.detail < 1 || ps.detail > PROJECT_MAX_DETAIL) { fail("detail " + std::to_string(ps.detail) + " is outside 1.." + std::to_string(PROJECT_MAX_DETAIL)); }
+        if (ps.bounds < 1 || ps.bounds > PROJECT_MAX_BOUNDS) { fail("bounds " + std::to_string(ps.bounds) + " are outside 1.." + std::to_string(PROJECT_MAX_BOUNDS)); }
+        if (std::isfinite(ps.grid_step) == false || ps.grid_step <= 0.0f) { fail("grid step " + std::to_string(ps.grid_step) + " is not a positive number"); }
+    }
+
+    void load_project(const std::string &path, Project &project) {
+        const MappedFile file{path};
+        if (file.size() >= sizeof(PROJECT_MAGIC) && std::memcmp(file.data(), PROJECT_MAGIC, sizeof(PROJECT_MAGIC)) == 0) {
+            load_project_binary(file.data(), file.size(), project);
+        } else {
+            load_project_text({reinterpret_cast<const char *>(file.data()), file.size()}, project);
+            project.snapshot.clear();
+        }
+        validate_settings(project.settings);
+    }
+
+    std::vector<std::string> load_data_sources(const std::string &project_path, std::vector<DataSource> &data_sources) {
+        std::vector<std::string> errors;
+        for (auto &d : data_sources) {
+            if (d.grid != nullptr || d.points != nullptr || d.path.empty()) { continue; }
+            auto path = std::filesystem::path(d.path);
+            if (path.is_relative()) { path = std::filesystem::path(project_path).parent_path() / path; }
+            try {
+                if (d.is_scattered) { d.points = std::make_shared<const ScatteredData>(build_scattered_data(load_data_points(path.string()))); }
+                else                { d.grid = std::make_shared<const DataGrid>(load_data_grid(path.string())); }
+            } catch (const std::exception &err) {
+                errors.push_back("Data source '" + d.name + "': " + err.what());
+            }
+        }
+        return errors;
+    }
+
+} // namespace g3d
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <project.hpp>
+
+namespace g3d {
+/* Definitions */
+    // Read-only view of a whole file mapped into memory. Throws std::runtime_error when it cannot be opened.
+    struct MappedFile {
+        explicit MappedFile(const std::string &path);
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const uint8_t *data() const { return _data; }
+        size_t size() const { return _size; }
+
+      private:
+        const uint8_t *_data{nullptr};
+        size_t _size{0};
+        void *_file{nullptr}, *_mapping{nullptr}; // platform handles
+    };
+
+    // The text format is the line based ".3dg"; the binary one starts with PROJECT_MAGIC and holds a section
+    // table, one string table every name and equation points into, and fixed-size records that carry their
+    // own size, so older and newer readers copy the prefix they know and skip sections they do not.
+    inline constexpr char PROJECT_MAGIC[4] = {'G', '3', 'D', 'P'};
+    inline constexpr uint32_t PROJECT_VERSION = 1;
+    // The plane a project may ask for, as the settings panel offers it
+    inline constexpr uint32_t PROJECT_MAX_DETAIL = 1000, PROJECT_MAX_BOUNDS = 100;
+
+    // Both throw std::runtime_error when the file cannot be written
+    void save_project_text(const std::string &path, const Project &project);
+    void save_project_binary(const std::string &path, const Project &project);
+    // Detects the format from the first bytes. Settings the file does not store keep the values `project`
+    // comes in with; functions, sliders and constants are replaced. Throws std::runtime_error on malformed files
+    // and on settings outside the ranges above (or a grid step that is not a positive number).
+    void load_project(const std::string &path, Project &project);
+    // Reads the data sources a loaded project references by path and did not embed, relative paths from the folder of
+    // `project_path`. A source that cannot be read stays null; the returned messages name it and the reason.
+    std::vector<std::string> load_data_sources(const std::string &project_path, std::vector<DataSource> &data_sources);
+} // namespace g3d
@@ -2,6 +2,10 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glad/glad.h>
 
 namespace g3d {
 
@@ -16,4 +20,194 @@ namespace g3d {
         memcpy(this->title, title, len);
     }
 
+    static uint64_t make_sort_key(const RenderState &state) {
+        return (static_cast<uint64_t>(state.program) << 32) | static_cast<uint64_t>(state.vao);
+    }
+
+    void Renderer::draw_arrays(const RenderState &state, uint32_t mode, uint32_t first, uint32_t count, uint32_t instance_count) {
+        commands.push_back(DrawCommand{.sort_key = make_sort_key(state), .state = state, .mode = mode,
+                                       .first = first, .count = count, .instance_count = instance_count,
+                                       .type = DrawCommand::Type::Arrays});
+    }
+
+    void Renderer::draw_elements(const RenderState &state, uint32_t mode, uint32_t count, uint32_t instance_count, uint32_t first) {
+        commands.push_back(DrawCommand{.sort_key = make_sort_key(state), .state = state, .mode = mode,
+                                       .first = first, .count = count, .instance_count = instance_count,
+                                       .type = DrawCommand::Type::Elements});
+    }
+
+    void Renderer::draw_elements_indirect(const RenderState &state, uint32_t mode, HandleBuffer indirect_buffer, uint32_t draw_count, uint32_t offset) {
+        commands.push_back(DrawCommand{.sort_key = make_sort_key(state), .state = state, .mode = mode,
+                                       .first = offset, .count = draw_count, .instance_count = 1,
+                                       .indirect_buffer = indirect_buffer,
+                                       .type = DrawCommand::Type::ElementsIndirect});
+    }
+
+    void Renderer::render() {
+        // Compute dispatches and ImGui bind their own programs and vaos between frames,
+        // so the shadow state is only trusted within a single submission.
+        _is_shadow_state_valid = false;
+        _shadow_indirect_buffer = ~0u;
+
+        std::stable_sort(commands.begin(), commands.end(), [](const DrawCommand &a, const DrawCommand &b) {
+            return a.sort_key < b.sort_key;
+        });
+
+        for (const auto &cmd : commands) {
+            if (cmd.instance_count == 0 || cmd.count == 0) { continue; }
+            _apply_state(cmd.state);
+
+            switch (cmd.type) {
+            case DrawCommand::Type::Arrays: {
+                glDrawArraysInstanced(cmd.mode, cmd.first, cmd.count, cmd.instance_count);
+                break;
+            }
+            case DrawCommand::Type::Elements: {
+                const auto offset = static_cast<uintptr_t>(cmd.first) * sizeof(uint32_t);
+                glDrawElementsInstanced(cmd.mode, cmd.count, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset), cmd.instance_count);
+                break;
+            }
+            case DrawCommand::Type::ElementsIndirect: {
+                if (_shadow_indirect_buffer != cmd.indirect_buffer) {
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cmd.indirect_buffer);
+                    _shadow_indirect_buffer = cmd.indirect_buffer;
+                }
+                const auto offset = static_cast<uintptr_t>(cmd.first);
+                glMultiDrawElementsIndirect(cmd.mode, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset), cmd.count, sizeof(DrawElementsIndirectCommand));
+                break;
+            }
+            }
+        }
+        commands.clear();
+    }
+
+    void Renderer::_apply_state(const RenderState &state) {
+        if (_is_shadow_state_valid == false || _shadow_state.vao != state.vao) { glBindVertexArray(state.vao); }
+        if (_is_shadow_state_valid == false || _shadow_state.program != state.program) { glUseProgram(state.program); }
+        if (_is_shadow_state_valid == false || _shadow_state.line_width != state.line_width) { glLineWidth(state.line_width); }
+
+        _shadow_state = state;
+        _is_shadow_state_valid = true;
+    }
+
+    Texture RenderTargetPool::acquire(uint32_t target, uint32_t format, uint32_t width, uint32_t height) {
+        auto best = free_textures.end();
+        for (auto it = free_textures.begin(); it != free_textures.end(); ++it) {
+            if (it->target != target || it->format != format || it->width < width || it->height < height) { continue; }
+            if (best == free_textures.end() || it->width * it->height < best->width * best->height) { best = it; }
+        }
+        if (best != free_textures.end()) {
+            const auto texture = *best;
+            free_textures.erase(best);
+            return texture;
+        }
+
+        const auto round_up = [](uint32_t v) { return (std::max(v, 1u) + GRANULARITY - 1) / GRANULARITY * GRANULARITY; };
+        Texture texture{.target = target, .format = format, .width = round_up(width), .height = round_up(height)};
+        glCreateTextures(target, 1, &texture.handle);
+        glTextureStorage2D(texture.handle, 1, format, texture.width, texture.height);
+        glTextureParameteri(texture.handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture.handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    void RenderTargetPool::release(const Texture &texture) {
+        if (texture.handle == 0) { return; }
+        free_textures.push_back(texture);
+        if (free_textures.size() > MAX_FREE_TEXTURES) {
+            glDeleteTextures(1, &free_textures.front().handle);
+            free_textures.erase(free_textures.begin());
+        }
+    }
+
+    void GpuTimer::create() { glCreateQueries(GL_TIME_ELAPSED, LATENCY, _queries); }
+
+    void GpuTimer::begin() {
+        const auto idx = _frame % LATENCY;
+        has_new_result = false;
+        if (_is_pending[idx]) {
+            // issued LATENCY frames ago, the result is practically always available by now
+            uint64_t elapsed_ns = 0;
+            glGetQueryObjectui64v(_queries[idx], GL_QUERY_RESULT, &elapsed_ns);
+            elapsed_ms = static_cast<float>(elapsed_ns) * 1e-6f;
+            has_new_result = true;
+            _is_pending[idx] = false;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, _queries[idx]);
+    }
+
+    void GpuTimer::end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        _is_pending[_frame % LATENCY] = true;
+        ++_frame;
+    }
+
+    void BufferReadback::request(HandleBuffer source, uint64_t offset, uint64_t size) {
+        if (_fence != nullptr) { glDeleteSync(_fence); _fence = nullptr; }
+        if (size > _capacity) {
+            glDeleteBuffers(1, &_staging);
+            glCreateBuffers(1, &_staging);
+            glNamedBufferStorage(_staging, size, nullptr, GL_CLIENT_STORAGE_BIT);
+            _capacity = size;
+        }
+        _size = size;
+        glCopyNamedBufferSubData(source, _staging, offset, 0, size);
+        _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool BufferReadback::poll(std::vector<uint8_t> &data) {
+        if (_fence == nullptr) { return false; }
+        const auto status = glClientWaitSync(_fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { return false; }
+        glDeleteSync(_fence);
+        _fence = nullptr;
+
+        data.resize(_size);
+        glGetNamedBufferSubData(_staging, 0, _size, data.data());
+        return true;
+    }
+
+    HandleProgram create_program(std::initializer_list<ShaderStage> stages) {
+        const auto info_log = [](uint32_t object, bool is_program) {
+            int length = 0;
+            if (is_program) { glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length); }
+            else            { glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length); }
+            std::string log(std::max(length, 1), '\0');
+            if (is_program) { glGetProgramInfoLog(object, length, &length, log.data()); }
+            else            { glGetShaderInfoLog(object, length, &length, log.data()); }
+            return log;
+        };
+
+        const auto program = glCreateProgram();
+        std::vector<HandleShader> shaders;
+        for (const auto &stage : stages) {
+            const auto shader = glCreateShader(stage.type);
+            glShaderSource(shader, 1, &stage.source, nullptr);
+            glCompileShader(shader);
+            glAttachShader(program, shader);
+            shaders.push_back(shader);
+
+            int status = GL_FALSE;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+            if (status != GL_TRUE) {
+                const auto log = info_log(shader, false);
+                for (auto s : shaders) { glDeleteShader(s); }
+                glDeleteProgram(program);
+                throw std::runtime_error{log};
+            }
+        }
+
+        glLinkProgram(program);
+        for (auto s : shaders) { glDetachShader(program, s); glDeleteShader(s); }
+
+        int status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            const auto log = info_log(program, true);
+            glDeleteProgram(program);
+            throw std::runtime_error{log};
+        }
+        return program;
+    }
+
 }
\ No newline at end of file
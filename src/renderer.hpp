@@ -1,9 +1,11 @@
 #pragma once
 #include <cstdint>
+#include <initializer_list>
 #include <string>
 #include <vector>
 
 struct GLFWwindow;
+struct __GLsync;
 
 namespace g3d {
 /* Forward Declarations */
@@ -12,6 +14,8 @@ namespace g3d {
     struct Texture;
     struct RenderState;
     struct Renderer;
+    struct RenderTargetPool;
+    struct GpuTimer;
 
 /* Typedefs */
     typedef uint32_t HandleVao;
@@ -20,6 +24,7 @@ namespace g3d {
     typedef uint32_t HandleFramebuffer;
     typedef uint32_t HandleShader;
     typedef uint32_t HandleProgram;
+    typedef __GLsync *HandleFence;
 
 /* Definitions */
     struct Window {
@@ -33,6 +38,7 @@ namespace g3d {
     };
     struct Framebuffer {
         uint32_t handle{0};
+        uint32_t width{0}, height{0}; // area in use, attached textures may be larger
         std::vector<std::pair<uint32_t, Texture*>> textures;
     };
     struct Texture {
@@ -41,11 +47,88 @@ namespace g3d {
         uint32_t width{0}, height{0};
     };
     struct RenderState {
-        HandleVao vao;
-        HandleProgram program;
+        HandleVao vao{0};
+        HandleProgram program{0};
         float line_width{1.0};
     };
+    // Layout mandated by glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        uint32_t count{0}, instance_count{0};
+        uint32_t first_index{0};
+        int32_t base_vertex{0};
+        uint32_t base_instance{0};
+    };
+    struct DrawCommand {
+        enum class Type : uint8_t { Arrays, Elements, ElementsIndirect };
+
+        uint64_t sort_key{0}; // program in the high half, vao in the low half
+        RenderState state;
+        uint32_t mode{0};
+        uint32_t first{0}, count{0}, instance_count{1}; // for indirect draws: byte offset, draw count, unused
+        HandleBuffer indirect_buffer{0};
+        Type type{Type::Arrays};
+    };
+    // Passes record draws against a RenderState; render() sorts them by program and vao
+    // and submits them, touching GL state only when it differs from what is already bound.
     struct Renderer {
+        void draw_arrays(const RenderState &state, uint32_t mode, uint32_t first, uint32_t count, uint32_t instance_count = 1);
+        void draw_elements(const RenderState &state, uint32_t mode, uint32_t count, uint32_t instance_count = 1, uint32_t first = 0);
+        void draw_elements_indirect(const RenderState &state, uint32_t mode, HandleBuffer indirect_buffer, uint32_t draw_count, uint32_t offset = 0);
         void render();
+
+        std::vector<DrawCommand> commands;
+
+      private:
+        void _apply_state(const RenderState &state);
+
+        RenderState _shadow_state;
+        HandleBuffer _shadow_indirect_buffer{0};
+        bool _is_shadow_state_valid{false};
+    };
+    // Recycles texture storage. Requests are rounded up to GRANULARITY and served by the smallest
+    // released texture that fits, so resizes and scale changes rarely allocate.
+    struct RenderTargetPool {
+        static constexpr uint32_t GRANULARITY = 256;
+        static constexpr uint32_t MAX_FREE_TEXTURES = 4;
+
+        Texture acquire(uint32_t target, uint32_t format, uint32_t width, uint32_t height);
+        void release(const Texture &texture);
+
+        std::vector<Texture> free_textures;
+    };
+    // Time spent by the GPU between begin() and end(), read back LATENCY frames later so it never stalls.
+    struct GpuTimer {
+        static constexpr uint32_t LATENCY = 3;
+
+        void create();
+        void begin();
+        void end();
+
+        float elapsed_ms{0.0f};
+        bool has_new_result{false};
+
+      private:
+        uint32_t _queries[LATENCY]{};
+        bool _is_pending[LATENCY]{};
+        uint32_t _frame{0};
+    };
+    // Copies a buffer range into staging storage and hands it to the CPU once a fence says the copy is done,
+    // so the frame never waits on the GPU. A new request replaces one that is still in flight.
+    struct BufferReadback {
+        void request(HandleBuffer source, uint64_t offset, uint64_t size);
+        bool poll(std::vector<uint8_t> &data);
+        bool is_pending() const { return _fence != nullptr; }
+
+      private:
+        HandleBuffer _staging{0};
+        uint64_t _capacity{0}, _size{0};
+        HandleFence _fence{nullptr};
+    };
+
+    struct ShaderStage {
+        uint32_t type; // GL_VERTEX_SHADER, GL_COMPUTE_SHADER...
+        const char *source;
     };
+    // Compiles and links the stages into a new program. Throws std::runtime_error with the info log on failure.
+    HandleProgram create_program(std::initializer_list<ShaderStage> stages);
 } // namespace g3d
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    Curve sample_cross_section(const Program &program, const double *parameters, SliceAxis axis, double position,
+                               double t_min, double t_max, const CurveSamplingSettings &settings) {
+        std::vector<double> xs, zs;
+        const auto evaluate_at = [&](const std::vector<double> &ts, std::vector<double> &ys) {
+            xs.assign(ts.size(), position);
+            zs.assign(ts.size(), position);
+            (axis == SliceAxis::ConstantX ? zs : xs) = ts;
+            ys.resize(ts.size());
+            evaluate_batch(program, xs.data(), zs.data(), parameters, ys.data(), ts.size());
+        };
+
+        Curve curve;
+        const auto initial = std::max(settings.initial_points, 2u);
+        for (uint32_t i = 0; i < initial; ++i) { curve.t.push_back(t_min + (t_max - t_min) * i / (initial - 1)); }
+        evaluate_at(curve.t, curve.y);
+        std::vector<uint8_t> is_refined(initial - 1, 1); // per interval between consecutive points
+
+        std::vector<double> midpoints, midpoint_values;
+        std::vector<size_t> intervals;
+        for (uint32_t depth = 0; depth < settings.max_depth; ++depth) {
+            double y_min = INFINITY, y_max = -INFINITY;
+            for (const auto y : curve.y) {
+                if (std::isfinite(y)) { y_min = std::min(y_min, y); y_max = std::max(y_max, y); }
+            }
+            const auto tolerance = settings.tolerance * std::max(y_max - y_min, 1e-12);
+
+            midpoints.clear();
+            intervals.clear();
+            for (size_t i = 0; i < is_refined.size(); ++i) {
+                if (is_refined[i] == 0) { continue; }
+                if (curve.t.size() + midpoints.size() >= settings.max_points) { break; }
+                midpoints.push_back(0.5 * (curve.t[i] + curve.t[i + 1]));
+                intervals.push_back(i);
+            }
+            if (midpoints.empty()) { break; }
+            evaluate_at(midpoints, midpoint_values);
+
+            // merge the midpoints in and decide which halves need another pass
+            Curve refined;
+            std::vector<uint8_t> refined_flags;
+            size_t next = 0;
+            for (size_t i = 0; i + 1 < curve.t.size(); ++i) {
+                refined.t.push_back(curve.t[i]);
+                refined.y.push_back(curve.y[i]);
+                if (next == intervals.size() || intervals[next] != i) { refined_flags.push_back(0); continue; }
+
+                const auto a = curve.y[i], b = curve.y[i + 1], m = midpoint_values[next];
+                const auto is_finite_edge = std::isfinite(a) != std::isfinite(m) || std::isfinite(m) != std::isfinite(b);
+                const auto needs_refinement = is_finite_edge || (std::isfinite(m) && std::abs(m - 0.5 * (a + b)) > tolerance);
+                refined.t.push_back(midpoints[next]);
+                refined.y.push_back(m);
+                refined_flags.push_back(needs_refinement);
+                refined_flags.push_back(needs_refinement);
+                ++next;
+            }
+            refined.t.push_back(curve.t.back());
+            refined.y.push_back(curve.y.back());
+            curve      = std::move(refined);
+            is_refined = std::move(refined_flags);
+        }
+        return curve;
+    }
+
+    void sample_heatmap(const Program &program, const double *parameters, double bounds, uint32_t resolution, std::vector<double> &values,
+                        const std::atomic<bool> *is_cancelled) {
+        values.resize(static_cast<size_t>(resolution) * resolution);
+        const auto cell = 2.0 * bounds / resolution;
+        global_thread_pool().parallel_for(resolution, [&](size_t row) {
+            if (is_cancelled != nullptr && is_cancelled->load(std::memory_order_relaxed)) { return; }
+            std::vector<double> xs(resolution), zs(resolution, bounds - cell * (row + 0.5));
+            for (uint32_t i = 0; i < resolution; ++i) { xs[i] = -bounds + cell * (i + 0.5); }
+            evaluate_batch(program, xs.data(), zs.data(), parameters, &values[row * resolution], resolution);
+        });
+    }
+
+    PlotSampleJob::~PlotSampleJob() { cancel(); }
+
+    void PlotSampleJob::cancel() {
+        _is_cancelled = true;
+        if (_thread.joinable()) { _thread.join(); }
+        _is_cancelled = false;
+    }
+
+    void PlotSampleJob::start(Program program, std::vector<double> parameters, double bounds, uint32_t resolution, SliceAxis axis, double position,
+                              CurveSamplingSettings curve_settings) {
+        if (_thread.joinable()) { throw std::runtime_error{"The plots are already being sampled"}; }
+
+        _is_finished = false;
+        _thread = std::thread([this, program = std::move(program), parameters = std::move(parameters), bounds, resolution, axis, position, curve_settings] {
+            try {
+                _result.resolution = resolution;
+                sample_heatmap(program, parameters.data(), bounds, resolution, _result.heatmap, &_is_cancelled);
+                _result.curve = sample_cross_section(program, parameters.data(), axis, position, -bounds, bounds, curve_settings);
+
+                _result.heatmap_min = INFINITY;
+                _result.heatmap_max = -INFINITY;
+                for (const auto v : _result.heatmap) {
+                    if (std::isfinite(v)) { _result.heatmap_min = std::min(_result.heatmap_min, v); _result.heatmap_max = std::max(_result.heatmap_max, v); }
+                }
+                if (_result.heatmap_min > _result.heatmap_max) { _result.heatmap_min = _result.heatmap_max = 0.0; }
+                _error.clear();
+            } catch (const std::exception &err) {
+                _error = std::string{"Sampling the plots failed: "} + err.what();
+            }
+            _is_finished = true;
+        });
+    }
+
+    bool PlotSampleJob::poll(PlotSamples &result, std::string &error) {
+        if (_thread.joinable() == false || _is_finished == false) { return false; }
+        _thread.join();
+        error = std::move(_error);
+        if (error.empty()) { result = std::move(_result); }
+        return true;
+    }
+
+} // namespace g3d
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    enum class SliceAxis : uint32_t { ConstantX, ConstantZ };
+
+    struct CurveSamplingSettings {
+        uint32_t initial_points{33};
+        uint32_t max_points{4096};
+        uint32_t max_depth{14};
+        double tolerance{2e-4}; // relative to the value range of the curve
+    };
+    struct Curve {
+        std::vector<double> t, y; // t runs along the free axis
+    };
+
+    // Samples f(position, t) or f(t, position) on [t_min, t_max]. Every pass bisects the intervals whose
+    // midpoint misses the chord by more than the tolerance, so points concentrate where the curvature is
+    // high; intervals crossing into NaN/Inf keep refining to locate the edge of the domain.
+    Curve sample_cross_section(const Program &program, const double *parameters, SliceAxis axis, double position,
+                               double t_min, double t_max, const CurveSamplingSettings &settings);
+
+    // resolution^2 values at cell centers over [-bounds, bounds]^2, row-major with the first row at z = +bounds
+    void sample_heatmap(const Program &program, const double *parameters, double bounds, uint32_t resolution, std::vector<double> &values,
+                        const std::atomic<bool> *is_cancelled = nullptr);
+
+    // What the 2D tab shows of a function: its heatmap and one cross-section
+    struct PlotSamples {
+        uint32_t resolution{0};                    // of the heatmap
+        std::vector<double> heatmap;
+        double heatmap_min{0.0}, heatmap_max{0.0}; // of the finite heatmap values
+        Curve curve;
+    };
+
+    // Samples on a background thread, so animated functions do not stall the UI; poll() hands over the finished
+    // plots, or the message of what sampling threw, in which case `result` is left as it was.
+    struct PlotSampleJob {
+        ~PlotSampleJob();
+
+        void start(Program program, std::vector<double> parameters, double bounds, uint32_t resolution, SliceAxis axis, double position,
+                   CurveSamplingSettings curve_settings);
+        bool poll(PlotSamples &result, std::string &error);
+        // Stops sampling and waits for the thread, nothing is reported for it. Call before the thread pool goes away.
+        void cancel();
+        bool is_running() const { return _thread.joinable(); }
+
+      private:
+        std::thread _thread;
+        std::atomic<bool> _is_finished{false}, _is_cancelled{false};
+        PlotSamples _result;
+        std::string _error;
+    };
+} // namespace g3d
@@ -0,0 +1,271 @@
+#include "scattered_data.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    static double coordinate(const DataPoint &p, uint32_t depth) { return depth % 2 == 0 ? p.x : p.z; }
+
+    // ranges this small stay unsorted and are scanned, which beats descending to single points
+    static constexpr size_t LEAF_SIZE = 8;
+
+    static void build_subtree(DataPoint *points, size_t lo, size_t hi, uint32_t depth) {
+        while (hi - lo > LEAF_SIZE) {
+            const auto mid = lo + (hi - lo) / 2;
+            std::nth_element(points + lo, points + mid, points + hi, [depth](const DataPoint &a, const DataPoint &b) { return coordinate(a, depth) < coordinate(b, depth); });
+            build_subtree(points, lo, mid, depth + 1);
+            lo = mid + 1;
+            ++depth;
+        }
+    }
+
+    ScatteredData build_scattered_data(std::vector<DataPoint> points) {
+        // a NaN coordinate has no place in the tree
+        std::erase_if(points, [](const DataPoint &p) { return std::isfinite(p.x) == false || std::isfinite(p.z) == false || std::isfinite(p.y) == false; });
+        if (points.empty()) { throw std::runtime_error{"No finite points in the data"}; }
+        if (points.size() > UINT32_MAX) { throw std::runtime_error{"More than 2^32 points in the data"}; }
+
+        ScatteredData data{std::move(points)};
+        const auto [x_min, x_max] = std::minmax_element(data.points.begin(), data.points.end(), [](const DataPoint &a, const DataPoint &b) { return a.x < b.x; });
+        const auto [z_min, z_max] = std::minmax_element(data.points.begin(), data.points.end(), [](const DataPoint &a, const DataPoint &b) { return a.z < b.z; });
+        data.x_min = x_min->x; data.x_max = x_max->x;
+        data.z_min = z_min->z; data.z_max = z_max->z;
+
+        // the top levels have too few ranges to keep every worker busy, so they are split one level at a time
+        struct Range { size_t lo, hi; uint32_t depth; };
+        auto *p = data.points.data();
+        std::vector<Range> level, next;
+        if (data.points.size() > LEAF_SIZE) { level.push_back({0, data.points.size(), 0}); }
+        while (level.empty() == false && level.size() < global_thread_pool().thread_count() * 4) {
+            global_thread_pool().parallel_for(level.size(), [&](size_t i) {
+                const auto [lo, hi, depth] = level[i];
+                std::nth_element(p + lo, p + lo + (hi - lo) / 2, p + hi, [depth](const DataPoint &a, const DataPoint &b) { return coordinate(a, depth) < coordinate(b, depth); });
+            });
+            next.clear();
+            for (const auto &[lo, hi, depth] : level) {
+                const auto mid = lo + (hi - lo) / 2;
+                if (mid - lo > LEAF_SIZE) { next.push_back({lo, mid, depth + 1}); }
+                if (hi - mid - 1 > LEAF_SIZE) { next.push_back({mid + 1, hi, depth + 1}); }
+            }
+            std::swap(level, next);
+        }
+        global_thread_pool().parallel_for(level.size(), [&](size_t i) { build_subtree(p, level[i].lo, level[i].hi, level[i].depth); });
+        return data;
+    }
+
+    static void consider(const DataPoint *points, size_t i, double x, double z, uint32_t k, std::vector<Neighbour> &best) {
+        const auto d2 = (x - points[i].x) * (x - points[i].x) + (z - points[i].z) * (z - points[i].z);
+        if (best.size() == k && d2 >= best.back().distance_squared) { return; }
+        // k is small, an insertion into the sorted list beats a heap
+        auto at = std::upper_bound(best.begin(), best.end(), d2, [](double d, const Neighbour &n) { return d < n.distance_squared; });
+        best.insert(at, Neighbour{static_cast<uint32_t>(i), d2});
+        if (best.size() > k) { best.pop_back(); }
+    }
+
+    static void search(const DataPoint *points, size_t lo, size_t hi, uint32_t depth, double x, double z, uint32_t k, std::vector<Neighbour> &best) {
+        while (hi - lo > LEAF_SIZE) {
+            const auto mid = lo + (hi - lo) / 2;
+            const auto &p  = points[mid];
+            consider(points, mid, x, z, k, best);
+            const auto delta = (depth % 2 == 0 ? x : z) - coordinate(p, depth);
+            const auto near_lo = delta < 0.0 ? lo : mid + 1, near_hi = delta < 0.0 ? mid : hi;
+            const auto far_lo  = delta < 0.0 ? mid + 1 : lo, far_hi  = delta < 0.0 ? hi : mid;
+            search(points, near_lo, near_hi, depth + 1, x, z, k, best);
+            // the far side only matters when the splitting line is closer than the current k-th neighbour
+            if (best.size() == k && delta * delta >= best.back().distance_squared) { return; }
+            lo = far_lo; hi = far_hi; ++depth;
+        }
+        for (auto i = lo; i < hi; ++i) { consider(points, i, x, z, k, best); }
+    }
+
+    void nearest_points(const ScatteredData &data, double x, double z, uint32_t k, std::vector<Neighbour> &out) {
+        out.clear();
+        search(data.points.data(), 0, data.points.size(), 0, x, z, std::max(k, 1u), out);
+    }
+
+    static double inverse_distance(const ScatteredData &data, const std::vector<Neighbour> &neighbours, double power) {
+        if (neighbours.front().distance_squared == 0.0) { return data.points[neighbours.front().index].y; }
+        double sum = 0.0, weights = 0.0;
+        for (const auto &n : neighbours) {
+            const auto w = power == 2.0 ? 1.0 / n.distance_squared : std::pow(n.distance_squared, -0.5 * power);
+            sum += w * data.points[n.index].y;
+            weights += w;
+        }
+        return sum / weights;
+    }
+
+    // Solves the multiquadric system [Phi 1; 1^T 0] [w; b] = [y; 0] by Gaussian elimination with partial pivoting.
+    // Coincident points make it singular, those cells fall back to inverse distance weighting.
+    static double radial_basis(const ScatteredData &data, const std::vector<Neighbour> &neighbours, double x, double z, std::vector<double> &system) {
+        const auto m = neighbours.size(), n = m + 1;
+        // shape parameter about the spacing of the neighbours, which spread over roughly the disc to the farthest one
+        const auto c2 = neighbours.back().distance_squared / static_cast<double>(m);
+        if (c2 == 0.0) { return data.points[neighbours.front().index].y; }
+
+        system.assign(n * (n + 1), 0.0); // row-major, the right-hand side in the last column
+        const auto at = [&](size_t r, size_t c) -> double & { return system[r * (n + 1) + c]; };
+        for (size_t i = 0; i < m; ++i) {
+            const auto &a = data.points[neighbours[i].index];
+            for (size_t j = i; j < m; ++j) {
+                const auto &b = data.points[neighbours[j].index];
+                at(i, j) = at(j, i) = std::sqrt((a.x - b.x) * (a.x - b.x) + (a.z - b.z) * (a.z - b.z) + c2);
+            }
+            at(i, m) = at(m, i) = 1.0;
+            at(i, n) = a.y;
+        }
+        for (size_t col = 0; col < n; ++col) {
+            size_t pivot = col;
+            for (size_t r = col + 1; r < n; ++r) { if (std::abs(at(r, col)) > std::abs(at(pivot, col))) { pivot = r; } }
+            if (std::abs(at(pivot, col)) < 1e-12 * std::sqrt(c2)) { return inverse_distance(data, neighbours, 2.0); }
+            if (pivot != col) { for (size_t c = col; c <= n; ++c) { std::swap(at(col, c), at(pivot, c)); } }
+            for (size_t r = col + 1; r < n; ++r) {
+                const auto f = at(r, col) / at(col, col);
+                for (size_t c = col; c <= n; ++c) { at(r, c) -= f * at(col, c); }
+            }
+        }
+        for (size_t r = n; r-- > 0;) {
+            auto v = at(r, n);
+            for (size_t c = r + 1; c < n; ++c) { v -= at(r, c) * at(c, n); }
+            at(r, n) = v / at(r, r);
+        }
+        double value = at(m, n);
+        for (size_t i = 0; i < m; ++i) {
+            const auto &p = data.points[neighbours[i].index];
+            value += at(i, n) * std::sqrt((x - p.x) * (x - p.x) + (z - p.z) * (z - p.z) + c2);
+        }
+        return value;
+    }
+
+    static DataGrid natural_neighbour(const ScatteredData &data, uint32_t resolution, double bounds) {
+        // every cell's nearest point and the distance to it, in cells; the disc areas are the cost of the
+        // spreading pass, so sparse data halves the resolution until they stay within a budget
+        std::vector<float> nearest, radius;
+        double step = 0.0;
+        for (;; resolution = std::max(resolution / 2, 2u)) {
+            step = 2.0 * bounds / (resolution - 1);
+            nearest.resize(static_cast<size_t>(resolution) * resolution);
+            radius.resize(nearest.size());
+            global_thread_pool().parallel_for(resolution, [&](size_t row) {
+                std::vector<Neighbour> neighbour;
+                for (uint32_t col = 0; col < resolution; ++col) {
+                    nearest_points(data, -bounds + col * step, -bounds + row * step, 1, neighbour);
+                    nearest[row * resolution + col] = static_cast<float>(data.points[neighbour.front().index].y);
+                    // a disc of twice the grid covers all of it, larger radii (data far off the plane) only cost time
+                    radius[row * resolution + col]  = static_cast<float>(std::min(std::sqrt(neighbour.front().distance_squared) / step, 2.0 * resolution));
+                }
+            }, 4);
+            double cost = 0.0;
+            for (const auto r : radius) { cost += (2.0 * r + 1.0) * (2.0 * r + 1.0); }
+            if (resolution <= 64 || cost <= 256.0 * radius.size()) { break; }
+        }
+
+        // each band of rows spreads into its own accumulator, which covers the rows its discs reach
+        struct Band {
+            uint32_t first_row{0}, row_count{0};
+            std::vector<double> sums;
+            std::vector<uint32_t> counts;
+        };
+        const auto band_count = std::min<uint32_t>(resolution, global_thread_pool().thread_count());
+        std::vector<Band> bands(band_count);
+        global_thread_pool().parallel_for(band_count, [&](size_t b) {
+            const auto row_begin = static_cast<uint32_t>(b * resolution / band_count), row_end = static_cast<uint32_t>((b + 1) * resolution / band_count);
+            const auto reach = static_cast<uint32_t>(*std::max_element(radius.begin() + size_t{row_begin} * resolution, radius.begin() + size_t{row_end} * resolution));
+            auto &band = bands[b];
+            band.first_row = row_begin - std::min(row_begin, reach);
+            band.row_count = std::min(resolution, row_end + reach) - band.first_row;
+            band.sums.assign(size_t{band.row_count} * resolution, 0.0);
+            band.counts.assign(band.sums.size(), 0);
+            for (auto row = row_begin; row < row_end; ++row) {
+                for (uint32_t col = 0; col < resolution; ++col) {
+                    const auto r = radius[size_t{row} * resolution + col];
+                    const auto v = nearest[size_t{row} * resolution + col];
+                    const auto rows = static_cast<int32_t>(r);
+                    const auto dy_begin = std::max(-rows, -static_cast<int32_t>(row));
+                    const auto dy_end   = std::min(rows, static_cast<int32_t>(resolution - 1 - row));
+                    for (int32_t dy = dy_begin; dy <= dy_end; ++dy) {
+                        const auto y = static_cast<int32_t>(row) + dy;
+                        const auto half = static_cast<int32_t>(std::sqrt(std::max(0.0f, r * r - static_cast<float>(dy * dy))));
+                        const auto x0 = std::max(static_cast<int32_t>(col) - half, 0), x1 = std::min(static_cast<int32_t>(col) + half, static_cast<int32_t>(resolution) - 1);
+                        const auto offset = static_cast<size_t>(y - band.first_row) * resolution;
+                        for (auto x = x0; x <= x1; ++x) { band.sums[offset + x] += v; ++band.counts[offset + x]; }
+                    }
+                }
+            }
+        });
+
+        DataGrid grid{resolution, resolution, std::vector<float>(static_cast<size_t>(resolution) * resolution)};
+        global_thread_pool().parallel_for(resolution, [&](size_t row) {
+            for (uint32_t col = 0; col < resolution; ++col) {
+                double sum = 0.0;
+                uint64_t count = 0;
+                for (const auto &band : bands) {
+                    if (row < band.first_row || row >= band.first_row + band.row_count) { continue; }
+                    const auto i = (row - band.first_row) * resolution + col;
+                    sum += band.sums[i];
+                    count += band.counts[i];
+                }
+                // every cell's own disc covers it, so count is never zero
+                grid.values[row * resolution + col] = static_cast<float>(sum / count);
+            }
+        }, 16);
+        return grid;
+    }
+
+    DataGrid resample_scattered(const ScatteredData &data, const ScatteredSettings &settings, uint32_t resolution, double bounds) {
+        if (data.points.empty()) { throw std::runtime_error{"No points to resample"}; }
+        resolution = std::max(resolution, 2u);
+        if (settings.interpolation == ScatteredInterpolation::NaturalNeighbour) { return natural_neighbour(data, resolution, bounds); }
+
+        constexpr uint32_t MAX_NEIGHBOURS = 64;
+        const auto k = std::clamp(settings.neighbours, 1u, static_cast<uint32_t>(std::min<size_t>(MAX_NEIGHBOURS, data.points.size())));
+        const auto step = 2.0 * bounds / (resolution - 1);
+        DataGrid grid{resolution, resolution, std::vector<float>(static_cast<size_t>(resolution) * resolution)};
+        global_thread_pool().parallel_for(resolution, [&](size_t row) {
+            std::vector<Neighbour> neighbours;
+            std::vector<double> system;
+            neighbours.reserve(k + 1);
+            const auto z = -bounds + row * step;
+            for (uint32_t col = 0; col < resolution; ++col) {
+                const auto x = -bounds + col * step;
+                nearest_points(data, x, z, k, neighbours);
+                const auto v = settings.interpolation == ScatteredInterpolation::RadialBasis ? radial_basis(data, neighbours, x, z, system)
+                                                                                            : inverse_distance(data, neighbours, settings.power);
+                grid.values[row * resolution + col] = static_cast<float>(v);
+            }
+        });
+        return grid;
+    }
+
+    ScatteredResampleJob::~ScatteredResampleJob() { wait(); }
+
+    void ScatteredResampleJob::wait() {
+        if (_thread.joinable()) { _thread.join(); }
+    }
+
+    void ScatteredResampleJob::start(std::shared_ptr<const ScatteredData> data, ScatteredResampling resampling) {
+        if (_thread.joinable()) { throw std::runtime_error{"Scattered data is already being resampled"}; }
+
+        _is_finished = false;
+        _thread = std::thread([this, data = std::move(data), resampling] {
+            _result = Result{data, resampling, nullptr, {}};
+            try {
+                _result.grid = std::make_shared<const DataGrid>(resample_scattered(*data, resampling.settings, resampling.resolution, resampling.bounds));
+            } catch (const std::exception &err) {
+                _result.error = "Resampling scattered data failed: " + std::string{err.what()};
+            }
+            _is_finished = true;
+        });
+    }
+
+    bool ScatteredResampleJob::poll(Result &result) {
+        if (_thread.joinable() == false || _is_finished == false) { return false; }
+        _thread.join();
+        result = std::move(_result);
+        return true;
+    }
+
+} // namespace g3d
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <data_source.hpp>
+
+namespace g3d {
+/* Definitions */
+    // Scattered (x, z, y) points indexed by an implicit 2D k-d tree: every subtree is a contiguous range of
+    // `points` whose middle element splits it, along x at even depths and z at odd ones.
+    struct ScatteredData {
+        std::vector<DataPoint> points;
+        double x_min{0.0}, x_max{0.0}, z_min{0.0}, z_max{0.0};
+    };
+    // Reorders the points into the tree; the levels below the first few are built on the thread pool
+    ScatteredData build_scattered_data(std::vector<DataPoint> points);
+
+    struct Neighbour {
+        uint32_t index;          // into ScatteredData::points
+        double distance_squared;
+    };
+    // The k points nearest to (x, z), nearest first
+    void nearest_points(const ScatteredData &data, double x, double z, uint32_t k, std::vector<Neighbour> &out);
+
+    enum class ScatteredInterpolation : uint32_t { InverseDistance, NaturalNeighbour, RadialBasis };
+    struct ScatteredSettings {
+        ScatteredInterpolation interpolation{ScatteredInterpolation::InverseDistance};
+        uint32_t neighbours{12}; // inverse distance and radial basis only
+        float power{2.0f};       // inverse distance only, weights are 1 / distance^power
+        bool operator==(const ScatteredSettings &) const = default;
+    };
+
+    // Interpolates onto a resolution x resolution grid over [-bounds, bounds]^2, in parallel rows.
+    //  - InverseDistance: Shepard weights over the nearest neighbours
+    //  - NaturalNeighbour: discrete Sibson interpolation, every cell spreads the value of its nearest point over
+    //    the disc that reaches that point. Its cost grows with the area per point, so sparse data is resampled
+    //    on a coarser grid.
+    //  - RadialBasis: a local multiquadric fit through the nearest neighbours, plus a constant
+    DataGrid resample_scattered(const ScatteredData &data, const ScatteredSettings &settings, uint32_t resolution, double bounds);
+
+    // What a data source's grid was resampled with; the resampling is redone when it no longer matches
+    struct ScatteredResampling {
+        ScatteredSettings settings;
+        uint32_t resolution{0};
+        float bounds{0.0f};
+        bool operator==(const ScatteredResampling &) const = default;
+    };
+
+    // Resamples on a background thread, the previous grid stays in use until poll() hands over the new one
+    struct ScatteredResampleJob {
+        struct Result {
+            std::shared_ptr<const ScatteredData> data;
+            ScatteredResampling resampling;
+            std::shared_ptr<const DataGrid> grid; // null when resampling threw
+            std::string error;                    // what it threw
+        };
+        ~ScatteredResampleJob();
+
+        void start(std::shared_ptr<const ScatteredData> data, ScatteredResampling resampling);
+        bool poll(Result &result);
+        // Blocks until the running resampling is done. Call before the thread pool goes away.
+        void wait();
+        bool is_running() const { return _thread.joinable(); }
+
+      private:
+        std::thread _thread;
+        std::atomic<bool> _is_finished{false};
+        Result _result;
+    };
+} // namespace g3d
@@ -0,0 +1,303 @@
+#include "sequence_export.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+#include <height_field_codec.hpp>
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    struct SequenceHeader {
+        uint32_t magic, detail, surface_count, frame_count;
+        float bounds, t0, t1;
+        uint32_t keyframe_interval;
+    };
+    struct FrameRecord {
+        uint32_t flags;
+        float time;
+        uint64_t size;
+    };
+    static constexpr uint32_t SEQUENCE_MAGIC = 0x31515348; // "HSQ1"
+    static constexpr uint32_t FRAME_DELTA    = 1;          // coded against the previous frame
+
+    static double frame_time(const SequenceSettings &settings, uint32_t frame) {
+        return settings.frame_count > 1 ? settings.t0 + (settings.t1 - settings.t0) * frame / (settings.frame_count - 1) : settings.t0;
+    }
+
+    void evaluate_height_frame(const std::vector<Program> &programs, const std::vector<double> &parameters, double time,
+                               uint32_t detail, double bounds, float *heights) {
+        const auto side = static_cast<size_t>(detail) + 1;
+        auto p = parameters;
+        p[Program::PARAMETER_TIME] = time;
+        global_thread_pool().parallel_for(programs.size() * side, [&](size_t task) {
+            const auto surface = task / side, z = task % side;
+            std::vector<double> xs(side), zs(side, -bounds + 2.0 * bounds * static_cast<double>(z) / detail), row(side);
+            for (size_t x = 0; x < side; ++x) { xs[x] = -bounds + 2.0 * bounds * static_cast<double>(x) / detail; }
+            evaluate_batch(programs[surface], xs.data(), zs.data(), p.data(), row.data(), side);
+            auto *out = heights + (surface * side + z) * side;
+            for (size_t x = 0; x < side; ++x) { out[x] = static_cast<float>(row[x]); }
+        });
+    }
+
+    // Streams the binary buffer while frames come in; the JSON, which needs every bound, is written at the end
+    struct GltfWriter {
+        std::string stem;
+        std::ofstream bin;
+        uint32_t detail{0}, surface_count{0};
+        float bounds{0.0f};
+        std::vector<float> base;              // frame 0, finite
+        std::vector<std::pair<float, float>> y_ranges; // per (frame, surface) accessor
+        uint64_t index_bytes{0}, vertex_bytes{0};
+
+        static std::string number(float v) {
+            char buffer[32];
+            const auto end = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr;
+            return std::string(buffer, end);
+        }
+
+        GltfWriter(const std::string &path_stem, uint32_t n, uint32_t surfaces, float b) : stem(path_stem), detail(n), surface_count(surfaces), bounds(b) {
+            bin.open(stem + ".bin", std::ios::binary | std::ios::trunc);
+            if (bin.is_open() == false) { throw std::runtime_error{"Could not write '" + stem + ".bin'"}; }
+            std::vector<uint32_t> indices;
+            indices.reserve(static_cast<size_t>(n) * n * 6);
+            for (uint32_t i = 0; i < n; ++i) {
+                for (uint32_t j = 0; j < n; ++j) {
+                    const auto a = i * (n + 1) + j, b = a + (n + 1), c = a + 1, d = b + 1;
+                    indices.insert(indices.end(), {a, b, c, c, b, d});
+                }
+            }
+            index_bytes = indices.size() * sizeof(uint32_t);
+            bin.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(index_bytes));
+        }
+
+        void add_frame(const float *heights) {
+            const auto side = detail + 1;
+            const auto vertex_count = static_cast<size_t>(side) * side;
+            const auto is_base = base.empty();
+            if (is_base) { base.resize(vertex_count * surface_count); }
+            std::vector<float> positions(vertex_count * 3);
+            for (uint32_t s = 0; s < surface_count; ++s) {
+                auto range = std::make_pair(INFINITY, -INFINITY);
+                for (size_t i = 0; i < vertex_count; ++i) {
+                    const auto h = std::isfinite(heights[s * vertex_count + i]) ? heights[s * vertex_count + i] : 0.0f;
+                    auto &b = base[s * vertex_count + i];
+                    if (is_base) { b = h; }
+                    // morph targets are displacements from the base mesh
+                    const auto y = is_base ? h : h - b;
+                    positions[i * 3 + 0] = is_base ? -bounds + 2.0f * bounds * static_cast<float>(i % side) / detail : 0.0f;
+                    positions[i * 3 + 1] = y;
+                    positions[i * 3 + 2] = is_base ? -bounds + 2.0f * bounds * static_cast<float>(i / side) / detail : 0.0f;
+                    range.first  = std::min(range.first, y);
+                    range.second = std::max(range.second, y);
+                }
+                y_ranges.push_back(range);
+                bin.write(reinterpret_cast<const char *>(positions.data()), static_cast<std::streamsize>(positions.size() * sizeof(float)));
+                vertex_bytes += positions.size() * sizeof(float);
+            }
+        }
+
+        void finish(const SequenceSettings &settings) {
+            const auto frames  = settings.frame_count;
+            const auto targets = frames - 1;
+            const auto vertex_count = static_cast<uint64_t>(detail + 1) * (detail + 1);
+
+            // weights animation: frame k shows target k - 1 alone, linear interpolation blends neighbouring frames
+            std::vector<float> times(frames), weights(static_cast<size_t>(frames) * targets, 0.0f);
+            for (uint32_t k = 0; k < frames; ++k) {
+                times[k] = static_cast<float>(frame_time(settings, k));
+                if (k > 0) { weights[static_cast<size_t>(k) * targets + k - 1] = 1.0f; }
+            }
+            const auto animation_bytes = (times.size() + weights.size()) * sizeof(float);
+            if (targets > 0) {
+                bin.write(reinterpret_cast<const char *>(times.data()), static_cast<std::streamsize>(times.size() * sizeof(float)));
+                bin.write(reinterpret_cast<const char *>(weights.data()), static_cast<std::streamsize>(weights.size() * sizeof(float)));
+            }
+            bin.close();
+            if (bin.fail()) { throw std::runtime_error{"Could not write '" + stem + ".bin'"}; }
+
+            const auto byte_length = index_bytes + vertex_bytes + (targets > 0 ? animation_bytes : 0);
+            const auto uri = std::filesystem::path(stem + ".bin").filename().string();
+            std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"3D Calculator\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+            for (uint32_t s = 0; s < surface_count; ++s) { json += (s > 0 ? "," : "") + std::to_string(s); }
+            json += "]}],\"nodes\":[";
+            for (uint32_t s = 0; s < surface_count; ++s) { json += (s > 0 ? ",{\"mesh\":" : "{\"mesh\":") + std::to_string(s) + "}"; }
+
+            // accessor 0 holds the indices, 1 + frame * surface_count + surface the positions, then times and weights
+            const auto position_accessor = [&](uint32_t frame, uint32_t s) { return std::to_string(1 + frame * surface_count + s); };
+            json += "],\"meshes\":[";
+            for (uint32_t s = 0; s < surface_count; ++s) {
+                json += (s > 0 ? "," : "") + std::string{"{\"primitives\":[{\"attributes\":{\"POSITION\":"} + position_accessor(0, s) + "},\"indices\":0";
+                if (targets > 0) {
+                    json += ",\"targets\":[";
+                    for (uint32_t k = 1; k < frames; ++k) { json += (k > 1 ? ",{\"POSITION\":" : "{\"POSITION\":") + position_accessor(k, s) + "}"; }
+                    json += "]}],\"weights\":[";
+                    for (uint32_t k = 1; k < frames; ++k) { json += k > 1 ? ",0" : "0"; }
+                    json += "]}";
+                } else {
+                    json += "}]}";
+                }
+            }
+            json += "]";
+
+            const auto times_accessor = std::to_string(1 + frames * surface_count);
+            if (targets > 0) {
+                json += ",\"animations\":[{\"samplers\":[{\"input\":" + times_accessor + ",\"output\":" + std::to_string(2 + frames * surface_count) +
+                        ",\"interpolation\":\"LINEAR\"}],\"channels\":[";
+                for (uint32_t s = 0; s < surface_count; ++s) {
+                    json += (s > 0 ? "," : "") + std::string{"{\"sampler\":0,\"target\":{\"node\":"} + std::to_string(s) + ",\"path\":\"weights\"}}";
+                }
+                json += "]}]";
+            }
+
+            json += ",\"buffers\":[{\"uri\":\"" + uri + "\",\"byteLength\":" + std::to_string(byte_length) + "}],\"bufferViews\":[";
+            json += "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(index_bytes) + ",\"target\":34963}";
+            json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(index_bytes) + ",\"byteLength\":" + std::to_string(vertex_bytes) + ",\"target\":34962}";
+            if (targets > 0) {
+                json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(index_bytes + vertex_bytes) + ",\"byteLength\":" + std::to_string(animation_bytes) + "}";
+            }
+
+            json += "],\"accessors\":[{\"bufferView\":0,\"componentType\":5125,\"type\":\"SCALAR\",\"count\":" + std::to_string(static_cast<uint64_t>(detail) * detail * 6) + "}";
+            for (uint32_t k = 0; k < frames; ++k) {
+                for (uint32_t s = 0; s < surface_count; ++s) {
+                    const auto &[low, high] = y_ranges[k * surface_count + s];
+                    const auto x = k == 0 ? number(bounds) : std::string{"0"}, minus_x = k == 0 ? number(-bounds) : std::string{"0"};
+                    json += ",{\"bufferView\":1,\"byteOffset\":" + std::to_string((static_cast<uint64_t>(k) * surface_count + s) * vertex_count * 12) +
+                            ",\"componentType\":5126,\"type\":\"VEC3\",\"count\":" + std::to_string(vertex_count) +
+                            ",\"min\":[" + minus_x + "," + number(low) + "," + minus_x + "],\"max\":[" + x + "," + number(high) + "," + x + "]}";
+                }
+            }
+            if (targets > 0) {
+                json += ",{\"bufferView\":2,\"byteOffset\":0,\"componentType\":5126,\"type\":\"SCALAR\",\"count\":" + std::to_string(frames) +
+                        ",\"min\":[" + number(*std::min_element(times.begin(), times.end())) + "],\"max\":[" + number(*std::max_element(times.begin(), times.end())) + "]}";
+                json += ",{\"bufferView\":2,\"byteOffset\":" + std::to_string(times.size() * sizeof(float)) +
+                        ",\"componentType\":5126,\"type\":\"SCALAR\",\"count\":" + std::to_string(weights.size()) + "}";
+            }
+            json += "]}\n";
+
+            std::ofstream file{stem + ".gltf", std::ios::trunc};
+            if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + stem + ".gltf'"}; }
+            file << json;
+        }
+    };
+
+    void export_height_sequence(const std::string &path_stem, const std::vector<Program> &programs, const std::vector<double> &parameters,
+                                uint32_t detail, double bounds, const SequenceSettings &settings, std::atomic<uint32_t> *completed) {
+        if (settings.frame_count == 0 || programs.empty()) { throw std::runtime_error{"Nothing to export"}; }
+        // glTF animation inputs must strictly increase, as the floats they are stored as
+        if (settings.is_gltf_written) {
+            for (uint32_t k = 1; k < settings.frame_count; ++k) {
+                if (static_cast<float>(frame_time(settings, k)) <= static_cast<float>(frame_time(settings, k - 1))) {
+                    throw std::runtime_error{"The glTF animation needs increasing frame times: the last TIME must be after the first"};
+                }
+            }
+        }
+        const auto surface_count = static_cast<uint32_t>(programs.size());
+        const auto value_count = static_cast<size_t>(detail + 1) * (detail + 1) * surface_count;
+
+        const auto path = path_stem + ".hseq";
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+        const SequenceHeader header{SEQUENCE_MAGIC, detail, surface_count, settings.frame_count, static_cast<float>(bounds),
+                                    static_cast<float>(settings.t0), static_cast<float>(settings.t1), settings.keyframe_interval};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        std::optional<GltfWriter> gltf;
+        if (settings.is_gltf_written) { gltf.emplace(path_stem, detail, surface_count, static_cast<float>(bounds)); }
+
+        std::vector<float> current(value_count), previous;
+        for (uint32_t frame = 0; frame < settings.frame_count; ++frame) {
+            const auto time = frame_time(settings, frame);
+            evaluate_height_frame(programs, parameters, time, detail, bounds, current.data());
+
+            const auto is_keyframe = previous.empty() || settings.keyframe_interval == 0 || frame % settings.keyframe_interval == 0;
+            const auto stream = HeightFieldCodec::encode(current.data(), detail + 1, detail + 1, surface_count, is_keyframe ? nullptr : previous.data());
+            const FrameRecord record{is_keyframe ? 0 : FRAME_DELTA, static_cast<float>(time), stream.size()};
+            file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            file.write(reinterpret_cast<const char *>(stream.data()), static_cast<std::streamsize>(stream.size()));
+            if (file.fail()) { throw std::runtime_error{"Could not write '" + path + "'"}; }
+
+            if (gltf) { gltf->add_frame(current.data()); }
+            std::swap(previous, current);
+            current.resize(value_count);
+            if (completed != nullptr) { completed->fetch_add(1, std::memory_order_relaxed); }
+        }
+        if (gltf) { gltf->finish(settings); }
+    }
+
+    HeightSequenceReader::HeightSequenceReader(const std::string &path) : _file(path, std::ios::binary) {
+        if (_file.is_open() == false) { throw std::runtime_error{"Could not open '" + path + "'"}; }
+        _file.seekg(0, std::ios::end);
+        _file_size = static_cast<uint64_t>(_file.tellg());
+        _file.seekg(0, std::ios::beg);
+        SequenceHeader header;
+        if (_file.read(reinterpret_cast<char *>(&header), sizeof(header)).fail() || header.magic != SEQUENCE_MAGIC) {
+            throw std::runtime_error{"'" + path + "' is not a height sequence"};
+        }
+        _detail        = header.detail;
+        _surface_count = header.surface_count;
+        _frame_count   = header.frame_count;
+        _bounds        = header.bounds;
+    }
+
+    bool HeightSequenceReader::next(std::vector<float> &heights, float &time) {
+        if (_frames_read == _frame_count) { return false; }
+        FrameRecord record;
+        if (_file.read(reinterpret_cast<char *>(&record), sizeof(record)).fail()) { throw std::runtime_error{"Height sequence: truncated frame"}; }
+        const auto has_reference = (record.flags & FRAME_DELTA) != 0;
+        if (has_reference && _previous.empty()) { throw std::runtime_error{"Height sequence: delta frame without a previous frame"}; }
+
+        // the size comes from the file, a corrupt one must not allocate more than the file could hold
+        if (record.size > _file_size - static_cast<uint64_t>(_file.tellg())) { throw std::runtime_error{"Height sequence: truncated frame"}; }
+        std::vector<uint8_t> stream(record.size);
+        if (_file.read(reinterpret_cast<char *>(stream.data()), static_cast<std::streamsize>(stream.size())).fail()) {
+            throw std::runtime_error{"Height sequence: truncated frame"};
+        }
+        const auto value_count = static_cast<size_t>(_detail + 1) * (_detail + 1) * _surface_count;
+        auto values = HeightFieldCodec::decode(stream.data(), stream.size(), has_reference ? _previous.data() : nullptr, _previous.size());
+        if (values.size() != value_count) { throw std::runtime_error{"Height sequence: frame does not match the grid"}; }
+
+        _previous = values;
+        heights   = std::move(values);
+        time      = record.time;
+        ++_frames_read;
+        return true;
+    }
+
+    SequenceExportJob::~SequenceExportJob() { wait(); }
+
+    void SequenceExportJob::wait() {
+        if (_thread.joinable()) { _thread.join(); }
+    }
+
+    void SequenceExportJob::start(std::string path_stem, std::vector<Program> programs, std::vector<double> parameters, uint32_t detail, double bounds,
+                                  SequenceSettings settings) {
+        if (_thread.joinable()) { throw std::runtime_error{"A sequence is already being exported"}; }
+
+        _total       = settings.frame_count;
+        _completed   = 0;
+        _is_finished = false;
+        _thread = std::thread([this, path_stem = std::move(path_stem), programs = std::move(programs), parameters = std::move(parameters), detail, bounds, settings] {
+            try {
+                export_height_sequence(path_stem, programs, parameters, detail, bounds, settings, &_completed);
+                _message = "Sequence of " + std::to_string(settings.frame_count) + " frames exported at: '" + path_stem + ".hseq'";
+            } catch (const std::exception &err) {
+                _message = err.what();
+            }
+            _is_finished = true;
+        });
+    }
+
+    bool SequenceExportJob::poll(std::string &message) {
+        if (_thread.joinable() == false || _is_finished == false) { return false; }
+        _thread.join();
+        message = std::move(_message);
+        return true;
+    }
+
+} // namespace g3d
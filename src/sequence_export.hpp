@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    struct SequenceSettings {
+        uint32_t frame_count{60};
+        double t0{0.0}, t1{2.0};        // TIME of the first and the last frame
+        uint32_t keyframe_interval{30}; // frames coded on their own, where a reader can start
+        bool is_gltf_written{false};    // also write "<name>.gltf" + ".bin" with one morph target per frame
+    };
+
+    // Evaluates every surface at TIME = time on the CPU, in the layout of the height field SSBO
+    // (surface after surface, (detail + 1)^2 row-major values each). Rows run on the thread pool.
+    void evaluate_height_frame(const std::vector<Program> &programs, const std::vector<double> &parameters, double time,
+                               uint32_t detail, double bounds, float *heights);
+
+    // ".hseq": an "HSQ1" header with the grid, the surface count, the bounds and the time range, then one record per
+    // frame as it is evaluated: flags, TIME, byte size and a HeightFieldCodec stream. Frames after a keyframe are
+    // coded against the previous frame, so slow motion costs a few bits per vertex. The topology is the grid itself.
+    // The glTF copy holds frame 0 as the mesh, every later frame as a morph target and a weights animation stepping
+    // through them; NaN and Inf heights are written as 0 since glTF cannot hold them.
+    // Throws std::runtime_error when a file cannot be written, and before writing anything when the glTF copy is
+    // asked for with frame times that do not strictly increase (t1 <= t0, or steps lost to float precision).
+    void export_height_sequence(const std::string &path_stem, const std::vector<Program> &programs, const std::vector<double> &parameters,
+                                uint32_t detail, double bounds, const SequenceSettings &settings, std::atomic<uint32_t> *completed = nullptr);
+
+    // Reads an ".hseq" frame by frame. Throws std::runtime_error on malformed files.
+    struct HeightSequenceReader {
+        explicit HeightSequenceReader(const std::string &path);
+
+        uint32_t detail() const { return _detail; }
+        uint32_t surface_count() const { return _surface_count; }
+        uint32_t frame_count() const { return _frame_count; }
+        float bounds() const { return _bounds; }
+        // False after the last frame
+        bool next(std::vector<float> &heights, float &time);
+
+      private:
+        std::ifstream _file;
+        uint64_t _file_size{0};
+        uint32_t _detail{0}, _surface_count{0}, _frame_count{0}, _frames_read{0};
+        float _bounds{0.0f};
+        std::vector<float> _previous;
+    };
+
+    // Exports on a background thread; poll() reports the outcome (or the error) once it is done.
+    struct SequenceExportJob {
+        ~SequenceExportJob();
+
+        void start(std::string path_stem, std::vector<Program> programs, std::vector<double> parameters, uint32_t detail, double bounds,
+                   SequenceSettings settings);
+        bool poll(std::string &message);
+        // Blocks until the files are written; the export is not cut short, a half written sequence is of no use
+        void wait();
+        bool is_running() const { return _thread.joinable(); }
+        float progress() const { return _total > 0 ? static_cast<float>(_completed.load()) / static_cast<float>(_total) : 0.0f; }
+
+      private:
+        std::thread _thread;
+        std::atomic<uint32_t> _completed{0};
+        uint32_t _total{0};
+        std::atomic<bool> _is_finished{false};
+        std::string _message;
+    };
+} // namespace g3d
@@ -0,0 +1,89 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <compression.hpp>
+#include <height_field_codec.hpp>
+
+namespace g3d {
+
+    struct SnapshotHeader {
+        SnapshotCodec codec;
+        uint32_t detail, surface_count;
+        float bounds;
+        uint64_t program_key;
+        uint64_t payload_size;
+        uint64_t checksum; // of the decoded heights, zlib as stb reads it does not verify its own
+    };
+
+    // Bounds on what a header may ask for, checked before anything is allocated from it
+    static constexpr uint32_t MAX_DETAIL = 16384, MAX_SURFACES = 1024;
+    static constexpr uint64_t MAX_DEFLATE_RATIO = 1032; // deflate cannot expand its input further
+
+    static uint64_t checksum(const std::vector<float> &heights) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        const auto *bytes = reinterpret_cast<const uint8_t *>(heights.data());
+        for (size_t i = 0; i < heights.size() * sizeof(float); ++i) { hash = (hash ^ bytes[i]) * 0x100000001b3ull; }
+        return hash;
+    }
+
+    std::vector<uint8_t> encode_snapshot(const HeightFieldSnapshot &snapshot, SnapshotCodec codec) {
+        const auto *raw = reinterpret_cast<const uint8_t *>(snapshot.heights.data());
+        const auto raw_size = snapshot.heights.size() * sizeof(float);
+        std::vector<uint8_t> payload;
+        switch (codec) {
+        case SnapshotCodec::Raw: payload.assign(raw, raw + raw_size); break;
+        case SnapshotCodec::Zlib: payload = zlib_compress(raw, raw_size); break;
+        case SnapshotCodec::Predictive:
+            payload = HeightFieldCodec::encode(snapshot.heights.data(), snapshot.detail + 1, snapshot.detail + 1, snapshot.surface_count);
+            break;
+        }
+
+        const SnapshotHeader header{codec, snapshot.detail, snapshot.surface_count, snapshot.bounds, snapshot.program_key, payload.size(), checksum(snapshot.heights)};
+        std::vector<uint8_t> out(sizeof(header) + payload.size());
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), payload.data(), payload.size());
+        return out;
+    }
+
+    HeightFieldSnapshot decode_snapshot(const uint8_t *data, size_t size) {
+        SnapshotHeader header;
+        if (size < sizeof(header)) { throw std::runtime_error{"Snapshot: truncated header"}; }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.payload_size > size - sizeof(header)) { throw std::runtime_error{"Snapshot: truncated payload"}; }
+
+        if (header.detail > MAX_DETAIL || header.surface_count > MAX_SURFACES) { throw std::runtime_error{"Snapshot: grid too large"}; }
+
+        HeightFieldSnapshot snapshot{header.detail, header.surface_count, header.bounds, header.program_key, {}};
+        const auto side = static_cast<uint64_t>(header.detail) + 1;
+        const auto count = side * side * header.surface_count;
+        const auto *payload = data + sizeof(header);
+        switch (header.codec) {
+        case SnapshotCodec::Raw:
+            if (header.payload_size != count * sizeof(float)) { throw std::runtime_error{"Snapshot: size does not match its grid"}; }
+            snapshot.heights.resize(count);
+            std::memcpy(snapshot.heights.data(), payload, header.payload_size);
+            break;
+        case SnapshotCodec::Zlib: {
+            if (count * sizeof(float) > header.payload_size * MAX_DEFLATE_RATIO) { throw std::runtime_error{"Snapshot: size does not match its grid"}; }
+            snapshot.heights.resize(count);
+            const auto raw = zlib_decompress(payload, header.payload_size, count * sizeof(float));
+            std::memcpy(snapshot.heights.data(), raw.data(), raw.size());
+            break;
+        }
+        case SnapshotCodec::Predictive: {
+            // the codec bounds its own allocation by the payload
+            auto values = HeightFieldCodec::decode(payload, header.payload_size);
+            if (values.size() != count) { throw std::runtime_error{"Snapshot: size does not match its grid"}; }
+            snapshot.heights = std::move(values);
+            break;
+        }
+        default: throw std::runtime_error{"Snapshot: unknown codec " + std::to_string(static_cast<uint32_t>(header.codec))};
+        }
+        if (checksum(snapshot.heights) != header.checksum) { throw std::runtime_error{"Snapshot: checksum mismatch"}; }
+        return snapshot;
+    }
+
+} // namespace g3d
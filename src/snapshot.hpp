@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    enum class SnapshotCodec : uint32_t { Raw, Zlib, Predictive }; // Predictive: HeightFieldCodec
+
+    // The evaluated height field of every surface, as the compute shader laid it out, together with the
+    // inputs it depends on. program_key identifies the compute program and the data grids it sampled, so a
+    // changed equation or a rewritten data file both make the field stale.
+    struct HeightFieldSnapshot {
+        uint32_t detail{0}, surface_count{0};
+        float bounds{0.0f};
+        uint64_t program_key{0};
+        std::vector<float> heights;
+    };
+
+    std::vector<uint8_t> encode_snapshot(const HeightFieldSnapshot &snapshot, SnapshotCodec codec);
+    // Throws std::runtime_error for unknown codecs and inconsistent or corrupt data
+    HeightFieldSnapshot decode_snapshot(const uint8_t *data, size_t size);
+} // namespace g3d
@@ -0,0 +1,5 @@
+// Implementations of the single-header stb libraries, compiled once
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
@@ -0,0 +1,166 @@
+#include "streamlines.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    static constexpr size_t LINES_PER_TASK = 256;
+
+    // Unit direction of the flow at every point, or zero where the gradient is flat or not finite
+    static void flow(const Program &program, const double *parameters, const double *xs, const double *zs, size_t count,
+                     double sign, double min_gradient, double *values, double *dxs, double *dzs) {
+        evaluate_gradient_batch(program, xs, zs, parameters, values, dxs, dzs, count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto length = std::hypot(dxs[i], dzs[i]);
+            if (std::isfinite(length) == false || length < min_gradient) { dxs[i] = dzs[i] = 0.0; continue; }
+            dxs[i] *= sign / length;
+            dzs[i] *= sign / length;
+        }
+    }
+
+    Streamlines trace_streamlines(const Program &program, const std::vector<double> &parameters, double bounds,
+                                  const StreamlineSettings &settings, const std::atomic<bool> *is_cancelled) {
+        const auto n = settings.seeds_per_axis;
+        const auto line_count = static_cast<size_t>(n) * n;
+        const auto h = static_cast<double>(settings.step_length) * 2.0 * bounds;
+        const auto sign = settings.direction == FlowDirection::Descent ? -1.0 : 1.0;
+        const auto is_inside = [&](double x, double z) { return std::abs(x) <= bounds && std::abs(z) <= bounds; };
+
+        const auto tasks = (line_count + LINES_PER_TASK - 1) / LINES_PER_TASK;
+        std::vector<std::vector<glm::vec3>> partial(tasks);
+        global_thread_pool().parallel_for(tasks, [&](size_t task) {
+            if (is_cancelled != nullptr && is_cancelled->load(std::memory_order_relaxed)) { return; }
+            const auto first = task * LINES_PER_TASK;
+            const auto count = std::min(LINES_PER_TASK, line_count - first);
+
+            // compacted state of the lines still running
+            std::vector<double> x(count), z(count), y(count), px(count), pz(count);
+            std::vector<double> sx(count), sz(count), v(count), kx[4], kz[4];
+            for (auto &k : kx) { k.resize(count); }
+            for (auto &k : kz) { k.resize(count); }
+            std::vector<uint32_t> lines(count);
+            std::vector<std::vector<glm::vec3>> points(count);
+            for (size_t i = 0; i < count; ++i) {
+                const auto seed = first + i;
+                x[i] = -bounds + 2.0 * bounds * (static_cast<double>(seed % n) + 0.5) / n;
+                z[i] = -bounds + 2.0 * bounds * (static_cast<double>(seed / n) + 0.5) / n;
+                lines[i] = static_cast<uint32_t>(i);
+            }
+
+            auto active = count;
+            flow(program, parameters.data(), x.data(), z.data(), active, sign, settings.min_gradient, y.data(), kx[0].data(), kz[0].data());
+            for (size_t i = 0; i < active; ++i) {
+                if (std::isfinite(y[i])) { points[i].emplace_back(x[i], y[i], z[i]); }
+                px[i] = kx[0][i]; pz[i] = kz[0][i];
+            }
+
+            for (uint32_t step = 0; step < settings.max_steps && active > 0; ++step) {
+                // k1 is the direction at the current points, left over from the previous step
+                for (int stage = 1; stage < 4; ++stage) {
+                    const auto t = stage == 3 ? h : 0.5 * h;
+                    for (size_t i = 0; i < active; ++i) { sx[i] = x[i] + t * kx[stage - 1][i]; sz[i] = z[i] + t * kz[stage - 1][i]; }
+                    flow(program, parameters.data(), sx.data(), sz.data(), active, sign, settings.min_gradient, v.data(), kx[stage].data(), kz[stage].data());
+                }
+                for (size_t i = 0; i < active; ++i) {
+                    sx[i] = x[i] + h / 6.0 * (kx[0][i] + 2.0 * kx[1][i] + 2.0 * kx[2][i] + kx[3][i]);
+                    sz[i] = z[i] + h / 6.0 * (kz[0][i] + 2.0 * kz[1][i] + 2.0 * kz[2][i] + kz[3][i]);
+                }
+                flow(program, parameters.data(), sx.data(), sz.data(), active, sign, settings.min_gradient, v.data(), kx[0].data(), kz[0].data());
+
+                size_t kept = 0;
+                for (size_t i = 0; i < active; ++i) {
+                    const auto is_stopped = kx[0][i] == 0.0 && kz[0][i] == 0.0;
+                    const auto is_reversed = kx[0][i] * px[i] + kz[0][i] * pz[i] < 0.0;
+                    if (is_inside(sx[i], sz[i]) == false || std::isfinite(v[i]) == false || is_reversed) { continue; }
+                    points[lines[i]].emplace_back(sx[i], v[i], sz[i]);
+                    if (is_stopped) { continue; }
+
+                    x[kept] = sx[i]; z[kept] = sz[i];
+                    px[kept] = kx[0][i]; pz[kept] = kz[0][i];
+                    kx[0][kept] = kx[0][i]; kz[0][kept] = kz[0][i];
+                    lines[kept] = lines[i];
+                    ++kept;
+                }
+                active = kept;
+            }
+
+            auto &out = partial[task];
+            for (const auto &line : points) {
+                for (size_t i = 1; i < line.size(); ++i) { out.push_back(line[i - 1]); out.push_back(line[i]); }
+            }
+        });
+
+        Streamlines result;
+        result.line_count = static_cast<uint32_t>(line_count);
+        for (const auto &p : partial) { result.line_vertices.insert(result.line_vertices.end(), p.begin(), p.end()); }
+
+        if (settings.is_arrows_shown && settings.arrows_per_axis > 0) {
+            const auto m = settings.arrows_per_axis;
+            const auto arrow_count = static_cast<size_t>(m) * m;
+            const auto length = 0.8 * 2.0 * bounds / m;
+            std::vector<double> xs(arrow_count), zs(arrow_count), ys(arrow_count), dxs(arrow_count), dzs(arrow_count);
+            for (size_t i = 0; i < arrow_count; ++i) {
+                xs[i] = -bounds + 2.0 * bounds * (static_cast<double>(i % m) + 0.5) / m;
+                zs[i] = -bounds + 2.0 * bounds * (static_cast<double>(i / m) + 0.5) / m;
+            }
+            // arrows are centred on their grid point and draped by evaluating f at the tip and the tail
+            flow(program, parameters.data(), xs.data(), zs.data(), arrow_count, sign, settings.min_gradient, ys.data(), dxs.data(), dzs.data());
+            std::vector<double> ends_x(arrow_count * 2), ends_z(arrow_count * 2), ends_y(arrow_count * 2);
+            for (size_t i = 0; i < arrow_count; ++i) {
+                ends_x[2 * i]     = xs[i] - 0.5 * length * dxs[i]; ends_z[2 * i]     = zs[i] - 0.5 * length * dzs[i];
+                ends_x[2 * i + 1] = xs[i] + 0.5 * length * dxs[i]; ends_z[2 * i + 1] = zs[i] + 0.5 * length * dzs[i];
+            }
+            evaluate_batch(program, ends_x.data(), ends_z.data(), parameters.data(), ends_y.data(), arrow_count * 2);
+
+            constexpr double BARB = 0.3, SPREAD = 0.5; // barb length relative to the shaft, tan of its angle
+            for (size_t i = 0; i < arrow_count; ++i) {
+                if ((dxs[i] == 0.0 && dzs[i] == 0.0) || std::isfinite(ends_y[2 * i]) == false || std::isfinite(ends_y[2 * i + 1]) == false) { continue; }
+                const glm::vec3 tail{ends_x[2 * i], ends_y[2 * i], ends_z[2 * i]};
+                const glm::vec3 tip{ends_x[2 * i + 1], ends_y[2 * i + 1], ends_z[2 * i + 1]};
+                const auto back = (tail - tip) * static_cast<float>(BARB);
+                const glm::vec3 side{static_cast<float>(-dzs[i] * length * BARB * SPREAD), 0.0f, static_cast<float>(dxs[i] * length * BARB * SPREAD)};
+                for (const auto &p : {tail, tip + back + side, tip + back - side}) {
+                    result.arrow_vertices.push_back(p);
+                    result.arrow_vertices.push_back(tip);
+                }
+            }
+        }
+        return result;
+    }
+
+    StreamlineJob::~StreamlineJob() { cancel(); }
+
+    void StreamlineJob::cancel() {
+        _is_cancelled = true;
+        if (_thread.joinable()) { _thread.join(); }
+        _is_cancelled = false;
+    }
+
+    void StreamlineJob::start(Program program, std::vector<double> parameters, double bounds, StreamlineSettings settings) {
+        if (_thread.joinable()) { throw std::runtime_error{"Streamlines are already being traced"}; }
+
+        _is_finished = false;
+        _thread = std::thread([this, program = std::move(program), parameters = std::move(parameters), bounds, settings] {
+            try {
+                _result = trace_streamlines(program, parameters, bounds, settings, &_is_cancelled);
+                _error.clear();
+            } catch (const std::exception &err) {
+                _error = std::string{"Streamlines failed: "} + err.what();
+            }
+            _is_finished = true;
+        });
+    }
+
+    bool StreamlineJob::poll(Streamlines &result, std::string &error) {
+        if (_thread.joinable() == false || _is_finished == false) { return false; }
+        _thread.join();
+        error = std::move(_error);
+        if (error.empty()) { result = std::move(_result); }
+        return true;
+    }
+
+} // namespace g3d
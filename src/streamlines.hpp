@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    enum class FlowDirection : uint32_t { Descent, Ascent };
+
+    struct StreamlineSettings {
+        bool is_enabled{false};
+        FlowDirection direction{FlowDirection::Descent};
+        uint32_t seeds_per_axis{100};
+        uint32_t max_steps{200};
+        float step_length{0.005f};      // fraction of the plane's width covered per step
+        double min_gradient{1e-9};      // lines stop at flat points
+        bool is_arrows_shown{false};
+        uint32_t arrows_per_axis{24};
+    };
+
+    struct Streamlines {
+        std::vector<glm::vec3> line_vertices;  // GL_LINES pairs at (x, f, z)
+        std::vector<glm::vec3> arrow_vertices; // GL_LINES pairs, shaft and two barbs per arrow
+        uint32_t line_count{0};
+    };
+
+    // Seeds a grid of particles and follows the normalised gradient of f with RK4, so every step covers the
+    // same distance in the plane. Particles advance in lockstep in chunks, each stage evaluating the gradient of
+    // the whole chunk with evaluate_gradient_batch(); chunks run on the thread pool. A line ends when it leaves
+    // the plane, reaches a flat point, turns back on itself (it crossed an extremum) or hits a non-finite value.
+    // Once `is_cancelled` is set the chunks not yet started are skipped.
+    Streamlines trace_streamlines(const Program &program, const std::vector<double> &parameters, double bounds,
+                                  const StreamlineSettings &settings, const std::atomic<bool> *is_cancelled = nullptr);
+
+    // Traces on a background thread so slider drags never wait on it; poll() hands over the finished lines,
+    // or the message of what tracing threw, in which case `result` is left as it was.
+    struct StreamlineJob {
+        ~StreamlineJob();
+
+        void start(Program program, std::vector<double> parameters, double bounds, StreamlineSettings settings);
+        bool poll(Streamlines &result, std::string &error);
+        // Stops tracing and waits for the thread, nothing is reported for it. Call before the thread pool goes away.
+        void cancel();
+        bool is_running() const { return _thread.joinable(); }
+
+      private:
+        std::thread _thread;
+        std::atomic<bool> _is_finished{false}, _is_cancelled{false};
+        Streamlines _result;
+        std::string _error;
+    };
+} // namespace g3d
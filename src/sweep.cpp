@@ -0,0 +1,103 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <thread_pool.hpp>
+
+namespace g3d {
+
+    SweepResult run_sweep(const Program &program, const std::vector<double> &parameters, double bounds,
+                          const SweepSettings &settings, std::atomic<uint64_t> *completed, const std::atomic<bool> *is_cancelled) {
+        SweepResult result{.settings = settings};
+        size_t combinations = 1;
+        for (size_t i = 0; i < settings.axes.size(); ++i) { combinations *= settings.steps; }
+        result.values.resize(combinations);
+
+        std::atomic<uint64_t> evaluations{0};
+        global_thread_pool().parallel_for(combinations, [&](size_t combination) {
+            if (is_cancelled != nullptr && is_cancelled->load(std::memory_order_relaxed)) { return; }
+            auto p = parameters;
+            auto rest = combination;
+            for (size_t axis = 0; axis < settings.axes.size(); ++axis) {
+                p[Program::PARAMETER_TIME + 1 + settings.axes[axis].slider] = result.axis_value(axis, static_cast<uint32_t>(rest % settings.steps));
+                rest /= settings.steps;
+            }
+
+            double value = 0.0;
+            uint64_t count = 0;
+            switch (settings.metric) {
+            case SweepMetric::Integral: {
+                const auto integral = integrate(program, p.data(), bounds, settings.cubature);
+                value = integral.value;
+                count = integral.evaluations;
+                break;
+            }
+            case SweepMetric::Maximum:
+            case SweepMetric::Minimum: {
+                const auto n = settings.extremum_resolution;
+                const auto cell = 2.0 * bounds / (n - 1);
+                std::vector<double> xs(n), zs(n), row(n);
+                for (uint32_t i = 0; i < n; ++i) { xs[i] = -bounds + cell * i; }
+                const auto is_max = settings.metric == SweepMetric::Maximum;
+                value = is_max ? -INFINITY : INFINITY;
+                for (uint32_t j = 0; j < n; ++j) {
+                    std::fill(zs.begin(), zs.end(), -bounds + cell * j);
+                    evaluate_batch(program, xs.data(), zs.data(), p.data(), row.data(), n);
+                    for (const auto v : row) {
+                        if (std::isfinite(v)) { value = is_max ? std::max(value, v) : std::min(value, v); }
+                    }
+                }
+                if (std::isinf(value)) { value = NAN; } // no finite sample
+                count = static_cast<uint64_t>(n) * n;
+                break;
+            }
+            case SweepMetric::ValueAtProbe:
+                value = evaluate(program, settings.probe_x, settings.probe_z, p.data());
+                count = 1;
+                break;
+            }
+            result.values[combination] = value;
+            evaluations.fetch_add(count, std::memory_order_relaxed);
+            if (completed != nullptr) { completed->fetch_add(1, std::memory_order_relaxed); }
+        });
+        result.evaluations = evaluations.load();
+        return result;
+    }
+
+    SweepJob::~SweepJob() { cancel(); }
+
+    void SweepJob::cancel() {
+        _is_cancelled = true;
+        if (_thread.joinable()) { _thread.join(); }
+        _is_cancelled = false;
+    }
+
+    void SweepJob::start(Program program, std::vector<double> parameters, double bounds, SweepSettings settings) {
+        if (_thread.joinable()) { throw std::runtime_error{"A parameter sweep is already running"}; }
+
+        _total = 1;
+        for (size_t i = 0; i < settings.axes.size(); ++i) { _total *= settings.steps; }
+        _completed   = 0;
+        _is_finished = false;
+        _thread = std::thread([this, program = std::move(program), parameters = std::move(parameters), bounds, settings = std::move(settings)] {
+            try {
+                _result = run_sweep(program, parameters, bounds, settings, &_completed, &_is_cancelled);
+                _error.clear();
+            } catch (const std::exception &err) {
+                _error = std::string{"Parameter sweep failed: "} + err.what();
+            }
+            _is_finished = true;
+        });
+    }
+
+    bool SweepJob::poll(SweepResult &result, std::string &error) {
+        if (_thread.joinable() == false || _is_finished == false) { return false; }
+        _thread.join();
+        error = std::move(_error);
+        if (error.empty()) { result = std::move(_result); }
+        return true;
+    }
+
+} // namespace g3d
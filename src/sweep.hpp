@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cubature.hpp>
+#include <expression.hpp>
+
+namespace g3d {
+/* Definitions */
+    enum class SweepMetric : uint32_t { Integral, Maximum, Minimum, ValueAtProbe };
+
+    struct SweepAxis {
+        uint32_t slider{0};
+        double min{0.0}, max{1.0};
+    };
+    struct SweepSettings {
+        std::vector<SweepAxis> axes;
+        uint32_t steps{32};
+        SweepMetric metric{SweepMetric::Integral};
+        double probe_x{0.0}, probe_z{0.0};
+        uint32_t extremum_resolution{64}; // samples per axis for Maximum and Minimum
+        CubatureSettings cubature{.relative_tolerance = 1e-4, .max_evaluations = 200'000};
+    };
+    struct SweepResult {
+        SweepSettings settings;
+        std::vector<double> values; // steps^axes values, the first axis varies fastest
+        uint64_t evaluations{0};
+
+        double axis_value(size_t axis, uint32_t step) const {
+            const auto &a = settings.axes[axis];
+            return settings.steps > 1 ? a.min + (a.max - a.min) * step / (settings.steps - 1) : a.min;
+        }
+    };
+
+    // Evaluates the metric for every combination of the axes. The program is compiled once by the
+    // caller; each combination only patches its own copy of the parameters. Once `is_cancelled` is set the
+    // remaining combinations are skipped and left at 0.
+    SweepResult run_sweep(const Program &program, const std::vector<double> &parameters, double bounds,
+                          const SweepSettings &settings, std::atomic<uint64_t> *completed = nullptr,
+                          const std::atomic<bool> *is_cancelled = nullptr);
+
+    // Runs a sweep on a background thread so the UI keeps drawing; poll() hands over the finished result,
+    // or the message of what the sweep threw, in which case `result` is left as it was.
+    struct SweepJob {
+        ~SweepJob();
+
+        void start(Program program, std::vector<double> parameters, double bounds, SweepSettings settings);
+        bool poll(SweepResult &result, std::string &error);
+        // Stops the sweep and waits for its thread, nothing is reported for it. Call before the thread pool goes away.
+        void cancel();
+        bool is_running() const { return _thread.joinable(); }
+        float progress() const { return _total > 0 ? static_cast<float>(_completed.load()) / static_cast<float>(_total) : 0.0f; }
+
+      private:
+        std::thread _thread;
+        std::atomic<uint64_t> _completed{0};
+        uint64_t _total{0};
+        std::atomic<bool> _is_finished{false}, _is_cancelled{false};
+        SweepResult _result;
+        std::string _error;
+    };
+} // namespace g3d
@@ -0,0 +1,90 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace g3d {
+
+    ThreadPool::ThreadPool(uint32_t thread_count) {
+        const auto workers = std::max(thread_count, 1u) - 1; // the caller is the last thread
+        for (uint32_t i = 0; i < workers; ++i) { _workers.emplace_back([this] { worker_loop(); }); }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock{_mutex};
+            _is_stopping = true;
+        }
+        _wake.notify_all();
+        for (auto &worker : _workers) { worker.join(); }
+    }
+
+    void ThreadPool::run_job(Job &job) {
+        for (;;) {
+            const auto first = job.next.fetch_add(job.grain);
+            if (first >= job.count) { return; }
+            const auto last = std::min(first + job.grain, job.count);
+            // after a failure the rest is claimed without running, so `done` still reaches `count`
+            if (job.has_failed.load() == false) {
+                try {
+                    for (auto i = first; i < last; ++i) { (*job.body)(i); }
+                } catch (...) {
+                    std::lock_guard lock{job.error_mutex};
+                    if (job.error == nullptr) { job.error = std::current_exception(); }
+                    job.has_failed = true;
+                }
+            }
+            job.done.fetch_add(last - first);
+        }
+    }
+
+    void ThreadPool::worker_loop() {
+        for (;;) {
+            Job *job = nullptr;
+            {
+                std::unique_lock lock{_mutex};
+                _wake.wait(lock, [&] { return _is_stopping || _jobs.empty() == false; });
+                if (_is_stopping) { return; }
+                job = _jobs.back();
+                ++job->active_workers;
+            }
+            run_job(*job);
+            std::lock_guard lock{_mutex};
+            // run_job() only returns once every index is claimed, so the job can be unlisted
+            if (const auto it = std::find(_jobs.begin(), _jobs.end(), job); it != _jobs.end()) { _jobs.erase(it); }
+            --job->active_workers;
+            _finished.notify_all();
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &body, size_t grain) {
+        if (count == 0) { return; }
+        if (_workers.empty() || count <= grain) {
+            for (size_t i = 0; i < count; ++i) { body(i); }
+            return;
+        }
+
+        Job job;
+        job.body  = &body;
+        job.count = count;
+        job.grain = std::max<size_t>(grain, 1);
+        {
+            std::lock_guard lock{_mutex};
+            _jobs.push_back(&job);
+        }
+        _wake.notify_all();
+
+        run_job(job);
+
+        std::unique_lock lock{_mutex};
+        if (const auto it = std::find(_jobs.begin(), _jobs.end(), &job); it != _jobs.end()) { _jobs.erase(it); }
+        _finished.wait(lock, [&] { return job.done.load() == job.count && job.active_workers == 0; });
+        lock.unlock();
+        if (job.error != nullptr) { std::rethrow_exception(job.error); }
+    }
+
+    ThreadPool &global_thread_pool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+} // namespace g3d
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace g3d {
+/* Definitions */
+    // A fixed set of workers for the CPU analyses. parallel_for() blocks until every index has run;
+    // the calling thread takes part in the work, so nested calls cannot deadlock. When a body throws, the
+    // indices not yet started are skipped and parallel_for() rethrows the first exception once every thread is out.
+    struct ThreadPool {
+        explicit ThreadPool(uint32_t thread_count = std::thread::hardware_concurrency());
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Runs body(i) for i in [0, count), handing out indices in chunks of `grain`
+        void parallel_for(size_t count, const std::function<void(size_t)> &body, size_t grain = 1);
+        uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()) + 1; }
+
+      private:
+        struct Job {
+            const std::function<void(size_t)> *body{nullptr};
+            size_t count{0}, grain{1};
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::atomic<bool> has_failed{false};
+            std::mutex error_mutex;
+            std::exception_ptr error; // the first one a body threw
+            uint32_t active_workers{0}; // guarded by _mutex; the job must outlive every worker inside it
+        };
+        void worker_loop();
+        static void run_job(Job &job);
+
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wake, _finished;
+        std::vector<Job *> _jobs; // jobs with unclaimed indices
+        bool _is_stopping{false};
+    };
+
+    ThreadPool &global_thread_pool();
+} // namespace g3d
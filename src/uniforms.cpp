@@ -0,0 +1,85 @@
+#include "uniforms.hpp"
+
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+namespace g3d {
+
+    static std::unordered_map<std::string, UniformName> &interned_uniform_names() {
+        static std::unordered_map<std::string, UniformName> names;
+        return names;
+    }
+
+    UniformName intern_uniform_name(std::string_view name) {
+        auto &names = interned_uniform_names();
+        auto [it, inserted] = names.try_emplace(std::string{name}, static_cast<UniformName>(names.size()));
+        return it->second;
+    }
+
+    void UniformTable::on_program_linked(HandleProgram program) {
+        this->program = program;
+        locations.clear();
+
+        int link_status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+        if (link_status != GL_TRUE) { return; }
+
+        int uniform_count = 0, max_name_length = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+        std::string name(max_name_length, '\0');
+        for (int i = 0; i < uniform_count; ++i) {
+            int name_length = 0;
+            glGetActiveUniformName(program, i, max_name_length, &name_length, name.data());
+            std::string_view uniform_name{name.data(), static_cast<size_t>(name_length)};
+
+            const auto location = glGetUniformLocation(program, name.c_str());
+            if (location == -1) { continue; } // members of uniform blocks
+
+            // arrays are reported as "name[0]", but are referred to by their plain name
+            if (uniform_name.ends_with("[0]")) { uniform_name.remove_suffix(3); }
+
+            const auto interned = intern_uniform_name(uniform_name);
+            if (interned >= locations.size()) { locations.resize(interned + 1, -1); }
+            locations[interned] = location;
+        }
+    }
+
+    void FrameUniformBuffer::create() {
+        glCreateBuffers(1, &handle);
+        glNamedBufferStorage(handle, sizeof(FrameTransforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    void FrameUniformBuffer::upload(const FrameTransforms &transforms) {
+        glNamedBufferSubData(handle, 0, sizeof(FrameTransforms), &transforms);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, handle);
+    }
+
+    void uniform1f(const UniformTable &table, UniformName name, float value) {
+        const auto location = table.location(name);
+        if (location == -1) { return; }
+        glProgramUniform1f(table.program, location, value);
+    }
+
+    void uniform1ui(const UniformTable &table, UniformName name, uint32_t value) {
+        const auto location = table.location(name);
+        if (location == -1) { return; }
+        glProgramUniform1ui(table.program, location, value);
+    }
+
+    void uniform3f(const UniformTable &table, UniformName name, glm::vec3 value) {
+        const auto location = table.location(name);
+        if (location == -1) { return; }
+        glProgramUniform3fv(table.program, location, 1, &value.x);
+    }
+
+    void uniformm4(const UniformTable &table, UniformName name, const glm::mat4 &value) {
+        const auto location = table.location(name);
+        if (location == -1) { return; }
+        glProgramUniformMatrix4fv(table.program, location, 1, GL_FALSE, &value[0][0]);
+    }
+
+} // namespace g3d
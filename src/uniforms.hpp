@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <renderer.hpp>
+
+namespace g3d {
+/* Typedefs */
+    typedef uint32_t UniformName;
+    inline constexpr UniformName INVALID_UNIFORM_NAME = ~0u;
+
+/* Definitions */
+    // Maps a uniform name onto a small, process-wide index. The same string always yields the same index.
+    UniformName intern_uniform_name(std::string_view name);
+
+    // Locations of every active uniform of one program, queried once per link
+    // and stored in a flat table indexed by interned names.
+    struct UniformTable {
+        void on_program_linked(HandleProgram program);
+        int32_t location(UniformName name) const {
+            return name < locations.size() ? locations[name] : -1;
+        }
+
+        HandleProgram program{0};
+        std::vector<int32_t> locations;
+    };
+
+    // Per-frame data shared by every scene shader through the FrameTransforms uniform block.
+    struct FrameTransforms {
+        glm::mat4 v;
+        glm::mat4 p;
+    };
+    struct FrameUniformBuffer {
+        static constexpr uint32_t BINDING = 0;
+
+        void create();
+        void upload(const FrameTransforms &transforms);
+
+        HandleBuffer handle{0};
+    };
+
+    void uniform1f(const UniformTable &table, UniformName name, float value);
+    void uniform1ui(const UniformTable &table, UniformName name, uint32_t value);
+    void uniform3f(const UniformTable &table, UniformName name, glm::vec3 value);
+    void uniformm4(const UniformTable &table, UniformName name, const glm::mat4 &value);
+} // namespace g3d
@@ -0,0 +1,70 @@
+# End to end run of the headless exporter: writes a small text project, exports it to every kind of file and
+# checks the exit codes, 0 when every job succeeded, 1 when a job failed and 2 for a bad command line.
+# cmake -DBATCH=<3dcalculator_batch> -DWORK_DIR=<scratch folder> -P batch_cli_test.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(WRITE "${WORK_DIR}/surfaces.3dg" "[Functions]
+f sin(x*3.0 + TIME) * cos(z*2.0) * a
+g sqrt(x) + k
+[Surfaces]
+f 0.5 0.5 0.5 1
+g 0.5 0.5 0.5 1
+[Constants]
+k 0.5
+[Sliders]
+a 2 0 4
+[Plane Settings]
+2 16 1 0.98 1
+")
+file(READ "${WORK_DIR}/surfaces.3dg" project)
+string(REPLACE "2 16 1 0.98 1" "2 0 1 0.98 1" project "${project}")
+file(WRITE "${WORK_DIR}/no_detail.3dg" "${project}")
+file(WRITE "${WORK_DIR}/manifest.txt" "# jobs of one project share its load
+--project surfaces.3dg --export from_manifest.obj
+--project surfaces.3dg --export from_manifest.r32 --surface f --time 0.5
+--project surfaces.3dg --export from_manifest.hfh --detail 40
+")
+
+function(expect_exit expected)
+    execute_process(COMMAND "${BATCH}" ${ARGN} WORKING_DIRECTORY "${WORK_DIR}" RESULT_VARIABLE code OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT code STREQUAL "${expected}")
+        message(FATAL_ERROR "'${ARGN}' exited with ${code}, expected ${expected}\n${out}${err}")
+    endif()
+endfunction()
+
+function(expect_file name magic)
+    if(NOT EXISTS "${WORK_DIR}/${name}")
+        message(FATAL_ERROR "${name} was not written")
+    endif()
+    file(READ "${WORK_DIR}/${name}" head LIMIT 4 HEX)
+    if(NOT magic STREQUAL "" AND NOT head STREQUAL "${magic}")
+        message(FATAL_ERROR "${name} starts with ${head}, expected ${magic}")
+    endif()
+endfunction()
+
+expect_exit(0 --help)
+
+expect_exit(0 --project surfaces.3dg --export surfaces.hfz)
+expect_file(surfaces.hfz "48465a31") # "HFZ1"
+expect_exit(0 --project surfaces.3dg --export surfaces.png --surface g --detail 33)
+expect_file(surfaces.png "89504e47")
+expect_exit(0 --project surfaces.3dg --export surfaces.glb --bad-vertices patch --time 1.5)
+expect_file(surfaces.glb "676c5446") # "glTF"
+expect_exit(0 --manifest manifest.txt --jobs 2)
+expect_file(from_manifest.obj "")
+expect_file(from_manifest.r32 "")
+expect_file(from_manifest.hfh "")
+
+# the command line is fine, a job is not
+expect_exit(1 --project missing.3dg --export missing.glb)
+expect_exit(1 --project no_detail.3dg --export no_detail.glb)
+expect_exit(1 --project surfaces.3dg --export unknown.png --surface h)
+
+# the command line itself is wrong
+expect_exit(2)
+expect_exit(2 --project surfaces.3dg)
+expect_exit(2 --project surfaces.3dg --export surfaces.stl)
+expect_exit(2 --project surfaces.3dg --export surfaces.glb --detail 20000)
+expect_exit(2 --project surfaces.3dg --export surfaces.glb --frobnicate 1)
+expect_exit(2 --manifest missing.txt)
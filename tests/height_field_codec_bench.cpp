@@ -0,0 +1,90 @@
+// Throughput of g3d::HeightFieldCodec next to writing the raw float32 grid, which is what a snapshot or sequence
+// frame costs without it. Prints the compression ratio and the encode, decode and write rates in GB/s of raw floats.
+// Usage: height_field_codec_bench [side] [surfaces], defaults to a 1024 x 1024 grid with 2 surfaces.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <height_field_codec.hpp>
+
+using g3d::HeightFieldCodec;
+
+static constexpr int REPETITIONS = 5;
+
+static std::vector<float> smooth_field(uint32_t side, uint32_t layers, float time) {
+    std::vector<float> values((size_t)side * side * layers);
+    for (uint32_t l = 0; l < layers; ++l) {
+        for (uint32_t z = 0; z < side; ++z) {
+            for (uint32_t x = 0; x < side; ++x) {
+                const auto fx = 8.0f * x / side, fz = 11.0f * z / side;
+                values[((size_t)l * side + z) * side + x] = std::sin(fx + time) * std::cos(fz - time) * (l + 1.0f) + 0.25f * l;
+            }
+        }
+    }
+    return values;
+}
+
+// fastest of a few runs, in seconds
+template <typename F>
+static double best_time(F &&run) {
+    double best = 1e30;
+    for (int i = 0; i < REPETITIONS; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+    return best;
+}
+
+static double write_file(const std::filesystem::path &path, const void *data, size_t size) {
+    return best_time([&] {
+        auto *file = std::fopen(path.string().c_str(), "wb");
+        if (file == nullptr) { std::printf("cannot open %s\n", path.string().c_str()); std::exit(1); }
+        std::fwrite(data, 1, size, file);
+        std::fclose(file);
+    });
+}
+
+static void report(const char *name, const std::vector<float> &values, uint32_t side, uint32_t layers, const float *reference,
+                   const std::filesystem::path &path) {
+    const auto raw_size = values.size() * sizeof(float);
+    std::vector<uint8_t> encoded;
+    std::vector<float> decoded;
+    const auto encode_time = best_time([&] { encoded = HeightFieldCodec::encode(values.data(), side, side, layers, reference); });
+    const auto decode_time = best_time([&] { decoded = HeightFieldCodec::decode(encoded.data(), encoded.size(), reference, reference ? values.size() : 0); });
+    const auto raw_write_time = write_file(path, values.data(), raw_size);
+    const auto encoded_write_time = write_file(path, encoded.data(), encoded.size());
+    const auto gb_per_s = [&](double seconds) { return raw_size / seconds * 1e-9; };
+
+    const auto is_exact = decoded.size() == values.size() && std::memcmp(decoded.data(), values.data(), raw_size) == 0;
+    std::printf("%-10s ratio %5.2f  encode %6.2f GB/s  decode %6.2f GB/s  raw write %6.2f GB/s  encode+write %6.2f GB/s%s\n", name,
+                (double)raw_size / encoded.size(), gb_per_s(encode_time), gb_per_s(decode_time), gb_per_s(raw_write_time),
+                gb_per_s(encode_time + encoded_write_time), is_exact ? "" : "  NOT BIT EXACT");
+}
+
+int main(int argc, char **argv) {
+    const auto side = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 1024u;
+    const auto layers = argc > 2 ? (uint32_t)std::strtoul(argv[2], nullptr, 10) : 2u;
+    if (side == 0 || layers == 0) {
+        std::printf("usage: height_field_codec_bench [side] [surfaces]\n");
+        return 1;
+    }
+
+    const auto path = std::filesystem::temp_directory_path() / "height_field_codec_bench.bin";
+    std::printf("%u x %u, %u surfaces, %.1f MB raw\n", side, side, layers, side * side * layers * sizeof(float) / 1e6);
+
+    const auto previous = smooth_field(side, layers, 0.0f);
+    const auto current = smooth_field(side, layers, 0.05f);
+    report("intra", current, side, layers, nullptr, path);
+    report("reference", current, side, layers, previous.data(), path);
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Round trips of g3d::HeightFieldCodec. The codec is lossless, so every decoded grid must match its source bit for
+// bit, NaN payloads and the sign of zero included. Returns non-zero and names the failing cases otherwise.
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <height_field_codec.hpp>
+
+using g3d::HeightFieldCodec;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &name) {
+    if (condition) { return; }
+    std::printf("FAILED: %s\n", name.c_str());
+    ++failures;
+}
+
+static bool is_bit_exact(const std::vector<float> &a, const std::vector<float> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+static void check_round_trip(const std::vector<float> &values, uint32_t width, uint32_t height, uint32_t layers, const std::string &name,
+                             const std::vector<float> *reference = nullptr) {
+    const auto *reference_data = reference ? reference->data() : nullptr;
+    const auto reference_count = reference ? reference->size() : 0;
+    try {
+        const auto encoded = HeightFieldCodec::encode(values.data(), width, height, layers, reference_data);
+        const auto decoded = HeightFieldCodec::decode(encoded.data(), encoded.size(), reference_data, reference_count);
+        check(is_bit_exact(values, decoded), name);
+    } catch (const std::exception &err) {
+        check(false, name + " (" + err.what() + ")");
+    }
+}
+
+static float from_bits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static std::vector<float> smooth_field(uint32_t width, uint32_t height, uint32_t layers, float time) {
+    std::vector<float> values((size_t)width * height * layers);
+    for (uint32_t l = 0; l < layers; ++l) {
+        for (uint32_t z = 0; z < height; ++z) {
+            for (uint32_t x = 0; x < width; ++x) {
+                const auto fx = 0.05f * x, fz = 0.07f * z;
+                values[((size_t)l * height + z) * width + x] = std::sin(fx + time) * std::cos(fz - time) * (l + 1.0f) + 0.25f * l;
+            }
+        }
+    }
+    return values;
+}
+
+int main() {
+    std::mt19937 rng{20241019};
+    const auto nan = std::numeric_limits<float>::quiet_NaN();
+    const auto inf = std::numeric_limits<float>::infinity();
+
+    // sizes around the block height and down to a single value
+    for (const uint32_t width : {1u, 2u, 3u, 63u, 64u, 65u, 127u}) {
+        for (const uint32_t height : {1u, 2u, 63u, 64u, 65u, 129u}) {
+            const auto name = std::to_string(width) + "x" + std::to_string(height);
+            check_round_trip(smooth_field(width, height, 1, 0.0f), width, height, 1, "smooth " + name);
+
+            std::vector<float> noise((size_t)width * height);
+            for (auto &v : noise) { v = from_bits(rng()); } // every bit pattern, NaNs with payloads among them
+            check_round_trip(noise, width, height, 1, "random bits " + name);
+        }
+    }
+
+    // values the prediction cannot form: NaN, infinities, signed zero and subnormals between smooth ones
+    {
+        const uint32_t side = 97;
+        auto values = smooth_field(side, side, 1, 0.3f);
+        const float specials[] = {nan, -nan, from_bits(0x7fa00001u), from_bits(0xffc12345u), inf, -inf, 0.0f, -0.0f,
+                                  std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::denorm_min(),
+                                  std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+        for (size_t i = 0; i < values.size(); i += 7) { values[i] = specials[(i / 7) % std::size(specials)]; }
+        check_round_trip(values, side, side, 1, "special values");
+
+        std::vector<float> nan_rows(values.size(), nan);
+        for (uint32_t x = 0; x < side; ++x) { nan_rows[(side / 2) * side + x] = values[x]; }
+        check_round_trip(nan_rows, side, side, 1, "NaN everywhere but one row");
+    }
+
+    // constant fields
+    for (const float constant : {0.0f, -0.0f, 1.0f, -3.5e7f, nan, inf, -inf}) {
+        check_round_trip(std::vector<float>(65 * 130, constant), 65, 130, 1, "constant " + std::to_string(constant));
+    }
+
+    // several surfaces back to back, unlike each other
+    {
+        const uint32_t width = 81, height = 70, layers = 4;
+        auto values = smooth_field(width, height, layers, 1.0f);
+        const size_t layer_size = (size_t)width * height;
+        std::fill(values.begin() + layer_size, values.begin() + 2 * layer_size, nan);
+        for (size_t i = 3 * layer_size; i < values.size(); ++i) { values[i] = from_bits(rng()); }
+        check_round_trip(values, width, height, layers, "multiple surfaces");
+    }
+
+    // frames coded against the previous one
+    {
+        const uint32_t width = 101, height = 101, layers = 2;
+        auto previous = smooth_field(width, height, layers, 0.0f);
+        for (int frame = 1; frame <= 4; ++frame) {
+            auto current = smooth_field(width, height, layers, 0.1f * frame);
+            check_round_trip(current, width, height, layers, "reference frame " + std::to_string(frame), &previous);
+            previous = std::move(current);
+        }
+
+        auto with_holes = previous;
+        for (size_t i = 0; i < with_holes.size(); i += 11) { with_holes[i] = nan; }
+        check_round_trip(previous, width, height, layers, "reference with NaN holes", &with_holes);
+        check_round_trip(with_holes, width, height, layers, "NaN holes against a full reference", &previous);
+        check_round_trip(previous, width, height, layers, "unchanged frame", &previous);
+
+        std::vector<float> unrelated(previous.size());
+        for (auto &v : unrelated) { v = from_bits(rng()); }
+        check_round_trip(unrelated, width, height, layers, "frame unrelated to its reference", &previous);
+
+        // a reference of another size must be refused, not read past
+        const auto encoded = HeightFieldCodec::encode(previous.data(), width, height, layers, previous.data());
+        bool is_refused = false;
+        try { HeightFieldCodec::decode(encoded.data(), encoded.size(), previous.data(), previous.size() - 1); } catch (const std::runtime_error &) { is_refused = true; }
+        check(is_refused, "reference of the wrong size");
+    }
+
+    // truncated streams throw instead of decoding garbage
+    {
+        const auto values = smooth_field(65, 65, 1, 0.0f);
+        const auto encoded = HeightFieldCodec::encode(values.data(), 65, 65, 1);
+        for (const size_t size : {(size_t)0, (size_t)4, encoded.size() / 2, encoded.size() - 1}) {
+            bool is_refused = false;
+            try { HeightFieldCodec::decode(encoded.data(), size); } catch (const std::runtime_error &) { is_refused = true; }
+            check(is_refused, "truncated to " + std::to_string(size) + " bytes");
+        }
+    }
+
+    if (failures == 0) { std::printf("height_field_codec: all round trips are bit exact\n"); }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+// Saves projects in both formats with g3d::save_project_text / save_project_binary and loads them back with
+// g3d::load_project. Everything a format stores must come back unchanged. Binary files with records shorter than
+// this version's (older writers) or longer (newer ones) must load the fields both know. Settings outside the
+// ranges the loader accepts must throw. Returns non-zero and names the failing cases otherwise.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <project_file.hpp>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &name) {
+    if (condition) { return; }
+    std::printf("FAILED: %s\n", name.c_str());
+    ++failures;
+}
+
+static Project sample_project() {
+    Project project;
+    project.functions = {
+        {"f", "sin(x * a) + cos(z) * k", true, {0.25f, 0.5f, 0.75f, 1.0f}},
+        {"g", "f(x, z) * 0.1 + height(x, z)", false},
+        {"h", "x*x - z*z", true, {1.0f, 0.0f, 0.1f, 0.5f}},
+    };
+    project.sliders = {{"a", 0.3f}, {"b", -2.5f}};
+    project.sliders[0].min = -1.0f;
+    project.sliders[0].max = 4.0f;
+    project.sliders[1].min = -10.0f;
+    project.constants = {{"k", 1.0f / 3.0f}, {"big", 1e30f}};
+
+    DataSource grid{.name = "height", .path = "maps/terrain height.png", .sampling = g3d::DataSampling::Bicubic, .domain = {-2.0f, 3.0f, -1.5f, 0.5f}};
+    DataSource scattered{.name = "wells", .path = "wells.xyz", .is_scattered = true,
+                         .scattered_settings = {g3d::ScatteredInterpolation::RadialBasis, 7, 1.5f}};
+    project.data_sources = {grid, scattered};
+
+    auto &ps = project.settings;
+    ps.color_background = {0.1f, 0.2f, 0.3f, 1.0f};
+    ps.color_grid       = {0.9f, 0.8f, 0.7f, 0.6f};
+    ps.color_plane      = {0.5f, 0.5f, 0.5f, 1.0f};
+    ps.color_plane_grid = {0.0f, 1.0f, 0.0f, 0.25f};
+    ps.bounds = 7, ps.detail = 321, ps.grid_step = 0.125f, ps.grid_line_thickness = 0.9f, ps.is_detail_affecting_grid_step = 0;
+    ps.is_grid_rendered = 0, ps.is_plane_grid_rendered = 1, ps.is_render_on_demand = 0;
+    ps.target_fps = 144.0f, ps.unfocused_target_fps = 5.0f, ps.is_dynamic_resolution = 0;
+    ps.gpu_frame_budget_ms = 4.5f, ps.min_resolution_scale = 0.3f, ps.font_idx = 3;
+    return project;
+}
+
+static bool same_functions(const Project &a, const Project &b) {
+    if (a.functions.size() != b.functions.size()) { return false; }
+    for (size_t i = 0; i < a.functions.size(); ++i) {
+        const auto &x = a.functions[i], &y = b.functions[i];
+        // only surfaces have a color worth storing
+        if (x.name != y.name || x.value != y.value || x.is_surface != y.is_surface || (x.is_surface && x.color != y.color)) { return false; }
+    }
+    return true;
+}
+
+static bool same_variables(const Project &a, const Project &b) {
+    if (a.sliders.size() != b.sliders.size() || a.constants.size() != b.constants.size()) { return false; }
+    for (size_t i = 0; i < a.sliders.size(); ++i) {
+        const auto &x = a.sliders[i], &y = b.sliders[i];
+        if (x.name != y.name || x.value != y.value || x.min != y.min || x.max != y.max) { return false; }
+    }
+    for (size_t i = 0; i < a.constants.size(); ++i) {
+        if (a.constants[i].name != b.constants[i].name || a.constants[i].value != b.constants[i].value) { return false; }
+    }
+    return true;
+}
+
+static bool same_data_sources(const Project &a, const Project &b) {
+    if (a.data_sources.size() != b.data_sources.size()) { return false; }
+    for (size_t i = 0; i < a.data_sources.size(); ++i) {
+        const auto &x = a.data_sources[i], &y = b.data_sources[i];
+        if (x.name != y.name || x.path != y.path || x.sampling != y.sampling || x.is_scattered != y.is_scattered) { return false; }
+        // the text format keeps no domain for scattered points, they follow the plane
+        if (x.is_scattered ? x.scattered_settings != y.scattered_settings : x.domain != y.domain) { return false; }
+    }
+    return true;
+}
+
+static void check_round_trip(const Project &saved, const Project &loaded, const std::string &name) {
+    check(same_functions(saved, loaded), name + " functions");
+    check(same_variables(saved, loaded), name + " sliders and constants");
+    check(same_data_sources(saved, loaded), name + " data sources");
+    check(saved.settings == loaded.settings, name + " settings");
+}
+
+static bool is_refused(const std::string &path) {
+    try {
+        Project project;
+        g3d::load_project(path, project);
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+// The binary layout of project_file.hpp: a 16 byte header holding the section count at byte 8, then the table of
+// {id, record size, offset, size} entries. Rewrites every record of section `id` to `record_size` bytes, cut short or
+// padded with `fill`, as an older or a newer writer would have stored it.
+static constexpr uint32_t SECTION_SETTINGS = 5;
+
+static void resize_records(const std::string &path, uint32_t id, uint32_t record_size, uint8_t fill = 0) {
+    std::ifstream in{path, std::ios::binary};
+    std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    in.close();
+
+    struct Entry { uint32_t id, record_size; uint64_t offset, size; };
+    uint32_t section_count;
+    std::memcpy(&section_count, bytes.data() + 8, sizeof(section_count));
+    for (uint32_t i = 0; i < section_count; ++i) {
+        auto *at = bytes.data() + 16 + i * sizeof(Entry);
+        Entry entry;
+        std::memcpy(&entry, at, sizeof(entry));
+        if (entry.id != id) { continue; }
+
+        std::vector<uint8_t> section;
+        for (uint64_t offset = 0; offset < entry.size; offset += entry.record_size) {
+            const auto *record = bytes.data() + entry.offset + offset;
+            const auto kept = std::min(record_size, entry.record_size);
+            section.insert(section.end(), record, record + kept);
+            section.insert(section.end(), record_size - kept, fill);
+        }
+        bytes.resize((bytes.size() + 7) & ~size_t{7}, 0);
+        entry = {id, record_size, bytes.size(), section.size()};
+        bytes.insert(bytes.end(), section.begin(), section.end());
+        std::memcpy(bytes.data() + 16 + i * sizeof(Entry), &entry, sizeof(entry));
+    }
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+int main() {
+    const auto directory = std::filesystem::temp_directory_path() / "project_file_test";
+    std::filesystem::create_directories(directory);
+    const auto text_path = (directory / "project.3dg").string(), binary_path = (directory / "project.3dgb").string();
+    const auto saved = sample_project();
+
+    try {
+        g3d::save_project_text(text_path, saved);
+        Project loaded;
+        g3d::load_project(text_path, loaded);
+        check_round_trip(saved, loaded, "text");
+        check(loaded.snapshot.empty(), "text keeps no snapshot");
+    } catch (const std::exception &err) {
+        check(false, std::string{"text ("} + err.what() + ")");
+    }
+
+    // binary files also embed data source values and the height field snapshot
+    auto embedded = saved;
+    {
+        auto &grid = embedded.data_sources[0];
+        grid.is_embedded = true;
+        g3d::DataGrid values{5, 3, {}};
+        for (uint32_t i = 0; i < values.width * values.height; ++i) { values.values.push_back(std::sin(0.7f * i) * 100.0f); }
+        values.values[4] = std::nanf("");
+        grid.grid = std::make_shared<const g3d::DataGrid>(std::move(values));
+
+        auto &scattered = embedded.data_sources[1];
+        scattered.is_embedded = true;
+        std::vector<g3d::DataPoint> points;
+        for (int i = 0; i < 40; ++i) { points.push_back({std::cos(i * 0.3) * i, std::sin(i * 0.3) * i, 0.5 * i}); }
+        scattered.points = std::make_shared<const g3d::ScatteredData>(g3d::build_scattered_data(points));
+
+        embedded.snapshot = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    }
+    try {
+        g3d::save_project_binary(binary_path, embedded);
+        Project loaded;
+        g3d::load_project(binary_path, loaded);
+        check_round_trip(embedded, loaded, "binary");
+        check(loaded.snapshot == embedded.snapshot, "binary snapshot");
+
+        const auto &grid = loaded.data_sources[0].grid;
+        const auto &values = embedded.data_sources[0].grid->values;
+        check(grid != nullptr && grid->width == 5 && grid->height == 3 && grid->values.size() == values.size() &&
+                  std::memcmp(grid->values.data(), values.data(), values.size() * sizeof(float)) == 0,
+              "binary embedded grid");
+
+        // the tree order is rebuilt on load, the points themselves must all be there
+        const auto &points = loaded.data_sources[1].points;
+        const auto by_position = [](const g3d::DataPoint &a, const g3d::DataPoint &b) { return std::tie(a.x, a.z, a.y) < std::tie(b.x, b.z, b.y); };
+        auto expected = embedded.data_sources[1].points->points, actual = points ? points->points : std::vector<g3d::DataPoint>{};
+        std::sort(expected.begin(), expected.end(), by_position);
+        std::sort(actual.begin(), actual.end(), by_position);
+        check(std::equal(expected.begin(), expected.end(), actual.begin(), actual.end(),
+                         [](const g3d::DataPoint &a, const g3d::DataPoint &b) { return a.x == b.x && a.z == b.z && a.y == b.y; }),
+              "binary embedded points");
+    } catch (const std::exception &err) {
+        check(false, std::string{"binary ("} + err.what() + ")");
+    }
+
+    // a settings record from before the render settings existed: those keep the values the project comes in with
+    try {
+        g3d::save_project_binary(binary_path, saved);
+        resize_records(binary_path, SECTION_SETTINGS, offsetof(ProjectSettings, is_grid_rendered));
+        Project loaded;
+        loaded.settings.target_fps = 30.0f;
+        loaded.settings.font_idx   = 4;
+        g3d::load_project(binary_path, loaded);
+
+        auto expected = saved.settings;
+        const ProjectSettings defaults;
+        expected.is_grid_rendered = defaults.is_grid_rendered, expected.is_plane_grid_rendered = defaults.is_plane_grid_rendered;
+        expected.is_render_on_demand = defaults.is_render_on_demand, expected.target_fps = 30.0f;
+        expected.unfocused_target_fps = defaults.unfocused_target_fps, expected.is_dynamic_resolution = defaults.is_dynamic_resolution;
+        expected.gpu_frame_budget_ms = defaults.gpu_frame_budget_ms, expected.min_resolution_scale = defaults.min_resolution_scale;
+        expected.font_idx = 4;
+        check(loaded.settings == expected, "older settings record");
+        check(same_functions(saved, loaded) && same_variables(saved, loaded), "older settings record, other sections");
+    } catch (const std::exception &err) {
+        check(false, std::string{"older settings record ("} + err.what() + ")");
+    }
+
+    // every record section grown by fields a newer version added, which this one skips
+    try {
+        g3d::save_project_binary(binary_path, saved);
+        for (uint32_t id = 2; id <= 7; ++id) {
+            if (id == 6) { continue; } // the snapshot is a blob
+            resize_records(binary_path, id, id == SECTION_SETTINGS ? sizeof(ProjectSettings) + 12 : 200, 0xab);
+        }
+        Project loaded;
+        g3d::load_project(binary_path, loaded);
+        check_round_trip(saved, loaded, "newer records");
+    } catch (const std::exception &err) {
+        check(false, std::string{"newer records ("} + err.what() + ")");
+    }
+
+    // a text project from before the later render settings: a short line leaves the rest as they were
+    try {
+        g3d::save_project_text(text_path, saved);
+        std::ifstream in{text_path, std::ios::binary};
+        std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        in.close();
+        const auto line = text.find("[Render Settings]\n") + std::strlen("[Render Settings]\n");
+        text.replace(line, text.find('\n', line) - line, "1 0 1");
+        std::ofstream{text_path, std::ios::binary | std::ios::trunc} << text;
+
+        Project loaded;
+        loaded.settings.target_fps = 75.0f;
+        g3d::load_project(text_path, loaded);
+        check(loaded.settings.is_grid_rendered == 1 && loaded.settings.is_plane_grid_rendered == 0 && loaded.settings.is_render_on_demand == 1 &&
+                  loaded.settings.target_fps == 75.0f && loaded.settings.detail == saved.settings.detail,
+              "older text render settings");
+    } catch (const std::exception &err) {
+        check(false, std::string{"older text render settings ("} + err.what() + ")");
+    }
+
+    // settings the plane cannot be built from, in either format
+    for (const auto &[what, change] : std::initializer_list<std::pair<const char *, void (*)(ProjectSettings &)>>{
+             {"detail 0", [](ProjectSettings &ps) { ps.detail = 0; }},
+             {"detail past the maximum", [](ProjectSettings &ps) { ps.detail = g3d::PROJECT_MAX_DETAIL + 1; }},
+             {"bounds past the maximum", [](ProjectSettings &ps) { ps.bounds = g3d::PROJECT_MAX_BOUNDS + 1; }},
+             {"NaN grid step", [](ProjectSettings &ps) { ps.grid_step = std::nanf(""); }},
+             {"negative grid step", [](ProjectSettings &ps) { ps.grid_step = -1.0f; }},
+         }) {
+        auto project = saved;
+        change(project.settings);
+        g3d::save_project_text(text_path, project);
+        g3d::save_project_binary(binary_path, project);
+        check(is_refused(text_path), std::string{"text refuses "} + what);
+        check(is_refused(binary_path), std::string{"binary refuses "} + what);
+    }
+
+    std::filesystem::remove_all(directory);
+    if (failures == 0) { std::printf("project_file: every project read back unchanged\n"); }
+    return failures == 0 ? 0 : 1;
+}
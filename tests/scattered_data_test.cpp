@@ -0,0 +1,118 @@
+// k-nearest queries on the k-d tree of g3d::build_scattered_data, checked against a brute force scan of the same
+// points: the distances must be the same k smallest, nearest first, and every index must name a distinct point at
+// the distance reported for it. Returns non-zero and names the failing cases otherwise.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <scattered_data.hpp>
+
+using g3d::DataPoint;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &name) {
+    if (condition) { return; }
+    std::printf("FAILED: %s\n", name.c_str());
+    ++failures;
+}
+
+static double distance_squared(const DataPoint &p, double x, double z) { return (x - p.x) * (x - p.x) + (z - p.z) * (z - p.z); }
+
+static bool matches_brute_force(const g3d::ScatteredData &data, double x, double z, uint32_t k, std::vector<g3d::Neighbour> &found) {
+    g3d::nearest_points(data, x, z, k, found);
+
+    std::vector<double> expected;
+    for (const auto &p : data.points) { expected.push_back(distance_squared(p, x, z)); }
+    const auto count = std::min<size_t>(k, expected.size());
+    std::partial_sort(expected.begin(), expected.begin() + count, expected.end());
+    expected.resize(count);
+
+    if (found.size() != expected.size()) { return false; }
+    std::set<uint32_t> indices;
+    for (size_t i = 0; i < found.size(); ++i) {
+        const auto &n = found[i];
+        if (n.index >= data.points.size() || indices.insert(n.index).second == false) { return false; }
+        if (n.distance_squared != expected[i] || distance_squared(data.points[n.index], x, z) != n.distance_squared) { return false; }
+    }
+    return true;
+}
+
+static void check_queries(const std::vector<DataPoint> &points, const std::string &name, std::mt19937 &rng) {
+    try {
+        const auto data = g3d::build_scattered_data(points);
+        check(data.points.size() == points.size(), name + " keeps every point");
+
+        const auto margin = 0.5 * std::max(data.x_max - data.x_min, data.z_max - data.z_min) + 1.0;
+        std::uniform_real_distribution<double> along_x{data.x_min - margin, data.x_max + margin}, along_z{data.z_min - margin, data.z_max + margin};
+        std::vector<g3d::Neighbour> found;
+        for (const uint32_t k : {1u, 2u, 8u, 9u, 12u, 33u}) {
+            bool is_exact = true;
+            // queries around the data and far outside it, and on the points themselves
+            for (int i = 0; i < 200; ++i) { is_exact &= matches_brute_force(data, along_x(rng), along_z(rng), k, found); }
+            is_exact &= matches_brute_force(data, data.x_max + 1e6, data.z_min - 1e6, k, found);
+            for (size_t i = 0; i < data.points.size(); i += 1 + data.points.size() / 50) {
+                is_exact &= matches_brute_force(data, data.points[i].x, data.points[i].z, k, found);
+            }
+            check(is_exact, name + " k = " + std::to_string(k));
+        }
+    } catch (const std::exception &err) {
+        check(false, name + " (" + err.what() + ")");
+    }
+}
+
+int main() {
+    std::mt19937 rng{20241019};
+    std::uniform_real_distribution<double> unit{-1.0, 1.0};
+
+    // sizes around the leaf size and big enough for the parallel top levels
+    for (const size_t count : {1, 2, 7, 8, 9, 17, 100, 1000, 20000}) {
+        std::vector<DataPoint> points(count);
+        for (auto &p : points) { p = {unit(rng) * 10.0, unit(rng) * 3.0, unit(rng)}; }
+        check_queries(points, "uniform " + std::to_string(count), rng);
+    }
+
+    // ties everywhere: a coarse lattice with every point several times
+    {
+        std::vector<DataPoint> points;
+        for (int copy = 0; copy < 3; ++copy) {
+            for (int x = -6; x <= 6; ++x) {
+                for (int z = -6; z <= 6; ++z) { points.push_back({(double)x, (double)z, (double)copy}); }
+            }
+        }
+        check_queries(points, "lattice with duplicates", rng);
+    }
+
+    // degenerate spreads: one line, one spot, tight clusters far apart
+    {
+        std::vector<DataPoint> line, spot, clusters;
+        for (int i = 0; i < 500; ++i) {
+            line.push_back({unit(rng) * 50.0, 2.0, unit(rng)});
+            spot.push_back({1.5, -0.5, unit(rng)});
+            const auto centre = (i % 4) * 1000.0;
+            clusters.push_back({centre + unit(rng) * 1e-3, -centre + unit(rng) * 1e-3, unit(rng)});
+        }
+        check_queries(line, "points on a line", rng);
+        check_queries(spot, "coincident points", rng);
+        check_queries(clusters, "distant clusters", rng);
+    }
+
+    // points that cannot be placed are dropped before the tree is built
+    {
+        const auto nan = std::nan("");
+        const auto data = g3d::build_scattered_data({{0.0, 0.0, 1.0}, {nan, 1.0, 1.0}, {1.0, 1.0, nan}, {2.0, 0.0, 3.0}});
+        check(data.points.size() == 2, "non-finite points dropped");
+        bool is_refused = false;
+        try { g3d::build_scattered_data({{nan, 0.0, 0.0}}); } catch (const std::runtime_error &) { is_refused = true; }
+        check(is_refused, "no finite points");
+    }
+
+    if (failures == 0) { std::printf("scattered_data: every query matches the brute force scan\n"); }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// Writes short height sequences with g3d::export_height_sequence and reads them back with g3d::HeightSequenceReader.
+// Frames are coded losslessly, so every frame read must match a fresh evaluation at its TIME bit for bit.
+// Corrupt and truncated files must throw before anything is allocated from them.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <expression.hpp>
+#include <sequence_export.hpp>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &name) {
+    if (condition) { return; }
+    std::printf("FAILED: %s\n", name.c_str());
+    ++failures;
+}
+
+static bool is_bit_exact(const std::vector<float> &a, const std::vector<float> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+static void check_round_trip(const std::string &stem, const std::vector<g3d::Program> &programs, const std::vector<double> &parameters,
+                             uint32_t detail, double bounds, const g3d::SequenceSettings &settings, const std::string &name) {
+    try {
+        g3d::export_height_sequence(stem, programs, parameters, detail, bounds, settings);
+        g3d::HeightSequenceReader reader{stem + ".hseq"};
+        check(reader.detail() == detail && reader.surface_count() == programs.size() && reader.frame_count() == settings.frame_count &&
+                  reader.bounds() == static_cast<float>(bounds),
+              name + " header");
+
+        const auto value_count = static_cast<size_t>(detail + 1) * (detail + 1) * programs.size();
+        std::vector<float> heights, expected(value_count);
+        float time = 0.0f;
+        uint32_t frame = 0;
+        for (; reader.next(heights, time); ++frame) {
+            const auto t = settings.frame_count > 1 ? settings.t0 + (settings.t1 - settings.t0) * frame / (settings.frame_count - 1) : settings.t0;
+            g3d::evaluate_height_frame(programs, parameters, t, detail, bounds, expected.data());
+            check(time == static_cast<float>(t), name + " time of frame " + std::to_string(frame));
+            check(is_bit_exact(heights, expected), name + " frame " + std::to_string(frame));
+        }
+        check(frame == settings.frame_count, name + " frame count");
+    } catch (const std::exception &err) {
+        check(false, name + " (" + err.what() + ")");
+    }
+}
+
+static bool is_refused(const std::string &path) {
+    try {
+        g3d::HeightSequenceReader reader{path};
+        std::vector<float> heights;
+        float time;
+        while (reader.next(heights, time)) {}
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    const auto directory = std::filesystem::temp_directory_path() / "sequence_export_test";
+    std::filesystem::create_directories(directory);
+    const auto stem = (directory / "sequence").string();
+
+    const std::vector<Function> functions{{"f", "sin(x + TIME) * cos(z * a)", true}, {"g", "x * z - TIME * TIME + 1.0 / x", true}};
+    const std::vector<Slider> sliders{{"a", 0.75f}};
+    std::vector<g3d::Program> programs;
+    for (const auto &f : functions) { programs.push_back(g3d::compile_program(f.name, functions, {}, sliders)); }
+    const auto parameters = g3d::make_parameters(sliders, 0.0);
+
+    // keyframes, delta frames and a 1 / x pole through the middle of the grid (Inf and NaN heights)
+    check_round_trip(stem, programs, parameters, 32, 2.0, {7, 0.0, 1.5, 3, false}, "two surfaces, keyframe every 3");
+    check_round_trip(stem, {programs[0]}, parameters, 1, 1.0, {2, -1.0, 1.0, 30, false}, "smallest grid");
+    check_round_trip(stem, {programs[0]}, parameters, 100, 5.0, {1, 0.25, 0.25, 1, false}, "single frame");
+    check_round_trip(stem, programs, parameters, 17, 3.0, {5, 0.0, 0.0, 1, false}, "every frame a keyframe, constant TIME");
+
+    // a frame size past the end of the file: the size field of the first record follows the 32 byte header, flags and TIME
+    {
+        g3d::export_height_sequence(stem, programs, parameters, 16, 1.0, {3, 0.0, 1.0, 30, false});
+        const auto path = stem + ".hseq";
+        const auto bytes = std::filesystem::file_size(path);
+        {
+            std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+            const uint64_t size = uint64_t{1} << 60;
+            file.seekp(40);
+            file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        }
+        check(is_refused(path), "frame size past the end of the file");
+
+        g3d::export_height_sequence(stem, programs, parameters, 16, 1.0, {3, 0.0, 1.0, 30, false});
+        std::filesystem::resize_file(path, bytes - 1);
+        check(is_refused(path), "truncated last frame");
+    }
+
+    std::filesystem::remove_all(directory);
+    if (failures == 0) { std::printf("sequence_export: every frame read back bit exact\n"); }
+    return failures == 0 ? 0 : 1;
+}
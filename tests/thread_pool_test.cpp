@@ -0,0 +1,79 @@
+// g3d::ThreadPool::parallel_for: every index runs exactly once, nested calls from inside a body complete, and an
+// exception from a body reaches the caller only after every thread has left the job. Returns non-zero on failure.
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <thread_pool.hpp>
+
+using g3d::ThreadPool;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &name) {
+    if (condition) { return; }
+    std::printf("FAILED: %s\n", name.c_str());
+    ++failures;
+}
+
+static void check_each_index_once(ThreadPool &pool, size_t count, size_t grain, const std::string &name) {
+    std::vector<std::atomic<uint32_t>> runs(count);
+    pool.parallel_for(count, [&](size_t i) { runs[i].fetch_add(1); }, grain);
+    bool is_once = true;
+    for (const auto &r : runs) { is_once = is_once && r.load() == 1; }
+    check(is_once, name);
+}
+
+int main() {
+    // more threads than this machine may have, so the workers really share jobs
+    for (const uint32_t threads : {1u, 2u, 8u}) {
+        ThreadPool pool{threads};
+        const auto prefix = std::to_string(threads) + " threads: ";
+        for (const size_t count : {(size_t)0, (size_t)1, (size_t)7, (size_t)1000, (size_t)100003}) {
+            for (const size_t grain : {(size_t)1, (size_t)16, (size_t)5000}) {
+                check_each_index_once(pool, count, grain, prefix + std::to_string(count) + " indices in chunks of " + std::to_string(grain));
+            }
+        }
+
+        // every outer index runs an inner loop on the same pool
+        const size_t outer = 64, inner = 257;
+        std::vector<std::atomic<uint32_t>> runs(outer * inner);
+        pool.parallel_for(outer, [&](size_t i) {
+            pool.parallel_for(inner, [&](size_t j) { runs[i * inner + j].fetch_add(1); });
+        });
+        bool is_once = true;
+        for (const auto &r : runs) { is_once = is_once && r.load() == 1; }
+        check(is_once, prefix + "nested calls");
+
+        // a throwing body: the first exception comes back, the job stays usable afterwards
+        for (int round = 0; round < 20; ++round) {
+            std::atomic<size_t> started{0};
+            bool is_rethrown = false;
+            try {
+                pool.parallel_for(10000, [&](size_t i) {
+                    started.fetch_add(1);
+                    if (i % 997 == 13) { throw std::runtime_error{"body " + std::to_string(i)}; }
+                });
+            } catch (const std::runtime_error &err) {
+                is_rethrown = std::string{err.what()}.starts_with("body ");
+            }
+            check(is_rethrown, prefix + "exception reaches the caller");
+            check(started.load() <= 10000, prefix + "no index runs twice after a failure");
+        }
+        bool is_nested_rethrown = false;
+        try {
+            pool.parallel_for(32, [&](size_t i) {
+                pool.parallel_for(32, [&](size_t j) { if (i == 5 && j == 7) { throw std::logic_error{"inner"}; } });
+            });
+        } catch (const std::logic_error &) {
+            is_nested_rethrown = true;
+        }
+        check(is_nested_rethrown, prefix + "exception from a nested call");
+        check_each_index_once(pool, 5000, 3, prefix + "pool still works after failures");
+    }
+
+    if (failures == 0) { std::printf("thread_pool: all checks passed\n"); }
+    return failures == 0 ? 0 : 1;
+}